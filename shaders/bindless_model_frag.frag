@@ -0,0 +1,19 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) out vec4 out_color;
+
+// The storage buffers of the bindless table.
+layout(set = 0, binding = 1) readonly buffer Material {
+  vec4 color;
+} materials[];
+
+// Follows the vertex shader's model_view_proj_mat.
+layout(push_constant) uniform PushConstants {
+  layout(offset = 64) uint material_slot;
+};
+
+void main() {
+  out_color = materials[material_slot].color;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 430 
+
+layout(location = 0) in vec3 vert_pos;
+
+// Per instance. Translation in xyz and uniform scale in w.
+layout(location = 3) in vec4 instance_transform;
+
+// The depth prepass and the shaded pass must compute exactly the same depth for their depth
+// test to pass.
+invariant gl_Position;
+
+layout(std140, binding = 0) uniform Matrices {
+  mat4 model_mat;
+  mat4 view_mat;
+  mat4 proj_mat;
+};
+
+void main() {
+  vec3 world_pos = vert_pos * instance_transform.w + instance_transform.xyz;
+  gl_Position = proj_mat * view_mat * model_mat * vec4(world_pos, 1.0);
+}
\ No newline at end of file
@@ -1,16 +1,42 @@
 #include "app.h"
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <variant>
 #include <vector>
+#include "gal/gal_bindless_table.h"
 #include "gal/gal_command_buffer.h"
+#include "gal/gal_command_encoder.h"
 #include "gal/gal_commands.h"
+#include "gal/gal_compute_pipeline.h"
 #include "gal/gal_shader.h"
 #include "gal/gal_pipeline.h"
+#include "gal/gal_pipeline_cache.h"
 #include "gal/gal_platform.h"
+#include "gal/gal_profiler.h"
+#include "gal/gal_render_queue.h"
+#include "gal/gal_texture.h"
+#include "gal/gal_upload_manager.h"
+#include "gal/gal_worker_pool.h"
+#include "mesh/mesh.h"
+#include "mesh/mesh_cache.h"
+#include "mesh/mesh_generator.h"
+#include "mesh/mesh_optimizer.h"
+#include "mesh/obj_importer.h"
+#include "scene/bvh.h"
+#include "scene/frustum.h"
 #include "window/window.h"
 #include "window/window_manager.h"
 
@@ -21,55 +47,82 @@ struct Vertex {
   glm::vec3 color;
 };
 
-} // namespace
+// Matches Object in cull_comp.comp.
+struct CullObject {
+  glm::vec4 transform;
+  glm::vec4 bounds;
+  uint32_t index_count;
+  uint32_t first_index;
+  int32_t vertex_offset;
+  uint32_t padding;
+};
 
-App::App() {
-  window_manager_ = std::make_unique<window::WindowManager>();
-  window_ = window_manager_->CreateWindow(1920, 1080, "My Window");
+// Matches local_size_x in cull_comp.comp.
+const uint32_t kCullWorkGroupSize = 64;
 
-  gal_platform_ = std::make_unique<gal::GALPlatform>(window_);
+// Matches local_size_x in reduce_comp.comp. Each invocation sums two values.
+const uint32_t kReduceWorkGroupSize = 256;
+const uint32_t kReduceValuesPerGroup = 2 * kReduceWorkGroupSize;
 
-  // TODO(colintan): Make this into a separate class
-  std::ifstream vert_shader_file("shaders/triangle_vert.spv", std::ios::ate | std::ios::binary);
-  if (!vert_shader_file.is_open()) {
-    throw;
+// Returns false if the file cannot be read or the shader cannot be created.
+bool LoadShader(gal::GALPlatform* gal_platform, const std::string& path, gal::ShaderType type,
+                gal::GALShader* shader) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Could not open shader: " << path << std::endl;
+    return false;
   }
 
-  size_t vert_shader_file_size = static_cast<size_t>(vert_shader_file.tellg());
-  vert_shader_file.seekg(0);
+  size_t file_size = static_cast<size_t>(file.tellg());
+  file.seekg(0);
 
-  std::vector<std::byte> vert_shader_binary(vert_shader_file_size);
-  vert_shader_file.read(reinterpret_cast<char*>(vert_shader_binary.data()), vert_shader_file_size);
+  std::vector<std::byte> binary(file_size);
+  file.read(reinterpret_cast<char*>(binary.data()), file_size);
 
-  std::ifstream frag_shader_file("shaders/triangle_frag.spv", std::ios::ate | std::ios::binary);
-  if (!frag_shader_file.is_open()) {
-    throw;
+  return shader->CreateFromBinary(gal_platform, type, binary);
+}
+
+} // namespace
+
+App::App(const AppOptions& options) : options_(options) {
+  if (options_.headless) {
+    gal_platform_ = std::make_unique<gal::GALPlatform>(options_.width, options_.height,
+                                                       options_.platform_options);
+  } else {
+    window_manager_ = std::make_unique<window::WindowManager>();
+    window_ = window_manager_->CreateWindow(options_.width, options_.height, "My Window");
+
+    gal_platform_ = std::make_unique<gal::GALPlatform>(window_, options_.platform_options);
+  }
+
+  if (options_.profile) {
+    gal::GALProfiler::Options profiler_options;
+    profiler_options.pipeline_statistics = true;
+    gal_platform_->EnableProfiler(profiler_options);
   }
 
-  size_t frag_shader_file_size = static_cast<size_t>(frag_shader_file.tellg());
-  frag_shader_file.seekg(0);
+  // CPU culling and model imports also run on the workers, even if recording does not.
+  if (options_.parallel_recording || options_.cpu_culling || options_.cull_benchmark_size > 0 ||
+      !options_.model_path.empty()) {
+    gal_platform_->EnableWorkerThreads(0);
+  }
 
-  std::vector<std::byte> frag_shader_binary(frag_shader_file_size);
-  frag_shader_file.read(reinterpret_cast<char*>(frag_shader_binary.data()), frag_shader_file_size);
+  if (!options_.pipeline_cache_path.empty()) {
+    gal_platform_->EnablePipelineCache(options_.pipeline_cache_path);
+  }
 
   gal::GALShader vert_shader;
-  if (!vert_shader.CreateFromBinary(gal_platform_.get(), gal::ShaderType::Vertex, 
-                                    vert_shader_binary)) {
+  if (!LoadShader(gal_platform_.get(), "shaders/triangle_vert.spv", gal::ShaderType::Vertex,
+                  &vert_shader)) {
     throw;
   }
 
   gal::GALShader frag_shader;
-  if (!frag_shader.CreateFromBinary(gal_platform_.get(), gal::ShaderType::Fragment, 
-                                    frag_shader_binary)) {
+  if (!LoadShader(gal_platform_.get(), "shaders/triangle_frag.spv", gal::ShaderType::Fragment,
+                  &frag_shader)) {
     throw;
   }
 
-  gal::GALPipeline::Viewport viewport;
-  viewport.x = 0;
-  viewport.y = 0;
-  viewport.width = window_->GetWidth();
-  viewport.height = window_->GetHeight();
-
   gal::GALPipeline::VertexInput vert_input;
   vert_input.buffer_idx = 0;
   vert_input.stride = sizeof(Vertex);
@@ -94,17 +147,20 @@ App::App() {
     gal_pipeline_ = gal::GALPipeline::BeginBuild(gal_platform_.get())
         .SetShader(gal::ShaderType::Vertex, vert_shader)
         .SetShader(gal::ShaderType::Fragment, frag_shader)
-        .SetViewport(viewport)
         .AddVertexInput(vert_input)
         .AddVertexDesc(pos_desc)
         .AddVertexDesc(color_desc)
         .AddUniformDesc(uniform_desc)
+        // The triangle is a backdrop that everything else is drawn over.
+        .SetDepthTest(false)
         .Create();
   } catch (gal::Exception& e) {
     std::cerr << e.what() << std::endl;
     throw;
   }
 
+  PrintPipelineCacheStats();
+
   std::vector<Vertex> vertices = {
     {{0.f, -0.5f}, {1.f, 0.f, 0.f}},
     {{0.5f, 0.5f}, {0.f, 1.f, 0.f}},
@@ -122,52 +178,1309 @@ App::App() {
     throw;
   }
 
+  if (!options_.model_path.empty() || options_.synthetic_mesh_segments > 0) {
+    LoadModel();
+  }
+
+  if (options_.compute_benchmark_size > 0) {
+    CreateComputeBenchmark();
+  }
+
+  if (model_ != nullptr && options_.gpu_culling) {
+    CreateGpuCulling();
+  } else if (model_ != nullptr && options_.cpu_culling) {
+    CreateCpuCulling();
+  }
+
+  if (model_ != nullptr && options_.bindless) {
+    CreateBindlessMaterial();
+  }
+
+  if (model_ != nullptr) {
+    CreateModelPipeline();
+
+    // The model's matrices are written with command::SetUniformData.
+    options_.per_frame_recording = true;
+  }
+
+  if (model_ != nullptr && options_.render_queue && cull_pipeline_ == nullptr) {
+    // The instances' transforms are the queue's instance data, bound where the model pipeline
+    // expects them.
+    render_queue_ = std::make_unique<gal::GALRenderQueue>(sizeof(glm::vec4), 1);
+  }
+
+  gal::RecordingMode recording_mode = options_.per_frame_recording
+                                          ? gal::RecordingMode::PerFrame
+                                          : gal::RecordingMode::Persistent;
+
   try {
-    command_buffer_ = std::make_unique<gal::GALCommandBuffer>(gal_platform_.get());
+    command_buffer_ = std::make_unique<gal::GALCommandBuffer>(gal_platform_.get(),
+                                                              recording_mode);
   } catch (gal::Exception& e) {
     std::cerr << e.what() << std::endl;
     throw;
   }
 
+  // Per-frame command buffers are recorded in Frame() instead.
+  if (!options_.per_frame_recording && !RecordCommands()) {
+    throw;
+  }
+}
+
+bool App::RecordCommands() {
   if (!command_buffer_->BeginRecording()) {
     std::cerr << "Command buffer could not begin recording." << std::endl;
-    throw;
+    return false;
+  }
+
+  // Reused between frames, so that per-frame recording does not allocate.
+  commands_.clear();
+
+  // Compute work must come before the first SetPipeline.
+  if (reduce_pipeline_ != nullptr) {
+    AddComputeBenchmarkCommands();
+  }
+  if (cull_pipeline_ != nullptr) {
+    AddCullingCommands();
+  }
+  if (cpu_culling_) {
+    CullOnCpu();
   }
 
   gal::command::SetPipeline set_pipeline;
   set_pipeline.pipeline = gal_pipeline_.get();
-  command_buffer_->SubmitCommand(set_pipeline);
+  commands_.push_back(set_pipeline);
 
   gal::command::SetVertexBuffer set_vert_buf;
   set_vert_buf.buffer = vert_buffer_.get();
   set_vert_buf.buffer_idx = 0;
-  command_buffer_->SubmitCommand(set_vert_buf);
+  commands_.push_back(set_vert_buf);
+
+  gal::command::BeginProfileScope begin_scope;
+  begin_scope.name = "triangles";
+  commands_.push_back(begin_scope);
 
   gal::command::DrawTriangles draw_triangles;
   draw_triangles.num_triangles = 1;
-  command_buffer_->SubmitCommand(draw_triangles);
+  commands_.push_back(draw_triangles);
+
+  commands_.push_back(gal::command::EndProfileScope{});
+
+  if (model_ != nullptr && render_queue_ != nullptr) {
+    gal::command::BeginProfileScope begin_model_scope;
+    begin_model_scope.name = "model";
+    commands_.push_back(begin_model_scope);
+
+    AddModelQueueCommands();
+
+    commands_.push_back(gal::command::EndProfileScope{});
+  } else if (model_ != nullptr) {
+    gal::command::SetPipeline set_model_pipeline;
+    set_model_pipeline.pipeline = model_prepass_pipeline_ != nullptr 
+                                      ? model_prepass_pipeline_.get() 
+                                      : model_pipeline_.get();
+    commands_.push_back(set_model_pipeline);
+
+    gal::CommandVariant set_matrices = MakeModelMatricesCommand();
+    commands_.push_back(set_matrices);
+
+    gal::command::SetVertexBuffer set_model_vert_buf;
+    set_model_vert_buf.buffer = model_->GetVertexBuffer();
+    set_model_vert_buf.buffer_idx = 0;
+    commands_.push_back(set_model_vert_buf);
+
+    gal::command::SetIndexBuffer set_model_index_buf;
+    set_model_index_buf.buffer = model_->GetIndexBuffer();
+    commands_.push_back(set_model_index_buf);
+
+    if (cull_pipeline_ != nullptr) {
+      gal::command::SetVertexBuffer set_objects;
+      set_objects.buffer = cull_objects_.get();
+      set_objects.buffer_idx = 1;
+      commands_.push_back(set_objects);
+    } else if (cpu_culling_) {
+      gal::command::SetInstanceData set_instances;
+      set_instances.buffer_idx = 1;
+      set_instances.data = cpu_visible_instances_.data();
+      set_instances.size = 
+          static_cast<uint32_t>(sizeof(glm::vec4) * cpu_visible_instances_.size());
+      commands_.push_back(set_instances);
+    } else {
+      gal::command::SetInstanceData set_instances;
+      set_instances.buffer_idx = 1;
+      set_instances.data = model_instances_.data();
+      set_instances.size = static_cast<uint32_t>(sizeof(glm::vec4) * model_instances_.size());
+      commands_.push_back(set_instances);
+    }
+
+    if (model_prepass_pipeline_ != nullptr) {
+      gal::command::BeginProfileScope begin_prepass_scope;
+      begin_prepass_scope.name = "model depth prepass";
+      commands_.push_back(begin_prepass_scope);
+
+      AddModelDrawCommands();
+
+      commands_.push_back(gal::command::EndProfileScope{});
+
+      // The buffers stay bound, but the matrices are reset along with the pipeline.
+      set_model_pipeline.pipeline = model_pipeline_.get();
+      commands_.push_back(set_model_pipeline);
+      commands_.push_back(set_matrices);
+    }
+
+    gal::command::BeginProfileScope begin_model_scope;
+    begin_model_scope.name = "model";
+    commands_.push_back(begin_model_scope);
+
+    AddModelDrawCommands();
+
+    commands_.push_back(gal::command::EndProfileScope{});
+  }
+
+  if (options_.parallel_recording) {
+    if (!command_buffer_->SubmitCommandsParallel(commands_)) {
+      std::cerr << "Command buffer could not record commands in parallel." << std::endl;
+      return false;
+    }
+  } else {
+    encoder_.Reset();
+    for (const gal::CommandVariant& command : commands_) {
+      encoder_.Encode(command);
+    }
+    command_buffer_->SubmitEncoder(encoder_);
+  }
 
   if (!command_buffer_->EndRecording()) {
     std::cerr << "Command buffer could not end recording." << std::endl;
-    throw;
+    return false;
+  }
+
+  return true;
+}
+
+void App::AddModelDrawCommands() {
+  if (cull_pipeline_ != nullptr) {
+    // The number of commands does not depend on the number of objects.
+    gal::command::DrawIndexedIndirectCount draw_visible;
+    draw_visible.buffer = cull_draw_records_.get();
+    draw_visible.count_buffer = cull_draw_count_.get();
+    draw_visible.max_draw_count = cull_object_count_;
+    commands_.push_back(draw_visible);
+  } else if (cpu_culling_) {
+    const std::vector<mesh::SubMesh>& submeshes = model_->GetSubMeshes();
+    for (size_t i = 0; i < submeshes.size(); ++i) {
+      uint32_t instance_count = cpu_submesh_offsets_[i + 1] - cpu_submesh_offsets_[i];
+      if (instance_count == 0) {
+        continue;
+      }
+
+      gal::command::DrawIndexed draw_indexed;
+      draw_indexed.index_count = submeshes[i].index_count;
+      draw_indexed.first_index = submeshes[i].first_index;
+      draw_indexed.vertex_offset = submeshes[i].vertex_offset;
+      draw_indexed.instance_count = instance_count;
+      draw_indexed.first_instance = cpu_submesh_offsets_[i];
+      commands_.push_back(draw_indexed);
+    }
+  } else {
+    for (const mesh::SubMesh& submesh : model_->GetSubMeshes()) {
+      gal::command::DrawIndexed draw_indexed;
+      draw_indexed.index_count = submesh.index_count;
+      draw_indexed.first_index = submesh.first_index;
+      draw_indexed.vertex_offset = submesh.vertex_offset;
+      draw_indexed.instance_count = static_cast<uint32_t>(model_instances_.size());
+      commands_.push_back(draw_indexed);
+    }
+  }
+}
+
+gal::CommandVariant App::MakeModelMatricesCommand() {
+  if (options_.push_constants) {
+    model_push_constants_.model_view_proj = 
+        model_matrices_[2] * model_matrices_[1] * model_matrices_[0];
+    model_push_constants_.material_slot = material_slot_;
+
+    gal::command::PushConstants push_matrices;
+    push_matrices.offset = 0;
+    push_matrices.size = sizeof(model_push_constants_.model_view_proj);
+    push_matrices.data = &model_push_constants_;
+
+    // The fragment shader's material slot follows the matrices.
+    if (options_.bindless) {
+      push_matrices.size += sizeof(model_push_constants_.material_slot);
+    }
+    return push_matrices;
+  }
+
+  gal::command::SetUniformData set_matrices;
+  set_matrices.shader_idx = 0;
+  set_matrices.data = model_matrices_;
+  set_matrices.size = sizeof(model_matrices_);
+  return set_matrices;
+}
+
+void App::AddModelQueueCommands() {
+  gal::CommandVariant set_matrices = MakeModelMatricesCommand();
+  if (std::holds_alternative<gal::command::PushConstants>(set_matrices)) {
+    render_queue_->AddPushConstants(std::get<gal::command::PushConstants>(set_matrices));
+  } else {
+    render_queue_->AddUniformData(std::get<gal::command::SetUniformData>(set_matrices));
+  }
+
+  // Matches the projection's near and far planes.
+  render_queue_->SetDepthRange(model_view_radius_ * 0.1f, model_view_radius_ * 10.f);
+
+  glm::mat4 model_view = model_matrices_[1] * model_matrices_[0];
+  const std::vector<mesh::SubMesh>& submeshes = model_->GetSubMeshes();
+  uint32_t submesh_count = static_cast<uint32_t>(submeshes.size());
+
+  gal::GALRenderQueue::Draw draw;
+  draw.vertex_buffer = model_->GetVertexBuffer();
+  draw.index_buffer = model_->GetIndexBuffer();
+
+  // Object i is submesh i % submesh count of instance i / submesh count, as in cull_bvh_.
+  auto add_object = [&](uint32_t object_idx) {
+    const glm::vec4& instance = model_instances_[object_idx / submesh_count];
+    const mesh::SubMesh& submesh = submeshes[object_idx % submesh_count];
+
+    draw.index_count = submesh.index_count;
+    draw.first_index = submesh.first_index;
+    draw.vertex_offset = submesh.vertex_offset;
+    draw.depth = -(model_view * glm::vec4(glm::vec3(instance), 1.f)).z;
+    draw.instance_data = &instance;
+    render_queue_->Add(draw);
+  };
+
+  // The prepass pipeline is added first, so that the queue draws all of its draws first.
+  for (gal::GALPipeline* pipeline : {model_prepass_pipeline_.get(), model_pipeline_.get()}) {
+    if (pipeline == nullptr) {
+      continue;
+    }
+    draw.pipeline = pipeline;
+
+    if (cpu_culling_) {
+      for (uint32_t object_idx : cpu_visible_objects_) {
+        add_object(object_idx);
+      }
+    } else {
+      uint32_t object_count = static_cast<uint32_t>(model_instances_.size()) * submesh_count;
+      for (uint32_t object_idx = 0; object_idx < object_count; ++object_idx) {
+        add_object(object_idx);
+      }
+    }
   }
+
+  render_queue_->Flush(&commands_);
 }
 
 App::~App() {
   
 }
 
-void App::MainLoop() {
-  while (!window_->ShouldClose()) {
+bool App::MainLoop() {
+  if (options_.cull_benchmark_size > 0) {
+    return RunCullBenchmark();
+  }
+
+  if (options_.encode_benchmark_size > 0) {
+    RunEncodeBenchmark();
+    return true;
+  }
+
+  if (options_.upload_check) {
+    return RunUploadCheck();
+  }
+
+  if (window_ != nullptr) {
+    while (!window_->ShouldClose()) {
+      Frame();
+    }
+    PrintProfilerStats();
+    return true;
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < options_.headless_frame_count; ++i) {
     Frame();
   }
+
+  auto end_time = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> elapsed = end_time - start_time;
+  std::cout << "Rendered " << options_.headless_frame_count << " frames in " 
+            << elapsed.count() << " s ("
+            << options_.headless_frame_count / elapsed.count() << " fps)." << std::endl;
+
+  bool passed = true;
+  if (reduce_pipeline_ != nullptr) {
+    passed = PrintComputeBenchmarkResult(elapsed.count());
+  }
+
+  if (cull_pipeline_ != nullptr) {
+    gal_platform_->WaitIdle();
+
+    uint32_t draw_count = 
+        *static_cast<const uint32_t*>(cull_draw_count_readback_->GetMappedData());
+    std::cout << "GPU culling: " << draw_count << " of " << cull_object_count_ 
+              << " objects visible in the last frame." << std::endl;
+  }
+
+  if (render_queue_ != nullptr) {
+    const gal::GALRenderQueue::Stats& stats = render_queue_->GetStats();
+    std::cout << "Render queue: " << stats.draws_added << " draws and " << stats.binds_added
+              << " binds added, " << stats.draws_submitted << " draws and " 
+              << stats.binds_submitted << " binds submitted in the last frame." << std::endl;
+  }
+
+  if (cpu_culling_ && cpu_cull_count_ > 0) {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    std::cout << "CPU culling: " << cpu_visible_objects_.size() << " of " 
+              << cull_bvh_.GetObjectCount() << " objects visible in the last frame, "
+              << Milliseconds(cpu_cull_time_).count() / cpu_cull_count_ << " ms per cull."
+              << std::endl;
+  }
+
+  PrintProfilerStats();
+
+  return passed;
+}
+
+void App::PrintProfilerStats() {
+  gal::GALProfiler* profiler = gal_platform_->GetProfiler();
+  if (profiler == nullptr) {
+    return;
+  }
+
+  for (const std::string& name : profiler->GetStatNames()) {
+    std::optional<gal::GALProfiler::Stats> stats = profiler->GetStats(name);
+    std::cout << name << ": min " << stats->min << ", avg " << stats->avg << ", p99 " 
+              << stats->p99 << " (" << stats->num_samples << " samples)" << std::endl;
+  }
+}
+
+void App::PrintPipelineCacheStats() {
+  gal::GALPipelineCache* pipeline_cache = gal_platform_->GetPipelineCache();
+  if (pipeline_cache == nullptr) {
+    return;
+  }
+
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  const gal::GALPipelineCache::Stats& stats = pipeline_cache->GetStats();
+
+  std::cout << "Pipeline cache: ";
+  if (stats.loaded_from_file) {
+    std::cout << "loaded " << stats.loaded_bytes << " bytes from " 
+              << options_.pipeline_cache_path;
+  } else {
+    std::cout << "started empty";
+  }
+  std::cout << " in " << Milliseconds(stats.load_time).count() << " ms" << std::endl;
+
+  std::cout << "Pipeline cache: " << stats.hit_count << " hits (" 
+            << Milliseconds(stats.hit_time).count() << " ms), " << stats.miss_count 
+            << " misses (" << Milliseconds(stats.miss_time).count() << " ms)";
+  if (stats.unknown_count > 0) {
+    std::cout << ", " << stats.unknown_count << " unknown (" 
+              << Milliseconds(stats.unknown_time).count() << " ms)";
+  }
+  std::cout << std::endl;
+}
+
+void App::LoadModel() {
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  auto start_time = std::chrono::steady_clock::now();
+  std::string source = "generated";
+
+  try {
+    if (options_.synthetic_mesh_segments > 0) {
+      mesh::MeshData mesh_data = mesh::GenerateSphere(options_.synthetic_mesh_segments,
+                                                      options_.synthetic_mesh_segments / 2,
+                                                      /* shuffle_seed= */ 1);
+      OptimizeModel(&mesh_data);
+
+      model_ = std::make_unique<mesh::Mesh>(gal_platform_.get(), mesh_data);
+    } else {
+      std::optional<uint64_t> source_hash = mesh::HashSourceFile(options_.model_path);
+      if (!source_hash.has_value()) {
+        std::cerr << "Could not read model: " << options_.model_path << std::endl;
+        return;
+      }
+
+      // Optimized and unoptimized meshes must not be mistaken for each other.
+      uint64_t cache_key = source_hash.value() ^ (options_.optimize_meshes ? 0 : 1);
+
+      std::string cache_path = options_.model_path + ".meshcache";
+      source = "loaded from " + cache_path;
+
+      model_ = mesh::LoadMeshCache(gal_platform_.get(), cache_path, cache_key);
+
+      if (model_ == nullptr) {
+        source = "imported";
+
+        std::optional<mesh::MeshData> mesh_data = 
+            mesh::ImportObj(options_.model_path, gal_platform_->GetWorkerPool());
+        if (!mesh_data.has_value()) {
+          std::cerr << "Could not import model: " << options_.model_path << std::endl;
+          return;
+        }
+
+        OptimizeModel(&mesh_data.value());
+
+        // Not fatal; the model is imported again on the next launch.
+        mesh::WriteMeshCache(cache_path, mesh_data.value(), cache_key);
+
+        model_ = std::make_unique<mesh::Mesh>(gal_platform_.get(), mesh_data.value());
+      }
+    }
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+
+  auto end_time = std::chrono::steady_clock::now();
+
+  uint64_t index_count = 0;
+  glm::vec3 bounds_min(std::numeric_limits<float>::max());
+  glm::vec3 bounds_max(std::numeric_limits<float>::lowest());
+
+  for (const mesh::SubMesh& submesh : model_->GetSubMeshes()) {
+    index_count += submesh.index_count;
+
+    bounds_min = glm::min(bounds_min, glm::vec3(submesh.bounds_min[0], submesh.bounds_min[1],
+                                                submesh.bounds_min[2]));
+    bounds_max = glm::max(bounds_max, glm::vec3(submesh.bounds_max[0], submesh.bounds_max[1],
+                                                submesh.bounds_max[2]));
+  }
+
+  std::cout << "Model: " << model_->GetSubMeshes().size() << " submeshes, " << index_count
+            << " indices; " << source << " in " << Milliseconds(end_time - start_time).count()
+            << " ms" << std::endl;
+
+  glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+  float radius = std::max(glm::length(bounds_max - bounds_min) * 0.5f, 0.001f);
+
+  // Lays the instances out in a square grid around the model's centre.
+  uint32_t instance_count = std::max(options_.model_instance_count, 1u);
+  uint32_t grid_side = static_cast<uint32_t>(std::ceil(std::sqrt(instance_count)));
+  float spacing = radius * 2.5f;
+  float grid_offset = (grid_side - 1) * spacing * 0.5f;
+
+  model_instances_.clear();
+  for (uint32_t i = 0; i < instance_count; ++i) {
+    model_instances_.push_back(glm::vec4((i % grid_side) * spacing - grid_offset,
+                                         (i / grid_side) * spacing - grid_offset, 0.f, 1.f));
+  }
+
+  // Frames the whole grid. With culling, the camera stays on the centre of the grid instead, so
+  // that there is something to cull.
+  if (!options_.gpu_culling && !options_.cpu_culling) {
+    radius += grid_offset * std::sqrt(2.f);
+  }
+
+  model_matrices_[0] = glm::mat4(1.f);
+  model_matrices_[1] = glm::lookAt(center + glm::vec3(0.f, 0.f, radius * 2.5f), center,
+                                   glm::vec3(0.f, 1.f, 0.f));
+
+  model_view_radius_ = radius;
+  UpdateProjection();
+}
+
+void App::UpdateProjection() {
+  float aspect = static_cast<float>(gal_platform_->GetVkSwapchainExtent().width) /
+                 gal_platform_->GetVkSwapchainExtent().height;
+
+  model_matrices_[2] = glm::perspective(glm::radians(45.f), aspect, model_view_radius_ * 0.1f,
+                                        model_view_radius_ * 10.f);
+
+  // Vulkan's clip space has Y pointing down.
+  model_matrices_[2][1][1] *= -1.f;
+}
+
+void App::OnSwapchainRecreated() {
+  if (model_ == nullptr) {
+    return;
+  }
+
+  UpdateProjection();
+
+  // Nothing is in flight once the swapchain has been recreated, so the frustum buffer can be
+  // replaced.
+  if (cull_pipeline_ != nullptr) {
+    CreateCullFrustum();
+  }
+}
+
+void App::OptimizeModel(mesh::MeshData* mesh_data) {
+  if (!options_.optimize_meshes) {
+    return;
+  }
+
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  mesh::MeshOptimizeStats stats = mesh::OptimizeMesh(mesh_data);
+
+  auto end_time = std::chrono::steady_clock::now();
+
+  std::cout << "Mesh optimizer: ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+            << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << " in "
+            << Milliseconds(end_time - start_time).count() << " ms" << std::endl;
+}
+
+void App::CreateModelPipeline() {
+  gal::GALShader vert_shader;
+  if (!LoadShader(gal_platform_.get(), 
+                  options_.push_constants ? "shaders/instanced_model_push_vert.spv"
+                                          : "shaders/instanced_model_vert.spv",
+                  gal::ShaderType::Vertex, &vert_shader)) {
+    throw;
+  }
+
+  gal::GALShader frag_shader;
+  if (!LoadShader(gal_platform_.get(), 
+                  options_.bindless ? "shaders/bindless_model_frag.spv" 
+                                    : "shaders/model_frag.spv",
+                  gal::ShaderType::Fragment, &frag_shader)) {
+    throw;
+  }
+
+  gal::GALPipeline::VertexInput instance_input;
+  instance_input.buffer_idx = 1;
+  // With GPU culling, the per-instance transforms are read from the culling objects.
+  instance_input.stride = cull_pipeline_ != nullptr ? sizeof(CullObject) : sizeof(glm::vec4);
+  instance_input.input_rate = gal::GALPipeline::InputRate::PerInstance;
+
+  gal::GALPipeline::VertexDesc instance_desc;
+  instance_desc.buffer_idx = 1;
+  instance_desc.shader_idx = 3;
+  instance_desc.num_components = 4;
+  instance_desc.offset = 0;
+
+  gal::GALPipeline::UniformDesc uniform_desc;
+  uniform_desc.shader_idx = 0;
+  uniform_desc.shader_stage = gal::ShaderType::Vertex;
+
+  gal::GALPipeline::PushConstantDesc push_constant_desc;
+  push_constant_desc.shader_stage = gal::ShaderType::Vertex;
+  push_constant_desc.offset = 0;
+  push_constant_desc.size = sizeof(glm::mat4);
+
+  auto builder = gal::GALPipeline::BeginBuild(gal_platform_.get());
+  builder.SetShader(gal::ShaderType::Vertex, vert_shader)
+      .AddVertexInput(mesh::GetVertexInput(0))
+      .AddVertexInput(instance_input)
+      .AddVertexDesc(instance_desc);
+
+  if (options_.push_constants) {
+    builder.AddPushConstantDesc(push_constant_desc);
+  } else {
+    builder.AddUniformDesc(uniform_desc);
+  }
+
+  for (const gal::GALPipeline::VertexDesc& vert_desc : mesh::GetVertexDescs(0)) {
+    builder.AddVertexDesc(vert_desc);
+  }
+
+  // The prepass declares the fragment shader's range too, so that both pipelines share a layout
+  // and the bindless set is only bound once.
+  if (options_.bindless) {
+    gal::GALPipeline::PushConstantDesc material_desc;
+    material_desc.shader_stage = gal::ShaderType::Fragment;
+    material_desc.offset = sizeof(glm::mat4);
+    material_desc.size = sizeof(uint32_t);
+
+    builder.AddPushConstantDesc(material_desc)
+        .SetBindless(true);
+  }
+
+  try {
+    if (options_.depth_prepass) {
+      // Without a fragment shader, the prepass only writes depth. The model pipeline then only
+      // passes the depth test for the nearest surface, so each pixel is shaded once.
+      auto prepass_builder = builder;
+      model_prepass_pipeline_ = prepass_builder.Create();
+
+      builder.SetDepthWrite(false)
+          .SetDepthCompareOp(gal::GALPipeline::CompareOp::Equal);
+    }
+
+    builder.SetShader(gal::ShaderType::Fragment, frag_shader);
+    model_pipeline_ = builder.Create();
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+}
+
+void App::CreateBindlessMaterial() {
+  gal::GALBindlessTable* bindless_table = gal_platform_->GetBindlessTable();
+  if (bindless_table == nullptr) {
+    std::cerr << "No bindless table. Drawing the model with per-pipeline descriptor sets instead."
+              << std::endl;
+    options_.bindless = false;
+    return;
+  }
+
+  // The same colour as model_frag.frag.
+  glm::vec4 color(1.f, 0.f, 0.f, 1.f);
+
+  try {
+    material_buffer_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Storage)
+        .SetBufferData(reinterpret_cast<uint8_t*>(&color), sizeof(color))
+        .Create();
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+
+  std::optional<uint32_t> slot = bindless_table->AddStorageBuffer(material_buffer_.get());
+  if (!slot.has_value()) {
+    material_buffer_.reset();
+    options_.bindless = false;
+    return;
+  }
+  material_slot_ = slot.value();
+
+  // The slot is passed in the model's push constants.
+  options_.push_constants = true;
+}
+
+void App::CreateGpuCulling() {
+  if (!gal_platform_->IsDrawIndirectFirstInstanceEnabled()) {
+    std::cerr << "GPU culling needs drawIndirectFirstInstance. Drawing every instance instead."
+              << std::endl;
+    return;
+  }
+
+  gal::GALShader shader;
+  if (!LoadShader(gal_platform_.get(), "shaders/cull_comp.spv", gal::ShaderType::Compute,
+                  &shader)) {
+    throw;
+  }
+
+  std::vector<CullObject> objects;
+  objects.reserve(model_instances_.size() * model_->GetSubMeshes().size());
+
+  for (const glm::vec4& instance : model_instances_) {
+    for (const mesh::SubMesh& submesh : model_->GetSubMeshes()) {
+      glm::vec3 bounds_min(submesh.bounds_min[0], submesh.bounds_min[1], submesh.bounds_min[2]);
+      glm::vec3 bounds_max(submesh.bounds_max[0], submesh.bounds_max[1], submesh.bounds_max[2]);
+
+      CullObject object{};
+      object.transform = instance;
+      object.bounds = glm::vec4((bounds_min + bounds_max) * 0.5f,
+                                glm::length(bounds_max - bounds_min) * 0.5f);
+      object.index_count = submesh.index_count;
+      object.first_index = submesh.first_index;
+      object.vertex_offset = submesh.vertex_offset;
+      objects.push_back(object);
+    }
+  }
+  cull_object_count_ = static_cast<uint32_t>(objects.size());
+
+  std::vector<gal::GALComputePipeline::BufferDesc> storage_descs(3);
+  storage_descs[0].shader_idx = 0;
+  storage_descs[1].shader_idx = 2;
+  storage_descs[2].shader_idx = 3;
+
+  gal::GALComputePipeline::BufferDesc frustum_desc;
+  frustum_desc.shader_idx = 1;
+
+  try {
+    cull_pipeline_ = gal::GALComputePipeline::BeginBuild(gal_platform_.get())
+        .SetShader(shader)
+        .AddStorageBufferDesc(storage_descs[0])
+        .AddUniformBufferDesc(frustum_desc)
+        .AddStorageBufferDesc(storage_descs[1])
+        .AddStorageBufferDesc(storage_descs[2])
+        .Create();
+
+    cull_objects_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Storage)
+        .SetBufferData(reinterpret_cast<uint8_t*>(objects.data()), 
+                       sizeof(CullObject) * objects.size())
+        .Create();
+
+    cull_draw_records_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Storage)
+        .SetBufferData(nullptr, sizeof(VkDrawIndexedIndirectCommand) * objects.size())
+        .Create();
+
+    cull_draw_count_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Storage)
+        .SetBufferData(nullptr, sizeof(uint32_t))
+        .Create();
+
+    cull_draw_count_readback_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Readback)
+        .SetBufferData(nullptr, sizeof(uint32_t))
+        .Create();
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+
+  CreateCullFrustum();
+}
+
+void App::CreateCullFrustum() {
+  // The camera only changes when the swapchain is resized, so the frustum is only uploaded then.
+  scene::Frustum frustum = 
+      scene::MakeFrustum(model_matrices_[2] * model_matrices_[1] * model_matrices_[0]);
+
+  try {
+    cull_frustum_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Uniform)
+        .SetBufferData(reinterpret_cast<uint8_t*>(frustum.planes), sizeof(frustum.planes))
+        .Create();
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+}
+
+void App::AddCullingCommands() {
+  gal::command::BeginProfileScope begin_scope;
+  begin_scope.name = "cull";
+  commands_.push_back(begin_scope);
+
+  gal::command::FillBuffer reset_count;
+  reset_count.buffer = cull_draw_count_.get();
+  commands_.push_back(reset_count);
+
+  // Without VK_KHR_draw_indirect_count every record is drawn, so the ones past the count must
+  // draw nothing.
+  if (gal_platform_->GetDrawIndexedIndirectCountFunction() == nullptr) {
+    gal::command::FillBuffer reset_records;
+    reset_records.buffer = cull_draw_records_.get();
+    commands_.push_back(reset_records);
+  }
+
+  gal::command::SetComputePipeline set_pipeline;
+  set_pipeline.pipeline = cull_pipeline_.get();
+  commands_.push_back(set_pipeline);
+
+  gal::command::BindStorageBuffer bind_objects;
+  bind_objects.buffer = cull_objects_.get();
+  bind_objects.shader_idx = 0;
+  commands_.push_back(bind_objects);
+
+  gal::command::BindUniformBuffer bind_frustum;
+  bind_frustum.buffer = cull_frustum_.get();
+  bind_frustum.shader_idx = 1;
+  commands_.push_back(bind_frustum);
+
+  gal::command::BindStorageBuffer bind_records;
+  bind_records.buffer = cull_draw_records_.get();
+  bind_records.shader_idx = 2;
+  commands_.push_back(bind_records);
+
+  gal::command::BindStorageBuffer bind_count;
+  bind_count.buffer = cull_draw_count_.get();
+  bind_count.shader_idx = 3;
+  commands_.push_back(bind_count);
+
+  gal::command::Dispatch dispatch;
+  dispatch.group_count_x = (cull_object_count_ + kCullWorkGroupSize - 1) / kCullWorkGroupSize;
+  commands_.push_back(dispatch);
+
+  commands_.push_back(gal::command::EndProfileScope{});
+
+  gal::command::CopyBuffer copy_count;
+  copy_count.src = cull_draw_count_.get();
+  copy_count.dst = cull_draw_count_readback_.get();
+  copy_count.size = sizeof(uint32_t);
+  commands_.push_back(copy_count);
+}
+
+void App::CreateCpuCulling() {
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  const std::vector<mesh::SubMesh>& submeshes = model_->GetSubMeshes();
+
+  std::vector<scene::Aabb> object_bounds;
+  object_bounds.reserve(model_instances_.size() * submeshes.size());
+
+  for (const glm::vec4& instance : model_instances_) {
+    for (const mesh::SubMesh& submesh : submeshes) {
+      scene::Aabb bounds;
+      for (int axis = 0; axis < 3; ++axis) {
+        bounds.min[axis] = submesh.bounds_min[axis] * instance.w + instance[axis];
+        bounds.max[axis] = submesh.bounds_max[axis] * instance.w + instance[axis];
+      }
+      object_bounds.push_back(bounds);
+    }
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  cull_bvh_.Build(object_bounds);
+
+  auto end_time = std::chrono::steady_clock::now();
+
+  scene::Bvh::Stats stats = cull_bvh_.GetStats();
+  std::cout << "CPU culling: built a BVH over " << object_bounds.size() << " objects in "
+            << Milliseconds(end_time - start_time).count() << " ms; " << stats.node_count
+            << " nodes, depth " << stats.depth << std::endl;
+
+  cpu_submesh_offsets_.resize(submeshes.size() + 1);
+  cpu_culling_ = true;
+}
+
+void App::CullOnCpu() {
+  auto start_time = std::chrono::steady_clock::now();
+
+  scene::Frustum frustum = 
+      scene::MakeFrustum(model_matrices_[2] * model_matrices_[1] * model_matrices_[0]);
+  cull_bvh_.Cull(frustum, gal_platform_->GetWorkerPool(), &cpu_visible_objects_);
+
+  // Groups the visible instances by submesh with a counting sort, so that each submesh is drawn
+  // with one instanced draw.
+  uint32_t submesh_count = static_cast<uint32_t>(model_->GetSubMeshes().size());
+
+  std::fill(cpu_submesh_offsets_.begin(), cpu_submesh_offsets_.end(), 0);
+  for (uint32_t object_idx : cpu_visible_objects_) {
+    ++cpu_submesh_offsets_[object_idx % submesh_count + 1];
+  }
+  for (uint32_t i = 0; i < submesh_count; ++i) {
+    cpu_submesh_offsets_[i + 1] += cpu_submesh_offsets_[i];
+  }
+
+  // Each submesh's offset is used as its cursor, which leaves it at the start of the next
+  // submesh, so the offsets are shifted back afterwards.
+  cpu_visible_instances_.resize(cpu_visible_objects_.size());
+  for (uint32_t object_idx : cpu_visible_objects_) {
+    uint32_t& cursor = cpu_submesh_offsets_[object_idx % submesh_count];
+    cpu_visible_instances_[cursor++] = model_instances_[object_idx / submesh_count];
+  }
+  for (uint32_t i = submesh_count; i-- > 1;) {
+    cpu_submesh_offsets_[i] = cpu_submesh_offsets_[i - 1];
+  }
+  cpu_submesh_offsets_[0] = 0;
+
+  cpu_cull_time_ += std::chrono::steady_clock::now() - start_time;
+  ++cpu_cull_count_;
+}
+
+bool App::RunCullBenchmark() {
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  const uint32_t kIterationCount = 100;
+  const float kWorldSize = 1000.f;
+
+  uint32_t object_count = options_.cull_benchmark_size;
+
+  // Boxes scattered through a cube, around a camera at its centre that turns a little every
+  // iteration.
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> position(-kWorldSize, kWorldSize);
+  std::uniform_real_distribution<float> half_size(0.5f, 5.f);
+  std::uniform_real_distribution<float> step(-1.f, 1.f);
+  std::uniform_int_distribution<uint32_t> pick_object(0, object_count - 1);
+
+  std::vector<scene::Aabb> boxes(object_count);
+  for (scene::Aabb& box : boxes) {
+    for (int axis = 0; axis < 3; ++axis) {
+      float center = position(rng);
+      float extent = half_size(rng);
+      box.min[axis] = center - extent;
+      box.max[axis] = center + extent;
+    }
+  }
+
+  scene::Bvh bvh;
+
+  auto build_start_time = Clock::now();
+  bvh.Build(boxes);
+  Clock::duration build_time = Clock::now() - build_start_time;
+
+  gal::GALWorkerPool* worker_pool = gal_platform_->GetWorkerPool();
+
+  glm::mat4 proj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 1.f, kWorldSize);
+
+  // About 1% of the objects move every iteration.
+  uint32_t moved_count = std::max(object_count / 100, 1u);
+
+  Clock::duration refit_time{};
+  Clock::duration cull_time{};
+  Clock::duration brute_force_time{};
+  uint64_t visible_count = 0;
+  uint32_t mismatch_count = 0;
+
+  std::vector<uint32_t> visible;
+  std::vector<uint32_t> expected;
+
+  for (uint32_t i = 0; i < kIterationCount; ++i) {
+    for (uint32_t j = 0; j < moved_count; ++j) {
+      uint32_t object_idx = pick_object(rng);
+      for (int axis = 0; axis < 3; ++axis) {
+        float offset = step(rng);
+        boxes[object_idx].min[axis] += offset;
+        boxes[object_idx].max[axis] += offset;
+      }
+      bvh.UpdateObject(object_idx, boxes[object_idx]);
+    }
+
+    auto refit_start_time = Clock::now();
+    bvh.Refit();
+    refit_time += Clock::now() - refit_start_time;
+
+    float angle = glm::radians(360.f) * i / kIterationCount;
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(std::cos(angle), 0.f, std::sin(angle)),
+                                 glm::vec3(0.f, 1.f, 0.f));
+    scene::Frustum frustum = scene::MakeFrustum(proj * view);
+
+    auto cull_start_time = Clock::now();
+    bvh.Cull(frustum, worker_pool, &visible);
+    cull_time += Clock::now() - cull_start_time;
+
+    visible_count += visible.size();
+
+    auto brute_force_start_time = Clock::now();
+    expected.clear();
+    for (uint32_t object_idx = 0; object_idx < object_count; ++object_idx) {
+      if (!scene::IsOutside(frustum, boxes[object_idx])) {
+        expected.push_back(object_idx);
+      }
+    }
+    brute_force_time += Clock::now() - brute_force_start_time;
+
+    std::sort(visible.begin(), visible.end());
+    if (visible != expected) {
+      ++mismatch_count;
+    }
+  }
+
+  scene::Bvh::Stats stats = bvh.GetStats();
+
+  std::cout << "Cull benchmark: " << object_count << " objects, " << scene::Bvh::kNodeWidth 
+            << "-wide nodes, " << (worker_pool != nullptr ? worker_pool->GetWorkerCount() : 0)
+            << " workers" << std::endl;
+  std::cout << "Cull benchmark: built in " << Milliseconds(build_time).count() << " ms; "
+            << stats.node_count << " nodes, depth " << stats.depth << std::endl;
+  std::cout << "Cull benchmark: refit after moving " << moved_count << " objects in " 
+            << Milliseconds(refit_time).count() / kIterationCount << " ms" << std::endl;
+  std::cout << "Cull benchmark: " << visible_count / kIterationCount << " objects visible in "
+            << Milliseconds(cull_time).count() / kIterationCount << " ms, against "
+            << Milliseconds(brute_force_time).count() / kIterationCount 
+            << " ms for a brute-force test" << std::endl;
+
+  if (mismatch_count > 0) {
+    std::cerr << "Cull benchmark: " << mismatch_count << " of " << kIterationCount
+              << " culls did not match the brute-force test." << std::endl;
+  }
+
+  return mismatch_count == 0;
+}
+
+bool App::RunUploadCheck() {
+  const uint32_t kTextureSize = 1024;
+  const VkDeviceSize kTextureBytes = 4 * kTextureSize * kTextureSize;
+
+  uint32_t texture_count = 
+      static_cast<uint32_t>(2 * gal::GALUploadManager::kStagingRingSize / kTextureBytes) + 1;
+
+  gal::GALUploadManager* upload_manager = gal_platform_->GetUploadManager();
+
+  // Buffer uploads from startup would make the full ring flush even without image uploads.
+  upload_manager->Flush();
+  uint64_t batch_count_before = upload_manager->GetStats().batch_count;
+
+  std::vector<uint8_t> texels(kTextureBytes);
+  std::vector<std::unique_ptr<gal::GALTexture>> textures;
+  try {
+    for (uint32_t i = 0; i < texture_count; ++i) {
+      std::fill(texels.begin(), texels.end(), static_cast<uint8_t>(i));
+      textures.push_back(gal::GALTexture::BeginBuild(gal_platform_.get())
+          .SetImageData(texels.data(), kTextureSize, kTextureSize)
+          .Create());
+    }
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+
+  // Each time the ring fills up, the textures staged so far must be submitted before their
+  // space is reused.
+  uint64_t batch_count = upload_manager->GetStats().batch_count - batch_count_before;
+  upload_manager->Wait(textures.back()->GetUploadTicket());
+
+  bool passed = batch_count >= 2 && upload_manager->IsComplete(textures.back()->GetUploadTicket());
+  std::cout << "Upload check: " << texture_count << " textures in " << batch_count 
+            << " batches before the final flush: " << (passed ? "passed" : "FAILED") << std::endl;
+
+  return passed;
+}
+
+void App::RunEncodeBenchmark() {
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  const uint32_t kIterationCount = 100;
+
+  // As often as a renderer that sorts its draws by pipeline might switch.
+  const uint32_t kDrawsPerPipeline = 64;
+
+  uint32_t draw_count = options_.encode_benchmark_size;
+
+  // Every draw rebinds its vertex buffer, as a renderer that does not track what is bound would,
+  // so that the encoder has binds to skip.
+  std::vector<gal::CommandVariant> commands;
+  for (uint32_t i = 0; i < draw_count; ++i) {
+    if (i % kDrawsPerPipeline == 0) {
+      gal::command::SetPipeline set_pipeline;
+      set_pipeline.pipeline = gal_pipeline_.get();
+      commands.push_back(set_pipeline);
+    }
+
+    gal::command::SetVertexBuffer set_vert_buf;
+    set_vert_buf.buffer = vert_buffer_.get();
+    set_vert_buf.buffer_idx = 0;
+    commands.push_back(set_vert_buf);
+
+    gal::command::DrawTriangles draw_triangles;
+    draw_triangles.num_triangles = 1;
+    commands.push_back(draw_triangles);
+  }
+
+  gal::GALCommandEncoder encoder;
+
+  for (gal::RecordingMode recording_mode : 
+       {gal::RecordingMode::PerFrame, gal::RecordingMode::Persistent}) {
+    bool per_frame = recording_mode == gal::RecordingMode::PerFrame;
+
+    std::unique_ptr<gal::GALCommandBuffer> command_buffer;
+    try {
+      command_buffer = std::make_unique<gal::GALCommandBuffer>(gal_platform_.get(), 
+                                                               recording_mode);
+    } catch (gal::Exception& e) {
+      std::cerr << e.what() << std::endl;
+      return;
+    }
+
+    Clock::duration variant_time{};
+    Clock::duration encode_time{};
+    Clock::duration encoder_submit_time{};
+    uint32_t variant_count = 0;
+    uint32_t encoder_count = 0;
+
+    for (uint32_t i = 0; i < 2 * kIterationCount; ++i) {
+      bool use_encoder = i % 2 == 1;
+
+      // PerFrame buffers can only be recorded within a frame, so they are executed as well.
+      if (per_frame && !gal_platform_->StartTick()) {
+        continue;
+      }
+
+      if (!command_buffer->BeginRecording()) {
+        std::cerr << "Command buffer could not begin recording." << std::endl;
+        if (per_frame) {
+          gal_platform_->ExecuteCommandBuffer(nullptr);
+          gal_platform_->EndTick();
+        }
+        return;
+      }
+
+      auto start_time = Clock::now();
+      if (use_encoder) {
+        encoder.Reset();
+        for (const gal::CommandVariant& command : commands) {
+          encoder.Encode(command);
+        }
+        auto encoded_time = Clock::now();
+
+        command_buffer->SubmitEncoder(encoder);
+        auto end_time = Clock::now();
+
+        encode_time += encoded_time - start_time;
+        encoder_submit_time += end_time - encoded_time;
+        ++encoder_count;
+      } else {
+        for (const gal::CommandVariant& command : commands) {
+          command_buffer->SubmitCommand(command);
+        }
+        variant_time += Clock::now() - start_time;
+        ++variant_count;
+      }
+
+      if (!command_buffer->EndRecording()) {
+        std::cerr << "Command buffer could not end recording." << std::endl;
+        if (per_frame) {
+          gal_platform_->ExecuteCommandBuffer(nullptr);
+          gal_platform_->EndTick();
+        }
+        return;
+      }
+
+      if (per_frame) {
+        gal_platform_->ExecuteCommandBuffer(command_buffer.get());
+        gal_platform_->EndTick();
+      }
+    }
+
+    if (variant_count == 0 || encoder_count == 0) {
+      std::cerr << "Encode benchmark: no frames could be started." << std::endl;
+      return;
+    }
+
+    // Persistent buffers wait for the device before they are recorded again, and must be idle
+    // before they are destroyed.
+    gal_platform_->WaitIdle();
+
+    double variant_ms = Milliseconds(variant_time).count() / variant_count;
+    double encode_ms = Milliseconds(encode_time).count() / encoder_count;
+    double encoder_submit_ms = Milliseconds(encoder_submit_time).count() / encoder_count;
+
+    std::cout << "Encode benchmark (" << (per_frame ? "PerFrame" : "Persistent") << ", " 
+              << draw_count << " draws, " << commands.size() << " commands): SubmitCommand() in "
+              << variant_ms << " ms (" << variant_ms * 1e6 / draw_count << " ns/draw); encoded in "
+              << encode_ms << " ms and submitted in " << encoder_submit_ms << " ms ("
+              << (encode_ms + encoder_submit_ms) * 1e6 / draw_count << " ns/draw)" << std::endl;
+  }
+}
+
+void App::CreateComputeBenchmark() {
+  gal::GALShader shader;
+  if (!LoadShader(gal_platform_.get(), "shaders/reduce_comp.spv", gal::ShaderType::Compute,
+                  &shader)) {
+    throw;
+  }
+
+  gal::GALComputePipeline::BufferDesc in_desc;
+  in_desc.shader_idx = 0;
+
+  gal::GALComputePipeline::BufferDesc out_desc;
+  out_desc.shader_idx = 1;
+
+  // Arbitrary but reproducible values, large enough that the sum wraps around.
+  std::vector<uint32_t> values(options_.compute_benchmark_size);
+  reduce_expected_sum_ = 0;
+  for (uint32_t i = 0; i < values.size(); ++i) {
+    values[i] = (i * 2654435761u) >> 4;
+    reduce_expected_sum_ += values[i];
+  }
+
+  try {
+    reduce_pipeline_ = gal::GALComputePipeline::BeginBuild(gal_platform_.get())
+        .SetShader(shader)
+        .AddStorageBufferDesc(in_desc)
+        .AddStorageBufferDesc(out_desc)
+        .Create();
+
+    reduce_buffers_.push_back(gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Storage)
+        .SetBufferData(reinterpret_cast<uint8_t*>(values.data()),
+                       sizeof(uint32_t) * values.size())
+        .Create());
+
+    // Each pass's output is sized exactly, since the shader stops at the end of its input.
+    uint32_t count = options_.compute_benchmark_size;
+    while (count > 1) {
+      count = (count + kReduceValuesPerGroup - 1) / kReduceValuesPerGroup;
+      reduce_group_counts_.push_back(count);
+
+      reduce_buffers_.push_back(gal::GALBuffer::BeginBuild(gal_platform_.get())
+          .SetType(gal::BufferType::Storage)
+          .SetBufferData(nullptr, sizeof(uint32_t) * count)
+          .Create());
+    }
+
+    reduce_readback_ = gal::GALBuffer::BeginBuild(gal_platform_.get())
+        .SetType(gal::BufferType::Readback)
+        .SetBufferData(nullptr, sizeof(uint32_t))
+        .Create();
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    throw;
+  }
+}
+
+void App::AddComputeBenchmarkCommands() {
+  gal::command::BeginProfileScope begin_scope;
+  begin_scope.name = "reduce";
+  commands_.push_back(begin_scope);
+
+  gal::command::SetComputePipeline set_pipeline;
+  set_pipeline.pipeline = reduce_pipeline_.get();
+  commands_.push_back(set_pipeline);
+
+  for (size_t i = 0; i < reduce_group_counts_.size(); ++i) {
+    gal::command::BindStorageBuffer bind_in;
+    bind_in.buffer = reduce_buffers_[i].get();
+    bind_in.shader_idx = 0;
+    commands_.push_back(bind_in);
+
+    gal::command::BindStorageBuffer bind_out;
+    bind_out.buffer = reduce_buffers_[i + 1].get();
+    bind_out.shader_idx = 1;
+    commands_.push_back(bind_out);
+
+    gal::command::Dispatch dispatch;
+    dispatch.group_count_x = reduce_group_counts_[i];
+    commands_.push_back(dispatch);
+  }
+
+  commands_.push_back(gal::command::EndProfileScope{});
+
+  gal::command::CopyBuffer copy_result;
+  copy_result.src = reduce_buffers_.back().get();
+  copy_result.dst = reduce_readback_.get();
+  copy_result.size = sizeof(uint32_t);
+  commands_.push_back(copy_result);
+}
+
+bool App::PrintComputeBenchmarkResult(double elapsed_seconds) {
+  // The last frame's copy must have landed before the result is read.
+  gal_platform_->WaitIdle();
+
+  uint32_t sum = *static_cast<const uint32_t*>(reduce_readback_->GetMappedData());
+
+  double values_per_second = 
+      static_cast<double>(options_.compute_benchmark_size) * options_.headless_frame_count / 
+      elapsed_seconds;
+
+  std::cout << "Compute benchmark: summed " << options_.compute_benchmark_size << " values in "
+            << reduce_group_counts_.size() << " passes, " << options_.headless_frame_count
+            << " times (" << values_per_second * 1e-9 << " Gvalues/s including the frame). "
+            << (sum == reduce_expected_sum_ ? "Sum matches" : "Sum does not match") 
+            << " the CPU's: " << sum << " vs " << reduce_expected_sum_ << std::endl;
+
+  return sum == reduce_expected_sum_;
 }
 
 void App::Frame() {
-  gal_platform_->StartTick();
-  gal_platform_->ExecuteCommandBuffer(command_buffer_.get());
+  if (!gal_platform_->StartTick()) {
+    // There is nothing to render into, e.g. while the window is minimized.
+    if (window_ != nullptr) {
+      window_->Tick();
+    }
+    return;
+  }
+
+  if (gal_platform_->GetSwapchainGeneration() != swapchain_generation_) {
+    swapchain_generation_ = gal_platform_->GetSwapchainGeneration();
+    OnSwapchainRecreated();
+  }
+
+  // Persistent command buffers refer to the swapchain's framebuffers, so they are recorded again
+  // once it has been recreated.
+  bool record = options_.per_frame_recording || command_buffer_->IsOutOfDate();
+
+  // The frame is still executed if recording fails, so that the acquired image is presented.
+  bool recorded = !record || RecordCommands();
+  gal_platform_->ExecuteCommandBuffer(recorded ? command_buffer_.get() : nullptr);
+
   gal_platform_->EndTick();
 
-  window_->Tick();
-  window_->SwapBuffers();
+  if (window_ != nullptr) {
+    window_->Tick();
+    window_->SwapBuffers();
+  }
 }
\ No newline at end of file
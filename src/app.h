@@ -1,31 +1,243 @@
 #ifndef APP_H_
 #define APP_H_
 
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 #include "gal/gal_buffer.h"
 #include "gal/gal_command_buffer.h"
+#include "gal/gal_command_encoder.h"
+#include "gal/gal_commands.h"
+#include "gal/gal_compute_pipeline.h"
 #include "gal/gal_pipeline.h"
 #include "gal/gal_platform.h"
+#include "gal/gal_render_queue.h"
+#include "mesh/mesh.h"
+#include "scene/bvh.h"
 #include "window/window.h"
 #include "window/window_manager.h"
 
+struct AppOptions {
+  // Renders into offscreen images instead of a window. Useful for measuring throughput on
+  // machines without a display.
+  bool headless = false;
+
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+
+  // Number of frames that MainLoop() renders before returning in headless mode.
+  uint32_t headless_frame_count = 1000;
+
+  // Frames in flight, present mode, swapchain image count and frame pacing.
+  gal::GALPlatform::Options platform_options;
+
+  // Enables the GPU/CPU profiler and prints its stats when MainLoop() returns.
+  bool profile = false;
+
+  // Records the draw list on worker threads.
+  bool parallel_recording = false;
+
+  // Re-records the command buffer every frame instead of once at startup.
+  bool per_frame_recording = false;
+
+  // File that the pipeline cache is loaded from and saved to. Empty disables the cache.
+  std::string pipeline_cache_path = "pipeline_cache.bin";
+
+  // OBJ file that is imported into a mesh at startup and drawn every frame. Empty skips the
+  // import. Drawing the model requires per-frame recording, which is enabled with it.
+  std::string model_path;
+
+  // Generates a shuffled UV sphere with this many segments instead of importing model_path. 0
+  // disables it. Useful for benchmarking the mesh optimizer.
+  uint32_t synthetic_mesh_segments = 0;
+
+  // Number of copies of the model that are drawn in a grid, with one instanced draw per submesh.
+  uint32_t model_instance_count = 1;
+
+  // Runs the mesh optimizer on imported and generated meshes before they are uploaded.
+  bool optimize_meshes = true;
+
+  // Draws the model into the depth buffer first, without a fragment shader, and then draws it
+  // again with an equal depth test, so that hidden surfaces are rejected by early-Z instead of
+  // being shaded.
+  bool depth_prepass = false;
+
+  // Passes the model's matrices to its pipelines as push constants, multiplied together on the
+  // CPU, instead of copying them into the uniform ring with command::SetUniformData.
+  bool push_constants = false;
+
+  // Draws the model with a bindless pipeline, whose fragment shader reads the model's colour from
+  // a storage buffer in the platform's GALBindlessTable, at a slot passed in push constants along
+  // with the matrices. Needs platform_options.bindless, and is ignored without a bindless table.
+  bool bindless = false;
+
+  // Frustum-culls every instance of every submesh of the model in a compute pass, and draws the
+  // visible ones with one indirect draw, instead of one instanced draw per submesh.
+  bool gpu_culling = false;
+
+  // Frustum-culls every instance of every submesh of the model on the CPU with a BVH, on the
+  // worker threads, and draws the visible instances of each submesh with one instanced draw.
+  // Ignored if gpu_culling is set.
+  bool cpu_culling = false;
+
+  // Adds every instance of every submesh of the model to a GALRenderQueue as a draw of its own,
+  // which sorts them front to back and merges them back into instanced draws. In headless mode,
+  // MainLoop() prints the draw and bind counts of the last frame. Ignored if gpu_culling is set.
+  bool render_queue = false;
+
+  // Builds a BVH over this many random boxes, and culls it against a rotating frustum while
+  // moving some of the boxes, checking every result against a brute-force test. MainLoop()
+  // prints the timings and returns without rendering, and fails if any result differed. 0
+  // disables it.
+  uint32_t cull_benchmark_size = 0;
+
+  // Sums this many values on the GPU with reduce_comp.comp every frame, ahead of the draws. In
+  // headless mode, MainLoop() checks the sum against the CPU's, prints the throughput, and fails
+  // if the sums differ. 0 disables it.
+  uint32_t compute_benchmark_size = 0;
+
+  // Records this many draws of the triangle, each rebinding its vertex buffer, into PerFrame and
+  // Persistent command buffers, once with SubmitCommand() and once with a GALCommandEncoder, and
+  // prints the time each takes. MainLoop() returns without rendering afterwards. 0 disables it.
+  uint32_t encode_benchmark_size = 0;
+
+  // Uploads enough textures to fill the staging ring twice, with no other uploads pending, and
+  // checks that the full ring submitted them instead of being reused under them. MainLoop()
+  // prints the result and returns without rendering, and fails if the check did.
+  bool upload_check = false;
+};
+
 class App {
 public:
-  App();
+  App(const AppOptions& options);
   ~App();
 
-  void MainLoop();
+  // Returns false if a benchmark or check found a wrong result.
+  bool MainLoop();
 
   void Frame();
 
 private:
+  bool RecordCommands();
+  void AddModelDrawCommands();
+  void AddModelQueueCommands();
+
+  // The command that passes model_matrices_ to the model pipelines.
+  gal::CommandVariant MakeModelMatricesCommand();
+
+  void PrintProfilerStats();
+  void PrintPipelineCacheStats();
+
+  void LoadModel();
+  void OptimizeModel(mesh::MeshData* mesh_data);
+  void CreateModelPipeline();
+  void CreateBindlessMaterial();
+
+  // Updates the projection matrix for the swapchain's aspect ratio.
+  void UpdateProjection();
+  void OnSwapchainRecreated();
+
+  void CreateGpuCulling();
+  void CreateCullFrustum();
+  void AddCullingCommands();
+
+  void CreateCpuCulling();
+  void CullOnCpu();
+
+  void RunEncodeBenchmark();
+
+  // Return false if a result was wrong.
+  bool RunCullBenchmark();
+  bool RunUploadCheck();
+
+  void CreateComputeBenchmark();
+  void AddComputeBenchmarkCommands();
+  // Returns false if the GPU's sum does not match the CPU's.
+  bool PrintComputeBenchmarkResult(double elapsed_seconds);
+
+  AppOptions options_;
+
   std::unique_ptr<window::WindowManager> window_manager_;
-  window::Window* window_;
+
+  // Null in headless mode.
+  window::Window* window_ = nullptr;
   
   std::unique_ptr<gal::GALPlatform> gal_platform_;
   std::unique_ptr<gal::GALPipeline> gal_pipeline_;
   std::unique_ptr<gal::GALBuffer> vert_buffer_;
+  std::unique_ptr<mesh::Mesh> model_;
+  std::unique_ptr<gal::GALPipeline> model_pipeline_;
+  // Null unless options_.depth_prepass is set.
+  std::unique_ptr<gal::GALPipeline> model_prepass_pipeline_;
+
+  // Null unless options_.bindless is set. Holds the model's colour, in the layout of
+  // bindless_model_frag.frag's Material, at material_slot_ of the bindless table.
+  std::unique_ptr<gal::GALBuffer> material_buffer_;
+  uint32_t material_slot_ = 0;
+
+  // Model, view and projection matrices, in the layout of instanced_model_vert.vert's uniform
+  // block.
+  glm::mat4 model_matrices_[3];
+
+  // What MakeModelMatricesCommand() pushes, in the layout of the model shaders' push constant
+  // blocks. material_slot is only pushed to bindless pipelines.
+  struct ModelPushConstants {
+    glm::mat4 model_view_proj;
+    uint32_t material_slot;
+  };
+  ModelPushConstants model_push_constants_{};
+
+  // The radius of the part of the scene that the camera frames.
+  float model_view_radius_ = 1.f;
+
+  // The swapchain generation that the camera and culling frustum were last updated for.
+  uint32_t swapchain_generation_ = 0;
+
+  // Per-instance translation and scale, streamed with command::SetInstanceData.
+  std::vector<glm::vec4> model_instances_;
+  // One object per instance of each submesh, in the layout of cull_comp.comp's Object. Also the
+  // per-instance vertex buffer of the model pipeline.
+  std::unique_ptr<gal::GALComputePipeline> cull_pipeline_;
+  std::unique_ptr<gal::GALBuffer> cull_objects_;
+  std::unique_ptr<gal::GALBuffer> cull_frustum_;
+  std::unique_ptr<gal::GALBuffer> cull_draw_records_;
+  std::unique_ptr<gal::GALBuffer> cull_draw_count_;
+  std::unique_ptr<gal::GALBuffer> cull_draw_count_readback_;
+  uint32_t cull_object_count_ = 0;
+
+  // The same objects as cull_objects_, for CPU culling. Object i is submesh i % submesh count of
+  // instance i / submesh count.
+  scene::Bvh cull_bvh_;
+  bool cpu_culling_ = false;
+  std::vector<uint32_t> cpu_visible_objects_;
+  // The visible instances, grouped by submesh. Submesh i's instances start at
+  // cpu_submesh_offsets_[i], and end at cpu_submesh_offsets_[i + 1].
+  std::vector<glm::vec4> cpu_visible_instances_;
+  std::vector<uint32_t> cpu_submesh_offsets_;
+  std::chrono::steady_clock::duration cpu_cull_time_{};
+  uint32_t cpu_cull_count_ = 0;
+
+  std::unique_ptr<gal::GALComputePipeline> reduce_pipeline_;
+
+  // The input values, followed by the output of each reduction pass.
+  std::vector<std::unique_ptr<gal::GALBuffer>> reduce_buffers_;
+  std::vector<uint32_t> reduce_group_counts_;
+  std::unique_ptr<gal::GALBuffer> reduce_readback_;
+  uint32_t reduce_expected_sum_ = 0;
+
   std::unique_ptr<gal::GALCommandBuffer> command_buffer_;
+
+  std::vector<gal::CommandVariant> commands_;
+
+  // Null unless options_.render_queue is set.
+  std::unique_ptr<gal::GALRenderQueue> render_queue_;
+
+  // Reused between frames, so that it stops allocating once it has grown to a frame's commands.
+  gal::GALCommandEncoder encoder_;
 };
 
 #endif // APP_H_
\ No newline at end of file
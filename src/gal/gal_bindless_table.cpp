@@ -0,0 +1,251 @@
+#include "gal/gal_bindless_table.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "gal/gal_buffer.h"
+#include "gal/gal_exception.h"
+#include "gal/gal_texture.h"
+
+namespace gal {
+
+namespace {
+
+// Enough for large scenes, while keeping the pool small on devices with lower limits.
+const uint32_t kMaxTextures = 16 * 1024;
+const uint32_t kMaxStorageBuffers = 4 * 1024;
+
+// Below this, the table would not be worth having over per-material sets.
+const uint32_t kMinSlots = 64;
+
+} // namespace
+
+GALBindlessTable::GALBindlessTable(VkPhysicalDevice vk_physical_device, VkDevice vk_device,
+                                   uint32_t num_frames_in_flight)
+    : vk_device_(vk_device) {
+  VkPhysicalDeviceDescriptorIndexingProperties indexing_props{};
+  indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 device_props{};
+  device_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  device_props.pNext = &indexing_props;
+  vkGetPhysicalDeviceProperties2(vk_physical_device, &device_props);
+
+  // Both stages can read every slot, so the per-stage limits apply to the whole array.
+  textures_.capacity = std::min({kMaxTextures, 
+                                 indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                 indexing_props.maxDescriptorSetUpdateAfterBindSampledImages});
+  storage_buffers_.capacity = 
+      std::min({kMaxStorageBuffers, 
+                indexing_props.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                indexing_props.maxDescriptorSetUpdateAfterBindStorageBuffers});
+  if (textures_.capacity < kMinSlots || storage_buffers_.capacity < kMinSlots) {
+    throw Exception("Update-after-bind descriptor limits are too low for a bindless table.");
+  }
+
+  textures_.live.resize(textures_.capacity, false);
+  storage_buffers_.live.resize(storage_buffers_.capacity, false);
+  textures_.removed_slots.resize(num_frames_in_flight);
+  storage_buffers_.removed_slots.resize(num_frames_in_flight);
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+  bindings[0].binding = kTextureBinding;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = textures_.capacity;
+  bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  bindings[1].binding = kStorageBufferBinding;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[1].descriptorCount = storage_buffers_.capacity;
+  bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  // Slots that no draw reads may be empty or stale, and may be written while the set is in use.
+  VkDescriptorBindingFlags binding_flags[] = {
+    VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | 
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | 
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+    VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | 
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | 
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+  };
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info{};
+  binding_flags_create_info.sType = 
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  binding_flags_create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+  binding_flags_create_info.pBindingFlags = binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info{};
+  descriptor_set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = &binding_flags_create_info;
+  descriptor_set_layout_create_info.flags = 
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  descriptor_set_layout_create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+  descriptor_set_layout_create_info.pBindings = bindings.data();
+
+  VkDescriptorSetLayout vk_set_layout;
+  if (vkCreateDescriptorSetLayout(vk_device_, &descriptor_set_layout_create_info, nullptr,
+                                  &vk_set_layout) != VK_SUCCESS) {
+    throw Exception("Could not create bindless VkDescriptorSetLayout.");
+  }
+
+  // Pipeline layouts keep the set layout alive, so it is destroyed once the table and every
+  // bindless pipeline are gone.
+  auto set_layout = std::make_unique<GALPipelineRegistry::DescriptorSetLayout>();
+  set_layout->vk_descriptor_set_layout = vk_set_layout;
+  set_layout->bindings = bindings;
+  set_layout_.reset(set_layout.release(), 
+      [vk_device](const GALPipelineRegistry::DescriptorSetLayout* set_layout) {
+        vkDestroyDescriptorSetLayout(vk_device, set_layout->vk_descriptor_set_layout, nullptr);
+        delete set_layout;
+      });
+
+  VkDescriptorPoolSize pool_sizes[2]{};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[0].descriptorCount = textures_.capacity;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_sizes[1].descriptorCount = storage_buffers_.capacity;
+
+  VkDescriptorPoolCreateInfo descriptor_pool_create_info{};
+  descriptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptor_pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  descriptor_pool_create_info.maxSets = 1;
+  descriptor_pool_create_info.poolSizeCount = 2;
+  descriptor_pool_create_info.pPoolSizes = pool_sizes;
+
+  if (vkCreateDescriptorPool(vk_device_, &descriptor_pool_create_info, nullptr, 
+                             &vk_descriptor_pool_) != VK_SUCCESS) {
+    throw Exception("Could not create bindless descriptor pool.");
+  }
+
+  VkDescriptorSetAllocateInfo descriptor_set_alloc_info{};
+  descriptor_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  descriptor_set_alloc_info.descriptorPool = vk_descriptor_pool_;
+  descriptor_set_alloc_info.descriptorSetCount = 1;
+  descriptor_set_alloc_info.pSetLayouts = &vk_set_layout;
+
+  if (vkAllocateDescriptorSets(vk_device_, &descriptor_set_alloc_info, 
+                               &vk_descriptor_set_) != VK_SUCCESS) {
+    vkDestroyDescriptorPool(vk_device_, vk_descriptor_pool_, nullptr);
+    throw Exception("Could not allocate bindless VkDescriptorSet.");
+  }
+}
+
+GALBindlessTable::~GALBindlessTable() {
+  // Destroying the pool frees the set.
+  vkDestroyDescriptorPool(vk_device_, vk_descriptor_pool_, nullptr);
+}
+
+void GALBindlessTable::BeginFrame(uint32_t frame) {
+  current_frame_ = frame;
+
+  for (SlotArray* slots : { &textures_, &storage_buffers_ }) {
+    std::vector<uint32_t>& removed_slots = slots->removed_slots[frame];
+    slots->free_slots.insert(slots->free_slots.end(), removed_slots.begin(), 
+                             removed_slots.end());
+    removed_slots.clear();
+  }
+}
+
+std::optional<uint32_t> GALBindlessTable::AddTexture(GALTexture* texture) {
+  std::optional<uint32_t> slot = AllocateSlot(&textures_);
+  if (!slot.has_value()) {
+    std::cerr << "Bindless table has no free texture slots." << std::endl;
+    return std::nullopt;
+  }
+
+  VkDescriptorImageInfo image_info{};
+  image_info.imageView = texture->GetVkImageView();
+  image_info.sampler = texture->GetVkSampler();
+  image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = vk_descriptor_set_;
+  write.dstBinding = kTextureBinding;
+  write.dstArrayElement = slot.value();
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &image_info;
+  vkUpdateDescriptorSets(vk_device_, 1, &write, 0, nullptr);
+
+  ++stats_.texture_count;
+  return slot;
+}
+
+std::optional<uint32_t> GALBindlessTable::AddStorageBuffer(GALBuffer* buffer) {
+  if (buffer->GetType() != BufferType::Storage) {
+    std::cerr << "Only storage buffers can be added to the bindless table." << std::endl;
+    return std::nullopt;
+  }
+
+  std::optional<uint32_t> slot = AllocateSlot(&storage_buffers_);
+  if (!slot.has_value()) {
+    std::cerr << "Bindless table has no free storage buffer slots." << std::endl;
+    return std::nullopt;
+  }
+
+  VkDescriptorBufferInfo buffer_info{};
+  buffer_info.buffer = buffer->GetVkBuffer();
+  buffer_info.offset = 0;
+  buffer_info.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = vk_descriptor_set_;
+  write.dstBinding = kStorageBufferBinding;
+  write.dstArrayElement = slot.value();
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &buffer_info;
+  vkUpdateDescriptorSets(vk_device_, 1, &write, 0, nullptr);
+
+  ++stats_.storage_buffer_count;
+  return slot;
+}
+
+void GALBindlessTable::RemoveTexture(uint32_t slot) {
+  if (RemoveSlot(&textures_, slot)) {
+    --stats_.texture_count;
+  }
+}
+
+void GALBindlessTable::RemoveStorageBuffer(uint32_t slot) {
+  if (RemoveSlot(&storage_buffers_, slot)) {
+    --stats_.storage_buffer_count;
+  }
+}
+
+std::optional<uint32_t> GALBindlessTable::AllocateSlot(SlotArray* slots) {
+  uint32_t slot = 0;
+  if (!slots->free_slots.empty()) {
+    slot = slots->free_slots.back();
+    slots->free_slots.pop_back();
+  } else if (slots->high_water < slots->capacity) {
+    slot = slots->high_water++;
+  } else {
+    return std::nullopt;
+  }
+
+  slots->live[slot] = true;
+  return slot;
+}
+
+bool GALBindlessTable::RemoveSlot(SlotArray* slots, uint32_t slot) {
+  // Removing a slot twice would hand it out twice once it is reused.
+  if (slot >= slots->capacity || !slots->live[slot]) {
+    std::cerr << "Bindless slot is not in use: " << slot << std::endl;
+    return false;
+  }
+  slots->live[slot] = false;
+
+  // The stale descriptor is left in place. Partially bound slots only need to be valid when a
+  // shader reads them.
+  slots->removed_slots[current_frame_].push_back(slot);
+  return true;
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef GAL_GAL_BINDLESS_TABLE_H_
+#define GAL_GAL_BINDLESS_TABLE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "gal/gal_pipeline_registry.h"
+
+namespace gal {
+
+// Forward declarations
+class GALBuffer;
+class GALTexture;
+
+// One descriptor set that holds every texture and storage buffer that bindless pipelines read, so
+// that a frame binds it once instead of a set per material. Binding 0 is an array of combined
+// image samplers and binding 1 an array of storage buffers, which shaders declare in set 0 as
+// runtime-sized arrays and index with the slots that AddTexture() and AddStorageBuffer() return,
+// passed in push constants.
+//
+// The set is created for update-after-bind, so slots can be added while frames that bind it are in
+// flight. A removed slot is only handed out again once every frame in flight that may have read it
+// has finished, but Persistent command buffers that read it must be recorded again.
+//
+// Only created by GALPlatform when the device supports descriptor indexing.
+//
+// Not thread-safe.
+class GALBindlessTable {
+public:
+  static constexpr uint32_t kTextureBinding = 0;
+  static constexpr uint32_t kStorageBufferBinding = 1;
+
+  struct Stats {
+    uint32_t texture_count = 0;
+    uint32_t storage_buffer_count = 0;
+  };
+
+  // Throws if the device cannot hold even a small table.
+  GALBindlessTable(VkPhysicalDevice vk_physical_device, VkDevice vk_device, 
+                   uint32_t num_frames_in_flight);
+  ~GALBindlessTable();
+
+  // Called once the frame's fence has signaled. Frees the slots that were removed while the frame
+  // was last recorded.
+  void BeginFrame(uint32_t frame);
+
+  // Returns the slot to index the array with, or std::nullopt if the array is full. The resource
+  // must stay alive until its slot is removed.
+  std::optional<uint32_t> AddTexture(GALTexture* texture);
+  std::optional<uint32_t> AddStorageBuffer(GALBuffer* buffer);
+
+  // Commands recorded after this must not read the slot.
+  void RemoveTexture(uint32_t slot);
+  void RemoveStorageBuffer(uint32_t slot);
+
+  // Set 0 of every bindless pipeline's layout.
+  const std::shared_ptr<const GALPipelineRegistry::DescriptorSetLayout>& GetSetLayout() const {
+    return set_layout_;
+  }
+  VkDescriptorSet GetVkDescriptorSet() { return vk_descriptor_set_; }
+
+  uint32_t GetTextureCapacity() const { return textures_.capacity; }
+  uint32_t GetStorageBufferCapacity() const { return storage_buffers_.capacity; }
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct SlotArray {
+    uint32_t capacity = 0;
+
+    // Slots below this have been handed out at least once.
+    uint32_t high_water = 0;
+    std::vector<uint32_t> free_slots;
+
+    // Indexed by slot. Whether the slot is handed out and has not been removed since.
+    std::vector<bool> live;
+
+    // Indexed by frame in flight. Slots removed while the frame was recorded.
+    std::vector<std::vector<uint32_t>> removed_slots;
+  };
+
+  std::optional<uint32_t> AllocateSlot(SlotArray* slots);
+  // False if the slot is not handed out, e.g. because it was already removed.
+  bool RemoveSlot(SlotArray* slots, uint32_t slot);
+
+private:
+  VkDevice vk_device_;
+
+  std::shared_ptr<const GALPipelineRegistry::DescriptorSetLayout> set_layout_;
+  VkDescriptorPool vk_descriptor_pool_ = VK_NULL_HANDLE;
+  VkDescriptorSet vk_descriptor_set_ = VK_NULL_HANDLE;
+
+  SlotArray textures_;
+  SlotArray storage_buffers_;
+
+  uint32_t current_frame_ = 0;
+
+  Stats stats_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_BINDLESS_TABLE_H_
\ No newline at end of file
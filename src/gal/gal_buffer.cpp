@@ -7,23 +7,13 @@
 namespace gal {
 
 GALBuffer::GALBuffer(GALBuffer::Builder& builder) {
-  vk_physical_device_ = builder.gal_platform_->GetVkPhysicalDevice();
   vk_device_ = builder.gal_platform_->GetVkDevice();
-  
-  std::optional<BufferInfo> staging_buf_info_opt = 
-      CreateBuffer(builder.data_size_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-  if (!staging_buf_info_opt.has_value()) {
-    throw Exception("Could not create staging buffer.");
-  }
-
-  VkBuffer staging_buf = staging_buf_info_opt.value().vk_buffer;
-  VkDeviceMemory staging_buf_mem = staging_buf_info_opt.value().vk_buffer_memory;
-
-  void* device_data;
-  vkMapMemory(vk_device_, staging_buf_mem, 0, builder.data_size_, 0, &device_data);
-  memcpy(device_data, builder.data_, builder.data_size_);
-  vkUnmapMemory(vk_device_, staging_buf_mem);
+  memory_allocator_ = builder.gal_platform_->GetMemoryAllocator();
+  upload_manager_ = builder.gal_platform_->GetUploadManager();
+  descriptor_cache_ = builder.gal_platform_->GetDescriptorCache();
+  buffer_type_ = builder.buffer_type_;
+  index_type_ = builder.index_type_;
+  size_ = builder.data_size_;
 
   std::optional<BufferInfo> vert_buf_info_opt;
 
@@ -31,7 +21,31 @@ GALBuffer::GALBuffer(GALBuffer::Builder& builder) {
       vert_buf_info_opt = CreateBuffer(
           builder.data_size_, 
           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+  } else if (builder.buffer_type_ == BufferType::Index) {
+      vert_buf_info_opt = CreateBuffer(
+          builder.data_size_, 
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+  } else if (builder.buffer_type_ == BufferType::Uniform) {
+      vert_buf_info_opt = CreateBuffer(
+          builder.data_size_, 
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+  } else if (builder.buffer_type_ == BufferType::Storage) {
+      vert_buf_info_opt = CreateBuffer(
+          builder.data_size_, 
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | 
+              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | 
+              VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+  } else if (builder.buffer_type_ == BufferType::Readback) {
+      // Cached memory is much faster for the CPU to read from.
+      vert_buf_info_opt = CreateBuffer(
+          builder.data_size_, 
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+          VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
   } else {
     throw Exception("Buffer type not supported.");
   }
@@ -41,55 +55,61 @@ GALBuffer::GALBuffer(GALBuffer::Builder& builder) {
   }
 
   vk_buffer_ = vert_buf_info_opt.value().vk_buffer;
-  vk_buffer_memory_ = vert_buf_info_opt.value().vk_buffer_memory;
-
-  // Copies data from the staging buffer to the vertex buffer
-
-  VkCommandPool cmd_pool = builder.gal_platform_->GetVkCommandPool();
-
-  VkCommandBufferAllocateInfo cmd_buf_alloc_info{};
-  cmd_buf_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  cmd_buf_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  cmd_buf_alloc_info.commandPool = cmd_pool;
-  cmd_buf_alloc_info.commandBufferCount = 1;
-
-  VkCommandBuffer cmd_buf;
-  vkAllocateCommandBuffers(vk_device_, &cmd_buf_alloc_info, &cmd_buf);
-
-  VkCommandBufferBeginInfo begin_info{};
-  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-  vkBeginCommandBuffer(cmd_buf, &begin_info);
-
-  VkBufferCopy buf_copy{};
-  buf_copy.size = builder.data_size_;
-  vkCmdCopyBuffer(cmd_buf, staging_buf, vk_buffer_, 1, &buf_copy);
-
-  vkEndCommandBuffer(cmd_buf);
-
-  VkSubmitInfo submit_info{};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &cmd_buf;
-
-  VkQueue graphics_queue = builder.gal_platform_->GetVkGraphicsQueue();
-  vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphics_queue);
+  allocation_ = vert_buf_info_opt.value().allocation;
+
+  upload_ticket_ = 0;
+  if (builder.data_ == nullptr) {
+    if (builder.buffer_type_ != BufferType::Storage && 
+        builder.buffer_type_ != BufferType::Readback) {
+      vkDestroyBuffer(vk_device_, vk_buffer_, nullptr);
+      memory_allocator_->Free(allocation_);
+      throw Exception("Buffer type requires data.");
+    }
+    return;
+  }
 
-  vkFreeCommandBuffers(vk_device_, cmd_pool, 1, &cmd_buf);
+  VkAccessFlags dst_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+  if (builder.buffer_type_ == BufferType::Index) {
+    dst_access = VK_ACCESS_INDEX_READ_BIT;
+  } else if (builder.buffer_type_ == BufferType::Uniform) {
+    // Any stage that BindUniformBuffer accepts may read it.
+    dst_access = VK_ACCESS_UNIFORM_READ_BIT;
+    dst_stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  } else if (builder.buffer_type_ == BufferType::Storage) {
+    // Storage buffers may also be read as vertices or indirect arguments.
+    dst_access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                 VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    dst_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+  }
 
-  vkFreeMemory(vk_device_, staging_buf_mem, nullptr);
-  vkDestroyBuffer(vk_device_, staging_buf, nullptr);
+  // The data is copied into staging memory here, but the copy into the buffer is only submitted
+  // with the next frame (or an explicit flush), so this does not wait on the GPU.
+  upload_ticket_ = upload_manager_->EnqueueBufferUpload(
+      vk_buffer_, 0, builder.data_, builder.data_size_, dst_access, dst_stage);
 }
 
 GALBuffer::~GALBuffer() {
-  vkFreeMemory(vk_device_, vk_buffer_memory_, nullptr);
+  // The upload may still be writing to the buffer.
+  upload_manager_->Wait(upload_ticket_);
+
+  // Only uniform and storage buffers are bound through descriptor sets.
+  if (buffer_type_ == BufferType::Uniform || buffer_type_ == BufferType::Storage) {
+    descriptor_cache_->OnResourceDestroyed();
+  }
+
   vkDestroyBuffer(vk_device_, vk_buffer_, nullptr);
+  memory_allocator_->Free(allocation_);
 }
 
 std::optional<GALBuffer::BufferInfo> 
     GALBuffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, 
-                            VkMemoryPropertyFlags properties) {
+                            VkMemoryPropertyFlags required_properties,
+                            VkMemoryPropertyFlags preferred_properties) {
   VkBufferCreateInfo buffer_create_info{};
   buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   buffer_create_info.size = size;
@@ -104,40 +124,15 @@ std::optional<GALBuffer::BufferInfo>
     return std::nullopt;
   }
 
-  VkMemoryRequirements memory_req;
-  vkGetBufferMemoryRequirements(vk_device_, buffer_info.vk_buffer, &memory_req);
-
-  VkPhysicalDeviceMemoryProperties memory_props;
-  vkGetPhysicalDeviceMemoryProperties(vk_physical_device_, &memory_props);
-
-  bool found_memory_type = false;
-  uint32_t memory_type_index = 0;
-
-  for (uint32_t i = 0; i < memory_props.memoryTypeCount; ++i) {
-    if (memory_req.memoryTypeBits & (1 << i) && 
-        memory_props.memoryTypes[i].propertyFlags == properties) {
-      found_memory_type = true;
-      memory_type_index = i;
-    }
-  }
-
-  if (!found_memory_type) {
-    std::cerr << "Could not find memory for memory type." << std::endl;
-    return std::nullopt;
-  }
-
-  VkMemoryAllocateInfo alloc_info{};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = memory_req.size;
-  alloc_info.memoryTypeIndex = memory_type_index;
-
-  if (vkAllocateMemory(vk_device_, &alloc_info, nullptr, &buffer_info.vk_buffer_memory) 
-          != VK_SUCCESS) {
-    std::cerr << "Could not allocate VkDeviceMemory." << std::endl;
+  std::optional<GALMemoryAllocator::Allocation> allocation = 
+      memory_allocator_->AllocateBufferMemory(buffer_info.vk_buffer, required_properties, 
+                                              preferred_properties);
+  if (!allocation.has_value()) {
+    std::cerr << "Could not allocate memory for VkBuffer." << std::endl;
+    vkDestroyBuffer(vk_device_, buffer_info.vk_buffer, nullptr);
     return std::nullopt;
   }
-
-  vkBindBufferMemory(vk_device_, buffer_info.vk_buffer, buffer_info.vk_buffer_memory, 0);
+  buffer_info.allocation = allocation.value();
 
   return buffer_info;
 }
@@ -153,6 +148,11 @@ GALBuffer::Builder& GALBuffer::Builder::SetBufferData(uint8_t* data, size_t size
   return *this;
 }
 
+GALBuffer::Builder& GALBuffer::Builder::SetIndexType(IndexType index_type) {
+  index_type_ = index_type;
+  return *this;
+}
+
 std::unique_ptr<GALBuffer> GALBuffer::Builder::Create() {
   return std::make_unique<GALBuffer>(*this);
 }
@@ -5,13 +5,36 @@
 
 #include <memory>
 #include <optional>
+#include "gal/gal_descriptor_cache.h"
+#include "gal/gal_memory_allocator.h"
 #include "gal/gal_platform.h"
+#include "gal/gal_upload_manager.h"
 
 namespace gal {
 
 enum class BufferType {
   Vertex,
-  Uniform
+
+  // Uniform data that does not change, bound with command::BindUniformBuffer. Uniform data that
+  // changes every frame or every draw should be written with command::SetUniformData instead.
+  Uniform,
+
+  // Indices of the type set with Builder::SetIndexType(), bound with command::SetIndexBuffer.
+  Index,
+
+  // Device-local data that compute shaders read and write, bound with
+  // command::BindStorageBuffer. Can also be bound as a vertex or index buffer, and copied from
+  // with command::CopyBuffer. The data passed to the builder is optional.
+  Storage,
+
+  // Host-visible memory that command::CopyBuffer copies GPU results into, for the CPU to read
+  // through GetMappedData() once the frame that copied them has finished. Takes no data.
+  Readback
+};
+
+enum class IndexType {
+  Uint16,
+  Uint32
 };
 
 class GALBuffer {
@@ -27,21 +50,43 @@ public:
   }
 
   VkBuffer GetVkBuffer() { return vk_buffer_; }
+  BufferType GetType() const { return buffer_type_; }
+
+  // Only meaningful for BufferType::Index.
+  IndexType GetIndexType() const { return index_type_; }
+
+  VkDeviceSize GetSize() const { return size_; }
+
+  // Null unless the buffer is a BufferType::Readback buffer.
+  const void* GetMappedData() const { return allocation_.mapped_data; }
+
+  // The buffer's contents are ready once this ticket completes. Frames submitted through
+  // GALPlatform do not need to wait on it.
+  UploadTicket GetUploadTicket() const { return upload_ticket_; }
 
 private:
   struct BufferInfo {
     VkBuffer vk_buffer;
-    VkDeviceMemory vk_buffer_memory;
+    GALMemoryAllocator::Allocation allocation;
   };
 
   std::optional<BufferInfo> CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, 
-                                         VkMemoryPropertyFlags properties);
+                                         VkMemoryPropertyFlags required_properties,
+                                         VkMemoryPropertyFlags preferred_properties);
 
 private:
-  VkPhysicalDevice vk_physical_device_;
   VkDevice vk_device_;
+  GALMemoryAllocator* memory_allocator_;
+  GALUploadManager* upload_manager_;
+  GALDescriptorCache* descriptor_cache_;
+
+  BufferType buffer_type_;
+  IndexType index_type_;
+  VkDeviceSize size_;
   VkBuffer vk_buffer_;
-  VkDeviceMemory vk_buffer_memory_;
+  GALMemoryAllocator::Allocation allocation_;
+
+  UploadTicket upload_ticket_;
 
 public:
   class Builder {
@@ -53,14 +98,18 @@ public:
     Builder& SetType(BufferType type);
     Builder& SetBufferData(uint8_t* data, size_t size);
 
+    // Defaults to IndexType::Uint32.
+    Builder& SetIndexType(IndexType index_type);
+
     std::unique_ptr<GALBuffer> Create();
 
   private:
     GALPlatform* gal_platform_; 
 
     BufferType buffer_type_;
-    uint8_t* data_;
-    size_t data_size_;
+    IndexType index_type_ = IndexType::Uint32;
+    uint8_t* data_ = nullptr;
+    size_t data_size_ = 0;
   };
 
 };
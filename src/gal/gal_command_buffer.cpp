@@ -2,53 +2,321 @@
 
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <vector>
+#include "gal/gal_command_encoder.h"
 #include "gal/gal_commands.h"
+#include "gal/gal_descriptor_cache.h"
 #include "gal/gal_exception.h"
 #include "gal/gal_platform.h"
+#include "gal/gal_profiler.h"
+#include "gal/gal_uniform_ring.h"
+#include "gal/gal_worker_pool.h"
 
 namespace gal {
 
-GALCommandBuffer::GALCommandBuffer(GALPlatform* gal_platform) {
+namespace {
+
+// Splitting shorter lists costs more in secondary command buffer overhead than it saves.
+const size_t kMinCommandsPerSlice = 256;
+
+// More slices than workers, so that a worker that finishes early can take another slice.
+const uint32_t kSlicesPerWorker = 2;
+
+// Vertex buffer bindings that slices carry over. Matches the minimum maxVertexInputBindings.
+const int kMaxVertexBufferBindings = 16;
+
+bool IsDrawCommand(const CommandVariant& command_variant) {
+  return std::holds_alternative<command::DrawTriangles>(command_variant) ||
+         std::holds_alternative<command::DrawIndexed>(command_variant) ||
+         std::holds_alternative<command::DrawIndexedIndirect>(command_variant) ||
+         std::holds_alternative<command::DrawIndexedIndirectCount>(command_variant);
+}
+
+// Commands that can only be recorded outside a render pass.
+bool IsComputeCommand(const CommandVariant& command_variant) {
+  return std::holds_alternative<command::SetComputePipeline>(command_variant) ||
+         std::holds_alternative<command::Dispatch>(command_variant) ||
+         std::holds_alternative<command::CopyBuffer>(command_variant) ||
+         std::holds_alternative<command::FillBuffer>(command_variant);
+}
+
+// The viewport and scissor are dynamic state, which is not inherited by secondary command
+// buffers, so they are recorded into every buffer that draws.
+void RecordViewport(VkCommandBuffer command_buffer, const command::SetViewport& viewport) {
+  VkViewport vk_viewport{};
+  vk_viewport.x = viewport.x;
+  vk_viewport.y = viewport.y;
+  vk_viewport.width = viewport.width;
+  vk_viewport.height = viewport.height;
+  vk_viewport.minDepth = 0.f;
+  vk_viewport.maxDepth = 1.f;
+  vkCmdSetViewport(command_buffer, 0, 1, &vk_viewport);
+
+  VkRect2D scissor{};
+  scissor.offset = {viewport.x, viewport.y};
+  scissor.extent = {viewport.width, viewport.height};
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+// Calls f(stages, offset, size) for each run of the bytes offset to offset + size that is read
+// by the same stages, since vkCmdPushConstants() must name exactly the stages of every range
+// that contains the bytes it writes. stages is 0 for bytes outside every range.
+template <typename Function>
+void ForEachPushConstantSegment(const std::vector<VkPushConstantRange>& ranges, uint32_t offset,
+                                uint32_t size, Function f) {
+  uint32_t begin = offset;
+  uint32_t end = offset + size;
+  while (begin < end) {
+    VkShaderStageFlags stages = 0;
+    uint32_t segment_end = end;
+    for (const VkPushConstantRange& range : ranges) {
+      uint32_t range_end = range.offset + range.size;
+      if (range.offset <= begin && begin < range_end) {
+        stages |= range.stageFlags;
+        segment_end = std::min(segment_end, range_end);
+      } else if (range.offset > begin) {
+        segment_end = std::min(segment_end, range.offset);
+      }
+    }
+
+    f(stages, begin, segment_end - begin);
+    begin = segment_end;
+  }
+}
+
+VkIndexType GetVkIndexType(IndexType index_type) {
+  return index_type == IndexType::Uint16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+} // namespace
+
+// What SubmitEncoder() has bound in the buffers it records into, so that binds which would not
+// change anything are skipped. VK_NULL_HANDLE for what is unknown.
+struct GALCommandBuffer::BoundState {
+  VkPipeline pipeline = VK_NULL_HANDLE;
+
+  // Sets are compared along with the layout they were bound with, since a pipeline with another
+  // layout may not be compatible with them.
+  VkPipelineLayout uniform_layout = VK_NULL_HANDLE;
+  VkDescriptorSet uniform_set = VK_NULL_HANDLE;
+  UniformOffsets uniform_offsets{};
+
+  VkPipelineLayout resource_layout = VK_NULL_HANDLE;
+  VkDescriptorSet resource_set = VK_NULL_HANDLE;
+
+  VkBuffer vertex_buffers[kMaxVertexBufferBindings]{};
+  VkDeviceSize vertex_buffer_offsets[kMaxVertexBufferBindings]{};
+
+  VkBuffer index_buffer = VK_NULL_HANDLE;
+  VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+};
+
+GALCommandBuffer::GALCommandBuffer(GALPlatform* gal_platform, RecordingMode recording_mode) {
   gal_platform_ = gal_platform;
   vk_device_ = gal_platform->GetVkDevice();
+  recording_mode_ = recording_mode;
 
-  uint32_t framebuffer_count = gal_platform->GetSwapchainImageViews().size();
+  VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+  command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  command_buffer_alloc_info.commandBufferCount = 1;
+
+  if (recording_mode_ == RecordingMode::PerFrame) {
+    uint32_t frames_in_flight = gal_platform->GetFramesInFlight();
+
+    vk_command_buffers_.resize(frames_in_flight);
+    for (uint32_t frame = 0; frame < frames_in_flight; ++frame) {
+      command_buffer_alloc_info.commandPool = gal_platform->GetFrameCommandPool(frame);
+
+      if (vkAllocateCommandBuffers(vk_device_, &command_buffer_alloc_info, 
+                                   &vk_command_buffers_[frame]) != VK_SUCCESS) {
+        throw Exception("Could not create command buffers.");
+      }
+    }
+
+    recording_targets_.resize(1);
+    vk_frame_secondary_command_buffers_.resize(frames_in_flight);
+    return;
+  }
+
+  AllocatePersistentCommandBuffers();
+}
+
+GALCommandBuffer::~GALCommandBuffer() {
+  GALWorkerPool* worker_pool = gal_platform_->GetWorkerPool();
+
+  for (size_t i = 0; i < vk_secondary_command_buffers_.size(); ++i) {
+    if (!vk_secondary_command_buffers_[i].empty()) {
+      vkFreeCommandBuffers(vk_device_, worker_pool->GetPersistentCommandPool(i), 
+                           static_cast<uint32_t>(vk_secondary_command_buffers_[i].size()),
+                           vk_secondary_command_buffers_[i].data());
+    }
+  }
+
+  for (size_t frame = 0; frame < vk_frame_secondary_command_buffers_.size(); ++frame) {
+    for (size_t i = 0; i < vk_frame_secondary_command_buffers_[frame].size(); ++i) {
+      const std::vector<VkCommandBuffer>& command_buffers = 
+          vk_frame_secondary_command_buffers_[frame][i];
+      if (!command_buffers.empty()) {
+        vkFreeCommandBuffers(vk_device_, worker_pool->GetFrameCommandPool(i, frame),
+                             static_cast<uint32_t>(command_buffers.size()),
+                             command_buffers.data());
+      }
+    }
+  }
+
+  if (vk_shared_command_buffer_ != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(vk_device_, gal_platform_->GetVkCommandPool(), 1, 
+                         &vk_shared_command_buffer_);
+  }
+
+  if (recording_mode_ == RecordingMode::PerFrame) {
+    for (size_t frame = 0; frame < vk_command_buffers_.size(); ++frame) {
+      vkFreeCommandBuffers(vk_device_, gal_platform_->GetFrameCommandPool(frame), 1, 
+                           &vk_command_buffers_[frame]);
+    }
+  }
+}
+
+void GALCommandBuffer::AllocatePersistentCommandBuffers() {
+  uint32_t framebuffer_count = gal_platform_->GetSwapchainImageViews().size();
 
   vk_command_buffers_.resize(framebuffer_count);
 
   VkCommandBufferAllocateInfo command_buffer_alloc_info{};
   command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  command_buffer_alloc_info.commandPool = gal_platform->GetVkCommandPool();
+  command_buffer_alloc_info.commandPool = gal_platform_->GetVkCommandPool();
   command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  command_buffer_alloc_info.commandBufferCount = static_cast<uint32_t>(vk_command_buffers_.size());
+  command_buffer_alloc_info.commandBufferCount = framebuffer_count;
 
   if (vkAllocateCommandBuffers(vk_device_, &command_buffer_alloc_info, 
                                vk_command_buffers_.data()) != VK_SUCCESS) {
     throw Exception("Could not create command buffers.");
   }
+
+  recording_targets_.clear();
+  for (uint32_t i = 0; i < framebuffer_count; ++i) {
+    recording_targets_.push_back({vk_command_buffers_[i], i});
+  }
 }
 
-GALCommandBuffer::~GALCommandBuffer() {}
+void GALCommandBuffer::FreePersistentCommandBuffers() {
+  GALWorkerPool* worker_pool = gal_platform_->GetWorkerPool();
+
+  for (size_t i = 0; i < vk_secondary_command_buffers_.size(); ++i) {
+    if (!vk_secondary_command_buffers_[i].empty()) {
+      vkFreeCommandBuffers(vk_device_, worker_pool->GetPersistentCommandPool(i), 
+                           static_cast<uint32_t>(vk_secondary_command_buffers_[i].size()),
+                           vk_secondary_command_buffers_[i].data());
+      vk_secondary_command_buffers_[i].clear();
+    }
+  }
+
+  vkFreeCommandBuffers(vk_device_, gal_platform_->GetVkCommandPool(), 
+                       static_cast<uint32_t>(vk_command_buffers_.size()), 
+                       vk_command_buffers_.data());
+  vk_command_buffers_.clear();
+
+  if (vk_shared_command_buffer_ != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(vk_device_, gal_platform_->GetVkCommandPool(), 1, 
+                         &vk_shared_command_buffer_);
+    vk_shared_command_buffer_ = VK_NULL_HANDLE;
+  }
+  recording_targets_.clear();
+}
 
 bool GALCommandBuffer::BeginRecording() {
-  for (VkCommandBuffer command_buffer : vk_command_buffers_) {
+  GALProfiler* profiler = gal_platform_->GetProfiler();
+
+  if (recording_mode_ == RecordingMode::Persistent && recorded_) {
+    // The buffers may still be executing, and their pool cannot reset them one at a time. They
+    // are only recorded again in rare cases, such as after the swapchain has been recreated.
+    gal_platform_->WaitIdle();
+
+    try {
+      FreePersistentCommandBuffers();
+      AllocatePersistentCommandBuffers();
+    } catch (Exception& e) {
+      std::cerr << e.what() << std::endl;
+      return false;
+    }
+  }
+  recorded_ = true;
+  swapchain_generation_ = gal_platform_->GetSwapchainGeneration();
+
+  const VkExtent2D& extent = gal_platform_->GetVkSwapchainExtent();
+  viewport_.x = 0;
+  viewport_.y = 0;
+  viewport_.width = static_cast<uint16_t>(extent.width);
+  viewport_.height = static_cast<uint16_t>(extent.height);
+
+  open_profile_scopes_.clear();
+  bound_pipeline_ = nullptr;
+  bound_compute_pipeline_ = nullptr;
+  bound_bindless_layout_ = VK_NULL_HANDLE;
+  bound_resource_layout_ = nullptr;
+  bound_resources_.clear();
+  resources_dirty_ = false;
+  render_pass_open_ = false;
+  render_pass_has_secondaries_ = false;
+  pending_write_stages_ = 0;
+  pending_write_access_ = 0;
+  compute_recorded_ = false;
+
+  if (recording_mode_ == RecordingMode::PerFrame) {
+    // The frame's pool was reset by StartTick(), which also reset this buffer.
+    recording_frame_ = gal_platform_->GetCurrentFrame();
+    recording_targets_[0].vk_command_buffer = vk_command_buffers_[recording_frame_];
+    recording_targets_[0].image_idx = gal_platform_->GetCurrentImageIndex();
+
+    std::fill(secondary_command_buffers_used_.begin(), secondary_command_buffers_used_.end(), 0);
+  }
+
+  for (const RecordingTarget& target : recording_targets_) {
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    if (recording_mode_ == RecordingMode::PerFrame) {
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    }
 
-    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+    if (vkBeginCommandBuffer(target.vk_command_buffer, &begin_info) != VK_SUCCESS) {
       std::cerr << "Could not begin command buffer." << std::endl;
       return false;
     }
+
+    if (profiler != nullptr) {
+      profiler->RecordFrameBegin(target.vk_command_buffer, target.image_idx);
+    }
   }
   return true;
 }
 
 bool GALCommandBuffer::EndRecording() {
-  for (VkCommandBuffer command_buffer : vk_command_buffers_) {
-    vkCmdEndRenderPass(command_buffer);
+  GALProfiler* profiler = gal_platform_->GetProfiler();
+
+  if (!open_profile_scopes_.empty()) {
+    std::cerr << "Profile scope was not ended before the command buffer." << std::endl;
+  }
+
+  if (shared_render_pass_open_ && !EndSharedRenderPass()) {
+    return false;
+  }
 
-    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+  for (const RecordingTarget& target : recording_targets_) {
+    if (render_pass_open_) {
+      vkCmdEndRenderPass(target.vk_command_buffer);
+    }
+
+    if (profiler != nullptr) {
+      profiler->RecordFrameEnd(target.vk_command_buffer, target.image_idx);
+    }
+
+    if (vkEndCommandBuffer(target.vk_command_buffer) != VK_SUCCESS) {
       std::cerr << "Could not end command buffer." << std::endl;
       return false;
     }
@@ -57,42 +325,1203 @@ bool GALCommandBuffer::EndRecording() {
 }
 
 void GALCommandBuffer::SubmitCommand(const CommandVariant& command_variant) {
+  if (render_pass_has_secondaries_) {
+    std::cerr << "Commands cannot be submitted after SubmitCommandsParallel()." << std::endl;
+    return;
+  }
+
+  if (IsComputeCommand(command_variant) && render_pass_open_) {
+    std::cerr << "Compute commands and copies must be submitted before the first SetPipeline."
+              << std::endl;
+    return;
+  }
+
+  if (std::holds_alternative<command::SetViewport>(command_variant)) {
+    viewport_ = std::get<command::SetViewport>(command_variant);
+
+    // Dynamic state cannot be set before the render pass, so it is set when it begins.
+    if (!render_pass_open_) {
+      return;
+    }
+  }
+
+  if (std::holds_alternative<command::SetPipeline>(command_variant) && !render_pass_open_) {
+    BeginRenderPass(VK_SUBPASS_CONTENTS_INLINE);
+  }
+
+  ResolvedCommand resolved = ResolveCommand(command_variant);
+
+  bool is_dispatch = std::holds_alternative<command::Dispatch>(command_variant);
+  bool is_copy = std::holds_alternative<command::CopyBuffer>(command_variant) ||
+                 std::holds_alternative<command::FillBuffer>(command_variant);
+
+  if (is_dispatch || is_copy) {
+    if (is_dispatch && bound_compute_pipeline_ == nullptr) {
+      std::cerr << "Dispatch was submitted before a compute pipeline." << std::endl;
+      return;
+    }
+
+    if (!compute_recorded_) {
+      pending_write_stages_ |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      pending_write_access_ |= VK_ACCESS_MEMORY_WRITE_BIT;
+      compute_recorded_ = true;
+    }
+
+    if (is_dispatch) {
+      RecordWriteBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
+                         VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    } else {
+      RecordWriteBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                         VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+  }
+
+  for (const RecordingTarget& target : recording_targets_) {
+    RecordCommand(target.vk_command_buffer, target.image_idx, command_variant, resolved);
+  }
+
+  if (is_dispatch) {
+    pending_write_stages_ |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    pending_write_access_ |= VK_ACCESS_SHADER_WRITE_BIT;
+  } else if (is_copy) {
+    pending_write_stages_ |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    pending_write_access_ |= VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    // The CPU reads readback buffers once the frame's fence has signaled, which does not make
+    // the copy visible to the host by itself.
+    if (std::holds_alternative<command::CopyBuffer>(command_variant) &&
+        std::get<command::CopyBuffer>(command_variant).dst->GetType() == BufferType::Readback) {
+      RecordBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+    }
+  }
+}
+
+bool GALCommandBuffer::SubmitCommandsParallel(const std::vector<CommandVariant>& commands) {
+  GALWorkerPool* worker_pool = gal_platform_->GetWorkerPool();
+  GALProfiler* profiler = gal_platform_->GetProfiler();
+
+  // Secondary command buffers can only be executed while the frame's pipeline statistics query
+  // is active if they inherit it.
+  bool queries_block_secondaries = 
+      profiler != nullptr && profiler->GetPipelineStatisticsFlags() != 0 &&
+      !gal_platform_->IsInheritedQueriesEnabled();
+
+  auto first_pipeline = std::find_if(commands.begin(), commands.end(), 
+      [](const CommandVariant& command_variant) {
+        return std::holds_alternative<command::SetPipeline>(command_variant);
+      });
+
+  if (worker_pool == nullptr || render_pass_open_ || queries_block_secondaries ||
+      first_pipeline == commands.end() || 
+      static_cast<size_t>(commands.end() - first_pipeline) < 2 * kMinCommandsPerSlice) {
+    for (const CommandVariant& command_variant : commands) {
+      SubmitCommand(command_variant);
+    }
+    return true;
+  }
+
+  if (std::any_of(first_pipeline, commands.end(), IsComputeCommand)) {
+    std::cerr << "Compute commands and copies must be submitted before the first SetPipeline."
+              << std::endl;
+    return false;
+  }
+
+  // Compute work is recorded inline, ahead of the render pass.
+  for (auto it = commands.begin(); it != first_pipeline; ++it) {
+    SubmitCommand(*it);
+  }
+
+  const CommandVariant* render_pass_commands = &*first_pipeline;
+  size_t command_count = static_cast<size_t>(commands.end() - first_pipeline);
+
+  // Profile scopes are matched and uniform and instance data are copied up front, since neither
+  // the scope stack nor the uniform ring is safe to share between workers, and a scope may begin
+  // and end in different slices.
+  resolved_commands_.resize(command_count);
+  for (size_t i = 0; i < command_count; ++i) {
+    resolved_commands_[i] = ResolveCommand(render_pass_commands[i]);
+  }
+
+  uint32_t slice_count = std::min<uint32_t>(
+      worker_pool->GetWorkerCount() * kSlicesPerWorker, 
+      static_cast<uint32_t>(command_count / kMinCommandsPerSlice));
+
+  // State does not carry over between secondary command buffers, so each slice starts by
+  // setting the viewport, and rebinding the pipeline, uniforms, vertex buffers and index buffer
+  // that were bound where it begins.
+  if (slices_.size() < slice_count) {
+    slices_.resize(slice_count);
+  }
+  {
+    command::SetViewport bound_viewport = viewport_;
+    std::optional<command::SetPipeline> bound_pipeline;
+    ResolvedCommand bound_sets;
+    std::optional<PrologueCommand> bound_vert_buffers[kMaxVertexBufferBindings];
+    std::optional<command::SetIndexBuffer> bound_index_buffer;
+
+    // The push constants written since the last SetPipeline. A write replaces an earlier one to
+    // the same bytes.
+    std::vector<PrologueCommand> bound_push_constants;
+
+    size_t command_idx = 0;
+    for (uint32_t s = 0; s < slice_count; ++s) {
+      Slice& slice = slices_[s];
+      slice.begin = command_count * s / slice_count;
+      slice.end = command_count * (s + 1) / slice_count;
+      slice.prologue.clear();
+
+      for (; command_idx < slice.begin; ++command_idx) {
+        const CommandVariant& command_variant = render_pass_commands[command_idx];
+
+        const ResolvedCommand& resolved = resolved_commands_[command_idx];
+
+        if (std::holds_alternative<command::SetPipeline>(command_variant)) {
+          bound_pipeline = std::get<command::SetPipeline>(command_variant);
+          bound_sets.uniform_pipeline = resolved.uniform_pipeline;
+          bound_sets.uniform_offsets = resolved.uniform_offsets;
+          bound_sets.resource_set = VK_NULL_HANDLE;
+          bound_push_constants.clear();
+
+          // Slices start with nothing bound, so the bindless set is bound even where this
+          // SetPipeline shared an earlier binding.
+          GALPipeline* pipeline = bound_pipeline.value().pipeline;
+          bound_sets.bindless_pipeline = pipeline->IsBindless() ? pipeline : nullptr;
+        } else if (resolved.push_constant_pipeline != nullptr) {
+          const auto& command = std::get<command::PushConstants>(command_variant);
+          auto it = std::find_if(bound_push_constants.begin(), bound_push_constants.end(),
+              [&command](const PrologueCommand& bound) {
+                const auto& bound_command = std::get<command::PushConstants>(bound.command);
+                return bound_command.offset == command.offset && 
+                       bound_command.size == command.size;
+              });
+          if (it != bound_push_constants.end()) {
+            *it = PrologueCommand{command_variant, resolved};
+          } else {
+            bound_push_constants.push_back({command_variant, resolved});
+          }
+        } else if (resolved.uniform_pipeline != nullptr) {
+          bound_sets.uniform_offsets = resolved.uniform_offsets;
+        } else if (resolved.resource_set != VK_NULL_HANDLE) {
+          bound_sets.resource_set = resolved.resource_set;
+          bound_sets.resource_layout = resolved.resource_layout;
+          bound_sets.resource_bind_point = resolved.resource_bind_point;
+          bound_sets.resource_set_index = resolved.resource_set_index;
+        } else if (std::holds_alternative<command::SetVertexBuffer>(command_variant) ||
+                   std::holds_alternative<command::SetInstanceData>(command_variant)) {
+          int buffer_idx =
+              std::holds_alternative<command::SetVertexBuffer>(command_variant)
+                  ? std::get<command::SetVertexBuffer>(command_variant).buffer_idx
+                  : std::get<command::SetInstanceData>(command_variant).buffer_idx;
+          if (buffer_idx >= 0 && buffer_idx < kMaxVertexBufferBindings) {
+            bound_vert_buffers[buffer_idx] = PrologueCommand{command_variant, resolved};
+          }
+        } else if (std::holds_alternative<command::SetIndexBuffer>(command_variant)) {
+          bound_index_buffer = std::get<command::SetIndexBuffer>(command_variant);
+        } else if (std::holds_alternative<command::SetViewport>(command_variant)) {
+          bound_viewport = std::get<command::SetViewport>(command_variant);
+        }
+      }
+
+      slice.prologue.push_back({bound_viewport, ResolvedCommand{}});
+      if (bound_pipeline.has_value()) {
+        slice.prologue.push_back({bound_pipeline.value(), bound_sets});
+      }
+      slice.prologue.insert(slice.prologue.end(), bound_push_constants.begin(), 
+                            bound_push_constants.end());
+      for (const std::optional<PrologueCommand>& vert_buffer : bound_vert_buffers) {
+        if (vert_buffer.has_value()) {
+          slice.prologue.push_back(vert_buffer.value());
+        }
+      }
+      if (bound_index_buffer.has_value()) {
+        slice.prologue.push_back({bound_index_buffer.value(), ResolvedCommand{}});
+      }
+    }
+  }
+
+  size_t target_count = recording_targets_.size();
+
+  // Indexed by slice, then by recording target.
+  slice_command_buffers_.resize(slice_count * target_count);
+
+  uint32_t worker_count = worker_pool->GetWorkerCount();
+  if (recording_mode_ == RecordingMode::PerFrame) {
+    vk_frame_secondary_command_buffers_[recording_frame_].resize(worker_count);
+    secondary_command_buffers_used_.resize(worker_count, 0);
+  } else {
+    vk_secondary_command_buffers_.resize(worker_count);
+  }
+
+  VkQueryPipelineStatisticFlags pipeline_statistics = 
+      profiler != nullptr ? profiler->GetPipelineStatisticsFlags() : 0;
+
+  try {
+    worker_pool->ParallelFor(slice_count, [&](uint32_t slice_idx, uint32_t worker_idx) {
+      const Slice& slice = slices_[slice_idx];
+
+      for (size_t t = 0; t < target_count; ++t) {
+        const RecordingTarget& target = recording_targets_[t];
+
+        VkCommandBuffer command_buffer = AcquireSecondaryCommandBuffer(worker_idx);
+        slice_command_buffers_[slice_idx * target_count + t] = command_buffer;
+
+        VkCommandBufferInheritanceInfo inheritance_info{};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = gal_platform_->GetVkRenderPass();
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = gal_platform_->GetVkFramebuffer(target.image_idx);
+        inheritance_info.pipelineStatistics = pipeline_statistics;
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        if (recording_mode_ == RecordingMode::PerFrame) {
+          begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        }
+        begin_info.pInheritanceInfo = &inheritance_info;
+
+        if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+          throw Exception("Could not begin secondary command buffer.");
+        }
+
+        for (const PrologueCommand& prologue_command : slice.prologue) {
+          RecordCommand(command_buffer, target.image_idx, prologue_command.command,
+                        prologue_command.resolved);
+        }
+        for (size_t c = slice.begin; c < slice.end; ++c) {
+          RecordCommand(command_buffer, target.image_idx, render_pass_commands[c], 
+                        resolved_commands_[c]);
+        }
+
+        if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+          throw Exception("Could not end secondary command buffer.");
+        }
+      }
+    });
+  } catch (Exception& e) {
+    std::cerr << e.what() << std::endl;
+    return false;
+  }
+
+  BeginRenderPass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  render_pass_has_secondaries_ = true;
+
+  target_command_buffers_.resize(slice_count);
+  for (size_t t = 0; t < target_count; ++t) {
+    for (uint32_t s = 0; s < slice_count; ++s) {
+      target_command_buffers_[s] = slice_command_buffers_[s * target_count + t];
+    }
+    vkCmdExecuteCommands(recording_targets_[t].vk_command_buffer, slice_count, 
+                         target_command_buffers_.data());
+  }
+
+  return true;
+}
+
+void GALCommandBuffer::SubmitEncoder(const GALCommandEncoder& encoder) {
+  if (render_pass_has_secondaries_) {
+    std::cerr << "Commands cannot be submitted after SubmitCommandsParallel()." << std::endl;
+    return;
+  }
+
+  BoundState bound;
+
+  const uint8_t* packet = encoder.GetData();
+  const uint8_t* end = packet + encoder.GetSize();
+  while (packet != end) {
+    GALCommandEncoder::PacketHeader header = GALCommandEncoder::ReadHeader(packet);
+
+    switch (header.type) {
+      case GALCommandEncoder::kPacketType<command::SetPipeline>: {
+        auto command = GALCommandEncoder::ReadCommand<command::SetPipeline>(packet);
+
+        if (!render_pass_open_) {
+          if (recording_mode_ == RecordingMode::Persistent && recording_targets_.size() > 1 &&
+              gal_platform_->GetProfiler() == nullptr) {
+            BeginSharedRenderPass();
+          } else {
+            BeginRenderPass(VK_SUBPASS_CONTENTS_INLINE);
+          }
+        }
+
+        ResolvedCommand resolved;
+        ResolvePipeline(command.pipeline, &resolved);
+
+        RecordPipelineBind(command.pipeline, &bound);
+        if (resolved.uniform_pipeline != nullptr) {
+          RecordUniformBind(resolved, &bound);
+        }
+        if (resolved.bindless_pipeline != nullptr) {
+          RecordBindlessBind(resolved, &bound);
+        }
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::SetVertexBuffer>: {
+        auto command = GALCommandEncoder::ReadCommand<command::SetVertexBuffer>(packet);
+        RecordVertexBufferBind(command.buffer_idx, command.buffer->GetVkBuffer(), 0, &bound);
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::SetIndexBuffer>: {
+        auto command = GALCommandEncoder::ReadCommand<command::SetIndexBuffer>(packet);
+        RecordIndexBufferBind(command.buffer, &bound);
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::SetUniformData>: {
+        ResolvedCommand resolved;
+        ResolveUniformData(GALCommandEncoder::ReadCommand<command::SetUniformData>(packet),
+                           &resolved);
+        if (resolved.uniform_pipeline != nullptr) {
+          RecordUniformBind(resolved, &bound);
+        }
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::SetInstanceData>: {
+        auto command = GALCommandEncoder::ReadCommand<command::SetInstanceData>(packet);
+
+        ResolvedCommand resolved;
+        ResolveInstanceData(command, &resolved);
+        if (resolved.vertex_buffer != VK_NULL_HANDLE) {
+          RecordVertexBufferBind(command.buffer_idx, resolved.vertex_buffer, 
+                                 resolved.vertex_buffer_offset, &bound);
+        }
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::PushConstants>: {
+        auto command = GALCommandEncoder::ReadCommand<command::PushConstants>(packet);
+
+        ResolvedCommand resolved;
+        ResolvePushConstants(command, &resolved);
+        if (resolved.push_constant_pipeline != nullptr) {
+          for (const RecordingTarget& target : recording_targets_) {
+            RecordPushConstants(target.vk_command_buffer, resolved.push_constant_pipeline, 
+                                command);
+          }
+        }
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::BindUniformBuffer>: {
+        auto command = GALCommandEncoder::ReadCommand<command::BindUniformBuffer>(packet);
+        ResolveResourceBinding(command.shader_idx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 
+                               command.buffer, nullptr);
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::BindStorageBuffer>: {
+        auto command = GALCommandEncoder::ReadCommand<command::BindStorageBuffer>(packet);
+        ResolveResourceBinding(command.shader_idx, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 
+                               command.buffer, nullptr);
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::BindTexture>: {
+        auto command = GALCommandEncoder::ReadCommand<command::BindTexture>(packet);
+        ResolveResourceBinding(command.shader_idx, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 
+                               nullptr, command.texture);
+        break;
+      }
+      case GALCommandEncoder::kPacketType<command::DrawTriangles>:
+      case GALCommandEncoder::kPacketType<command::DrawIndexed>:
+      case GALCommandEncoder::kPacketType<command::DrawIndexedIndirect>:
+      case GALCommandEncoder::kPacketType<command::DrawIndexedIndirectCount>: {
+        ResolvedCommand resolved;
+        ResolveDrawResources(false, &resolved);
+        if (resolved.resource_set != VK_NULL_HANDLE) {
+          RecordResourceBind(resolved, &bound);
+        }
+        RecordEncodedDraw(header.type, packet);
+        break;
+      }
+      default:
+        // Viewports, profile scopes, compute commands and copies are rare enough to go through
+        // SubmitCommand(), which binds without updating the bound state.
+        SubmitCommand(GALCommandEncoder::Decode(packet));
+        bound = BoundState{};
+        break;
+    }
+
+    packet += header.size;
+  }
+}
+
+void GALCommandBuffer::RecordEncodedDraw(uint16_t packet_type, const uint8_t* packet) {
+  switch (packet_type) {
+    case GALCommandEncoder::kPacketType<command::DrawTriangles>: {
+      auto command = GALCommandEncoder::ReadCommand<command::DrawTriangles>(packet);
+      for (const RecordingTarget& target : recording_targets_) {
+        vkCmdDraw(target.vk_command_buffer, 3 * command.num_triangles, command.instance_count, 
+                  0, command.first_instance);
+      }
+      break;
+    }
+    case GALCommandEncoder::kPacketType<command::DrawIndexed>: {
+      auto command = GALCommandEncoder::ReadCommand<command::DrawIndexed>(packet);
+      for (const RecordingTarget& target : recording_targets_) {
+        vkCmdDrawIndexed(target.vk_command_buffer, command.index_count, command.instance_count, 
+                         command.first_index, command.vertex_offset, command.first_instance);
+      }
+      break;
+    }
+    case GALCommandEncoder::kPacketType<command::DrawIndexedIndirect>: {
+      auto command = GALCommandEncoder::ReadCommand<command::DrawIndexedIndirect>(packet);
+      for (const RecordingTarget& target : recording_targets_) {
+        RecordDrawIndexedIndirect(target.vk_command_buffer, command.buffer->GetVkBuffer(), 
+                                  command.offset, command.draw_count, command.stride);
+      }
+      break;
+    }
+    case GALCommandEncoder::kPacketType<command::DrawIndexedIndirectCount>: {
+      auto command = GALCommandEncoder::ReadCommand<command::DrawIndexedIndirectCount>(packet);
+      for (const RecordingTarget& target : recording_targets_) {
+        RecordDrawIndexedIndirectCount(target.vk_command_buffer, command);
+      }
+      break;
+    }
+  }
+}
+
+void GALCommandBuffer::BeginSharedRenderPass() {
+  if (vk_shared_command_buffer_ == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+    command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_alloc_info.commandPool = gal_platform_->GetVkCommandPool();
+    command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    command_buffer_alloc_info.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(vk_device_, &command_buffer_alloc_info, 
+                                 &vk_shared_command_buffer_) != VK_SUCCESS) {
+      std::cerr << "Could not allocate shared command buffer." << std::endl;
+      vk_shared_command_buffer_ = VK_NULL_HANDLE;
+      BeginRenderPass(VK_SUBPASS_CONTENTS_INLINE);
+      return;
+    }
+  }
+
+  // The framebuffer differs between the buffers that execute it, so it is left unspecified.
+  VkCommandBufferInheritanceInfo inheritance_info{};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass = gal_platform_->GetVkRenderPass();
+  inheritance_info.subpass = 0;
+  inheritance_info.framebuffer = VK_NULL_HANDLE;
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | 
+                     VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+  begin_info.pInheritanceInfo = &inheritance_info;
+
+  if (vkBeginCommandBuffer(vk_shared_command_buffer_, &begin_info) != VK_SUCCESS) {
+    std::cerr << "Could not begin shared command buffer." << std::endl;
+    BeginRenderPass(VK_SUBPASS_CONTENTS_INLINE);
+    return;
+  }
+
+  BeginRenderPass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  RecordViewport(vk_shared_command_buffer_, viewport_);
+
+  shared_recording_targets_.assign(1, {vk_shared_command_buffer_, 0});
+  recording_targets_.swap(shared_recording_targets_);
+  shared_render_pass_open_ = true;
+}
+
+bool GALCommandBuffer::EndSharedRenderPass() {
+  recording_targets_.swap(shared_recording_targets_);
+  shared_render_pass_open_ = false;
+
+  if (vkEndCommandBuffer(vk_shared_command_buffer_) != VK_SUCCESS) {
+    std::cerr << "Could not end shared command buffer." << std::endl;
+    return false;
+  }
+
+  for (const RecordingTarget& target : recording_targets_) {
+    vkCmdExecuteCommands(target.vk_command_buffer, 1, &vk_shared_command_buffer_);
+  }
+  render_pass_has_secondaries_ = true;
+  return true;
+}
+
+VkCommandBuffer GALCommandBuffer::AcquireSecondaryCommandBuffer(uint32_t worker_idx) {
+  GALWorkerPool* worker_pool = gal_platform_->GetWorkerPool();
+
+  std::vector<VkCommandBuffer>* command_buffers;
+  VkCommandPool command_pool;
+
+  if (recording_mode_ == RecordingMode::PerFrame) {
+    command_buffers = &vk_frame_secondary_command_buffers_[recording_frame_][worker_idx];
+    command_pool = worker_pool->GetFrameCommandPool(worker_idx, recording_frame_);
+
+    // Buffers recorded the last time this frame came around were reset with the pool.
+    uint32_t& used = secondary_command_buffers_used_[worker_idx];
+    if (used < command_buffers->size()) {
+      return (*command_buffers)[used++];
+    }
+    ++used;
+  } else {
+    command_buffers = &vk_secondary_command_buffers_[worker_idx];
+    command_pool = worker_pool->GetPersistentCommandPool(worker_idx);
+  }
+
+  VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+  command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  command_buffer_alloc_info.commandPool = command_pool;
+  command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  command_buffer_alloc_info.commandBufferCount = 1;
+
+  VkCommandBuffer command_buffer;
+  if (vkAllocateCommandBuffers(vk_device_, &command_buffer_alloc_info, &command_buffer) 
+          != VK_SUCCESS) {
+    throw Exception("Could not allocate secondary command buffer.");
+  }
+  command_buffers->push_back(command_buffer);
+
+  return command_buffer;
+}
+
+void GALCommandBuffer::BeginRenderPass(VkSubpassContents contents) {
+  // Draws may consume compute results as vertices, indices, indirect arguments or shader
+  // resources.
+  RecordWriteBarrier(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                         VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | 
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                     VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                         VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+                         VK_ACCESS_SHADER_READ_BIT);
+
+  for (const RecordingTarget& target : recording_targets_) {
+    VkClearValue clear_values[2]{};
+    clear_values[0].color = {{0.f, 0.f, 0.f, 1.f}};
+    clear_values[1].depthStencil = {1.f, 0};
+
+    VkRenderPassBeginInfo render_pass_begin_info{};
+    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_begin_info.renderPass = gal_platform_->GetVkRenderPass();
+    render_pass_begin_info.framebuffer = gal_platform_->GetVkFramebuffer(target.image_idx);
+    render_pass_begin_info.renderArea.offset = {0, 0};
+    render_pass_begin_info.renderArea.extent = gal_platform_->GetVkSwapchainExtent();
+    render_pass_begin_info.clearValueCount = static_cast<uint32_t>(std::size(clear_values));
+    render_pass_begin_info.pClearValues = clear_values;
+
+    vkCmdBeginRenderPass(target.vk_command_buffer, &render_pass_begin_info, contents);
+
+    // Secondary command buffers set their own.
+    if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+      RecordViewport(target.vk_command_buffer, viewport_);
+    }
+  }
+
+  render_pass_open_ = true;
+}
+
+void GALCommandBuffer::RecordWriteBarrier(VkPipelineStageFlags dst_stages, 
+                                          VkAccessFlags dst_access) {
+  if (pending_write_stages_ == 0) {
+    return;
+  }
+
+  RecordBarrier(pending_write_stages_, pending_write_access_, dst_stages, dst_access);
+
+  pending_write_stages_ = 0;
+  pending_write_access_ = 0;
+}
+
+void GALCommandBuffer::RecordBarrier(VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+                                     VkPipelineStageFlags dst_stages, VkAccessFlags dst_access) {
+  // A global barrier is as cheap as a buffer barrier on current drivers, and covers every
+  // buffer that was written.
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+
+  for (const RecordingTarget& target : recording_targets_) {
+    vkCmdPipelineBarrier(target.vk_command_buffer, src_stages, dst_stages, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+  }
+}
+
+GALCommandBuffer::ResolvedCommand GALCommandBuffer::ResolveCommand(
+    const CommandVariant& command_variant) {
+  ResolvedCommand resolved;
+  resolved.scope_id = ResolveProfileScope(command_variant);
+  ResolveUniforms(command_variant, &resolved);
+  ResolveInstanceData(command_variant, &resolved);
+  ResolveResources(command_variant, &resolved);
+
+  if (std::holds_alternative<command::PushConstants>(command_variant)) {
+    ResolvePushConstants(std::get<command::PushConstants>(command_variant), &resolved);
+  }
+  return resolved;
+}
+
+std::optional<uint32_t> GALCommandBuffer::ResolveProfileScope(
+    const CommandVariant& command_variant) {
+  GALProfiler* profiler = gal_platform_->GetProfiler();
+  if (profiler == nullptr) {
+    return std::nullopt;
+  }
+
+  if (std::holds_alternative<command::BeginProfileScope>(command_variant)) {
+    const command::BeginProfileScope& command = 
+        std::get<command::BeginProfileScope>(command_variant);
+
+    std::optional<uint32_t> scope_id = profiler->GetScopeId(command.name);
+    if (!scope_id.has_value()) {
+      std::cerr << "Too many profile scopes. Ignoring scope: " << command.name << std::endl;
+    }
+    open_profile_scopes_.push_back(scope_id);
+
+    return scope_id;
+  } else if (std::holds_alternative<command::EndProfileScope>(command_variant)) {
+    if (open_profile_scopes_.empty()) {
+      return std::nullopt;
+    }
+
+    std::optional<uint32_t> scope_id = open_profile_scopes_.back();
+    open_profile_scopes_.pop_back();
+
+    return scope_id;
+  }
+
+  return std::nullopt;
+}
+
+void GALCommandBuffer::ResolveUniforms(const CommandVariant& command_variant, 
+                                       ResolvedCommand* resolved) {
   if (std::holds_alternative<command::SetPipeline>(command_variant)) {
-    const command::SetPipeline& command = std::get<command::SetPipeline>(command_variant);
+    ResolvePipeline(std::get<command::SetPipeline>(command_variant).pipeline, resolved);
+  } else if (std::holds_alternative<command::SetUniformData>(command_variant)) {
+    ResolveUniformData(std::get<command::SetUniformData>(command_variant), resolved);
+  }
+}
+
+void GALCommandBuffer::ResolvePipeline(GALPipeline* pipeline, ResolvedCommand* resolved) {
+  bound_pipeline_ = pipeline;
+  bound_uniform_offsets_.fill(0);
+
+  // The uniforms are bound along with the pipeline, so that draws never see an unbound set.
+  if (bound_pipeline_->GetVkUniformDescriptorSet() != VK_NULL_HANDLE) {
+    resolved->uniform_pipeline = bound_pipeline_;
+    resolved->uniform_offsets = bound_uniform_offsets_;
+  }
+
+  // Binding another pipeline's uniforms may have replaced the bindless set, and binding it with
+  // another layout may not be compatible with this one.
+  if (!bound_pipeline_->IsBindless()) {
+    bound_bindless_layout_ = VK_NULL_HANDLE;
+  } else if (bound_pipeline_->GetVkPipelineLayout() != bound_bindless_layout_) {
+    bound_bindless_layout_ = bound_pipeline_->GetVkPipelineLayout();
+    resolved->bindless_pipeline = bound_pipeline_;
+  }
 
-    for (size_t i = 0; i < vk_command_buffers_.size(); ++i) {
-      VkClearValue clear_color = {0.f, 0.f, 0.f, 1.f};
+  ResolveResourceLayout(bound_pipeline_->GetResourceSetLayout(), 
+                        bound_pipeline_->GetVkPipelineLayout(), VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        GALPipeline::kResourceSetIndex);
+}
+
+void GALCommandBuffer::ResolveUniformData(const command::SetUniformData& command, 
+                                          ResolvedCommand* resolved) {
+  if (recording_mode_ != RecordingMode::PerFrame) {
+    std::cerr << "Uniform data can only be set in RecordingMode::PerFrame." << std::endl;
+    return;
+  }
 
-      VkRenderPassBeginInfo render_pass_begin_info{};
-      render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      render_pass_begin_info.renderPass = command.pipeline->GetVkRenderPass();
-      render_pass_begin_info.framebuffer = command.pipeline->GetVkFramebuffers()[i];
-      render_pass_begin_info.renderArea.offset = {0, 0};
-      render_pass_begin_info.renderArea.extent = gal_platform_->GetVkSwapchainExtent();
-      render_pass_begin_info.clearValueCount = 1;
-      render_pass_begin_info.pClearValues = &clear_color;
+  if (bound_pipeline_ == nullptr) {
+    std::cerr << "Uniform data was set before a pipeline." << std::endl;
+    return;
+  }
 
-      vkCmdBeginRenderPass(vk_command_buffers_[i], &render_pass_begin_info, 
-                           VK_SUBPASS_CONTENTS_INLINE);
+  const std::vector<uint32_t>& bindings = bound_pipeline_->GetUniformBindings();
+  auto binding_it = std::find(bindings.begin(), bindings.end(), 
+                              static_cast<uint32_t>(command.shader_idx));
+  if (binding_it == bindings.end()) {
+    std::cerr << "Pipeline has no uniform at shader index: " << command.shader_idx << std::endl;
+    return;
+  }
 
-      vkCmdBindPipeline(vk_command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                        command.pipeline->GetVkPipeline());
+  std::optional<GALUniformRing::Allocation> allocation = 
+      gal_platform_->GetUniformRing()->Allocate(command.size);
+  if (!allocation.has_value()) {
+    std::cerr << "Could not allocate uniform data. Ignoring uniform data." << std::endl;
+    return;
+  }
+
+  memcpy(allocation.value().mapped_data, command.data, command.size);
+  bound_uniform_offsets_[binding_it - bindings.begin()] = allocation.value().offset;
+
+  resolved->uniform_pipeline = bound_pipeline_;
+  resolved->uniform_offsets = bound_uniform_offsets_;
+}
+
+void GALCommandBuffer::ResolveInstanceData(const CommandVariant& command_variant,
+                                           ResolvedCommand* resolved) {
+  if (std::holds_alternative<command::SetInstanceData>(command_variant)) {
+    ResolveInstanceData(std::get<command::SetInstanceData>(command_variant), resolved);
+  }
+}
+
+void GALCommandBuffer::ResolveInstanceData(const command::SetInstanceData& command,
+                                           ResolvedCommand* resolved) {
+  if (recording_mode_ != RecordingMode::PerFrame) {
+    std::cerr << "Instance data can only be set in RecordingMode::PerFrame." << std::endl;
+    return;
+  }
+
+  GALUniformRing* uniform_ring = gal_platform_->GetUniformRing();
+
+  std::optional<GALUniformRing::Allocation> allocation = 
+      uniform_ring->AllocateVertexData(command.size);
+  if (!allocation.has_value()) {
+    std::cerr << "Could not allocate instance data. Ignoring instance data." << std::endl;
+    return;
+  }
+
+  memcpy(allocation.value().mapped_data, command.data, command.size);
+
+  resolved->vertex_buffer = uniform_ring->GetVkBuffer();
+  resolved->vertex_buffer_offset = allocation.value().offset;
+}
+
+void GALCommandBuffer::ResolvePushConstants(const command::PushConstants& command,
+                                            ResolvedCommand* resolved) {
+  if (bound_pipeline_ == nullptr) {
+    std::cerr << "Push constants were set before a pipeline." << std::endl;
+    return;
+  }
+
+  if (command.data == nullptr) {
+    std::cerr << "Push constants have no data." << std::endl;
+    return;
+  }
+
+  if (command.size > GALPipeline::kMaxPushConstantsSize ||
+      command.offset > GALPipeline::kMaxPushConstantsSize - command.size) {
+    std::cerr << "Push constants end past kMaxPushConstantsSize." << std::endl;
+    return;
+  }
+
+  bool covered = true;
+  ForEachPushConstantSegment(bound_pipeline_->GetPushConstantRanges(), command.offset, 
+                             command.size, [&covered](VkShaderStageFlags stages, uint32_t, 
+                                                      uint32_t) {
+                               covered = covered && stages != 0;
+                             });
+  if (!covered) {
+    std::cerr << "Push constants are outside the pipeline's push constant ranges." << std::endl;
+    return;
+  }
+
+  resolved->push_constant_pipeline = bound_pipeline_;
+}
+
+void GALCommandBuffer::ResolveResources(const CommandVariant& command_variant, 
+                                        ResolvedCommand* resolved) {
+  // SetPipeline's resource layout is resolved by ResolvePipeline().
+  if (std::holds_alternative<command::SetPipeline>(command_variant)) {
+    return;
+  }
+
+  if (std::holds_alternative<command::SetComputePipeline>(command_variant)) {
+    bound_compute_pipeline_ = std::get<command::SetComputePipeline>(command_variant).pipeline;
+
+    ResolveResourceLayout(bound_compute_pipeline_->GetResourceSetLayout(),
+                          bound_compute_pipeline_->GetVkPipelineLayout(), 
+                          VK_PIPELINE_BIND_POINT_COMPUTE, GALComputePipeline::kResourceSetIndex);
+    return;
+  }
+
+  if (std::holds_alternative<command::BindUniformBuffer>(command_variant)) {
+    const auto& command = std::get<command::BindUniformBuffer>(command_variant);
+    ResolveResourceBinding(command.shader_idx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, command.buffer,
+                           nullptr);
+    return;
+  }
+  if (std::holds_alternative<command::BindStorageBuffer>(command_variant)) {
+    const auto& command = std::get<command::BindStorageBuffer>(command_variant);
+    ResolveResourceBinding(command.shader_idx, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, command.buffer,
+                           nullptr);
+    return;
+  }
+  if (std::holds_alternative<command::BindTexture>(command_variant)) {
+    const auto& command = std::get<command::BindTexture>(command_variant);
+    ResolveResourceBinding(command.shader_idx, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 
+                           nullptr, command.texture);
+    return;
+  }
+
+  bool is_dispatch = std::holds_alternative<command::Dispatch>(command_variant);
+  if (IsDrawCommand(command_variant) || is_dispatch) {
+    ResolveDrawResources(is_dispatch, resolved);
+  }
+}
+
+void GALCommandBuffer::ResolveResourceLayout(
+    const GALPipelineRegistry::DescriptorSetLayout* layout, VkPipelineLayout pipeline_layout,
+    VkPipelineBindPoint bind_point, uint32_t set_index) {
+  bound_resource_pipeline_layout_ = pipeline_layout;
+  bound_resource_bind_point_ = bind_point;
+  bound_resource_set_index_ = set_index;
+
+  // Pipelines with the same resource layout keep the resources that were bound for the last
+  // one.
+  if (layout != bound_resource_layout_) {
+    bound_resource_layout_ = layout;
+    bound_resources_.assign(layout != nullptr ? layout->bindings.size() : 0, 
+                            DescriptorResource{});
+  }
+  resources_dirty_ = layout != nullptr;
+}
+
+void GALCommandBuffer::ResolveResourceBinding(int shader_idx, VkDescriptorType type, 
+                                              GALBuffer* buffer, GALTexture* texture) {
+  if (bound_resource_layout_ == nullptr) {
+    std::cerr << "Resource was bound without a pipeline that has resources." << std::endl;
+    return;
+  }
+
+  const std::vector<VkDescriptorSetLayoutBinding>& bindings = bound_resource_layout_->bindings;
+  auto binding_it = std::find_if(bindings.begin(), bindings.end(), 
+      [shader_idx, type](const VkDescriptorSetLayoutBinding& binding) {
+        return binding.binding == static_cast<uint32_t>(shader_idx) && 
+               binding.descriptorType == type;
+      });
+  if (binding_it == bindings.end()) {
+    std::cerr << "Pipeline has no resource of this type at shader index: " << shader_idx 
+              << std::endl;
+    return;
+  }
+
+  DescriptorResource& resource = bound_resources_[binding_it - bindings.begin()];
+  if (texture == nullptr) {
+    resource.buffer = buffer->GetVkBuffer();
+    resource.buffer_range = VK_WHOLE_SIZE;
+  } else {
+    resource.image_view = texture->GetVkImageView();
+    resource.sampler = texture->GetVkSampler();
+  }
+  resources_dirty_ = true;
+}
+
+void GALCommandBuffer::ResolveDrawResources(bool is_dispatch, ResolvedCommand* resolved) {
+  if (!resources_dirty_) {
+    return;
+  }
+
+  // The set is bound for the kind of pipeline that was bound last, so a draw that follows a
+  // SetComputePipeline without a SetPipeline does not get the compute layout's set, and vice
+  // versa.
+  if ((bound_resource_bind_point_ == VK_PIPELINE_BIND_POINT_COMPUTE) != is_dispatch) {
+    return;
+  }
+
+  // Persistent command buffers are replayed every frame, so their sets must outlive any one
+  // frame.
+  std::optional<uint32_t> frame;
+  if (recording_mode_ == RecordingMode::PerFrame) {
+    frame = recording_frame_;
+  }
+
+  std::optional<VkDescriptorSet> resource_set = 
+      gal_platform_->GetDescriptorCache()->GetOrCreate(*bound_resource_layout_, 
+                                                       bound_resources_, frame);
+  if (!resource_set.has_value()) {
+    return;
+  }
+
+  resolved->resource_set = resource_set.value();
+  resolved->resource_layout = bound_resource_pipeline_layout_;
+  resolved->resource_bind_point = bound_resource_bind_point_;
+  resolved->resource_set_index = bound_resource_set_index_;
+  resources_dirty_ = false;
+}
+
+void GALCommandBuffer::RecordCommand(VkCommandBuffer command_buffer, uint32_t image_idx,
+                                     const CommandVariant& command_variant, 
+                                     const ResolvedCommand& resolved) {
+  if (std::holds_alternative<command::SetViewport>(command_variant)) {
+    RecordViewport(command_buffer, std::get<command::SetViewport>(command_variant));
+
+  } else if (std::holds_alternative<command::SetPipeline>(command_variant)) {
+    const command::SetPipeline& command = std::get<command::SetPipeline>(command_variant);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                      command.pipeline->GetVkPipeline());
+
+    if (resolved.uniform_pipeline != nullptr) {
+      BindUniforms(command_buffer, resolved);
     }
+    if (resolved.bindless_pipeline != nullptr) {
+      BindBindlessSet(command_buffer, resolved);
+    }
+    if (resolved.resource_set != VK_NULL_HANDLE) {
+      BindResources(command_buffer, resolved);
+    }
+
   } else if (std::holds_alternative<command::SetVertexBuffer>(command_variant)) {
     const command::SetVertexBuffer& command = std::get<command::SetVertexBuffer>(command_variant);
 
-    for (VkCommandBuffer command_buffer : vk_command_buffers_) {
-      VkBuffer buffers[] = { command.buffer->GetVkBuffer() };
-      VkDeviceSize offsets[] = {0};
-      vkCmdBindVertexBuffers(command_buffer, command.buffer_idx, 1, buffers, offsets);
+    VkBuffer buffers[] = { command.buffer->GetVkBuffer() };
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(command_buffer, command.buffer_idx, 1, buffers, offsets);
+
+  } else if (std::holds_alternative<command::SetUniformData>(command_variant)) {
+    if (resolved.uniform_pipeline != nullptr) {
+      BindUniforms(command_buffer, resolved);
+    }
+
+  } else if (std::holds_alternative<command::SetInstanceData>(command_variant)) {
+    const command::SetInstanceData& command = std::get<command::SetInstanceData>(command_variant);
+
+    if (resolved.vertex_buffer != VK_NULL_HANDLE) {
+      vkCmdBindVertexBuffers(command_buffer, command.buffer_idx, 1, &resolved.vertex_buffer,
+                             &resolved.vertex_buffer_offset);
+    }
+
+  } else if (std::holds_alternative<command::PushConstants>(command_variant)) {
+    if (resolved.push_constant_pipeline != nullptr) {
+      RecordPushConstants(command_buffer, resolved.push_constant_pipeline, 
+                          std::get<command::PushConstants>(command_variant));
     }
 
   } else if (std::holds_alternative<command::DrawTriangles>(command_variant)) {
     const command::DrawTriangles& command = std::get<command::DrawTriangles>(command_variant);
 
-    for (VkCommandBuffer command_buffer : vk_command_buffers_) {
-      vkCmdDraw(command_buffer, 3, command.num_triangles, 0, 0);
+    if (resolved.resource_set != VK_NULL_HANDLE) {
+      BindResources(command_buffer, resolved);
+    }
+
+    vkCmdDraw(command_buffer, 3 * command.num_triangles, command.instance_count, 0, 
+              command.first_instance);
+
+  } else if (std::holds_alternative<command::SetIndexBuffer>(command_variant)) {
+    const command::SetIndexBuffer& command = std::get<command::SetIndexBuffer>(command_variant);
+
+    vkCmdBindIndexBuffer(command_buffer, command.buffer->GetVkBuffer(), 0, 
+                         GetVkIndexType(command.buffer->GetIndexType()));
+
+  } else if (std::holds_alternative<command::DrawIndexed>(command_variant)) {
+    const command::DrawIndexed& command = std::get<command::DrawIndexed>(command_variant);
+
+    if (resolved.resource_set != VK_NULL_HANDLE) {
+      BindResources(command_buffer, resolved);
+    }
+
+    vkCmdDrawIndexed(command_buffer, command.index_count, command.instance_count, 
+                     command.first_index, command.vertex_offset, command.first_instance);
+
+  } else if (std::holds_alternative<command::SetComputePipeline>(command_variant)) {
+    const command::SetComputePipeline& command = 
+        std::get<command::SetComputePipeline>(command_variant);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, 
+                      command.pipeline->GetVkPipeline());
+
+  } else if (std::holds_alternative<command::Dispatch>(command_variant)) {
+    const command::Dispatch& command = std::get<command::Dispatch>(command_variant);
+
+    if (resolved.resource_set != VK_NULL_HANDLE) {
+      BindResources(command_buffer, resolved);
+    }
+
+    vkCmdDispatch(command_buffer, command.group_count_x, command.group_count_y, 
+                  command.group_count_z);
+
+  } else if (std::holds_alternative<command::CopyBuffer>(command_variant)) {
+    const command::CopyBuffer& command = std::get<command::CopyBuffer>(command_variant);
+
+    VkBufferCopy region{};
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = command.size;
+    vkCmdCopyBuffer(command_buffer, command.src->GetVkBuffer(), command.dst->GetVkBuffer(), 1,
+                    &region);
+
+  } else if (std::holds_alternative<command::FillBuffer>(command_variant)) {
+    const command::FillBuffer& command = std::get<command::FillBuffer>(command_variant);
+
+    vkCmdFillBuffer(command_buffer, command.buffer->GetVkBuffer(), 0, command.size, 
+                    command.value);
+
+  } else if (std::holds_alternative<command::DrawIndexedIndirect>(command_variant)) {
+    const command::DrawIndexedIndirect& command = 
+        std::get<command::DrawIndexedIndirect>(command_variant);
+
+    if (resolved.resource_set != VK_NULL_HANDLE) {
+      BindResources(command_buffer, resolved);
+    }
+
+    RecordDrawIndexedIndirect(command_buffer, command.buffer->GetVkBuffer(), command.offset, 
+                              command.draw_count, command.stride);
+
+  } else if (std::holds_alternative<command::DrawIndexedIndirectCount>(command_variant)) {
+    const command::DrawIndexedIndirectCount& command = 
+        std::get<command::DrawIndexedIndirectCount>(command_variant);
+
+    if (resolved.resource_set != VK_NULL_HANDLE) {
+      BindResources(command_buffer, resolved);
+    }
+
+    RecordDrawIndexedIndirectCount(command_buffer, command);
+
+  } else if (std::holds_alternative<command::BeginProfileScope>(command_variant)) {
+    if (resolved.scope_id.has_value()) {
+      gal_platform_->GetProfiler()->RecordScopeBegin(command_buffer, image_idx, 
+                                                     resolved.scope_id.value());
+    }
+
+  } else if (std::holds_alternative<command::EndProfileScope>(command_variant)) {
+    if (resolved.scope_id.has_value()) {
+      gal_platform_->GetProfiler()->RecordScopeEnd(command_buffer, image_idx, 
+                                                   resolved.scope_id.value());
+    }
+  }
+}
+
+void GALCommandBuffer::RecordDrawIndexedIndirect(VkCommandBuffer command_buffer, 
+                                                 VkBuffer buffer, VkDeviceSize offset,
+                                                 uint32_t draw_count, uint32_t stride) {
+  if (gal_platform_->IsMultiDrawIndirectEnabled()) {
+    vkCmdDrawIndexedIndirect(command_buffer, buffer, offset, draw_count, stride);
+    return;
+  }
+
+  for (uint32_t i = 0; i < draw_count; ++i) {
+    vkCmdDrawIndexedIndirect(command_buffer, buffer, offset + static_cast<VkDeviceSize>(i) * stride,
+                             1, stride);
+  }
+}
+
+void GALCommandBuffer::RecordDrawIndexedIndirectCount(
+    VkCommandBuffer command_buffer, const command::DrawIndexedIndirectCount& command) {
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = 
+      gal_platform_->GetDrawIndexedIndirectCountFunction();
+  if (draw_indexed_indirect_count != nullptr) {
+    draw_indexed_indirect_count(command_buffer, command.buffer->GetVkBuffer(), command.offset,
+                                command.count_buffer->GetVkBuffer(), command.count_offset,
+                                command.max_draw_count, command.stride);
+  } else {
+    RecordDrawIndexedIndirect(command_buffer, command.buffer->GetVkBuffer(), command.offset,
+                              command.max_draw_count, command.stride);
+  }
+}
+
+void GALCommandBuffer::RecordPushConstants(VkCommandBuffer command_buffer, GALPipeline* pipeline,
+                                           const command::PushConstants& command) {
+  VkPipelineLayout layout = pipeline->GetVkPipelineLayout();
+  ForEachPushConstantSegment(pipeline->GetPushConstantRanges(), command.offset, command.size,
+      [&](VkShaderStageFlags stages, uint32_t offset, uint32_t size) {
+        vkCmdPushConstants(command_buffer, layout, stages, offset, size, 
+                           static_cast<const uint8_t*>(command.data) + (offset - command.offset));
+      });
+}
+
+void GALCommandBuffer::BindUniforms(VkCommandBuffer command_buffer, 
+                                    const ResolvedCommand& resolved) {
+  GALPipeline* pipeline = resolved.uniform_pipeline;
+  VkDescriptorSet descriptor_set = pipeline->GetVkUniformDescriptorSet();
+
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                          pipeline->GetVkPipelineLayout(), GALPipeline::kUniformSetIndex, 1,
+                          &descriptor_set, 
+                          static_cast<uint32_t>(pipeline->GetUniformBindings().size()),
+                          resolved.uniform_offsets.data());
+}
+
+void GALCommandBuffer::BindResources(VkCommandBuffer command_buffer, 
+                                     const ResolvedCommand& resolved) {
+  vkCmdBindDescriptorSets(command_buffer, resolved.resource_bind_point, resolved.resource_layout,
+                          resolved.resource_set_index, 1, &resolved.resource_set, 0, nullptr);
+}
+
+void GALCommandBuffer::BindBindlessSet(VkCommandBuffer command_buffer, 
+                                       const ResolvedCommand& resolved) {
+  GALPipeline* pipeline = resolved.bindless_pipeline;
+  VkDescriptorSet descriptor_set = pipeline->GetVkBindlessDescriptorSet();
+
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                          pipeline->GetVkPipelineLayout(), GALPipeline::kUniformSetIndex, 1,
+                          &descriptor_set, 0, nullptr);
+}
+
+void GALCommandBuffer::RecordPipelineBind(GALPipeline* pipeline, BoundState* bound) {
+  VkPipeline vk_pipeline = pipeline->GetVkPipeline();
+  if (vk_pipeline == bound->pipeline) {
+    return;
+  }
+  bound->pipeline = vk_pipeline;
+
+  for (const RecordingTarget& target : recording_targets_) {
+    vkCmdBindPipeline(target.vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
+  }
+}
+
+void GALCommandBuffer::RecordUniformBind(const ResolvedCommand& resolved, BoundState* bound) {
+  GALPipeline* pipeline = resolved.uniform_pipeline;
+  VkPipelineLayout layout = pipeline->GetVkPipelineLayout();
+  VkDescriptorSet descriptor_set = pipeline->GetVkUniformDescriptorSet();
+
+  if (layout == bound->uniform_layout && descriptor_set == bound->uniform_set && 
+      resolved.uniform_offsets == bound->uniform_offsets) {
+    return;
+  }
+  bound->uniform_layout = layout;
+  bound->uniform_set = descriptor_set;
+  bound->uniform_offsets = resolved.uniform_offsets;
+
+  for (const RecordingTarget& target : recording_targets_) {
+    BindUniforms(target.vk_command_buffer, resolved);
+  }
+}
+
+void GALCommandBuffer::RecordResourceBind(const ResolvedCommand& resolved, BoundState* bound) {
+  if (resolved.resource_layout == bound->resource_layout && 
+      resolved.resource_set == bound->resource_set) {
+    return;
+  }
+  bound->resource_layout = resolved.resource_layout;
+  bound->resource_set = resolved.resource_set;
+
+  for (const RecordingTarget& target : recording_targets_) {
+    BindResources(target.vk_command_buffer, resolved);
+  }
+}
+
+void GALCommandBuffer::RecordBindlessBind(const ResolvedCommand& resolved, BoundState* bound) {
+  // ResolvePipeline() only asks for the bind when it is needed. The bindless set replaces
+  // whatever uniforms were bound in its place.
+  bound->uniform_layout = VK_NULL_HANDLE;
+  bound->uniform_set = VK_NULL_HANDLE;
+
+  for (const RecordingTarget& target : recording_targets_) {
+    BindBindlessSet(target.vk_command_buffer, resolved);
+  }
+}
+
+void GALCommandBuffer::RecordVertexBufferBind(int buffer_idx, VkBuffer buffer, 
+                                              VkDeviceSize offset, BoundState* bound) {
+  bool tracked = buffer_idx >= 0 && buffer_idx < kMaxVertexBufferBindings;
+  if (tracked) {
+    if (bound->vertex_buffers[buffer_idx] == buffer && 
+        bound->vertex_buffer_offsets[buffer_idx] == offset) {
+      return;
     }
+    bound->vertex_buffers[buffer_idx] = buffer;
+    bound->vertex_buffer_offsets[buffer_idx] = offset;
+  }
+
+  for (const RecordingTarget& target : recording_targets_) {
+    vkCmdBindVertexBuffers(target.vk_command_buffer, buffer_idx, 1, &buffer, &offset);
+  }
+}
+
+void GALCommandBuffer::RecordIndexBufferBind(GALBuffer* buffer, BoundState* bound) {
+  VkBuffer vk_buffer = buffer->GetVkBuffer();
+  VkIndexType index_type = GetVkIndexType(buffer->GetIndexType());
+  if (vk_buffer == bound->index_buffer && index_type == bound->index_type) {
+    return;
+  }
+  bound->index_buffer = vk_buffer;
+  bound->index_type = index_type;
+
+  for (const RecordingTarget& target : recording_targets_) {
+    vkCmdBindIndexBuffer(target.vk_command_buffer, vk_buffer, 0, index_type);
   }
 }
 
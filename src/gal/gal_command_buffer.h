@@ -3,18 +3,36 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
+#include <cstdint>
+#include <optional>
 #include <vector>
+#include "gal/gal_command_encoder.h"
 #include "gal/gal_commands.h"
+#include "gal/gal_descriptor_cache.h"
+#include "gal/gal_pipeline_registry.h"
 #include "gal/gal_platform.h"
+#include "gal/gal_uniform_ring.h"
 
 namespace gal {
 
+enum class RecordingMode {
+  // Recorded once, with one VkCommandBuffer per swapchain image, and replayed every frame.
+  Persistent,
+
+  // Recorded every frame, after GALPlatform::StartTick() and before ExecuteCommandBuffer(),
+  // into one VkCommandBuffer from the pool of the current frame in flight. Recording does not
+  // allocate once the buffers for a frame have been created.
+  PerFrame
+};
+
 class GALCommandBuffer {
   // Forward declaration
 class Builder;
 
 public:
-  GALCommandBuffer(GALPlatform* gal_platform);
+  GALCommandBuffer(GALPlatform* gal_platform,
+                   RecordingMode recording_mode = RecordingMode::Persistent);
   ~GALCommandBuffer();
 
   bool BeginRecording();
@@ -22,13 +40,253 @@ public:
 
   void SubmitCommand(const CommandVariant& command_variant);
 
-  const std::vector<VkCommandBuffer>& GetVkCommandBuffers() { return vk_command_buffers_; }
+  // Records the commands into secondary command buffers on the platform's worker threads, one
+  // per slice of the list, and executes them from this buffer in submission order. The list
+  // must contain a SetPipeline, whose render pass is begun here, and only EndRecording() may
+  // follow. Commands before the first SetPipeline, such as compute commands, are recorded
+  // inline.
+  //
+  // Falls back to SubmitCommand() for each command if worker threads are not enabled, the list
+  // is too short to be worth splitting, or a render pass is already open.
+  bool SubmitCommandsParallel(const std::vector<CommandVariant>& commands);
+
+  // Translates the encoder's packets in one pass, with the same rules as SubmitCommand(), and
+  // skips pipeline, uniform, resource, vertex buffer and index buffer binds that would not change
+  // what is bound. The encoder is not modified, so it can be submitted again.
+  //
+  // In Persistent mode, the render pass is recorded once, into a secondary command buffer that
+  // every swapchain image's buffer executes, rather than once per swapchain image. Not done when
+  // the profiler is enabled, since its queries are per swapchain image.
+  void SubmitEncoder(const GALCommandEncoder& encoder);
+
+  RecordingMode GetRecordingMode() const { return recording_mode_; }
+
+  // True if the swapchain has been recreated since the buffer was recorded, in which case it must
+  // be recorded again before it is executed. PerFrame buffers are recorded after
+  // GALPlatform::StartTick(), which is where the swapchain is recreated, so this only happens to
+  // Persistent ones. Recording them again waits for the device to be idle.
+  bool IsOutOfDate() const {
+    return swapchain_generation_ != gal_platform_->GetSwapchainGeneration();
+  }
+
+  // The VkCommandBuffer to submit for the given frame in flight and swapchain image.
+  VkCommandBuffer GetVkCommandBuffer(uint32_t frame, uint32_t image_idx) const {
+    return recording_mode_ == RecordingMode::PerFrame ? vk_command_buffers_[frame]
+                                                      : vk_command_buffers_[image_idx];
+  }
+
+private:
+  using UniformOffsets = std::array<uint32_t, GALUniformRing::kMaxBindingsPerSet>;
+
+  // What a command needs from state that is only safe to touch on the recording thread, worked
+  // out before the command is recorded.
+  struct ResolvedCommand {
+    std::optional<uint32_t> scope_id;
+
+    // Set if the command binds this pipeline's uniforms, at uniform_offsets.
+    GALPipeline* uniform_pipeline = nullptr;
+    UniformOffsets uniform_offsets{};
+
+    // Set if the command binds the bindless table's set with this pipeline's layout.
+    GALPipeline* bindless_pipeline = nullptr;
+
+    // Set if the command binds resource_set at resource_set_index of resource_layout.
+    VkDescriptorSet resource_set = VK_NULL_HANDLE;
+    VkPipelineLayout resource_layout = VK_NULL_HANDLE;
+    VkPipelineBindPoint resource_bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    uint32_t resource_set_index = 0;
+
+    // Set if the command writes push constants with this pipeline's layout.
+    GALPipeline* push_constant_pipeline = nullptr;
+
+    // Set if the command binds this range of the uniform ring as a vertex buffer.
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    VkDeviceSize vertex_buffer_offset = 0;
+  };
+
+  struct BoundState;
+
+  struct RecordingTarget {
+    VkCommandBuffer vk_command_buffer;
+
+    // Selects the framebuffer and the profiler's query set.
+    uint32_t image_idx;
+  };
+
+  // Called from worker threads. Only touches state owned by worker_idx.
+  VkCommandBuffer AcquireSecondaryCommandBuffer(uint32_t worker_idx);
+
+  void AllocatePersistentCommandBuffers();
+  void FreePersistentCommandBuffers();
+
+  void BeginRenderPass(VkSubpassContents contents);
+
+  // Begins the render pass for vk_shared_command_buffer_, and records into it instead of the
+  // swapchain images' buffers until EndSharedRenderPass(), which EndRecording() calls.
+  void BeginSharedRenderPass();
+  bool EndSharedRenderPass();
+
+  // Records a barrier that makes the compute and transfer writes since the last barrier
+  // available to dst_stages, if there are any.
+  void RecordWriteBarrier(VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+  void RecordBarrier(VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+                     VkPipelineStageFlags dst_stages, VkAccessFlags dst_access);
+
+  ResolvedCommand ResolveCommand(const CommandVariant& command_variant);
+
+  // Updates open_profile_scopes_ for BeginProfileScope and EndProfileScope, and returns the id
+  // of the scope to record. std::nullopt for other commands.
+  std::optional<uint32_t> ResolveProfileScope(const CommandVariant& command_variant);
+
+  // Copies SetUniformData's data into the uniform ring, and tracks the uniform offsets of the
+  // bound pipeline.
+  void ResolveUniforms(const CommandVariant& command_variant, ResolvedCommand* resolved);
+  void ResolvePipeline(GALPipeline* pipeline, ResolvedCommand* resolved);
+  void ResolveUniformData(const command::SetUniformData& command, ResolvedCommand* resolved);
+
+  // Copies SetInstanceData's data into the uniform ring.
+  void ResolveInstanceData(const CommandVariant& command_variant, ResolvedCommand* resolved);
+  void ResolveInstanceData(const command::SetInstanceData& command, ResolvedCommand* resolved);
+
+  // Checks that the push constants fit the bound pipeline's ranges.
+  void ResolvePushConstants(const command::PushConstants& command, ResolvedCommand* resolved);
+
+  // Tracks the resources bound with BindUniformBuffer, BindStorageBuffer and BindTexture, and
+  // looks up the set that holds them before the next draw or dispatch.
+  void ResolveResources(const CommandVariant& command_variant, ResolvedCommand* resolved);
+  void ResolveResourceLayout(const GALPipelineRegistry::DescriptorSetLayout* layout,
+                             VkPipelineLayout pipeline_layout, VkPipelineBindPoint bind_point,
+                             uint32_t set_index);
+  void ResolveResourceBinding(int shader_idx, VkDescriptorType type, GALBuffer* buffer,
+                              GALTexture* texture);
+  void ResolveDrawResources(bool is_dispatch, ResolvedCommand* resolved);
+
+  // Records a command. Compute commands and copies must be recorded before the render pass.
+  // Safe to call from worker threads.
+  void RecordCommand(VkCommandBuffer command_buffer, uint32_t image_idx, 
+                     const CommandVariant& command_variant, const ResolvedCommand& resolved);
+
+  // Draws the records one at a time if the device cannot draw more than one per call.
+  void RecordDrawIndexedIndirect(VkCommandBuffer command_buffer, VkBuffer buffer, 
+                                 VkDeviceSize offset, uint32_t draw_count, uint32_t stride);
+  void RecordDrawIndexedIndirectCount(VkCommandBuffer command_buffer, 
+                                      const command::DrawIndexedIndirectCount& command);
+
+  void RecordPushConstants(VkCommandBuffer command_buffer, GALPipeline* pipeline,
+                           const command::PushConstants& command);
+
+  void BindUniforms(VkCommandBuffer command_buffer, const ResolvedCommand& resolved);
+  void BindResources(VkCommandBuffer command_buffer, const ResolvedCommand& resolved);
+  void BindBindlessSet(VkCommandBuffer command_buffer, const ResolvedCommand& resolved);
+
+  // Record into every recording target, unless the bind matches what bound says is bound.
+  void RecordPipelineBind(GALPipeline* pipeline, BoundState* bound);
+  void RecordUniformBind(const ResolvedCommand& resolved, BoundState* bound);
+  void RecordResourceBind(const ResolvedCommand& resolved, BoundState* bound);
+  void RecordBindlessBind(const ResolvedCommand& resolved, BoundState* bound);
+  void RecordVertexBufferBind(int buffer_idx, VkBuffer buffer, VkDeviceSize offset, 
+                              BoundState* bound);
+  void RecordIndexBufferBind(GALBuffer* buffer, BoundState* bound);
+
+  // Records the draw packet into every recording target.
+  void RecordEncodedDraw(uint16_t packet_type, const uint8_t* packet);
 
 private:
   GALPlatform* gal_platform_;
 
   VkDevice vk_device_;
+  RecordingMode recording_mode_;
+
+  // Set once the buffer has been recorded, for the swapchain generation it was recorded for.
+  bool recorded_ = false;
+  uint32_t swapchain_generation_ = 0;
+
+  // Indexed by swapchain image in Persistent mode, and by frame in flight in PerFrame mode.
   std::vector<VkCommandBuffer> vk_command_buffers_;
+
+  // The buffers that commands are currently recorded into. Every swapchain image's buffer in
+  // Persistent mode, and only the current frame's buffer in PerFrame mode.
+  std::vector<RecordingTarget> recording_targets_;
+
+  // Persistent mode: records the render pass once for SubmitEncoder(). While it is open,
+  // recording_targets_ holds only it, and shared_recording_targets_ holds the swapchain images'
+  // buffers.
+  VkCommandBuffer vk_shared_command_buffer_ = VK_NULL_HANDLE;
+  std::vector<RecordingTarget> shared_recording_targets_;
+  bool shared_render_pass_open_ = false;
+
+  // Profile scopes that have begun but not ended. std::nullopt for scopes that could not be
+  // assigned an id, so that the matching EndProfileScope is still consumed.
+  std::vector<std::optional<uint32_t>> open_profile_scopes_;
+
+  // The pipeline and uniform offsets as of the last resolved command.
+  GALPipeline* bound_pipeline_ = nullptr;
+  UniformOffsets bound_uniform_offsets_{};
+
+  GALComputePipeline* bound_compute_pipeline_ = nullptr;
+
+  // The layout that the bindless table's set was last bound with, or null if a pipeline that is
+  // not bindless has been bound since. Bindless pipelines with the same layout share the binding,
+  // so a frame whose pipelines all have the same push constant ranges binds it once.
+  VkPipelineLayout bound_bindless_layout_ = VK_NULL_HANDLE;
+
+  // One entry per binding of the bound pipeline's resource set layout. The set is looked up
+  // again at the next draw or dispatch once they are dirty, and bound where the last bound
+  // pipeline of either kind expects it.
+  const GALPipelineRegistry::DescriptorSetLayout* bound_resource_layout_ = nullptr;
+  VkPipelineLayout bound_resource_pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipelineBindPoint bound_resource_bind_point_ = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  uint32_t bound_resource_set_index_ = 0;
+  std::vector<DescriptorResource> bound_resources_;
+  bool resources_dirty_ = false;
+
+  // The viewport as of the last submitted command. Covers the whole swapchain image until a
+  // SetViewport is submitted.
+  command::SetViewport viewport_{};
+
+  bool render_pass_open_ = false;
+
+  // Stages and accesses of the dispatches and copies that no barrier has covered yet.
+  VkPipelineStageFlags pending_write_stages_ = 0;
+  VkAccessFlags pending_write_access_ = 0;
+
+  // Set once a dispatch or copy has been recorded. The first one also waits for the work that
+  // was submitted before this buffer, which may still be reading what it overwrites.
+  bool compute_recorded_ = false;
+
+  // Set once the render pass has been begun for secondary command buffers, after which no
+  // commands can be recorded inline.
+  bool render_pass_has_secondaries_ = false;
+
+  // Persistent mode: indexed by the worker whose persistent pool they were allocated from.
+  // PerFrame mode: indexed by frame in flight, then by worker. Reused every time the frame comes
+  // around, since resetting the pool resets them without freeing them.
+  std::vector<std::vector<VkCommandBuffer>> vk_secondary_command_buffers_;
+  std::vector<std::vector<std::vector<VkCommandBuffer>>> vk_frame_secondary_command_buffers_;
+
+  // Number of the current frame's secondary command buffers in use, per worker.
+  std::vector<uint32_t> secondary_command_buffers_used_;
+
+  uint32_t recording_frame_ = 0;
+
+  // Scratch space for SubmitCommandsParallel(), kept so that it does not allocate every frame.
+  struct PrologueCommand {
+    CommandVariant command;
+    ResolvedCommand resolved;
+  };
+
+  struct Slice {
+    size_t begin;
+    size_t end;
+
+    // The SetPipeline's resolved command also rebinds the uniforms and resources.
+    std::vector<PrologueCommand> prologue;
+  };
+
+  std::vector<ResolvedCommand> resolved_commands_;
+  std::vector<Slice> slices_;
+  std::vector<VkCommandBuffer> slice_command_buffers_;
+  std::vector<VkCommandBuffer> target_command_buffers_;
 };
 
 } // namespace gal
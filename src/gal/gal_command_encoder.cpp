@@ -0,0 +1,43 @@
+#include "gal/gal_command_encoder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <variant>
+#include "gal/gal_commands.h"
+
+namespace gal {
+
+namespace {
+
+// Enough for a few thousand commands before the first Grow().
+const size_t kInitialArenaSize = 64 * 1024;
+
+template <size_t... Indices>
+CommandVariant DecodePacket(uint16_t type, const uint8_t* packet, 
+                            std::index_sequence<Indices...>) {
+  CommandVariant command_variant;
+  ((type == Indices 
+        ? (command_variant = GALCommandEncoder::ReadCommand<
+               std::variant_alternative_t<Indices, CommandVariant>>(packet), true) 
+        : false) || ...);
+  return command_variant;
+}
+
+} // namespace
+
+void GALCommandEncoder::Encode(const CommandVariant& command_variant) {
+  std::visit([this](const auto& command) { Encode(command); }, command_variant);
+}
+
+CommandVariant GALCommandEncoder::Decode(const uint8_t* packet) {
+  return DecodePacket(ReadHeader(packet).type, packet, 
+                      std::make_index_sequence<std::variant_size_v<CommandVariant>>());
+}
+
+void GALCommandEncoder::Grow(size_t min_size) {
+  arena_.resize(std::max({min_size, arena_.size() * 2, kInitialArenaSize}));
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef GAL_GAL_COMMAND_ENCODER_H_
+#define GAL_GAL_COMMAND_ENCODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include "gal/gal_commands.h"
+
+namespace gal {
+
+// Encodes commands as packets in a linear arena, for GALCommandBuffer::SubmitEncoder() to
+// translate in one pass.
+//
+// A packet is a PacketHeader followed by the command struct itself, which is plain data. Its
+// type is the command's index in CommandVariant. Reset() keeps the arena, so an encoder that is
+// reused every frame stops allocating once it has grown to the frame's size.
+//
+// An encoder that is not reset can be submitted again, e.g. for static content that is encoded
+// once. SetUniformData and SetInstanceData packets are copied into the uniform ring every time
+// they are submitted, and PushConstants packets are recorded from their data, so their data must
+// stay valid for as long as the stream is.
+//
+// Not thread-safe.
+class GALCommandEncoder {
+  // Declared ahead of kPacketType, which needs it.
+  template <typename Command, typename... Commands>
+  static constexpr size_t GetVariantIndex(std::variant<Commands...>*) {
+    constexpr bool matches[] = { std::is_same_v<Command, Commands>... };
+    for (size_t i = 0; i < sizeof...(Commands); ++i) {
+      if (matches[i]) {
+        return i;
+      }
+    }
+    return sizeof...(Commands);
+  }
+
+public:
+  struct PacketHeader {
+    uint16_t type;
+
+    // Including the header and the padding after the command.
+    uint16_t size;
+  };
+
+  // Packets, and the commands in them, start at multiples of this.
+  static constexpr size_t kPacketAlignment = 8;
+  static constexpr size_t kPayloadOffset = kPacketAlignment;
+
+  template <typename Command>
+  static constexpr uint16_t kPacketType = 
+      static_cast<uint16_t>(GetVariantIndex<Command>(static_cast<CommandVariant*>(nullptr)));
+
+  template <typename Command>
+  void Encode(const Command& command) {
+    static_assert(std::is_trivially_copyable_v<Command>, "Commands must be plain data.");
+
+    constexpr size_t packet_size = 
+        (kPayloadOffset + sizeof(Command) + kPacketAlignment - 1) & ~(kPacketAlignment - 1);
+
+    if (size_ + packet_size > arena_.size()) {
+      Grow(size_ + packet_size);
+    }
+
+    PacketHeader header;
+    header.type = kPacketType<Command>;
+    header.size = static_cast<uint16_t>(packet_size);
+
+    uint8_t* packet = arena_.data() + size_;
+    memcpy(packet, &header, sizeof(header));
+    memcpy(packet + kPayloadOffset, &command, sizeof(Command));
+
+    size_ += packet_size;
+    ++packet_count_;
+  }
+
+  void Encode(const CommandVariant& command_variant);
+
+  // Discards every packet, without freeing the arena.
+  void Reset() {
+    size_ = 0;
+    packet_count_ = 0;
+  }
+
+  const uint8_t* GetData() const { return arena_.data(); }
+  size_t GetSize() const { return size_; }
+  uint32_t GetPacketCount() const { return packet_count_; }
+  bool IsEmpty() const { return size_ == 0; }
+
+  static PacketHeader ReadHeader(const uint8_t* packet) {
+    PacketHeader header;
+    memcpy(&header, packet, sizeof(header));
+    return header;
+  }
+
+  template <typename Command>
+  static Command ReadCommand(const uint8_t* packet) {
+    Command command;
+    memcpy(&command, packet + kPayloadOffset, sizeof(Command));
+    return command;
+  }
+
+  // Rebuilds the variant of any packet, for commands that are not worth translating directly.
+  static CommandVariant Decode(const uint8_t* packet);
+
+private:
+  void Grow(size_t min_size);
+
+private:
+  std::vector<uint8_t> arena_;
+  size_t size_ = 0;
+  uint32_t packet_count_ = 0;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_COMMAND_ENCODER_H_
\ No newline at end of file
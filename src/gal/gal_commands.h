@@ -4,12 +4,17 @@
 #include <cstdint>
 #include <variant>
 #include "gal/gal_buffer.h"
+#include "gal/gal_compute_pipeline.h"
 #include "gal/gal_pipeline.h"
+#include "gal/gal_texture.h"
 
 namespace gal {
 
 namespace command {
 
+// Sets the viewport, and a scissor rectangle of the same size, for the draws that follow. Both
+// cover the whole swapchain image until this is submitted, and again at the start of every
+// recording.
 struct SetViewport {
   uint16_t x;
   uint16_t y;
@@ -26,10 +31,145 @@ struct SetVertexBuffer {
   int buffer_idx;
 };
 
+// buffer must be a BufferType::Index buffer. Its index type is used.
+struct SetIndexBuffer {
+  GALBuffer* buffer;
+};
+
+// Copies size bytes from data into the current frame's uniform ring, and binds the copy to the
+// uniform at shader_idx of the current pipeline for the draws that follow. data only needs to
+// stay valid until the command has been submitted. Requires RecordingMode::PerFrame, since the
+// copy is only kept for one frame.
+struct SetUniformData {
+  int shader_idx;
+  const void* data;
+  uint32_t size;
+};
+
+// Copies size bytes from data into the current frame's uniform ring, and binds the copy as the
+// vertex buffer at buffer_idx, typically for a GALPipeline::InputRate::PerInstance input. data
+// only needs to stay valid until the command has been submitted. Requires RecordingMode::PerFrame.
+struct SetInstanceData {
+  int buffer_idx;
+  const void* data;
+  uint32_t size;
+};
+
+// Writes size bytes of data to the push constants of the current pipeline at offset, for the
+// draws that follow. Cheaper than SetUniformData for small per-draw data, e.g. a model matrix
+// or a material index, since nothing is copied or bound. Every byte must be in a range declared
+// with GALPipeline::Builder::AddPushConstantDesc(). Push constants must be written again after
+// every SetPipeline. data only needs to stay valid until the command has been submitted, and is
+// kept out of line so that this command is no larger than the others.
+struct PushConstants {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  const void* data = nullptr;
+};
+
+// Binds a BufferType::Uniform buffer to the uniform buffer at shader_idx of the current
+// pipeline's resource set, for the draws that follow.
+struct BindUniformBuffer {
+  GALBuffer* buffer;
+  int shader_idx;
+};
+
+// Binds a BufferType::Storage buffer to the storage buffer at shader_idx of the current
+// pipeline's resource set, for the draws or dispatches that follow.
+struct BindStorageBuffer {
+  GALBuffer* buffer;
+  int shader_idx;
+};
+
+// Binds a texture to the sampler at shader_idx of the current pipeline's resource set, for the
+// draws that follow.
+struct BindTexture {
+  GALTexture* texture;
+  int shader_idx;
+};
+
+// Draws num_triangles triangles, instance_count times. Per-instance inputs start at element
+// first_instance of their buffers.
 struct DrawTriangles {
   uint32_t num_triangles;
+  uint32_t instance_count = 1;
+  uint32_t first_instance = 0;
+};
+
+// Draws index_count indices from the bound index buffer, starting at first_index. vertex_offset
+// is added to each index before it is used to fetch vertices. instance_count instances are drawn,
+// and per-instance inputs start at element first_instance of their buffers.
+struct DrawIndexed {
+  uint32_t index_count;
+  uint32_t first_index = 0;
+  int32_t vertex_offset = 0;
+  uint32_t instance_count = 1;
+  uint32_t first_instance = 0;
+};
+
+// Compute commands, copies and fills must be submitted before the first SetPipeline, since that
+// begins the render pass that the rest of the command buffer records into. Barriers between
+// them, and between them and the draws that follow, are inserted automatically.
+struct SetComputePipeline {
+  GALComputePipeline* pipeline;
+};
+
+// Runs the current compute pipeline over group_count_x * group_count_y * group_count_z
+// workgroups.
+struct Dispatch {
+  uint32_t group_count_x;
+  uint32_t group_count_y = 1;
+  uint32_t group_count_z = 1;
+};
+
+// Copies size bytes from the start of src to the start of dst, typically from a
+// BufferType::Storage buffer into a BufferType::Readback buffer.
+struct CopyBuffer {
+  GALBuffer* src;
+  GALBuffer* dst;
+  VkDeviceSize size;
+};
+
+// Fills size bytes from the start of buffer with value, e.g. to reset a draw count before the
+// dispatch that writes it. size must be a multiple of 4, or VK_WHOLE_SIZE.
+struct FillBuffer {
+  GALBuffer* buffer;
+  uint32_t value = 0;
+  VkDeviceSize size = VK_WHOLE_SIZE;
 };
 
+// Draws draw_count VkDrawIndexedIndirectCommand records, stride bytes apart, starting at offset
+// into buffer, with the bound index buffer. buffer must be a BufferType::Storage buffer, and
+// is typically written by a dispatch earlier in the command buffer. Records with a non-zero
+// firstInstance require GALPlatform::IsDrawIndirectFirstInstanceEnabled().
+struct DrawIndexedIndirect {
+  GALBuffer* buffer;
+  VkDeviceSize offset = 0;
+  uint32_t draw_count;
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+};
+
+// Like DrawIndexedIndirect, but draws the number of records in the uint32_t at count_offset
+// into count_buffer, up to max_draw_count. Without VK_KHR_draw_indirect_count, all
+// max_draw_count records are drawn, so records past the count should have an instanceCount of
+// 0.
+struct DrawIndexedIndirectCount {
+  GALBuffer* buffer;
+  VkDeviceSize offset = 0;
+  GALBuffer* count_buffer;
+  VkDeviceSize count_offset = 0;
+  uint32_t max_draw_count;
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+};
+
+// Times the commands between this and the matching EndProfileScope on the GPU. Only recorded if
+// the platform's profiler is enabled. Results are reported as "gpu/<name>".
+struct BeginProfileScope {
+  const char* name;
+};
+
+struct EndProfileScope {};
+
 } // namespace command
 
 using CommandVariant = 
@@ -37,7 +177,23 @@ using CommandVariant =
         command::SetViewport,
         command::SetPipeline,
         command::SetVertexBuffer,
-        command::DrawTriangles>;
+        command::SetIndexBuffer,
+        command::SetUniformData,
+        command::SetInstanceData,
+        command::PushConstants,
+        command::BindUniformBuffer,
+        command::BindStorageBuffer,
+        command::BindTexture,
+        command::DrawTriangles,
+        command::DrawIndexed,
+        command::SetComputePipeline,
+        command::Dispatch,
+        command::CopyBuffer,
+        command::FillBuffer,
+        command::DrawIndexedIndirect,
+        command::DrawIndexedIndirectCount,
+        command::BeginProfileScope,
+        command::EndProfileScope>;
 
 } // namespace gal
 
@@ -0,0 +1,173 @@
+#include "gal/gal_compute_pipeline.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "gal/gal_exception.h"
+#include "gal/gal_pipeline_cache.h"
+#include "gal/gal_pipeline_registry.h"
+
+namespace gal {
+
+GALComputePipeline::GALComputePipeline(GALComputePipeline::Builder& builder) {
+  vk_device_ = builder.gal_platform_->GetVkDevice();
+
+  if (builder.shader_.GetShaderModule() == VK_NULL_HANDLE) {
+    throw Exception("Compute pipeline has no shader.");
+  }
+
+  VkPipelineShaderStageCreateInfo shader_stage{};
+  shader_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shader_stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  shader_stage.module = builder.shader_.GetShaderModule();
+  shader_stage.pName = "main";
+
+  std::vector<VkDescriptorSetLayoutBinding> resource_bindings;
+  for (const BufferDesc& buffer_desc : builder.storage_buffer_descs_) {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = buffer_desc.shader_idx;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    resource_bindings.push_back(binding);
+  }
+  for (const BufferDesc& buffer_desc : builder.uniform_buffer_descs_) {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = buffer_desc.shader_idx;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    resource_bindings.push_back(binding);
+  }
+
+  std::sort(resource_bindings.begin(), resource_bindings.end(), 
+      [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding < b.binding;
+      });
+
+  GALPipelineRegistry* registry = builder.gal_platform_->GetPipelineRegistry();
+
+  std::vector<std::shared_ptr<const GALPipelineRegistry::DescriptorSetLayout>> set_layouts;
+
+  if (!resource_bindings.empty()) {
+    GALStateKey set_layout_key;
+    for (const VkDescriptorSetLayoutBinding& binding : resource_bindings) {
+      set_layout_key.Add(binding.binding).Add(binding.descriptorType)
+          .Add(binding.descriptorCount).Add(binding.stageFlags);
+    }
+
+    set_layouts.push_back(registry->GetOrCreateDescriptorSetLayout(set_layout_key, [&]() {
+      VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info{};
+      descriptor_set_layout_create_info.sType = 
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      descriptor_set_layout_create_info.bindingCount = resource_bindings.size();
+      descriptor_set_layout_create_info.pBindings = resource_bindings.data();
+
+      GALPipelineRegistry::DescriptorSetLayout result;
+      if (vkCreateDescriptorSetLayout(vk_device_, &descriptor_set_layout_create_info, nullptr,
+                                      &result.vk_descriptor_set_layout) != VK_SUCCESS) {
+        throw Exception("Could not create VkDescriptorSetLayout.");
+      }
+      result.bindings = resource_bindings;
+      return result;
+    }));
+  }
+
+  std::vector<VkDescriptorSetLayout> vk_set_layouts;
+  for (const auto& layout : set_layouts) {
+    vk_set_layouts.push_back(layout->vk_descriptor_set_layout);
+  }
+
+  GALStateKey pipeline_layout_key;
+  pipeline_layout_key.Add(vk_set_layouts);
+
+  std::shared_ptr<const GALPipelineRegistry::PipelineLayout> pipeline_layout = 
+      registry->GetOrCreatePipelineLayout(pipeline_layout_key, [&]() {
+        VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+        pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipeline_layout_create_info.setLayoutCount = static_cast<uint32_t>(vk_set_layouts.size());
+        pipeline_layout_create_info.pSetLayouts = vk_set_layouts.data();
+
+        GALPipelineRegistry::PipelineLayout result;
+        if (vkCreatePipelineLayout(vk_device_, &pipeline_layout_create_info, nullptr,
+                                   &result.vk_pipeline_layout) != VK_SUCCESS) {
+          throw Exception("Could not create VkPipelineLayout.");
+        }
+        result.set_layouts = set_layouts;
+        return result;
+      });
+
+  // The bind point keeps compute keys apart from graphics keys.
+  GALStateKey pipeline_key;
+  pipeline_key.Add(VK_PIPELINE_BIND_POINT_COMPUTE).Add(shader_stage.module)
+      .Add(pipeline_layout->vk_pipeline_layout);
+
+  pipeline_ = registry->GetOrCreatePipeline(pipeline_key, [&]() {
+    VkComputePipelineCreateInfo pipeline_create_info{};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage = shader_stage;
+    pipeline_create_info.layout = pipeline_layout->vk_pipeline_layout;
+
+    GALPipelineCache* pipeline_cache = builder.gal_platform_->GetPipelineCache();
+
+    VkPipelineCreationFeedbackEXT creation_feedback{};
+    VkPipelineCreationFeedbackEXT stage_creation_feedback{};
+
+    VkPipelineCreationFeedbackCreateInfoEXT creation_feedback_info{};
+    creation_feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    creation_feedback_info.pPipelineCreationFeedback = &creation_feedback;
+    creation_feedback_info.pipelineStageCreationFeedbackCount = 1;
+    creation_feedback_info.pPipelineStageCreationFeedbacks = &stage_creation_feedback;
+
+    bool use_creation_feedback = 
+        pipeline_cache != nullptr && pipeline_cache->IsCreationFeedbackSupported();
+    if (use_creation_feedback) {
+      pipeline_create_info.pNext = &creation_feedback_info;
+    }
+
+    auto create_start = std::chrono::steady_clock::now();
+
+    GALPipelineRegistry::Pipeline result;
+    if (vkCreateComputePipelines(
+            vk_device_, 
+            pipeline_cache != nullptr ? pipeline_cache->GetVkPipelineCache() : VK_NULL_HANDLE, 
+            1, &pipeline_create_info, nullptr, &result.vk_pipeline) != VK_SUCCESS) {
+      throw Exception("Could not create compute VkPipeline.");
+    }
+
+    if (pipeline_cache != nullptr) {
+      pipeline_cache->RecordPipelineCreation(
+          std::chrono::steady_clock::now() - create_start,
+          use_creation_feedback ? &creation_feedback : nullptr);
+    }
+
+    result.layout = pipeline_layout;
+    return result;
+  });
+}
+
+GALComputePipeline::Builder& GALComputePipeline::Builder::SetShader(const GALShader& shader) {
+  shader_ = shader;
+  return *this;
+}
+
+GALComputePipeline::Builder& GALComputePipeline::Builder::AddStorageBufferDesc(
+    const BufferDesc& buffer_desc) {
+  storage_buffer_descs_.push_back(buffer_desc);
+  return *this;
+}
+
+GALComputePipeline::Builder& GALComputePipeline::Builder::AddUniformBufferDesc(
+    const BufferDesc& buffer_desc) {
+  uniform_buffer_descs_.push_back(buffer_desc);
+  return *this;
+}
+
+std::unique_ptr<GALComputePipeline> GALComputePipeline::Builder::Create() {
+  return std::make_unique<GALComputePipeline>(*this);
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef GAL_GAL_COMPUTE_PIPELINE_H_
+#define GAL_GAL_COMPUTE_PIPELINE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <vector>
+#include "gal/gal_pipeline_registry.h"
+#include "gal/gal_platform.h"
+#include "gal/gal_shader.h"
+
+namespace gal {
+
+// A pipeline for command::Dispatch, set with command::SetComputePipeline. Like GALPipeline, its
+// Vulkan objects are shared through the platform's GALPipelineRegistry.
+class GALComputePipeline {
+// Forward declaration
+class Builder;
+
+public:
+  // The only set holds the buffers that are bound with command::BindStorageBuffer and
+  // command::BindUniformBuffer, and shaders must declare those with "set = 0".
+  static constexpr uint32_t kResourceSetIndex = 0;
+
+  GALComputePipeline(Builder& builder);
+
+  static Builder BeginBuild(GALPlatform* gal_platform) {
+    return Builder(gal_platform);
+  }
+
+  VkPipelineLayout GetVkPipelineLayout() { return pipeline_->layout->vk_pipeline_layout; }
+  VkPipeline GetVkPipeline() { return pipeline_->vk_pipeline; }
+
+  // Null if the pipeline has no buffer resources.
+  const GALPipelineRegistry::DescriptorSetLayout* GetResourceSetLayout() {
+    const auto& set_layouts = pipeline_->layout->set_layouts;
+    return set_layouts.empty() ? nullptr : set_layouts[kResourceSetIndex].get();
+  }
+
+private:
+  std::shared_ptr<const GALPipelineRegistry::Pipeline> pipeline_;
+
+  VkDevice vk_device_;
+
+public:
+  struct BufferDesc {
+    int shader_idx = 0;
+  };
+
+  class Builder {
+  friend class GALComputePipeline;
+
+  public:
+    Builder(GALPlatform* gal_platform) : gal_platform_(gal_platform) {}
+
+    Builder& SetShader(const GALShader& shader);
+    Builder& AddStorageBufferDesc(const BufferDesc& buffer_desc);
+    Builder& AddUniformBufferDesc(const BufferDesc& buffer_desc);
+
+    std::unique_ptr<GALComputePipeline> Create();
+
+  private:
+    GALPlatform* gal_platform_;
+
+    GALShader shader_;
+
+    std::vector<BufferDesc> storage_buffer_descs_;
+    std::vector<BufferDesc> uniform_buffer_descs_;
+  };
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_COMPUTE_PIPELINE_H_
\ No newline at end of file
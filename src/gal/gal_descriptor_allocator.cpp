@@ -0,0 +1,107 @@
+#include "gal/gal_descriptor_allocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+namespace gal {
+
+namespace {
+
+const uint32_t kInitialSetsPerPool = 64;
+const uint32_t kMaxSetsPerPool = 4096;
+
+// Descriptors of each type that a pool holds per set.
+const uint32_t kDescriptorsPerSet = 4;
+
+const VkDescriptorType kPoolDescriptorTypes[] = {
+  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+  VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+};
+
+} // namespace
+
+GALDescriptorAllocator::GALDescriptorAllocator(VkDevice vk_device) 
+    : vk_device_(vk_device), next_pool_set_count_(kInitialSetsPerPool) {}
+
+GALDescriptorAllocator::~GALDescriptorAllocator() {
+  // Destroying the pools frees their descriptor sets.
+  for (VkDescriptorPool pool : vk_pools_) {
+    vkDestroyDescriptorPool(vk_device_, pool, nullptr);
+  }
+}
+
+std::optional<VkDescriptorSet> GALDescriptorAllocator::Allocate(
+    VkDescriptorSetLayout set_layout) {
+  VkDescriptorSetAllocateInfo descriptor_set_alloc_info{};
+  descriptor_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  descriptor_set_alloc_info.descriptorSetCount = 1;
+  descriptor_set_alloc_info.pSetLayouts = &set_layout;
+
+  for (;;) {
+    bool new_pool = false;
+    if (current_pool_ == vk_pools_.size()) {
+      if (!CreatePool()) {
+        return std::nullopt;
+      }
+      new_pool = true;
+    }
+
+    descriptor_set_alloc_info.descriptorPool = vk_pools_[current_pool_];
+
+    VkDescriptorSet descriptor_set;
+    VkResult result = vkAllocateDescriptorSets(vk_device_, &descriptor_set_alloc_info, 
+                                               &descriptor_set);
+    if (result == VK_SUCCESS) {
+      return descriptor_set;
+    }
+
+    // A set that does not fit into an empty pool never will.
+    if (new_pool || 
+        (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+      std::cerr << "Could not allocate VkDescriptorSet." << std::endl;
+      return std::nullopt;
+    }
+
+    ++current_pool_;
+  }
+}
+
+void GALDescriptorAllocator::Reset() {
+  for (size_t i = 0; i < vk_pools_.size() && i <= current_pool_; ++i) {
+    vkResetDescriptorPool(vk_device_, vk_pools_[i], 0);
+  }
+  current_pool_ = 0;
+}
+
+bool GALDescriptorAllocator::CreatePool() {
+  std::vector<VkDescriptorPoolSize> pool_sizes;
+  for (VkDescriptorType type : kPoolDescriptorTypes) {
+    VkDescriptorPoolSize pool_size{};
+    pool_size.type = type;
+    pool_size.descriptorCount = next_pool_set_count_ * kDescriptorsPerSet;
+    pool_sizes.push_back(pool_size);
+  }
+
+  VkDescriptorPoolCreateInfo descriptor_pool_create_info{};
+  descriptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptor_pool_create_info.maxSets = next_pool_set_count_;
+  descriptor_pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+  descriptor_pool_create_info.pPoolSizes = pool_sizes.data();
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(vk_device_, &descriptor_pool_create_info, nullptr, &pool) 
+          != VK_SUCCESS) {
+    std::cerr << "Could not create VkDescriptorPool." << std::endl;
+    return false;
+  }
+  vk_pools_.push_back(pool);
+
+  next_pool_set_count_ = std::min(next_pool_set_count_ * 2, kMaxSetsPerPool);
+
+  return true;
+}
+
+} // namespace gal
\ No newline at end of file
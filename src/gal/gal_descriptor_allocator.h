@@ -0,0 +1,45 @@
+#ifndef GAL_GAL_DESCRIPTOR_ALLOCATOR_H_
+#define GAL_GAL_DESCRIPTOR_ALLOCATOR_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace gal {
+
+// Allocates descriptor sets from a list of pools that grows on demand. When a pool runs out,
+// the next one is created with twice as many sets, up to a limit. Sets are never freed one at a
+// time. Reset() returns every set to the pools at once, and keeps the pools for reuse.
+//
+// Not thread-safe.
+class GALDescriptorAllocator {
+public:
+  GALDescriptorAllocator(VkDevice vk_device);
+  ~GALDescriptorAllocator();
+
+  std::optional<VkDescriptorSet> Allocate(VkDescriptorSetLayout set_layout);
+
+  // None of the sets allocated since the last reset may still be in use by the GPU.
+  void Reset();
+
+  uint32_t GetPoolCount() const { return static_cast<uint32_t>(vk_pools_.size()); }
+
+private:
+  bool CreatePool();
+
+private:
+  VkDevice vk_device_;
+
+  std::vector<VkDescriptorPool> vk_pools_;
+
+  // Pools before this one are full.
+  size_t current_pool_ = 0;
+
+  uint32_t next_pool_set_count_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_DESCRIPTOR_ALLOCATOR_H_
\ No newline at end of file
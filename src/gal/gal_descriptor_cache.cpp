@@ -0,0 +1,140 @@
+#include "gal/gal_descriptor_cache.h"
+
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace gal {
+
+namespace {
+
+// Past this, a frame's sets are reset when it next begins, to bound the memory held by sets
+// that are no longer used.
+const size_t kMaxSetsPerFrame = 4096;
+
+} // namespace
+
+GALDescriptorCache::GALDescriptorCache(VkDevice vk_device, uint32_t num_frames_in_flight) 
+    : vk_device_(vk_device) {
+  frame_slots_.resize(num_frames_in_flight);
+  for (Slot& slot : frame_slots_) {
+    slot.allocator = std::make_unique<GALDescriptorAllocator>(vk_device_);
+  }
+  persistent_slot_.allocator = std::make_unique<GALDescriptorAllocator>(vk_device_);
+}
+
+void GALDescriptorCache::BeginFrame(uint32_t frame) {
+  Slot& slot = frame_slots_[frame];
+  if (!slot.stale && slot.sets.size() <= kMaxSetsPerFrame) {
+    return;
+  }
+
+  slot.allocator->Reset();
+  slot.sets.clear();
+  slot.stale = false;
+
+  ++stats_.reset_count;
+}
+
+std::optional<VkDescriptorSet> GALDescriptorCache::GetOrCreate(
+    const GALPipelineRegistry::DescriptorSetLayout& set_layout, 
+    const std::vector<DescriptorResource>& resources, std::optional<uint32_t> frame) {
+  if (resources.size() != set_layout.bindings.size()) {
+    std::cerr << "Descriptor resources do not match the descriptor set layout." << std::endl;
+    return std::nullopt;
+  }
+
+  key_.Clear();
+  key_.Add(set_layout.vk_descriptor_set_layout);
+  for (const DescriptorResource& resource : resources) {
+    key_.Add(resource.buffer).Add(resource.buffer_range).Add(resource.image_view)
+        .Add(resource.sampler);
+  }
+
+  Slot& slot = frame.has_value() ? frame_slots_[frame.value()] : persistent_slot_;
+
+  auto it = slot.sets.find(key_);
+  if (it != slot.sets.end()) {
+    ++stats_.hit_count;
+    return it->second;
+  }
+
+  ++stats_.miss_count;
+
+  // The infos are sized up front, since the writes point into them.
+  buffer_infos_.resize(resources.size());
+  image_infos_.resize(resources.size());
+  writes_.clear();
+
+  for (size_t i = 0; i < resources.size(); ++i) {
+    const VkDescriptorSetLayoutBinding& binding = set_layout.bindings[i];
+    const DescriptorResource& resource = resources[i];
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstBinding = binding.binding;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = binding.descriptorType;
+
+    if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+        binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+      if (resource.buffer == VK_NULL_HANDLE) {
+        std::cerr << "No buffer bound at shader index: " << binding.binding << std::endl;
+        return std::nullopt;
+      }
+
+      buffer_infos_[i].buffer = resource.buffer;
+      buffer_infos_[i].offset = 0;
+      buffer_infos_[i].range = resource.buffer_range;
+      write.pBufferInfo = &buffer_infos_[i];
+    } else if (binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+      if (resource.image_view == VK_NULL_HANDLE || resource.sampler == VK_NULL_HANDLE) {
+        std::cerr << "No texture bound at shader index: " << binding.binding << std::endl;
+        return std::nullopt;
+      }
+
+      image_infos_[i].imageView = resource.image_view;
+      image_infos_[i].sampler = resource.sampler;
+      image_infos_[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      write.pImageInfo = &image_infos_[i];
+    } else {
+      std::cerr << "Descriptor type not supported by the descriptor cache." << std::endl;
+      return std::nullopt;
+    }
+
+    writes_.push_back(write);
+  }
+
+  std::optional<VkDescriptorSet> descriptor_set = 
+      slot.allocator->Allocate(set_layout.vk_descriptor_set_layout);
+  if (!descriptor_set.has_value()) {
+    return std::nullopt;
+  }
+
+  for (VkWriteDescriptorSet& write : writes_) {
+    write.dstSet = descriptor_set.value();
+  }
+  vkUpdateDescriptorSets(vk_device_, static_cast<uint32_t>(writes_.size()), writes_.data(), 0, 
+                         nullptr);
+
+  slot.sets.emplace(key_, descriptor_set.value());
+
+  return descriptor_set;
+}
+
+void GALDescriptorCache::OnResourceDestroyed() {
+  // A frame's sets may still be in use by the GPU, so they are only reset once the frame
+  // begins again. Until then, nothing is looked up in them.
+  for (Slot& slot : frame_slots_) {
+    slot.sets.clear();
+    slot.stale = true;
+  }
+
+  // Persistent command buffers that use these sets may still be replayed, so they are kept
+  // until the cache is destroyed.
+  persistent_slot_.sets.clear();
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef GAL_GAL_DESCRIPTOR_CACHE_H_
+#define GAL_GAL_DESCRIPTOR_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "gal/gal_descriptor_allocator.h"
+#include "gal/gal_pipeline_registry.h"
+
+namespace gal {
+
+// The resource bound to one binding of a descriptor set. Buffers set buffer and buffer_range,
+// and combined image samplers set image_view and sampler.
+struct DescriptorResource {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize buffer_range = 0;
+  VkImageView image_view = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+};
+
+// Hands out descriptor sets keyed by their layout and the resources bound to them, so that
+// draws binding the same resources share a set, which is only written once.
+//
+// Every frame in flight has its own GALDescriptorAllocator and cache, since a set cannot be
+// reset while a frame that uses it is in flight. A frame's sets are kept from one use of the
+// frame to the next, so frames that bind the same resources as before allocate nothing. The
+// frame's sets are reset in bulk when it begins, if there are too many of them or a resource
+// has been destroyed since, as a new resource may reuse a destroyed one's handle.
+//
+// Sets for command buffers that are recorded once come from an allocator of their own, which is
+// never reset.
+//
+// Not thread-safe.
+class GALDescriptorCache {
+public:
+  struct Stats {
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+    uint64_t reset_count = 0;
+  };
+
+  GALDescriptorCache(VkDevice vk_device, uint32_t num_frames_in_flight);
+
+  // Called once the frame's fence has signaled.
+  void BeginFrame(uint32_t frame);
+
+  // resources has one entry per binding of set_layout, in the same order. frame is the frame in
+  // flight whose command buffer binds the set, or std::nullopt if the set must stay valid for as
+  // long as its resources.
+  std::optional<VkDescriptorSet> GetOrCreate(
+      const GALPipelineRegistry::DescriptorSetLayout& set_layout, 
+      const std::vector<DescriptorResource>& resources, std::optional<uint32_t> frame);
+
+  // Must be called whenever a resource that may have been bound through the cache is destroyed.
+  void OnResourceDestroyed();
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct KeyHash {
+    size_t operator()(const GALStateKey& key) const { return key.Hash(); }
+  };
+
+  struct Slot {
+    std::unique_ptr<GALDescriptorAllocator> allocator;
+    std::unordered_map<GALStateKey, VkDescriptorSet, KeyHash> sets;
+
+    // Set once a resource has been destroyed. The allocator is reset when the frame begins.
+    bool stale = false;
+  };
+
+private:
+  VkDevice vk_device_;
+
+  std::vector<Slot> frame_slots_;
+  Slot persistent_slot_;
+
+  Stats stats_;
+
+  // Scratch space, so that cache hits do not allocate.
+  GALStateKey key_;
+  std::vector<VkDescriptorBufferInfo> buffer_infos_;
+  std::vector<VkDescriptorImageInfo> image_infos_;
+  std::vector<VkWriteDescriptorSet> writes_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_DESCRIPTOR_CACHE_H_
\ No newline at end of file
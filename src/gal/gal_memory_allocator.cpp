@@ -0,0 +1,418 @@
+#include "gal/gal_memory_allocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+namespace {
+
+const VkDeviceSize kLargeHeapBlockSize = 64 * 1024 * 1024;
+const VkDeviceSize kSmallHeapMaxSize = 1024 * 1024 * 1024;
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Whether the last byte of one resource and the first byte of the next resource fall on the same
+// "page" of size bufferImageGranularity.
+bool IsOnSamePage(VkDeviceSize end_of_first, VkDeviceSize start_of_second, 
+                  VkDeviceSize page_size) {
+  VkDeviceSize page_mask = ~(page_size - 1);
+  return (end_of_first & page_mask) == (start_of_second & page_mask);
+}
+
+} // namespace
+
+GALMemoryAllocator::GALMemoryAllocator(VkPhysicalDevice vk_physical_device, VkDevice vk_device)
+    : vk_device_(vk_device) {
+  vkGetPhysicalDeviceMemoryProperties(vk_physical_device, &memory_props_);
+
+  VkPhysicalDeviceProperties device_props;
+  vkGetPhysicalDeviceProperties(vk_physical_device, &device_props);
+
+  buffer_image_granularity_ = std::max<VkDeviceSize>(
+      device_props.limits.bufferImageGranularity, 1);
+  max_memory_allocation_count_ = device_props.limits.maxMemoryAllocationCount;
+
+  memory_type_blocks_.resize(memory_props_.memoryTypeCount);
+}
+
+GALMemoryAllocator::~GALMemoryAllocator() {
+  for (const auto& [block_id, block] : blocks_) {
+    if (block->allocation_count != 0) {
+      std::cerr << "Memory block destroyed with " << block->allocation_count 
+                << " live allocations." << std::endl;
+    }
+    vkFreeMemory(vk_device_, block->vk_memory, nullptr);
+  }
+}
+
+std::optional<GALMemoryAllocator::Allocation> GALMemoryAllocator::AllocateBufferMemory(
+    VkBuffer buffer, VkMemoryPropertyFlags required_flags, 
+    VkMemoryPropertyFlags preferred_flags) {
+  VkMemoryRequirements memory_req;
+  vkGetBufferMemoryRequirements(vk_device_, buffer, &memory_req);
+
+  std::optional<Allocation> allocation = 
+      Allocate(memory_req, ResourceLayout::Linear, required_flags, preferred_flags);
+  if (!allocation.has_value()) {
+    return std::nullopt;
+  }
+
+  if (vkBindBufferMemory(vk_device_, buffer, allocation->vk_memory, allocation->offset) 
+          != VK_SUCCESS) {
+    std::cerr << "Could not bind buffer memory." << std::endl;
+    Free(allocation.value());
+    return std::nullopt;
+  }
+
+  return allocation;
+}
+
+std::optional<GALMemoryAllocator::Allocation> GALMemoryAllocator::AllocateImageMemory(
+    VkImage image, VkMemoryPropertyFlags required_flags, 
+    VkMemoryPropertyFlags preferred_flags) {
+  VkMemoryRequirements memory_req;
+  vkGetImageMemoryRequirements(vk_device_, image, &memory_req);
+
+  std::optional<Allocation> allocation = 
+      Allocate(memory_req, ResourceLayout::Optimal, required_flags, preferred_flags);
+  if (!allocation.has_value()) {
+    return std::nullopt;
+  }
+
+  if (vkBindImageMemory(vk_device_, image, allocation->vk_memory, allocation->offset) 
+          != VK_SUCCESS) {
+    std::cerr << "Could not bind image memory." << std::endl;
+    Free(allocation.value());
+    return std::nullopt;
+  }
+
+  return allocation;
+}
+
+std::optional<GALMemoryAllocator::Allocation> GALMemoryAllocator::Allocate(
+    const VkMemoryRequirements& memory_req, ResourceLayout layout, 
+    VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags) {
+  std::optional<uint32_t> memory_type_index_opt = 
+      FindMemoryType(memory_req.memoryTypeBits, required_flags, preferred_flags);
+  if (!memory_type_index_opt.has_value()) {
+    std::cerr << "Could not find memory for memory type." << std::endl;
+    return std::nullopt;
+  }
+  uint32_t memory_type_index = memory_type_index_opt.value();
+
+  VkDeviceSize alignment = std::max<VkDeviceSize>(memory_req.alignment, 1);
+  VkDeviceSize block_size = GetPreferredBlockSize(memory_type_index);
+
+  // Large resources get their own block, so that they do not fragment the shared blocks.
+  if (memory_req.size > block_size / 2) {
+    std::optional<uint64_t> block_id = CreateBlock(memory_type_index, memory_req.size, true);
+    if (!block_id.has_value()) {
+      return std::nullopt;
+    }
+
+    Placement placement;
+    placement.block = blocks_[block_id.value()].get();
+    return Commit(block_id.value(), placement, memory_req.size, layout);
+  }
+
+  for (uint64_t block_id : memory_type_blocks_[memory_type_index]) {
+    std::optional<Placement> placement = 
+        FindPlacement(blocks_[block_id].get(), memory_req.size, alignment, layout);
+    if (placement.has_value()) {
+      return Commit(block_id, placement.value(), memory_req.size, layout);
+    }
+  }
+
+  std::optional<uint64_t> block_id = CreateBlock(memory_type_index, block_size, false);
+  if (!block_id.has_value()) {
+    return std::nullopt;
+  }
+
+  std::optional<Placement> placement = 
+      FindPlacement(blocks_[block_id.value()].get(), memory_req.size, alignment, layout);
+  if (!placement.has_value()) {
+    std::cerr << "Could not place allocation in a new memory block." << std::endl;
+    return std::nullopt;
+  }
+
+  return Commit(block_id.value(), placement.value(), memory_req.size, layout);
+}
+
+void GALMemoryAllocator::Free(const Allocation& allocation) {
+  auto block_it = blocks_.find(allocation.block_id);
+  if (block_it == blocks_.end()) {
+    throw Exception("Freeing memory from an unknown block.");
+  }
+  Block* block = block_it->second.get();
+
+  auto it = block->suballocations.find(allocation.offset);
+  if (it == block->suballocations.end() || it->second.free) {
+    throw Exception("Freeing memory that is not allocated.");
+  }
+
+  it->second.free = true;
+  --block->allocation_count;
+
+  auto next_it = std::next(it);
+  if (next_it != block->suballocations.end() && next_it->second.free) {
+    it->second.size += next_it->second.size;
+    block->suballocations.erase(next_it);
+  }
+
+  if (it != block->suballocations.begin()) {
+    auto prev_it = std::prev(it);
+    if (prev_it->second.free) {
+      prev_it->second.size += it->second.size;
+      block->suballocations.erase(it);
+    }
+  }
+
+  if (block->allocation_count != 0) {
+    return;
+  }
+
+  if (block->dedicated) {
+    DestroyBlock(allocation.block_id);
+    return;
+  }
+
+  // Keep at most one empty block per memory type around, so that a pattern of allocating and
+  // freeing a single resource does not allocate device memory every time.
+  for (uint64_t block_id : memory_type_blocks_[block->memory_type_index]) {
+    if (block_id != allocation.block_id && blocks_[block_id]->allocation_count == 0) {
+      DestroyBlock(allocation.block_id);
+      return;
+    }
+  }
+}
+
+std::optional<uint32_t> GALMemoryAllocator::FindMemoryType(
+    uint32_t memory_type_bits, VkMemoryPropertyFlags required_flags, 
+    VkMemoryPropertyFlags preferred_flags) const {
+  std::optional<uint32_t> best_index;
+  size_t best_cost = SIZE_MAX;
+
+  for (uint32_t i = 0; i < memory_props_.memoryTypeCount; ++i) {
+    if (!(memory_type_bits & (1u << i))) {
+      continue;
+    }
+
+    VkMemoryPropertyFlags flags = memory_props_.memoryTypes[i].propertyFlags;
+    if ((flags & required_flags) != required_flags) {
+      continue;
+    }
+
+    // A missing preferred flag costs more than any number of unneeded flags.
+    size_t missing_preferred = std::bitset<32>(preferred_flags & ~flags).count();
+    size_t unneeded = std::bitset<32>(flags & ~(required_flags | preferred_flags)).count();
+    size_t cost = missing_preferred * 32 + unneeded;
+
+    if (cost < best_cost) {
+      best_index = i;
+      best_cost = cost;
+    }
+  }
+
+  return best_index;
+}
+
+GALMemoryAllocator::Stats GALMemoryAllocator::GetStats() const {
+  Stats stats;
+  for (const auto& [block_id, block] : blocks_) {
+    ++stats.block_count;
+    if (block->dedicated) {
+      ++stats.dedicated_block_count;
+    }
+    stats.allocation_count += block->allocation_count;
+    stats.block_bytes += block->size;
+
+    for (const auto& [offset, suballocation] : block->suballocations) {
+      if (!suballocation.free) {
+        stats.used_bytes += suballocation.size;
+      }
+    }
+  }
+  return stats;
+}
+
+std::optional<uint64_t> GALMemoryAllocator::CreateBlock(uint32_t memory_type_index, 
+                                                        VkDeviceSize size, bool dedicated) {
+  if (blocks_.size() >= max_memory_allocation_count_) {
+    std::cerr << "Reached maxMemoryAllocationCount." << std::endl;
+    return std::nullopt;
+  }
+
+  auto block = std::make_unique<Block>();
+  block->size = size;
+  block->memory_type_index = memory_type_index;
+  block->mapped_data = nullptr;
+  block->dedicated = dedicated;
+
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type_index;
+
+  if (vkAllocateMemory(vk_device_, &alloc_info, nullptr, &block->vk_memory) != VK_SUCCESS) {
+    std::cerr << "Could not allocate VkDeviceMemory." << std::endl;
+    return std::nullopt;
+  }
+
+  if (memory_props_.memoryTypes[memory_type_index].propertyFlags & 
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(vk_device_, block->vk_memory, 0, VK_WHOLE_SIZE, 0, &block->mapped_data) 
+            != VK_SUCCESS) {
+      std::cerr << "Could not map VkDeviceMemory." << std::endl;
+      vkFreeMemory(vk_device_, block->vk_memory, nullptr);
+      return std::nullopt;
+    }
+  }
+
+  Suballocation suballocation;
+  suballocation.size = size;
+  suballocation.free = true;
+  suballocation.layout = ResourceLayout::Linear;
+  block->suballocations.emplace(0, suballocation);
+
+  uint64_t block_id = next_block_id_++;
+  blocks_.emplace(block_id, std::move(block));
+
+  if (!dedicated) {
+    memory_type_blocks_[memory_type_index].push_back(block_id);
+  }
+
+  return block_id;
+}
+
+void GALMemoryAllocator::DestroyBlock(uint64_t block_id) {
+  auto block_it = blocks_.find(block_id);
+  Block* block = block_it->second.get();
+
+  std::vector<uint64_t>& type_blocks = memory_type_blocks_[block->memory_type_index];
+  type_blocks.erase(std::remove(type_blocks.begin(), type_blocks.end(), block_id), 
+                    type_blocks.end());
+
+  // Freeing the memory implicitly unmaps it.
+  vkFreeMemory(vk_device_, block->vk_memory, nullptr);
+
+  blocks_.erase(block_it);
+}
+
+std::optional<GALMemoryAllocator::Placement> GALMemoryAllocator::FindPlacement(
+    Block* block, VkDeviceSize size, VkDeviceSize alignment, ResourceLayout layout) const {
+  std::optional<Placement> best_placement;
+  VkDeviceSize best_free_size = 0;
+
+  for (auto it = block->suballocations.begin(); it != block->suballocations.end(); ++it) {
+    if (!it->second.free || it->second.size < size) {
+      continue;
+    }
+
+    VkDeviceSize free_offset = it->first;
+    VkDeviceSize free_end = free_offset + it->second.size;
+
+    VkDeviceSize offset = AlignUp(free_offset, alignment);
+
+    // Free suballocations are always merged, so the neighbours are allocated.
+    if (buffer_image_granularity_ > 1 && it != block->suballocations.begin()) {
+      auto prev_it = std::prev(it);
+      if (prev_it->second.layout != layout && 
+          IsOnSamePage(prev_it->first + prev_it->second.size - 1, offset, 
+                       buffer_image_granularity_)) {
+        offset = AlignUp(offset, buffer_image_granularity_);
+      }
+    }
+
+    if (offset + size > free_end) {
+      continue;
+    }
+
+    auto next_it = std::next(it);
+    if (buffer_image_granularity_ > 1 && next_it != block->suballocations.end() && 
+        next_it->second.layout != layout && 
+        IsOnSamePage(offset + size - 1, next_it->first, buffer_image_granularity_)) {
+      continue;
+    }
+
+    // Best fit - the smallest free range that the allocation fits in.
+    if (!best_placement.has_value() || it->second.size < best_free_size) {
+      Placement placement;
+      placement.block = block;
+      placement.free_offset = free_offset;
+      placement.offset = offset;
+
+      best_placement = placement;
+      best_free_size = it->second.size;
+    }
+  }
+
+  return best_placement;
+}
+
+GALMemoryAllocator::Allocation GALMemoryAllocator::Commit(
+    uint64_t block_id, const Placement& placement, VkDeviceSize size, ResourceLayout layout) {
+  Block* block = placement.block;
+
+  auto free_it = block->suballocations.find(placement.free_offset);
+  VkDeviceSize free_end = placement.free_offset + free_it->second.size;
+  block->suballocations.erase(free_it);
+
+  if (placement.offset > placement.free_offset) {
+    Suballocation padding;
+    padding.size = placement.offset - placement.free_offset;
+    padding.free = true;
+    padding.layout = layout;
+    block->suballocations.emplace(placement.free_offset, padding);
+  }
+
+  Suballocation suballocation;
+  suballocation.size = size;
+  suballocation.free = false;
+  suballocation.layout = layout;
+  block->suballocations.emplace(placement.offset, suballocation);
+
+  if (placement.offset + size < free_end) {
+    Suballocation remainder;
+    remainder.size = free_end - (placement.offset + size);
+    remainder.free = true;
+    remainder.layout = layout;
+    block->suballocations.emplace(placement.offset + size, remainder);
+  }
+
+  ++block->allocation_count;
+
+  Allocation allocation;
+  allocation.vk_memory = block->vk_memory;
+  allocation.offset = placement.offset;
+  allocation.size = size;
+  allocation.memory_type_index = block->memory_type_index;
+  allocation.block_id = block_id;
+  if (block->mapped_data != nullptr) {
+    allocation.mapped_data = static_cast<uint8_t*>(block->mapped_data) + placement.offset;
+  }
+
+  return allocation;
+}
+
+VkDeviceSize GALMemoryAllocator::GetPreferredBlockSize(uint32_t memory_type_index) const {
+  uint32_t heap_index = memory_props_.memoryTypes[memory_type_index].heapIndex;
+  VkDeviceSize heap_size = memory_props_.memoryHeaps[heap_index].size;
+
+  if (heap_size <= kSmallHeapMaxSize) {
+    return heap_size / 8;
+  }
+  return kLargeHeapBlockSize;
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef GAL_GAL_MEMORY_ALLOCATOR_H_
+#define GAL_GAL_MEMORY_ALLOCATOR_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace gal {
+
+// Sub-allocates buffer and image memory from large per-memory-type VkDeviceMemory blocks, so
+// that the number of vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+//
+// Within a block, suballocations respect the resource's alignment and keep linear resources
+// (buffers) and optimal resources (images) bufferImageGranularity apart. Host-visible blocks are
+// persistently mapped.
+//
+// Not thread-safe.
+class GALMemoryAllocator {
+public:
+  enum class ResourceLayout {
+    Linear,
+    Optimal
+  };
+
+  struct Allocation {
+    VkDeviceMemory vk_memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    // Null unless the memory is host-visible.
+    void* mapped_data = nullptr;
+
+    uint32_t memory_type_index = 0;
+    uint64_t block_id = 0;
+  };
+
+  struct Stats {
+    uint32_t block_count = 0;
+    uint32_t dedicated_block_count = 0;
+    uint32_t allocation_count = 0;
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+  };
+
+  GALMemoryAllocator(VkPhysicalDevice vk_physical_device, VkDevice vk_device);
+  ~GALMemoryAllocator();
+
+  // Allocates memory for the resource and binds it.
+  std::optional<Allocation> AllocateBufferMemory(VkBuffer buffer, 
+                                                 VkMemoryPropertyFlags required_flags,
+                                                 VkMemoryPropertyFlags preferred_flags);
+  std::optional<Allocation> AllocateImageMemory(VkImage image, 
+                                                VkMemoryPropertyFlags required_flags,
+                                                VkMemoryPropertyFlags preferred_flags);
+
+  std::optional<Allocation> Allocate(const VkMemoryRequirements& memory_req, 
+                                     ResourceLayout layout, 
+                                     VkMemoryPropertyFlags required_flags,
+                                     VkMemoryPropertyFlags preferred_flags);
+  void Free(const Allocation& allocation);
+
+  // Picks the memory type that has all of the required flags, as many of the preferred flags as
+  // possible, and as few other flags as possible.
+  std::optional<uint32_t> FindMemoryType(uint32_t memory_type_bits, 
+                                         VkMemoryPropertyFlags required_flags,
+                                         VkMemoryPropertyFlags preferred_flags) const;
+
+  Stats GetStats() const;
+
+private:
+  struct Suballocation {
+    VkDeviceSize size;
+    bool free;
+    ResourceLayout layout;
+  };
+
+  struct Block {
+    VkDeviceMemory vk_memory;
+    VkDeviceSize size;
+    uint32_t memory_type_index;
+    void* mapped_data;
+    bool dedicated;
+    uint32_t allocation_count = 0;
+
+    // Keyed by offset. Covers the whole block, and adjacent free suballocations are merged.
+    std::map<VkDeviceSize, Suballocation> suballocations;
+  };
+
+  struct Placement {
+    Block* block = nullptr;
+    VkDeviceSize free_offset = 0;
+    VkDeviceSize offset = 0;
+  };
+
+  std::optional<uint64_t> CreateBlock(uint32_t memory_type_index, VkDeviceSize size, 
+                                      bool dedicated);
+  void DestroyBlock(uint64_t block_id);
+
+  std::optional<Placement> FindPlacement(Block* block, VkDeviceSize size, 
+                                         VkDeviceSize alignment, ResourceLayout layout) const;
+  Allocation Commit(uint64_t block_id, const Placement& placement, VkDeviceSize size, 
+                    ResourceLayout layout);
+
+  VkDeviceSize GetPreferredBlockSize(uint32_t memory_type_index) const;
+
+private:
+  VkDevice vk_device_;
+
+  VkPhysicalDeviceMemoryProperties memory_props_;
+  VkDeviceSize buffer_image_granularity_;
+  uint32_t max_memory_allocation_count_;
+
+  uint64_t next_block_id_ = 1;
+  std::unordered_map<uint64_t, std::unique_ptr<Block>> blocks_;
+
+  // Non-dedicated block ids for each memory type.
+  std::vector<std::vector<uint64_t>> memory_type_blocks_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_MEMORY_ALLOCATOR_H_
\ No newline at end of file
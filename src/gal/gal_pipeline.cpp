@@ -2,11 +2,56 @@
 
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <vector>
+#include "gal/gal_bindless_table.h"
 #include "gal/gal_exception.h"
+#include "gal/gal_pipeline_cache.h"
+#include "gal/gal_pipeline_registry.h"
+#include "gal/gal_uniform_ring.h"
 
 namespace gal {
 
+namespace {
+
+VkShaderStageFlags GetVkShaderStage(ShaderType type) {
+  switch (type) {
+  case ShaderType::Vertex:
+    return VK_SHADER_STAGE_VERTEX_BIT;
+  case ShaderType::Fragment:
+    return VK_SHADER_STAGE_FRAGMENT_BIT;
+  default:
+    throw Exception("Shader stage not supported for resource description.");
+  }
+}
+
+VkCompareOp GetVkCompareOp(GALPipeline::CompareOp compare_op) {
+  switch (compare_op) {
+  case GALPipeline::CompareOp::Never:
+    return VK_COMPARE_OP_NEVER;
+  case GALPipeline::CompareOp::Less:
+    return VK_COMPARE_OP_LESS;
+  case GALPipeline::CompareOp::Equal:
+    return VK_COMPARE_OP_EQUAL;
+  case GALPipeline::CompareOp::LessOrEqual:
+    return VK_COMPARE_OP_LESS_OR_EQUAL;
+  case GALPipeline::CompareOp::Greater:
+    return VK_COMPARE_OP_GREATER;
+  case GALPipeline::CompareOp::NotEqual:
+    return VK_COMPARE_OP_NOT_EQUAL;
+  case GALPipeline::CompareOp::GreaterOrEqual:
+    return VK_COMPARE_OP_GREATER_OR_EQUAL;
+  default:
+    return VK_COMPARE_OP_ALWAYS;
+  }
+}
+
+} // namespace
+
 GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
   vk_device_ = builder.gal_platform_->GetVkDevice();
 
@@ -24,12 +69,17 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
 
   VkPipelineShaderStageCreateInfo shader_stages[] = { vert_shader_stage, frag_shader_stage };
 
+  // Depth-only pipelines have no fragment shader.
+  bool has_frag_shader = frag_shader_stage.module != VK_NULL_HANDLE;
+
   std::vector<VkVertexInputBindingDescription> vert_binding_descs;
   for (const VertexInput& vert_input : builder.vert_inputs_) {
     VkVertexInputBindingDescription desc;
     desc.binding = vert_input.buffer_idx;
     desc.stride = vert_input.stride;
-    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    desc.inputRate = vert_input.input_rate == InputRate::PerInstance
+                         ? VK_VERTEX_INPUT_RATE_INSTANCE
+                         : VK_VERTEX_INPUT_RATE_VERTEX;
     vert_binding_descs.push_back(std::move(desc));
   }
 
@@ -40,12 +90,18 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
     desc.location = vert_desc.shader_idx;
     
     switch (vert_desc.num_components) {
+    case 1:
+      desc.format = VK_FORMAT_R32_SFLOAT;
+      break;
     case 2:
       desc.format = VK_FORMAT_R32G32_SFLOAT;
       break;
     case 3:
       desc.format = VK_FORMAT_R32G32B32_SFLOAT;
       break;
+    case 4:
+      desc.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      break;
     default: 
       throw Exception("Vertex format not supported.");
     }
@@ -54,11 +110,24 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
     vert_attribute_descs.push_back(std::move(desc));
   }
 
+  GALBindlessTable* bindless_table = nullptr;
+  if (builder.bindless_) {
+    bindless_table = builder.gal_platform_->GetBindlessTable();
+    if (bindless_table == nullptr) {
+      throw Exception("Bindless pipelines need the platform's bindless table.");
+    }
+    if (!builder.uniform_descs_.empty() || !builder.uniform_buffer_descs_.empty() || 
+        !builder.storage_buffer_descs_.empty() || !builder.texture_descs_.empty()) {
+      throw Exception("Bindless pipelines cannot have uniform or resource descriptions.");
+    }
+    vk_bindless_descriptor_set_ = bindless_table->GetVkDescriptorSet();
+  }
+
   std::vector<VkDescriptorSetLayoutBinding> uniform_bindings;
   for (const UniformDesc& uniform_desc : builder.uniform_descs_) {
     VkDescriptorSetLayoutBinding uniform_binding{};
     uniform_binding.binding = uniform_desc.shader_idx;
-    uniform_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uniform_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uniform_binding.descriptorCount = 1;
 
     if (uniform_desc.shader_stage == ShaderType::Vertex) {
@@ -70,6 +139,91 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
     uniform_bindings.push_back(uniform_binding);
   }
 
+  // Dynamic offsets are passed in binding order.
+  std::sort(uniform_bindings.begin(), uniform_bindings.end(), 
+      [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding < b.binding;
+      });
+
+  if (uniform_bindings.size() > GALUniformRing::kMaxBindingsPerSet) {
+    throw Exception("Too many uniform descriptions.");
+  }
+
+  std::vector<VkDescriptorSetLayoutBinding> resource_bindings;
+  for (const UniformDesc& uniform_desc : builder.uniform_buffer_descs_) {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = uniform_desc.shader_idx;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = GetVkShaderStage(uniform_desc.shader_stage);
+    resource_bindings.push_back(binding);
+  }
+  for (const UniformDesc& storage_desc : builder.storage_buffer_descs_) {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = storage_desc.shader_idx;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = GetVkShaderStage(storage_desc.shader_stage);
+    resource_bindings.push_back(binding);
+  }
+  for (const TextureDesc& texture_desc : builder.texture_descs_) {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = texture_desc.shader_idx;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = GetVkShaderStage(texture_desc.shader_stage);
+    resource_bindings.push_back(binding);
+  }
+
+  std::sort(resource_bindings.begin(), resource_bindings.end(), 
+      [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding < b.binding;
+      });
+
+  std::vector<VkPushConstantRange> push_constant_ranges;
+  if (!builder.push_constant_descs_.empty()) {
+    VkPhysicalDeviceProperties device_props;
+    vkGetPhysicalDeviceProperties(builder.gal_platform_->GetVkPhysicalDevice(), &device_props);
+
+    uint32_t max_size = 
+        std::min(device_props.limits.maxPushConstantsSize, kMaxPushConstantsSize);
+
+    VkShaderStageFlags declared_stages = 0;
+    for (const PushConstantDesc& push_constant_desc : builder.push_constant_descs_) {
+      if (push_constant_desc.size == 0 || push_constant_desc.offset % 4 != 0 || 
+          push_constant_desc.size % 4 != 0) {
+        throw Exception("Push constant range must be a non-empty multiple of 4 bytes.");
+      }
+      if (push_constant_desc.offset + push_constant_desc.size > max_size) {
+        throw Exception("Push constant range exceeds maxPushConstantsSize.");
+      }
+
+      VkShaderStageFlags stage = GetVkShaderStage(push_constant_desc.shader_stage);
+      if ((declared_stages & stage) != 0) {
+        throw Exception("Shader stage has more than one push constant range.");
+      }
+      declared_stages |= stage;
+
+      // Stages that read the same range share it.
+      auto range_it = std::find_if(push_constant_ranges.begin(), push_constant_ranges.end(), 
+          [&push_constant_desc](const VkPushConstantRange& range) {
+            return range.offset == push_constant_desc.offset && 
+                   range.size == push_constant_desc.size;
+          });
+      if (range_it != push_constant_ranges.end()) {
+        range_it->stageFlags |= stage;
+      } else {
+        push_constant_ranges.push_back({stage, push_constant_desc.offset, 
+                                        push_constant_desc.size});
+      }
+    }
+
+    std::sort(push_constant_ranges.begin(), push_constant_ranges.end(), 
+        [](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+          return a.offset < b.offset;
+        });
+  }
+
   VkPipelineVertexInputStateCreateInfo vert_input_state{};
   vert_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vert_input_state.vertexBindingDescriptionCount = vert_binding_descs.size();
@@ -82,29 +236,18 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
   input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   input_assembly_state.primitiveRestartEnable = VK_FALSE;
 
-  // TODO(colintan): Use the default viewport - the window dimensions - if user does not specify
-  // an initial viewport. Also add support for changing the viewport later on (using Vulkan's
-  // dynamic state))
-  VkViewport viewport{};
-  viewport.x = builder.viewport_.x;
-  viewport.y = builder.viewport_.y;
-  viewport.width = builder.viewport_.width;
-  viewport.height = builder.viewport_.height;
-  viewport.minDepth = 0.f;
-  viewport.maxDepth = 1.f;
-
-  const VkExtent2D& swapchain_extent = builder.gal_platform_->GetVkSwapchainExtent();
-
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = swapchain_extent;
-
+  // The viewport and scissor are dynamic, so only their counts are baked in.
   VkPipelineViewportStateCreateInfo viewport_state{};
   viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewport_state.viewportCount = 1;
-  viewport_state.pViewports = &viewport;
   viewport_state.scissorCount = 1;
-  viewport_state.pScissors = &scissor;
+
+  VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+  VkPipelineDynamicStateCreateInfo dynamic_state{};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount = static_cast<uint32_t>(std::size(dynamic_states));
+  dynamic_state.pDynamicStates = dynamic_states;
 
   VkPipelineRasterizationStateCreateInfo rasterization_state{};
   rasterization_state.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -121,9 +264,20 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
   multisample_state.sampleShadingEnable = VK_FALSE;
   multisample_state.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+  VkPipelineDepthStencilStateCreateInfo depth_stencil_state{};
+  depth_stencil_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_stencil_state.depthTestEnable = builder.depth_test_ ? VK_TRUE : VK_FALSE;
+  depth_stencil_state.depthWriteEnable = builder.depth_write_ ? VK_TRUE : VK_FALSE;
+  depth_stencil_state.depthCompareOp = GetVkCompareOp(builder.depth_compare_op_);
+  depth_stencil_state.depthBoundsTestEnable = VK_FALSE;
+  depth_stencil_state.stencilTestEnable = VK_FALSE;
+
+  // Without a fragment shader, the colour attachment's values would be undefined.
   VkPipelineColorBlendAttachmentState color_blend_attachment{};
-  color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  color_blend_attachment.colorWriteMask = 
+      has_frag_shader ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+                      : 0;
   color_blend_attachment.blendEnable = VK_FALSE;
 
   VkPipelineColorBlendStateCreateInfo color_blend_state{};
@@ -132,120 +286,179 @@ GALPipeline::GALPipeline(GALPipeline::Builder& builder) {
   color_blend_state.attachmentCount = 1;
   color_blend_state.pAttachments = &color_blend_attachment;
 
-  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info{};
-  descriptor_set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  descriptor_set_layout_create_info.bindingCount = uniform_bindings.size();
-  descriptor_set_layout_create_info.pBindings = uniform_bindings.data();
+  GALPipelineRegistry* registry = builder.gal_platform_->GetPipelineRegistry();
 
-  if (vkCreateDescriptorSetLayout(vk_device_, &descriptor_set_layout_create_info, nullptr,
-                                  &vk_descriptor_set_layout_) != VK_SUCCESS) {
-    throw Exception("Coult not create VkDescriptorSetLayout.");
+  GALStateKey set_layout_key;
+  for (const VkDescriptorSetLayoutBinding& binding : uniform_bindings) {
+    set_layout_key.Add(binding.binding).Add(binding.descriptorType)
+        .Add(binding.descriptorCount).Add(binding.stageFlags);
   }
 
-  VkPipelineLayoutCreateInfo  pipeline_layout_create_info{};
-  pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipeline_layout_create_info.setLayoutCount = 1;
-  pipeline_layout_create_info.pSetLayouts = &vk_descriptor_set_layout_;
-  
-  if (vkCreatePipelineLayout(vk_device_, &pipeline_layout_create_info, nullptr,
-                             &vk_pipeline_layout_) != VK_SUCCESS) {
-    throw Exception("Could not create VkPipelineLayout.");
+  // Bindless pipelines have no uniforms, and read everything from the table's set instead.
+  std::shared_ptr<const GALPipelineRegistry::DescriptorSetLayout> set_layout;
+  if (bindless_table != nullptr) {
+    set_layout = bindless_table->GetSetLayout();
+  } else {
+    set_layout = registry->GetOrCreateDescriptorSetLayout(set_layout_key, [&]() {
+      VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info{};
+      descriptor_set_layout_create_info.sType = 
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      descriptor_set_layout_create_info.bindingCount = uniform_bindings.size();
+      descriptor_set_layout_create_info.pBindings = uniform_bindings.data();
+
+      GALPipelineRegistry::DescriptorSetLayout result;
+      if (vkCreateDescriptorSetLayout(vk_device_, &descriptor_set_layout_create_info, nullptr,
+                                      &result.vk_descriptor_set_layout) != VK_SUCCESS) {
+        throw Exception("Coult not create VkDescriptorSetLayout.");
+      }
+      result.bindings = uniform_bindings;
+
+      if (uniform_bindings.empty()) {
+        return result;
+      }
+
+      for (const VkDescriptorSetLayoutBinding& binding : uniform_bindings) {
+        result.uniform_bindings.push_back(binding.binding);
+      }
+
+      GALUniformRing* uniform_ring = builder.gal_platform_->GetUniformRing();
+
+      std::optional<VkDescriptorSet> descriptor_set = 
+          uniform_ring->AllocateDescriptorSet(result.vk_descriptor_set_layout, 
+                                              result.uniform_bindings);
+      if (!descriptor_set.has_value()) {
+        vkDestroyDescriptorSetLayout(vk_device_, result.vk_descriptor_set_layout, nullptr);
+        throw Exception("Could not create uniform VkDescriptorSet.");
+      }
+      result.vk_uniform_descriptor_set = descriptor_set.value();
+      result.vk_descriptor_pool = uniform_ring->GetVkDescriptorPool();
+
+      return result;
+    });
   }
 
-  VkAttachmentDescription color_attachment{};
-  color_attachment.format = builder.gal_platform_->GetVkSwapchainImageFormat();
-  color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentReference color_attachment_ref{};
-  color_attachment_ref.attachment = 0;
-  color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass{};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &color_attachment_ref;
-
-  VkSubpassDependency subpass_dependency{};
-  subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  subpass_dependency.dstSubpass = 0;
-  subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  subpass_dependency.srcAccessMask = 0;
-  subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  VkRenderPassCreateInfo render_pass_create_info{};
-  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  render_pass_create_info.attachmentCount = 1;
-  render_pass_create_info.pAttachments = &color_attachment;
-  render_pass_create_info.subpassCount = 1;
-  render_pass_create_info.pSubpasses = &subpass;
-  render_pass_create_info.dependencyCount = 1;
-  render_pass_create_info.pDependencies = &subpass_dependency;
-
-  if (vkCreateRenderPass(vk_device_, &render_pass_create_info, nullptr, 
-                         &vk_render_pass_) != VK_SUCCESS) {
-    throw Exception("Could not create VkRenderPass.");
+  std::vector<std::shared_ptr<const GALPipelineRegistry::DescriptorSetLayout>> set_layouts = {
+    set_layout
+  };
+
+  if (!resource_bindings.empty()) {
+    GALStateKey resource_set_layout_key;
+    for (const VkDescriptorSetLayoutBinding& binding : resource_bindings) {
+      resource_set_layout_key.Add(binding.binding).Add(binding.descriptorType)
+          .Add(binding.descriptorCount).Add(binding.stageFlags);
+    }
+
+    set_layouts.push_back(registry->GetOrCreateDescriptorSetLayout(resource_set_layout_key, 
+        [&]() {
+          VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info{};
+          descriptor_set_layout_create_info.sType = 
+              VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+          descriptor_set_layout_create_info.bindingCount = resource_bindings.size();
+          descriptor_set_layout_create_info.pBindings = resource_bindings.data();
+
+          GALPipelineRegistry::DescriptorSetLayout result;
+          if (vkCreateDescriptorSetLayout(vk_device_, &descriptor_set_layout_create_info, 
+                                          nullptr, &result.vk_descriptor_set_layout) 
+                  != VK_SUCCESS) {
+            throw Exception("Could not create VkDescriptorSetLayout.");
+          }
+          result.bindings = resource_bindings;
+          return result;
+        }));
   }
 
-  VkGraphicsPipelineCreateInfo pipeline_create_info{};
-  pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipeline_create_info.stageCount = 2;
-  pipeline_create_info.pStages = shader_stages;
-  pipeline_create_info.pVertexInputState = &vert_input_state;
-  pipeline_create_info.pInputAssemblyState = &input_assembly_state;
-  pipeline_create_info.pViewportState = &viewport_state;
-  pipeline_create_info.pRasterizationState = &rasterization_state;
-  pipeline_create_info.pMultisampleState = &multisample_state;
-  pipeline_create_info.pDepthStencilState = nullptr;
-  pipeline_create_info.pColorBlendState = &color_blend_state;
-  pipeline_create_info.pDynamicState = nullptr;
-  pipeline_create_info.layout = vk_pipeline_layout_;
-  pipeline_create_info.renderPass = vk_render_pass_;
-  pipeline_create_info.subpass = 0;
-
-  if (vkCreateGraphicsPipelines(vk_device_, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
-                                &vk_pipeline_) != VK_SUCCESS) {
-    throw Exception("Could not create VkPipeline.");
+  std::vector<VkDescriptorSetLayout> vk_set_layouts;
+  for (const auto& layout : set_layouts) {
+    vk_set_layouts.push_back(layout->vk_descriptor_set_layout);
   }
 
-  const std::vector<VkImageView>& swapchain_image_views = 
-      builder.gal_platform_->GetSwapchainImageViews();
-
-  vk_framebuffers_.resize(swapchain_image_views.size());
-  for (size_t i = 0; i < swapchain_image_views.size(); ++i) {
-    VkImageView attachments[] = { swapchain_image_views[i] };
-
-    VkFramebufferCreateInfo framebuffer_create_info{};
-    framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebuffer_create_info.renderPass = vk_render_pass_;
-    framebuffer_create_info.attachmentCount = 1;
-    framebuffer_create_info.pAttachments = attachments;
-    framebuffer_create_info.width = swapchain_extent.width;
-    framebuffer_create_info.height = swapchain_extent.height;
-    framebuffer_create_info.layers = 1;
-
-    if (vkCreateFramebuffer(vk_device_, &framebuffer_create_info, nullptr, 
-                            &vk_framebuffers_[i]) != VK_SUCCESS) {
-      throw Exception("Could not create VkFramebuffer.");
+  GALStateKey pipeline_layout_key;
+  pipeline_layout_key.Add(vk_set_layouts).Add(push_constant_ranges);
+
+  std::shared_ptr<const GALPipelineRegistry::PipelineLayout> pipeline_layout = 
+      registry->GetOrCreatePipelineLayout(pipeline_layout_key, [&]() {
+        VkPipelineLayoutCreateInfo  pipeline_layout_create_info{};
+        pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipeline_layout_create_info.setLayoutCount = static_cast<uint32_t>(vk_set_layouts.size());
+        pipeline_layout_create_info.pSetLayouts = vk_set_layouts.data();
+        pipeline_layout_create_info.pushConstantRangeCount = 
+            static_cast<uint32_t>(push_constant_ranges.size());
+        pipeline_layout_create_info.pPushConstantRanges = push_constant_ranges.data();
+
+        GALPipelineRegistry::PipelineLayout result;
+        if (vkCreatePipelineLayout(vk_device_, &pipeline_layout_create_info, nullptr,
+                                   &result.vk_pipeline_layout) != VK_SUCCESS) {
+          throw Exception("Could not create VkPipelineLayout.");
+        }
+        result.set_layouts = set_layouts;
+        result.push_constant_ranges = push_constant_ranges;
+        return result;
+      });
+
+  VkRenderPass vk_render_pass = builder.gal_platform_->GetVkRenderPass();
+
+  // Any state that is added to the pipeline create info below must also be added to the key.
+  GALStateKey pipeline_key;
+  pipeline_key.Add(vert_shader_stage.module).Add(frag_shader_stage.module)
+      .Add(vert_binding_descs).Add(vert_attribute_descs)
+      .Add(input_assembly_state.topology)
+      .Add(depth_stencil_state.depthTestEnable).Add(depth_stencil_state.depthWriteEnable)
+      .Add(depth_stencil_state.depthCompareOp)
+      .Add(vk_render_pass).Add(pipeline_layout->vk_pipeline_layout);
+
+  pipeline_ = registry->GetOrCreatePipeline(pipeline_key, [&]() {
+    VkGraphicsPipelineCreateInfo pipeline_create_info{};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stageCount = has_frag_shader ? 2 : 1;
+    pipeline_create_info.pStages = shader_stages;
+    pipeline_create_info.pVertexInputState = &vert_input_state;
+    pipeline_create_info.pInputAssemblyState = &input_assembly_state;
+    pipeline_create_info.pViewportState = &viewport_state;
+    pipeline_create_info.pRasterizationState = &rasterization_state;
+    pipeline_create_info.pMultisampleState = &multisample_state;
+    pipeline_create_info.pDepthStencilState = &depth_stencil_state;
+    pipeline_create_info.pColorBlendState = &color_blend_state;
+    pipeline_create_info.pDynamicState = &dynamic_state;
+    pipeline_create_info.layout = pipeline_layout->vk_pipeline_layout;
+    pipeline_create_info.renderPass = vk_render_pass;
+    pipeline_create_info.subpass = 0;
+
+    GALPipelineCache* pipeline_cache = builder.gal_platform_->GetPipelineCache();
+
+    VkPipelineCreationFeedbackEXT creation_feedback{};
+    VkPipelineCreationFeedbackEXT stage_creation_feedbacks[2]{};
+
+    VkPipelineCreationFeedbackCreateInfoEXT creation_feedback_info{};
+    creation_feedback_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    creation_feedback_info.pPipelineCreationFeedback = &creation_feedback;
+    creation_feedback_info.pipelineStageCreationFeedbackCount = pipeline_create_info.stageCount;
+    creation_feedback_info.pPipelineStageCreationFeedbacks = stage_creation_feedbacks;
+
+    bool use_creation_feedback = 
+        pipeline_cache != nullptr && pipeline_cache->IsCreationFeedbackSupported();
+    if (use_creation_feedback) {
+      pipeline_create_info.pNext = &creation_feedback_info;
     }
-  }
-}
 
-GALPipeline::~GALPipeline() {
-  for (VkFramebuffer framebuffer : vk_framebuffers_) {
-    vkDestroyFramebuffer(vk_device_, framebuffer, nullptr);
-  }
+    auto create_start = std::chrono::steady_clock::now();
+
+    GALPipelineRegistry::Pipeline result;
+    if (vkCreateGraphicsPipelines(
+            vk_device_, 
+            pipeline_cache != nullptr ? pipeline_cache->GetVkPipelineCache() : VK_NULL_HANDLE, 
+            1, &pipeline_create_info, nullptr, &result.vk_pipeline) != VK_SUCCESS) {
+      throw Exception("Could not create VkPipeline.");
+    }
+
+    if (pipeline_cache != nullptr) {
+      pipeline_cache->RecordPipelineCreation(
+          std::chrono::steady_clock::now() - create_start,
+          use_creation_feedback ? &creation_feedback : nullptr);
+    }
 
-  vkDestroyPipeline(vk_device_, vk_pipeline_, nullptr);
-  vkDestroyRenderPass(vk_device_, vk_render_pass_, nullptr);
-  vkDestroyPipelineLayout(vk_device_, vk_pipeline_layout_, nullptr);
-  vkDestroyDescriptorSetLayout(vk_device_, vk_descriptor_set_layout_, nullptr);
+    result.layout = pipeline_layout;
+    return result;
+  });
 }
 
 GALPipeline::Builder& GALPipeline::Builder::SetShader(ShaderType type, const GALShader& shader) {
@@ -262,11 +475,6 @@ GALPipeline::Builder& GALPipeline::Builder::SetShader(ShaderType type, const GAL
   return *this;
 }
 
-GALPipeline::Builder& GALPipeline::Builder::SetViewport(const Viewport& viewport) {
-  viewport_ = viewport;
-  return *this;
-}
-
 GALPipeline::Builder& GALPipeline::Builder::AddVertexInput(const VertexInput& vert_input) {
   vert_inputs_.push_back(vert_input);
   return *this;
@@ -282,6 +490,49 @@ GALPipeline::Builder& GALPipeline::Builder::AddUniformDesc(const UniformDesc& un
   return *this;
 }
 
+GALPipeline::Builder& GALPipeline::Builder::AddUniformBufferDesc(
+    const UniformDesc& uniform_desc) {
+  uniform_buffer_descs_.push_back(uniform_desc);
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::AddStorageBufferDesc(
+    const UniformDesc& storage_desc) {
+  storage_buffer_descs_.push_back(storage_desc);
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::AddTextureDesc(const TextureDesc& texture_desc) {
+  texture_descs_.push_back(texture_desc);
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::AddPushConstantDesc(
+    const PushConstantDesc& push_constant_desc) {
+  push_constant_descs_.push_back(push_constant_desc);
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::SetBindless(bool enabled) {
+  bindless_ = enabled;
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::SetDepthTest(bool enabled) {
+  depth_test_ = enabled;
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::SetDepthWrite(bool enabled) {
+  depth_write_ = enabled;
+  return *this;
+}
+
+GALPipeline::Builder& GALPipeline::Builder::SetDepthCompareOp(CompareOp compare_op) {
+  depth_compare_op_ = compare_op;
+  return *this;
+}
+
 std::unique_ptr<GALPipeline> GALPipeline::Builder::Create() {
   return std::make_unique<GALPipeline>(*this);
 }
@@ -5,48 +5,101 @@
 
 #include <memory>
 #include <vector>
+#include "gal/gal_pipeline_registry.h"
 #include "gal/gal_platform.h"
 #include "gal/gal_shader.h"
 
 namespace gal {
 
+// The Vulkan objects behind a GALPipeline are shared with every other GALPipeline built from
+// the same state, through the platform's GALPipelineRegistry.
+//
+// Pipelines render into the platform's render pass. The viewport and scissor are dynamic state,
+// set with command::SetViewport, so they survive the swapchain being recreated.
+//
+// The depth test is enabled by default, with depth writes and VK_COMPARE_OP_LESS. A pipeline
+// without a fragment shader only writes depth, e.g. for a depth prepass that later pipelines
+// test against with CompareOp::Equal and depth writes disabled.
 class GALPipeline {
 // Forward declaration
 class Builder;
 
 public:
+  // Set 0 holds the uniforms that are written with command::SetUniformData. Set 1 holds the
+  // buffers and textures that are bound with command::BindUniformBuffer,
+  // command::BindStorageBuffer and command::BindTexture, and shaders must declare those with
+  // "set = 1". Bindless pipelines have neither, and set 0 is the GALBindlessTable's set.
+  static constexpr uint32_t kUniformSetIndex = 0;
+  static constexpr uint32_t kResourceSetIndex = 1;
+
+  // Push constant ranges must end within this, which is the smallest maxPushConstantsSize that
+  // Vulkan allows, so that the same ranges work on every device.
+  static constexpr uint32_t kMaxPushConstantsSize = 128;
+
   GALPipeline(Builder& builder);
-  ~GALPipeline();
 
   static Builder BeginBuild(GALPlatform* gal_platform) {
     return Builder(gal_platform);
   }
 
-  VkRenderPass GetVkRenderPass() { return vk_render_pass_; }
-  const std::vector<VkFramebuffer>& GetVkFramebuffers() { return vk_framebuffers_; }
-  VkPipeline GetVkPipeline() { return vk_pipeline_; }
+  VkPipelineLayout GetVkPipelineLayout() { return pipeline_->layout->vk_pipeline_layout; }
+  VkPipeline GetVkPipeline() { return pipeline_->vk_pipeline; }
+
+  // Set with Builder::SetBindless(). The set is bound at kUniformSetIndex.
+  bool IsBindless() const { return vk_bindless_descriptor_set_ != VK_NULL_HANDLE; }
+  VkDescriptorSet GetVkBindlessDescriptorSet() { return vk_bindless_descriptor_set_; }
+
+  // Null if the pipeline has no uniforms. Bound with one dynamic offset per uniform binding, in
+  // the order of GetUniformBindings().
+  VkDescriptorSet GetVkUniformDescriptorSet() {
+    return pipeline_->layout->set_layouts[0]->vk_uniform_descriptor_set;
+  }
+  const std::vector<uint32_t>& GetUniformBindings() {
+    return pipeline_->layout->set_layouts[0]->uniform_bindings;
+  }
+
+  // One range per set of stages that read the same bytes, in ascending order of offset.
+  const std::vector<VkPushConstantRange>& GetPushConstantRanges() {
+    return pipeline_->layout->push_constant_ranges;
+  }
+
+  // Null if the pipeline has no buffer or texture resources.
+  const GALPipelineRegistry::DescriptorSetLayout* GetResourceSetLayout() {
+    const auto& set_layouts = pipeline_->layout->set_layouts;
+    return set_layouts.size() > kResourceSetIndex ? set_layouts[kResourceSetIndex].get() 
+                                                  : nullptr;
+  }
 
 private:
-  VkDescriptorSetLayout vk_descriptor_set_layout_;
-  VkPipelineLayout vk_pipeline_layout_;
-  VkRenderPass vk_render_pass_;
-  VkPipeline vk_pipeline_;
+  std::shared_ptr<const GALPipelineRegistry::Pipeline> pipeline_;
 
-  std::vector<VkFramebuffer> vk_framebuffers_;
+  VkDescriptorSet vk_bindless_descriptor_set_ = VK_NULL_HANDLE;
 
   VkDevice vk_device_;
 
 public:
-  struct Viewport {
-    float x = 0.f;
-    float y = 0.f;
-    float width = 0.f;
-    float height = 0.f;
+  enum class InputRate {
+    PerVertex,
+
+    // Advances once per instance, e.g. for instance data written with command::SetInstanceData.
+    PerInstance
+  };
+
+  enum class CompareOp {
+    Never,
+    Less,
+    Equal,
+    LessOrEqual,
+    Greater,
+    NotEqual,
+    GreaterOrEqual,
+    Always
   };
 
   struct VertexInput {
     int buffer_idx = 0;
     int stride = 0;
+    InputRate input_rate = InputRate::PerVertex;
   };
 
   struct VertexDesc {
@@ -61,6 +114,20 @@ public:
     ShaderType shader_stage = ShaderType::Invalid;
   };
 
+  struct TextureDesc {
+    int shader_idx = 0;
+    ShaderType shader_stage = ShaderType::Invalid;
+  };
+
+  // Bytes offset to offset + size of the push constants, read by shader_stage. Both must be
+  // multiples of 4. A stage can only read one range, and ranges that several stages read are
+  // declared once per stage.
+  struct PushConstantDesc {
+    ShaderType shader_stage = ShaderType::Invalid;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+  };
+
   class Builder {
   friend class GALPipeline;
 
@@ -68,10 +135,28 @@ public:
     Builder(GALPlatform* gal_platform) : gal_platform_(gal_platform) {}
 
     Builder& SetShader(ShaderType type, const GALShader& shader);
-    Builder& SetViewport(const Viewport& viewport);
     Builder& AddVertexInput(const VertexInput& vert_input);
     Builder& AddVertexDesc(const VertexDesc& vert_desc);
+    // Uniforms in set 0, written with command::SetUniformData.
     Builder& AddUniformDesc(const UniformDesc& uniform_desc);
+
+    // Resources in set 1.
+    Builder& AddUniformBufferDesc(const UniformDesc& uniform_desc);
+    // Read-only in the graphics stages, e.g. data written by a GALComputePipeline.
+    Builder& AddStorageBufferDesc(const UniformDesc& storage_desc);
+    Builder& AddTextureDesc(const TextureDesc& texture_desc);
+
+    // Written with command::PushConstants.
+    Builder& AddPushConstantDesc(const PushConstantDesc& push_constant_desc);
+
+    // Reads every texture and storage buffer through the platform's GALBindlessTable in set 0,
+    // with slots passed in push constants. Cannot be combined with uniform or resource
+    // descriptions, and throws if GALPlatform::GetBindlessTable() is null.
+    Builder& SetBindless(bool enabled);
+
+    Builder& SetDepthTest(bool enabled);
+    Builder& SetDepthWrite(bool enabled);
+    Builder& SetDepthCompareOp(CompareOp compare_op);
     
     std::unique_ptr<GALPipeline> Create();
 
@@ -81,11 +166,18 @@ public:
     GALShader vert_shader_;
     GALShader frag_shader_;
 
-    Viewport viewport_;
-
     std::vector<VertexInput> vert_inputs_;
     std::vector<VertexDesc> vert_descs_;
     std::vector<UniformDesc> uniform_descs_;
+    std::vector<UniformDesc> uniform_buffer_descs_;
+    std::vector<UniformDesc> storage_buffer_descs_;
+    std::vector<TextureDesc> texture_descs_;
+    std::vector<PushConstantDesc> push_constant_descs_;
+    bool bindless_ = false;
+
+    bool depth_test_ = true;
+    bool depth_write_ = true;
+    CompareOp depth_compare_op_ = CompareOp::Less;
   };
 };
 
@@ -0,0 +1,165 @@
+#include "gal/gal_pipeline_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+GALPipelineCache::GALPipelineCache(VkPhysicalDevice vk_physical_device, VkDevice vk_device,
+                                   const std::string& path, bool creation_feedback_supported)
+    : vk_device_(vk_device), path_(path), 
+      creation_feedback_supported_(creation_feedback_supported) {
+  vkGetPhysicalDeviceProperties(vk_physical_device, &device_props_);
+
+  auto load_start = std::chrono::steady_clock::now();
+
+  std::vector<uint8_t> initial_data = ReadValidatedFile();
+
+  VkPipelineCacheCreateInfo cache_create_info{};
+  cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_create_info.initialDataSize = initial_data.size();
+  cache_create_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+
+  VkResult result = vkCreatePipelineCache(vk_device_, &cache_create_info, nullptr, 
+                                          &vk_pipeline_cache_);
+  if (result != VK_SUCCESS && !initial_data.empty()) {
+    // The driver is allowed to reject data that passed the header checks. Start empty instead.
+    std::cerr << "Pipeline cache data in " << path_ << " was rejected." << std::endl;
+
+    initial_data.clear();
+    cache_create_info.initialDataSize = 0;
+    cache_create_info.pInitialData = nullptr;
+
+    result = vkCreatePipelineCache(vk_device_, &cache_create_info, nullptr, 
+                                   &vk_pipeline_cache_);
+  }
+  if (result != VK_SUCCESS) {
+    throw Exception("Could not create VkPipelineCache.");
+  }
+
+  stats_.loaded_from_file = !initial_data.empty();
+  stats_.loaded_bytes = initial_data.size();
+  stats_.load_time = std::chrono::steady_clock::now() - load_start;
+}
+
+GALPipelineCache::~GALPipelineCache() {
+  Save();
+
+  vkDestroyPipelineCache(vk_device_, vk_pipeline_cache_, nullptr);
+}
+
+bool GALPipelineCache::Save() {
+  size_t data_size = 0;
+  if (vkGetPipelineCacheData(vk_device_, vk_pipeline_cache_, &data_size, nullptr) 
+          != VK_SUCCESS) {
+    std::cerr << "Could not get pipeline cache data size." << std::endl;
+    return false;
+  }
+
+  std::vector<uint8_t> data(data_size);
+  if (vkGetPipelineCacheData(vk_device_, vk_pipeline_cache_, &data_size, data.data()) 
+          != VK_SUCCESS) {
+    std::cerr << "Could not get pipeline cache data." << std::endl;
+    return false;
+  }
+  data.resize(data_size);
+
+  std::string temp_path = path_ + ".tmp";
+
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      std::cerr << "Could not open " << temp_path << " for writing." << std::endl;
+      return false;
+    }
+
+    // Closing flushes the buffered data, which can fail too, e.g. when the disk is full. A
+    // truncated cache must not replace the old one.
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+    if (file.fail()) {
+      std::cerr << "Could not write " << temp_path << "." << std::endl;
+      std::error_code error;
+      std::filesystem::remove(temp_path, error);
+      return false;
+    }
+  }
+
+  // Replaces the old file in one step, so that readers see either the old or the new cache.
+  std::error_code error;
+  std::filesystem::rename(temp_path, path_, error);
+  if (error) {
+    std::cerr << "Could not replace " << path_ << ": " << error.message() << std::endl;
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+
+  return true;
+}
+
+void GALPipelineCache::RecordPipelineCreation(std::chrono::nanoseconds duration, 
+                                              const VkPipelineCreationFeedbackEXT* feedback) {
+  if (feedback == nullptr || !(feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) {
+    ++stats_.unknown_count;
+    stats_.unknown_time += duration;
+  } else if (feedback->flags & 
+             VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+    ++stats_.hit_count;
+    stats_.hit_time += duration;
+  } else {
+    ++stats_.miss_count;
+    stats_.miss_time += duration;
+  }
+}
+
+std::vector<uint8_t> GALPipelineCache::ReadValidatedFile() {
+  std::ifstream file(path_, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+
+  size_t file_size = static_cast<size_t>(file.tellg());
+  file.seekg(0);
+
+  if (file_size < sizeof(VkPipelineCacheHeaderVersionOne)) {
+    std::cerr << "Pipeline cache " << path_ << " is truncated. Ignoring it." << std::endl;
+    return {};
+  }
+
+  std::vector<uint8_t> data(file_size);
+  file.read(reinterpret_cast<char*>(data.data()), file_size);
+  if (!file.good()) {
+    std::cerr << "Could not read pipeline cache " << path_ << "." << std::endl;
+    return {};
+  }
+
+  VkPipelineCacheHeaderVersionOne header;
+  memcpy(&header, data.data(), sizeof(header));
+
+  if (header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || 
+      header.headerSize > file_size ||
+      header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+    std::cerr << "Pipeline cache " << path_ << " has an invalid header. Ignoring it." 
+              << std::endl;
+    return {};
+  }
+
+  if (header.vendorID != device_props_.vendorID || 
+      header.deviceID != device_props_.deviceID ||
+      memcmp(header.pipelineCacheUUID, device_props_.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    std::cerr << "Pipeline cache " << path_ << " is for a different device or driver. "
+              << "Ignoring it." << std::endl;
+    return {};
+  }
+
+  return data;
+}
+
+} // namespace gal
\ No newline at end of file
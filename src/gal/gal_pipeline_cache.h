@@ -0,0 +1,75 @@
+#ifndef GAL_GAL_PIPELINE_CACHE_H_
+#define GAL_GAL_PIPELINE_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gal {
+
+// A VkPipelineCache that persists to a file between runs.
+//
+// The file is only used if its header matches the device's vendor ID, device ID and
+// pipelineCacheUUID, since data from another driver or device is useless at best. Saving writes
+// to a temporary file which then replaces the old one, so an interrupted save never leaves a
+// truncated cache behind.
+class GALPipelineCache {
+public:
+  struct Stats {
+    bool loaded_from_file = false;
+    size_t loaded_bytes = 0;
+    std::chrono::nanoseconds load_time{0};
+
+    // Hits and misses are only known if VK_EXT_pipeline_creation_feedback is supported.
+    // Otherwise every creation is counted as unknown.
+    uint32_t hit_count = 0;
+    uint32_t miss_count = 0;
+    uint32_t unknown_count = 0;
+
+    std::chrono::nanoseconds hit_time{0};
+    std::chrono::nanoseconds miss_time{0};
+    std::chrono::nanoseconds unknown_time{0};
+  };
+
+  GALPipelineCache(VkPhysicalDevice vk_physical_device, VkDevice vk_device, 
+                   const std::string& path, bool creation_feedback_supported);
+
+  // Saves the cache.
+  ~GALPipelineCache();
+
+  bool Save();
+
+  VkPipelineCache GetVkPipelineCache() { return vk_pipeline_cache_; }
+
+  // If true, pipelines should chain a VkPipelineCreationFeedbackCreateInfoEXT and pass its
+  // result to RecordPipelineCreation().
+  bool IsCreationFeedbackSupported() const { return creation_feedback_supported_; }
+
+  // feedback may be null, in which case the creation is counted as unknown.
+  void RecordPipelineCreation(std::chrono::nanoseconds duration, 
+                              const VkPipelineCreationFeedbackEXT* feedback);
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  // Returns an empty vector if the file is missing or was written for a different device.
+  std::vector<uint8_t> ReadValidatedFile();
+
+private:
+  VkDevice vk_device_;
+  VkPhysicalDeviceProperties device_props_;
+
+  std::string path_;
+  bool creation_feedback_supported_;
+
+  VkPipelineCache vk_pipeline_cache_;
+
+  Stats stats_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_PIPELINE_CACHE_H_
\ No newline at end of file
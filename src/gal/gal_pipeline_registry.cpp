@@ -0,0 +1,86 @@
+#include "gal/gal_pipeline_registry.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace gal {
+
+size_t GALStateKey::Hash() const {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (uint8_t byte : bytes_) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+template<typename T>
+std::shared_ptr<const T> GALPipelineRegistry::GetOrCreate(
+    Cache<T>& cache, CacheStats& stats, const GALStateKey& key, 
+    const std::function<T()>& create, const std::function<void(const T&)>& destroy) {
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    if (std::shared_ptr<const T> object = it->second.lock()) {
+      ++stats.reused;
+      return object;
+    }
+  }
+
+  // Entries whose objects have been destroyed are left behind by the deleter, since it cannot
+  // safely touch the cache. Drop them here, while the cache is being modified anyway.
+  for (auto entry_it = cache.begin(); entry_it != cache.end();) {
+    if (entry_it->second.expired()) {
+      entry_it = cache.erase(entry_it);
+    } else {
+      ++entry_it;
+    }
+  }
+
+  std::shared_ptr<const T> object(new T(create()), [destroy](const T* object) {
+    destroy(*object);
+    delete object;
+  });
+
+  cache[key] = object;
+  ++stats.created;
+
+  return object;
+}
+
+std::shared_ptr<const GALPipelineRegistry::DescriptorSetLayout> 
+    GALPipelineRegistry::GetOrCreateDescriptorSetLayout(
+        const GALStateKey& key, const std::function<DescriptorSetLayout()>& create) {
+  VkDevice vk_device = vk_device_;
+  return GetOrCreate<DescriptorSetLayout>(descriptor_set_layouts_, 
+                                          stats_.descriptor_set_layouts, key, create,
+      [vk_device](const DescriptorSetLayout& set_layout) {
+        if (set_layout.vk_uniform_descriptor_set != VK_NULL_HANDLE) {
+          vkFreeDescriptorSets(vk_device, set_layout.vk_descriptor_pool, 1, 
+                               &set_layout.vk_uniform_descriptor_set);
+        }
+        vkDestroyDescriptorSetLayout(vk_device, set_layout.vk_descriptor_set_layout, nullptr);
+      });
+}
+
+std::shared_ptr<const GALPipelineRegistry::PipelineLayout> 
+    GALPipelineRegistry::GetOrCreatePipelineLayout(
+        const GALStateKey& key, const std::function<PipelineLayout()>& create) {
+  VkDevice vk_device = vk_device_;
+  return GetOrCreate<PipelineLayout>(pipeline_layouts_, stats_.pipeline_layouts, key, create,
+      [vk_device](const PipelineLayout& layout) {
+        vkDestroyPipelineLayout(vk_device, layout.vk_pipeline_layout, nullptr);
+      });
+}
+
+std::shared_ptr<const GALPipelineRegistry::Pipeline> GALPipelineRegistry::GetOrCreatePipeline(
+    const GALStateKey& key, const std::function<Pipeline()>& create) {
+  VkDevice vk_device = vk_device_;
+  return GetOrCreate<Pipeline>(pipelines_, stats_.pipelines, key, create,
+      [vk_device](const Pipeline& pipeline) {
+        vkDestroyPipeline(vk_device, pipeline.vk_pipeline, nullptr);
+      });
+}
+
+} // namespace gal
\ No newline at end of file
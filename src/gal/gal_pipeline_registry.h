@@ -0,0 +1,141 @@
+#ifndef GAL_GAL_PIPELINE_REGISTRY_H_
+#define GAL_GAL_PIPELINE_REGISTRY_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace gal {
+
+// Canonical byte encoding of the state that an object is created from. Two keys are equal only
+// if every byte matches, so hash collisions cannot alias different objects.
+class GALStateKey {
+public:
+  // T must not contain padding or pointers to other state, since those would make equal states
+  // compare unequal. Vulkan handles are fine, since they are compared by identity.
+  template<typename T>
+  GALStateKey& Add(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>, "State must be trivially copyable.");
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    bytes_.insert(bytes_.end(), bytes, bytes + sizeof(T));
+    return *this;
+  }
+
+  template<typename T>
+  GALStateKey& Add(const std::vector<T>& values) {
+    Add(static_cast<uint64_t>(values.size()));
+    for (const T& value : values) {
+      Add(value);
+    }
+    return *this;
+  }
+
+  // Keeps the capacity, so that a key can be rebuilt for every lookup without allocating.
+  void Clear() { bytes_.clear(); }
+
+  bool operator==(const GALStateKey& other) const { return bytes_ == other.bytes_; }
+
+  size_t Hash() const;
+
+private:
+  std::vector<uint8_t> bytes_;
+};
+
+// Deduplicates the objects that pipelines are made of. Each kind of object is looked up by the
+// GALStateKey it was created from, and handed out as a shared, reference-counted object that is
+// destroyed once its last user releases it.
+//
+// Layouts are cached separately from the pipelines, since many pipelines share them. A cached
+// object keeps the objects it was created from alive, so a pipeline's key can safely include its
+// layout handles. The render pass is owned by GALPlatform, and outlives every pipeline.
+//
+// Not thread-safe.
+class GALPipelineRegistry {
+public:
+  struct DescriptorSetLayout {
+    VkDescriptorSetLayout vk_descriptor_set_layout;
+
+    // In ascending order of binding number. pImmutableSamplers is always null.
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+    // Binding numbers of the layout's dynamic uniform buffers, in ascending order, which is also
+    // the order of their dynamic offsets.
+    std::vector<uint32_t> uniform_bindings;
+
+    // Points every uniform binding at the platform's GALUniformRing. Null if there are no
+    // uniform bindings. Freed back to vk_descriptor_pool with the layout.
+    VkDescriptorSet vk_uniform_descriptor_set = VK_NULL_HANDLE;
+    VkDescriptorPool vk_descriptor_pool = VK_NULL_HANDLE;
+  };
+
+  struct PipelineLayout {
+    VkPipelineLayout vk_pipeline_layout;
+    std::vector<std::shared_ptr<const DescriptorSetLayout>> set_layouts;
+
+    // In ascending order of offset.
+    std::vector<VkPushConstantRange> push_constant_ranges;
+  };
+
+  struct Pipeline {
+    VkPipeline vk_pipeline;
+
+    std::shared_ptr<const PipelineLayout> layout;
+  };
+
+  struct CacheStats {
+    uint32_t created = 0;
+    uint32_t reused = 0;
+  };
+
+  struct Stats {
+    CacheStats descriptor_set_layouts;
+    CacheStats pipeline_layouts;
+    CacheStats pipelines;
+  };
+
+  GALPipelineRegistry(VkDevice vk_device) : vk_device_(vk_device) {}
+
+  // Each of these returns the live object created from an equal key, or calls create to make a
+  // new one. create may throw, in which case nothing is cached.
+  std::shared_ptr<const DescriptorSetLayout> GetOrCreateDescriptorSetLayout(
+      const GALStateKey& key, const std::function<DescriptorSetLayout()>& create);
+  std::shared_ptr<const PipelineLayout> GetOrCreatePipelineLayout(
+      const GALStateKey& key, const std::function<PipelineLayout()>& create);
+  std::shared_ptr<const Pipeline> GetOrCreatePipeline(
+      const GALStateKey& key, const std::function<Pipeline()>& create);
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct KeyHash {
+    size_t operator()(const GALStateKey& key) const { return key.Hash(); }
+  };
+
+  template<typename T>
+  using Cache = std::unordered_map<GALStateKey, std::weak_ptr<const T>, KeyHash>;
+
+  template<typename T>
+  std::shared_ptr<const T> GetOrCreate(Cache<T>& cache, CacheStats& stats, 
+                                       const GALStateKey& key, 
+                                       const std::function<T()>& create,
+                                       const std::function<void(const T&)>& destroy);
+
+private:
+  VkDevice vk_device_;
+
+  Cache<DescriptorSetLayout> descriptor_set_layouts_;
+  Cache<PipelineLayout> pipeline_layouts_;
+  Cache<Pipeline> pipelines_;
+
+  Stats stats_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_PIPELINE_REGISTRY_H_
\ No newline at end of file
@@ -1,13 +1,25 @@
 #include "gal/gal_platform.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
+#include "gal/gal_bindless_table.h"
 #include "gal/gal_command_buffer.h"
+#include "gal/gal_descriptor_cache.h"
 #include "gal/gal_exception.h"
+#include "gal/gal_pipeline_cache.h"
+#include "gal/gal_pipeline_registry.h"
+#include "gal/gal_profiler.h"
+#include "gal/gal_uniform_ring.h"
+#include "gal/gal_upload_manager.h"
+#include "gal/gal_worker_pool.h"
 #include "window/window.h"
 
 namespace gal {
@@ -24,24 +36,242 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
   return VK_FALSE;
 }
 
-const int kMaxFramesInFlight = 2;
+// Bounds how long frame pacing can sleep for, e.g. after a hitch inflated its estimate.
+constexpr std::chrono::milliseconds kMaxPacingDelay(100);
+
+// Each new measurement moves the frame pacing estimates by 1/kPacingSmoothing of the difference.
+constexpr int kPacingSmoothing = 8;
+
+VkPresentModeKHR GetVkPresentMode(GALPlatform::PresentMode present_mode) {
+  switch (present_mode) {
+  case GALPlatform::PresentMode::Immediate:
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  case GALPlatform::PresentMode::Mailbox:
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  case GALPlatform::PresentMode::FifoRelaxed:
+    return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+  default:
+    return VK_PRESENT_MODE_FIFO_KHR;
+  }
+}
+
+const VkFormat kOffscreenImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+bool IsLayerAvailable(const char* layer_name) {
+  uint32_t layers_count = 0;
+  vkEnumerateInstanceLayerProperties(&layers_count, nullptr);
+
+  std::vector<VkLayerProperties> layers(layers_count);
+  vkEnumerateInstanceLayerProperties(&layers_count, layers.data());
+
+  return std::find_if(layers.begin(), layers.end(),
+      [layer_name](const VkLayerProperties& props) {
+        return strcmp(props.layerName, layer_name) == 0;
+      }) != layers.end();
+}
+
+bool IsInstanceExtensionAvailable(const char* extension_name) {
+  uint32_t extensions_count = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensions_count, nullptr);
+
+  std::vector<VkExtensionProperties> extensions(extensions_count);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensions_count, extensions.data());
+
+  return std::find_if(extensions.begin(), extensions.end(),
+      [extension_name](const VkExtensionProperties& props) {
+        return strcmp(props.extensionName, extension_name) == 0;
+      }) != extensions.end();
+}
+
+// Lower is better. Software rasterizers (e.g. lavapipe) are accepted, but only picked when no
+// hardware device is suitable.
+int GetDeviceTypeRank(VkPhysicalDeviceType device_type) {
+  switch (device_type) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    return 0;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    return 1;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    return 2;
+  case VK_PHYSICAL_DEVICE_TYPE_CPU:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+bool HasStencilComponent(VkFormat format) {
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D16_UNORM_S8_UINT;
+}
 
 } // namespace
 
-GALPlatform::GALPlatform(window::Window* window) {
+GALPlatform::Options GALPlatform::Options::LowLatency() {
+  Options options;
+  options.frames_in_flight = 2;
+  options.present_mode = PresentMode::Mailbox;
+  options.extra_swapchain_images = 0;
+  options.frame_pacing = true;
+  return options;
+}
+
+GALPlatform::Options GALPlatform::Options::Throughput() {
+  Options options;
+  options.frames_in_flight = 3;
+  options.present_mode = PresentMode::Immediate;
+  options.extra_swapchain_images = 2;
+  options.frame_pacing = false;
+  options.validation = false;
+  return options;
+}
+
+GALPlatform::GALPlatform(window::Window* window, const Options& options) : options_(options) {
   if (window == nullptr) {
     throw Exception("window parameter cannot be nullptr.");
   }
+  if (options.frames_in_flight == 0) {
+    throw Exception("frames_in_flight must be at least 1.");
+  }
+  if (options.frame_pacing && options.frames_in_flight < 2) {
+    throw Exception("frame_pacing needs frames_in_flight of at least 2.");
+  }
   window_ = window;
 
+  CreateInstance();
+
+  vk_surface_ = window->CreateVkSurface(vk_instance_);
+
+  CreateDevice();
+
+  vk_surface_format_ = ChooseSurfaceFormat();
+  CreateSwapchain();
+
+  vk_depth_format_ = ChooseDepthFormat();
+  CreateRenderPass();
+  CreateDepthImages();
+  CreateFramebuffers();
+  CreateCommandPoolAndSyncObjects();
+}
+
+GALPlatform::GALPlatform(uint32_t width, uint32_t height, const Options& options)
+    : options_(options) {
+  if (width == 0 || height == 0) {
+    throw Exception("Headless image dimensions cannot be zero.");
+  }
+  if (options.frames_in_flight == 0) {
+    throw Exception("frames_in_flight must be at least 1.");
+  }
+  if (options.frame_pacing && options.frames_in_flight < 2) {
+    throw Exception("frame_pacing needs frames_in_flight of at least 2.");
+  }
+
+  CreateInstance();
+  CreateDevice();
+  CreateOffscreenImages(width, height);
+
+  vk_depth_format_ = ChooseDepthFormat();
+  CreateRenderPass();
+  CreateDepthImages();
+  CreateFramebuffers();
+  CreateCommandPoolAndSyncObjects();
+}
+
+GALPlatform::~GALPlatform() {
+  // TODO(colintan): Should this be here?
+  vkDeviceWaitIdle(vk_device_);
+
+  worker_pool_.reset();
+  profiler_.reset();
+  pipeline_cache_.reset();
+
+  // Objects handed out by the registry destroy themselves, so this only drops the lookup tables.
+  pipeline_registry_.reset();
+
+  for (VkFence fence : vk_in_flight_fences_) {
+    vkDestroyFence(vk_device_, fence, nullptr);
+  }
+  for (VkSemaphore semaphore : vk_render_finished_semaphores_) {
+    vkDestroySemaphore(vk_device_, semaphore, nullptr);
+  }
+  for (VkSemaphore semaphore : vk_image_available_semaphores_) {
+    vkDestroySemaphore(vk_device_, semaphore, nullptr);
+  }
+
+  for (VkCommandPool command_pool : vk_frame_command_pools_) {
+    vkDestroyCommandPool(vk_device_, command_pool, nullptr);
+  }
+  vkDestroyCommandPool(vk_device_, vk_command_pool_, nullptr);
+
+  for (VkFramebuffer framebuffer : vk_framebuffers_) {
+    vkDestroyFramebuffer(vk_device_, framebuffer, nullptr);
+  }
+  vkDestroyRenderPass(vk_device_, vk_render_pass_, nullptr);
+
+  DestroyDepthImages();
+
+  for (VkImageView image_view : vk_swapchain_image_views_) {
+    vkDestroyImageView(vk_device_, image_view, nullptr);
+  }
+
+  if (IsHeadless()) {
+    // The offscreen images are owned by the platform, unlike the swapchain images.
+    for (VkImage image : vk_swapchain_images_) {
+      vkDestroyImage(vk_device_, image, nullptr);
+    }
+    for (const GALMemoryAllocator::Allocation& allocation : offscreen_image_allocations_) {
+      memory_allocator_->Free(allocation);
+    }
+  } else {
+    vkDestroySwapchainKHR(vk_device_, vk_swapchain_, nullptr);
+  }
+
+  bindless_table_.reset();
+  descriptor_cache_.reset();
+  uniform_ring_.reset();
+  upload_manager_.reset();
+  memory_allocator_.reset();
+
+  vkDestroyDevice(vk_device_, nullptr);
+
+  if (vk_surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(vk_instance_, vk_surface_, nullptr);
+  }
+
+  if (vk_debug_messenger_ != VK_NULL_HANDLE) {
+    auto destroy_debug_utils_messenger_func = 
+        (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(vk_instance_, 
+            "vkDestroyDebugUtilsMessengerEXT");
+    if (destroy_debug_utils_messenger_func != nullptr) {
+      destroy_debug_utils_messenger_func(vk_instance_, vk_debug_messenger_, nullptr);
+    }
+  }
+
+  vkDestroyInstance(vk_instance_, nullptr);
+}
+
+void GALPlatform::CreateInstance() {
   VkApplicationInfo app_info = {};
   app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
   app_info.apiVersion = VK_MAKE_VERSION(1, 0, 0);
 
+  // Descriptor indexing is queried with vkGetPhysicalDeviceFeatures2(), which needs Vulkan 1.1,
+  // and is core in Vulkan 1.2. vkEnumerateInstanceVersion() is missing from 1.0 loaders.
+  if (options_.bindless) {
+    auto enumerate_instance_version_func = 
+        (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, 
+            "vkEnumerateInstanceVersion");
+    uint32_t loader_version = VK_API_VERSION_1_0;
+    if (enumerate_instance_version_func != nullptr) {
+      enumerate_instance_version_func(&loader_version);
+    }
+    app_info.apiVersion = std::min(loader_version, VK_API_VERSION_1_2);
+  }
+  instance_api_version_ = app_info.apiVersion;
+
   VkDebugUtilsMessengerCreateInfoEXT debug_create_info= {};
   debug_create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
   debug_create_info.messageSeverity = 
-      VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | 
       VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | 
       VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
   debug_create_info.messageType =
@@ -50,21 +280,35 @@ GALPlatform::GALPlatform(window::Window* window) {
       VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
   debug_create_info.pfnUserCallback = debugCallback;
 
-  uint32_t glfw_extension_count = 0;
-  const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+  std::vector<const char*> extensions;
+  if (!IsHeadless()) {
+    uint32_t glfw_extension_count = 0;
+    const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+  }
 
-  std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
-  extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  // Headless machines (e.g. CI with only a software driver) often do not have the validation
+  // layers or the debug utils extension installed, so these are only enabled when available.
+  bool enable_debug_utils = 
+      options_.validation && IsInstanceExtensionAvailable(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  if (enable_debug_utils) {
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  }
 
-  std::vector<const char*> validation_layers;
-  validation_layers.push_back("VK_LAYER_KHRONOS_validation");
+  if (options_.validation) {
+    if (IsLayerAvailable("VK_LAYER_KHRONOS_validation")) {
+      validation_layers_.push_back("VK_LAYER_KHRONOS_validation");
+    } else {
+      std::cerr << "VK_LAYER_KHRONOS_validation is not available." << std::endl;
+    }
+  }
 
   VkInstanceCreateInfo instance_create_info = {};
   instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-  instance_create_info.pNext = &debug_create_info;
+  instance_create_info.pNext = enable_debug_utils ? &debug_create_info : nullptr;
   instance_create_info.pApplicationInfo = &app_info;
-  instance_create_info.enabledLayerCount = validation_layers.size();
-  instance_create_info.ppEnabledLayerNames = validation_layers.data();
+  instance_create_info.enabledLayerCount = validation_layers_.size();
+  instance_create_info.ppEnabledLayerNames = validation_layers_.data();
   instance_create_info.enabledExtensionCount = extensions.size();
   instance_create_info.ppEnabledExtensionNames = extensions.data();
 
@@ -72,6 +316,10 @@ GALPlatform::GALPlatform(window::Window* window) {
     throw Exception("Could not create VkInstance.");
   }
 
+  if (!enable_debug_utils) {
+    return;
+  }
+
   auto create_debug_utils_messenger_func = 
       (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(
             vk_instance_, "vkCreateDebugUtilsMessengerEXT");
@@ -82,41 +330,100 @@ GALPlatform::GALPlatform(window::Window* window) {
         vk_instance_, &debug_create_info, nullptr, &vk_debug_messenger_) != VK_SUCCESS) {
     throw Exception("Could not create debug utils messenger.");
   }
+}
 
-  vk_surface_ = window->CreateVkSurface(vk_instance_);
-
+void GALPlatform::CreateDevice() {
   std::optional<PhysicalDeviceInfo> physical_device_info = ChoosePhysicalDevice();
   if (!physical_device_info.has_value()) {
     throw Exception("Could not find a suitable physical device.");
   }
 
-  uint32_t graphics_queue_family_index = physical_device_info.value().graphics_queue_family_index;
-  uint32_t present_queue_family_index = physical_device_info.value().present_queue_family_index;
+  graphics_queue_family_index_ = physical_device_info.value().graphics_queue_family_index;
+  present_queue_family_index_ = physical_device_info.value().present_queue_family_index;
+  transfer_queue_family_index_ = physical_device_info.value().transfer_queue_family_index;
 
   std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-  std::unordered_set<uint32_t> queue_family_indices_set = { graphics_queue_family_index, 
-                                                            present_queue_family_index };
+  std::unordered_set<uint32_t> queue_family_indices_set = { graphics_queue_family_index_, 
+                                                            present_queue_family_index_,
+                                                            transfer_queue_family_index_ };
+  float queue_priorities[] = { 1.f };
   for (uint32_t queue_family_index : queue_family_indices_set) {
-    float queue_properties[] = { 1.f };
-
     VkDeviceQueueCreateInfo queue_create_info{};
     queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queue_create_info.queueFamilyIndex = queue_family_index;
     queue_create_info.queueCount = 1;
-    queue_create_info.pQueuePriorities = queue_properties;
+    queue_create_info.pQueuePriorities = queue_priorities;
 
     queue_create_infos.push_back(std::move(queue_create_info));
   }
 
+  VkPhysicalDeviceFeatures supported_features;
+  vkGetPhysicalDeviceFeatures(vk_physical_device_, &supported_features);
+
   VkPhysicalDeviceFeatures device_enabled_features{};
-  std::vector<const char*> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+  device_enabled_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+  device_enabled_features.inheritedQueries = supported_features.inheritedQueries;
+  device_enabled_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+  device_enabled_features.drawIndirectFirstInstance = 
+      supported_features.drawIndirectFirstInstance;
+
+  inherited_queries_enabled_ = supported_features.inheritedQueries;
+  multi_draw_indirect_enabled_ = supported_features.multiDrawIndirect;
+  draw_indirect_first_instance_enabled_ = supported_features.drawIndirectFirstInstance;
+
+  std::vector<const char*> device_extensions;
+  if (!IsHeadless()) {
+    device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
+
+  // Only used to tell pipeline cache hits from misses, so it is optional.
+  uint32_t available_extensions_count = 0;
+  vkEnumerateDeviceExtensionProperties(vk_physical_device_, nullptr, &available_extensions_count, 
+                                       nullptr);
+
+  std::vector<VkExtensionProperties> available_extensions(available_extensions_count);
+  vkEnumerateDeviceExtensionProperties(vk_physical_device_, nullptr, &available_extensions_count,
+                                       available_extensions.data());
+
+  pipeline_creation_feedback_supported_ = 
+      std::find_if(available_extensions.begin(), available_extensions.end(),
+          [](const VkExtensionProperties& props) {
+            return strcmp(props.extensionName, 
+                          VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0;
+          }) != available_extensions.end();
+  if (pipeline_creation_feedback_supported_) {
+    device_extensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+  }
+
+  // Optional. Without it, indirect draws with a GPU-written count draw every record instead.
+  bool draw_indirect_count_supported = 
+      std::find_if(available_extensions.begin(), available_extensions.end(),
+          [](const VkExtensionProperties& props) {
+            return strcmp(props.extensionName, 
+                          VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+          }) != available_extensions.end();
+  if (draw_indirect_count_supported) {
+    device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures indexing_features{};
+  indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+  bool descriptor_indexing_enabled = 
+      options_.bindless && EnableDescriptorIndexing(available_extensions, &device_extensions,
+                                                    &device_enabled_features, &indexing_features);
+  if (options_.bindless && !descriptor_indexing_enabled) {
+    std::cerr << "Descriptor indexing is not supported. Falling back to per-draw descriptor sets."
+              << std::endl;
+  }
 
   VkDeviceCreateInfo device_create_info{};
   device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_create_info.pNext = descriptor_indexing_enabled ? &indexing_features : nullptr;
   device_create_info.queueCreateInfoCount = queue_create_infos.size();
   device_create_info.pQueueCreateInfos = queue_create_infos.data();
-  device_create_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
-  device_create_info.ppEnabledLayerNames = validation_layers.data();
+  device_create_info.enabledLayerCount = static_cast<uint32_t>(validation_layers_.size());
+  device_create_info.ppEnabledLayerNames = validation_layers_.data();
   device_create_info.enabledExtensionCount = device_extensions.size();
   device_create_info.ppEnabledExtensionNames = device_extensions.data();
   device_create_info.pEnabledFeatures = &device_enabled_features;
@@ -126,10 +433,105 @@ GALPlatform::GALPlatform(window::Window* window) {
     throw Exception("Could not create VkDevice.");
   }
 
-  vkGetDeviceQueue(vk_device_, graphics_queue_family_index, 0, &vk_graphics_queue_);
-  vkGetDeviceQueue(vk_device_, present_queue_family_index, 0, &vk_present_queue_);
+  if (draw_indirect_count_supported) {
+    vk_cmd_draw_indexed_indirect_count_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(vk_device_, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+
+  vkGetDeviceQueue(vk_device_, graphics_queue_family_index_, 0, &vk_graphics_queue_);
+  vkGetDeviceQueue(vk_device_, present_queue_family_index_, 0, &vk_present_queue_);
+  vkGetDeviceQueue(vk_device_, transfer_queue_family_index_, 0, &vk_transfer_queue_);
+
+  memory_allocator_ = std::make_unique<GALMemoryAllocator>(vk_physical_device_, vk_device_);
+
+  VkPhysicalDeviceProperties device_props;
+  vkGetPhysicalDeviceProperties(vk_physical_device_, &device_props);
 
-  VkSurfaceFormatKHR surface_format = ChooseSurfaceFormat();
+  upload_manager_ = std::make_unique<GALUploadManager>(
+      vk_device_, memory_allocator_.get(), vk_graphics_queue_, graphics_queue_family_index_,
+      vk_transfer_queue_, transfer_queue_family_index_, 
+      device_props.limits.optimalBufferCopyOffsetAlignment);
+
+  uniform_ring_ = std::make_unique<GALUniformRing>(vk_device_, memory_allocator_.get(), 
+                                                   device_props.limits, 
+                                                   options_.frames_in_flight);
+
+  descriptor_cache_ = 
+      std::make_unique<GALDescriptorCache>(vk_device_, options_.frames_in_flight);
+
+  pipeline_registry_ = std::make_unique<GALPipelineRegistry>(vk_device_);
+
+  if (descriptor_indexing_enabled) {
+    try {
+      bindless_table_ = std::make_unique<GALBindlessTable>(vk_physical_device_, vk_device_, 
+                                                           options_.frames_in_flight);
+    } catch (Exception& e) {
+      std::cerr << e.what() << " Falling back to per-draw descriptor sets." << std::endl;
+    }
+  }
+}
+
+bool GALPlatform::EnableDescriptorIndexing(
+    const std::vector<VkExtensionProperties>& available_extensions,
+    std::vector<const char*>* device_extensions, VkPhysicalDeviceFeatures* enabled_features,
+    VkPhysicalDeviceDescriptorIndexingFeatures* indexing_features) {
+  VkPhysicalDeviceProperties device_props;
+  vkGetPhysicalDeviceProperties(vk_physical_device_, &device_props);
+
+  // The device can only be used up to the version that the instance asked for.
+  uint32_t api_version = std::min(device_props.apiVersion, instance_api_version_);
+  if (api_version < VK_API_VERSION_1_1) {
+    return false;
+  }
+
+  // VK_EXT_descriptor_indexing needs VK_KHR_maintenance3, which is core in Vulkan 1.1.
+  bool is_core = api_version >= VK_API_VERSION_1_2;
+  if (!is_core && 
+      std::find_if(available_extensions.begin(), available_extensions.end(),
+          [](const VkExtensionProperties& props) {
+            return strcmp(props.extensionName, 
+                          VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+          }) == available_extensions.end()) {
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures supported_indexing_features{};
+  supported_indexing_features.sType = 
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+  VkPhysicalDeviceFeatures2 supported_features{};
+  supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supported_features.pNext = &supported_indexing_features;
+  vkGetPhysicalDeviceFeatures2(vk_physical_device_, &supported_features);
+
+  // Slots are indexed with push constants, which are dynamically uniform, so non-uniform
+  // indexing is not needed.
+  if (!supported_features.features.shaderSampledImageArrayDynamicIndexing ||
+      !supported_features.features.shaderStorageBufferArrayDynamicIndexing ||
+      !supported_indexing_features.runtimeDescriptorArray ||
+      !supported_indexing_features.descriptorBindingPartiallyBound ||
+      !supported_indexing_features.descriptorBindingUpdateUnusedWhilePending ||
+      !supported_indexing_features.descriptorBindingSampledImageUpdateAfterBind ||
+      !supported_indexing_features.descriptorBindingStorageBufferUpdateAfterBind) {
+    return false;
+  }
+
+  enabled_features->shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+  enabled_features->shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+  indexing_features->runtimeDescriptorArray = VK_TRUE;
+  indexing_features->descriptorBindingPartiallyBound = VK_TRUE;
+  indexing_features->descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  indexing_features->descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  indexing_features->descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+
+  if (!is_core) {
+    device_extensions->push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  }
+  return true;
+}
+
+void GALPlatform::CreateSwapchain() {
+  const VkSurfaceFormatKHR& surface_format = vk_surface_format_;
   VkPresentModeKHR present_mode = ChoosePresentMode();
   VkExtent2D extent = ChooseSwapExtent();
 
@@ -137,7 +539,8 @@ GALPlatform::GALPlatform(window::Window* window) {
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk_physical_device_, vk_surface_, 
                                             &surface_capabilities);
 
-  uint32_t requested_image_count = surface_capabilities.minImageCount + 1;
+  uint32_t requested_image_count = 
+      surface_capabilities.minImageCount + options_.extra_swapchain_images;
   if (surface_capabilities.maxImageCount != 0) {
     requested_image_count = std::min(requested_image_count, surface_capabilities.maxImageCount);
   }
@@ -152,8 +555,8 @@ GALPlatform::GALPlatform(window::Window* window) {
   swapchain_create_info.imageArrayLayers = 1;
   swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  if (graphics_queue_family_index != present_queue_family_index) {
-    uint32_t queue_family_indices[] = { graphics_queue_family_index, present_queue_family_index };
+  uint32_t queue_family_indices[] = { graphics_queue_family_index_, present_queue_family_index_ };
+  if (graphics_queue_family_index_ != present_queue_family_index_) {
     swapchain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
     swapchain_create_info.queueFamilyIndexCount = 2;
     swapchain_create_info.pQueueFamilyIndices = queue_family_indices;
@@ -167,13 +570,20 @@ GALPlatform::GALPlatform(window::Window* window) {
   swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   swapchain_create_info.presentMode = present_mode;
   swapchain_create_info.clipped = VK_TRUE;
-  swapchain_create_info.oldSwapchain = VK_NULL_HANDLE;
+  // Hands the surface over from the old swapchain, if this is a recreation, so that the
+  // presentation engine can keep showing its last image until the new one is presented.
+  VkSwapchainKHR old_swapchain = vk_swapchain_;
+  swapchain_create_info.oldSwapchain = old_swapchain;
 
   if (vkCreateSwapchainKHR(vk_device_, &swapchain_create_info, nullptr, &vk_swapchain_) 
           != VK_SUCCESS) {
     throw Exception("Could not create VkSwapchain.");
   }
 
+  if (old_swapchain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(vk_device_, old_swapchain, nullptr);
+  }
+
   uint32_t image_count = 0;
   vkGetSwapchainImagesKHR(vk_device_, vk_swapchain_, &image_count, nullptr);
 
@@ -206,29 +616,283 @@ GALPlatform::GALPlatform(window::Window* window) {
       throw Exception("Could not create image view for swapchain image.");
     }
   }
+}
+
+void GALPlatform::CreateOffscreenImages(uint32_t width, uint32_t height) {
+  vk_swapchain_image_format_ = kOffscreenImageFormat;
+  vk_swapchain_extent_.width = width;
+  vk_swapchain_extent_.height = height;
+
+  // One image per frame in flight, so that a frame never has to wait on an image that another
+  // frame is still rendering to.
+  vk_swapchain_images_.resize(options_.frames_in_flight);
+  vk_swapchain_image_views_.resize(options_.frames_in_flight);
+
+  for (size_t i = 0; i < vk_swapchain_images_.size(); ++i) {
+    VkImageCreateInfo image_create_info{};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = vk_swapchain_image_format_;
+    image_create_info.extent.width = width;
+    image_create_info.extent.height = height;
+    image_create_info.extent.depth = 1;
+    image_create_info.mipLevels = 1;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | 
+                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(vk_device_, &image_create_info, nullptr, &vk_swapchain_images_[i]) 
+            != VK_SUCCESS) {
+      throw Exception("Could not create offscreen image.");
+    }
 
+    std::optional<GALMemoryAllocator::Allocation> allocation = 
+        memory_allocator_->AllocateImageMemory(vk_swapchain_images_[i], 
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+    if (!allocation.has_value()) {
+      throw Exception("Could not allocate memory for offscreen image.");
+    }
+    offscreen_image_allocations_.push_back(allocation.value());
+
+    VkImageViewCreateInfo image_view_create_info{};
+    image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_create_info.image = vk_swapchain_images_[i];
+    image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    image_view_create_info.format = vk_swapchain_image_format_;
+    image_view_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    image_view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    image_view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    image_view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_view_create_info.subresourceRange.baseMipLevel = 0;
+    image_view_create_info.subresourceRange.levelCount = 1;
+    image_view_create_info.subresourceRange.baseArrayLayer = 0;
+    image_view_create_info.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(vk_device_, &image_view_create_info, nullptr, 
+            &vk_swapchain_image_views_[i]) != VK_SUCCESS) {
+      throw Exception("Could not create image view for offscreen image.");
+    }
+  }
+}
+
+void GALPlatform::CreateRenderPass() {
+  VkAttachmentDescription color_attachment{};
+  color_attachment.format = vk_swapchain_image_format_;
+  color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  color_attachment.finalLayout = GetVkFinalImageLayout();
+
+  // The depth buffer is cleared at the start of every frame and never read afterwards, so it is
+  // not stored.
+  VkAttachmentDescription depth_attachment{};
+  depth_attachment.format = vk_depth_format_;
+  depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription attachments[] = { color_attachment, depth_attachment };
+
+  VkAttachmentReference color_attachment_ref{};
+  color_attachment_ref.attachment = 0;
+  color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depth_attachment_ref{};
+  depth_attachment_ref.attachment = 1;
+  depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &color_attachment_ref;
+  subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+  VkSubpassDependency subpass_dependency{};
+  subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  subpass_dependency.dstSubpass = 0;
+  subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  subpass_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo render_pass_create_info{};
+  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_create_info.attachmentCount = static_cast<uint32_t>(std::size(attachments));
+  render_pass_create_info.pAttachments = attachments;
+  render_pass_create_info.subpassCount = 1;
+  render_pass_create_info.pSubpasses = &subpass;
+  render_pass_create_info.dependencyCount = 1;
+  render_pass_create_info.pDependencies = &subpass_dependency;
+
+  if (vkCreateRenderPass(vk_device_, &render_pass_create_info, nullptr, &vk_render_pass_) 
+          != VK_SUCCESS) {
+    throw Exception("Could not create VkRenderPass.");
+  }
+}
+
+void GALPlatform::CreateFramebuffers() {
+  vk_framebuffers_.resize(vk_swapchain_image_views_.size());
+
+  for (size_t i = 0; i < vk_swapchain_image_views_.size(); ++i) {
+    VkImageView attachments[] = { vk_swapchain_image_views_[i], vk_depth_image_views_[i] };
+
+    VkFramebufferCreateInfo framebuffer_create_info{};
+    framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_create_info.renderPass = vk_render_pass_;
+    framebuffer_create_info.attachmentCount = static_cast<uint32_t>(std::size(attachments));
+    framebuffer_create_info.pAttachments = attachments;
+    framebuffer_create_info.width = vk_swapchain_extent_.width;
+    framebuffer_create_info.height = vk_swapchain_extent_.height;
+    framebuffer_create_info.layers = 1;
+
+    if (vkCreateFramebuffer(vk_device_, &framebuffer_create_info, nullptr, 
+                            &vk_framebuffers_[i]) != VK_SUCCESS) {
+      throw Exception("Could not create VkFramebuffer.");
+    }
+  }
+}
+
+void GALPlatform::CreateDepthImages() {
+  // One per swapchain image, so that frames in flight never share a depth buffer.
+  vk_depth_images_.resize(vk_swapchain_images_.size());
+  vk_depth_image_views_.resize(vk_swapchain_images_.size());
+
+  VkImageAspectFlags aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (HasStencilComponent(vk_depth_format_)) {
+    aspect_mask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+
+  for (size_t i = 0; i < vk_depth_images_.size(); ++i) {
+    VkImageCreateInfo image_create_info{};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = vk_depth_format_;
+    image_create_info.extent.width = vk_swapchain_extent_.width;
+    image_create_info.extent.height = vk_swapchain_extent_.height;
+    image_create_info.extent.depth = 1;
+    image_create_info.mipLevels = 1;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // The contents never leave the render pass, so tiled GPUs can keep them in tile memory.
+    image_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | 
+                              VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(vk_device_, &image_create_info, nullptr, &vk_depth_images_[i]) 
+            != VK_SUCCESS) {
+      throw Exception("Could not create depth image.");
+    }
+
+    std::optional<GALMemoryAllocator::Allocation> allocation = 
+        memory_allocator_->AllocateImageMemory(vk_depth_images_[i], 
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+                                               VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+    if (!allocation.has_value()) {
+      throw Exception("Could not allocate memory for depth image.");
+    }
+    depth_image_allocations_.push_back(allocation.value());
+
+    VkImageViewCreateInfo image_view_create_info{};
+    image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_create_info.image = vk_depth_images_[i];
+    image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    image_view_create_info.format = vk_depth_format_;
+    image_view_create_info.subresourceRange.aspectMask = aspect_mask;
+    image_view_create_info.subresourceRange.baseMipLevel = 0;
+    image_view_create_info.subresourceRange.levelCount = 1;
+    image_view_create_info.subresourceRange.baseArrayLayer = 0;
+    image_view_create_info.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(vk_device_, &image_view_create_info, nullptr, 
+            &vk_depth_image_views_[i]) != VK_SUCCESS) {
+      throw Exception("Could not create image view for depth image.");
+    }
+  }
+}
+
+void GALPlatform::DestroyDepthImages() {
+  for (VkImageView image_view : vk_depth_image_views_) {
+    vkDestroyImageView(vk_device_, image_view, nullptr);
+  }
+  for (VkImage image : vk_depth_images_) {
+    vkDestroyImage(vk_device_, image, nullptr);
+  }
+  for (const GALMemoryAllocator::Allocation& allocation : depth_image_allocations_) {
+    memory_allocator_->Free(allocation);
+  }
+
+  vk_depth_image_views_.clear();
+  vk_depth_images_.clear();
+  depth_image_allocations_.clear();
+}
+
+void GALPlatform::CreateCommandPoolAndSyncObjects() {
   VkCommandPoolCreateInfo command_pool_create_info{};
   command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  command_pool_create_info.queueFamilyIndex = graphics_queue_family_index;
+  command_pool_create_info.queueFamilyIndex = graphics_queue_family_index_;
 
   if (vkCreateCommandPool(vk_device_, &command_pool_create_info, nullptr,
                           &vk_command_pool_) != VK_SUCCESS) {
     throw Exception("Could not create command pool.");
   }
 
-  vk_image_available_semaphores_.resize(kMaxFramesInFlight);
-  vk_render_finished_semaphores_.resize(kMaxFramesInFlight);
-  vk_in_flight_fences_.resize(kMaxFramesInFlight);
-  vk_images_in_flight_.resize(vk_swapchain_images_.size(), VK_NULL_HANDLE);
+  command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-  VkSemaphoreCreateInfo semaphore_create_info{};
-  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  vk_frame_command_pools_.resize(options_.frames_in_flight);
+  for (VkCommandPool& command_pool : vk_frame_command_pools_) {
+    if (vkCreateCommandPool(vk_device_, &command_pool_create_info, nullptr,
+                            &command_pool) != VK_SUCCESS) {
+      throw Exception("Could not create command pool.");
+    }
+  }
+
+  vk_clear_command_buffers_.resize(options_.frames_in_flight, VK_NULL_HANDLE);
+
+  vk_in_flight_fences_.resize(options_.frames_in_flight);
+  vk_images_in_flight_.resize(vk_swapchain_images_.size(), VK_NULL_HANDLE);
+  frame_submit_times_.resize(options_.frames_in_flight);
+  frame_gpu_done_.resize(options_.frames_in_flight, true);
 
   VkFenceCreateInfo fence_create_info{};
   fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+  for (size_t i = 0; i < options_.frames_in_flight; ++i) {
+    if (vkCreateFence(vk_device_, &fence_create_info, nullptr, &vk_in_flight_fences_[i]) 
+            != VK_SUCCESS) {
+      throw Exception("Could not create fence." );
+    }
+  }
+
+  // Nothing is acquired or presented in headless mode, so the frames are only fenced.
+  if (IsHeadless()) {
+    return;
+  }
+
+  vk_image_available_semaphores_.resize(options_.frames_in_flight);
+  vk_render_finished_semaphores_.resize(options_.frames_in_flight);
+
+  VkSemaphoreCreateInfo semaphore_create_info{};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for (size_t i = 0; i < options_.frames_in_flight; ++i) {
     if (vkCreateSemaphore(vk_device_, &semaphore_create_info, nullptr,
                           &vk_image_available_semaphores_[i]) != VK_SUCCESS) {
       throw Exception("Could not create semaphore.");
@@ -238,85 +902,281 @@ GALPlatform::GALPlatform(window::Window* window) {
                           &vk_render_finished_semaphores_[i]) != VK_SUCCESS) {
       throw Exception("Could not create semaphore.");
     }
-
-    if (vkCreateFence(vk_device_, &fence_create_info, nullptr, &vk_in_flight_fences_[i]) 
-            != VK_SUCCESS) {
-      throw Exception("Could not create fence." );
-    }
   }
 }
 
-GALPlatform::~GALPlatform() {
-  // TODO(colintan): Should this be here?
-  vkDeviceWaitIdle(vk_device_);
+void GALPlatform::EnableProfiler(const GALProfiler::Options& options) {
+  profiler_ = std::make_unique<GALProfiler>(
+      vk_physical_device_, vk_device_, graphics_queue_family_index_, 
+      static_cast<uint32_t>(vk_swapchain_images_.size()), options_.frames_in_flight, options);
+}
+
+void GALPlatform::EnablePipelineCache(const std::string& path) {
+  pipeline_cache_ = std::make_unique<GALPipelineCache>(
+      vk_physical_device_, vk_device_, path, pipeline_creation_feedback_supported_);
+}
 
-  for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
-    vkDestroyFence(vk_device_, vk_in_flight_fences_[i], nullptr);
-    vkDestroySemaphore(vk_device_, vk_render_finished_semaphores_[i], nullptr);
-    vkDestroySemaphore(vk_device_, vk_image_available_semaphores_[i], nullptr);
+void GALPlatform::EnableWorkerThreads(uint32_t worker_count) {
+  if (worker_count == 0) {
+    worker_count = std::max(2u, std::thread::hardware_concurrency()) - 1;
   }
 
-  vkDestroyCommandPool(vk_device_, vk_command_pool_, nullptr);
+  worker_pool_ = std::make_unique<GALWorkerPool>(vk_device_, graphics_queue_family_index_, 
+                                                 worker_count, options_.frames_in_flight);
+}
 
-  for (VkImageView image_view : vk_swapchain_image_views_) {
-    vkDestroyImageView(vk_device_, image_view, nullptr);
+bool GALPlatform::StartTick() {
+  if (options_.frame_pacing) {
+    PaceFrame();
   }
 
-  vkDestroySwapchainKHR(vk_device_, vk_swapchain_, nullptr);
+  auto fence_wait_start = std::chrono::steady_clock::now();
 
-  vkDestroyDevice(vk_device_, nullptr);
+  WaitForFrame(current_frame_, UINT64_MAX);
 
-  vkDestroySurfaceKHR(vk_instance_, vk_surface_, nullptr);
+  auto fence_wait_duration = std::chrono::steady_clock::now() - fence_wait_start;
 
-  auto destroy_debug_utils_messenger_func = 
-      (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(vk_instance_, 
-          "vkDestroyDebugUtilsMessengerEXT");
-  if (destroy_debug_utils_messenger_func != nullptr) {
-    destroy_debug_utils_messenger_func(vk_instance_, vk_debug_messenger_, nullptr);
+  if (profiler_) {
+    profiler_->OnFrameFenceSignaled(current_frame_);
   }
 
-  vkDestroyInstance(vk_instance_, nullptr);
-}
+  // Nothing recorded from this frame's pools is in flight any more.
+  vkResetCommandPool(vk_device_, vk_frame_command_pools_[current_frame_], 0);
+  if (worker_pool_) {
+    worker_pool_->ResetFrameCommandPools(current_frame_);
+  }
+  uniform_ring_->BeginFrame(current_frame_);
+  descriptor_cache_->BeginFrame(current_frame_);
+  if (bindless_table_) {
+    bindless_table_->BeginFrame(current_frame_);
+  }
 
-void GALPlatform::StartTick() {
-  vkWaitForFences(vk_device_, 1, &vk_in_flight_fences_[current_frame_], VK_TRUE, UINT64_MAX);
+  auto acquire_start = std::chrono::steady_clock::now();
+
+  if (IsHeadless()) {
+    // Each frame in flight owns one offscreen image.
+    current_image_index_ = current_frame_;
+  } else if (!AcquireSwapchainImage()) {
+    return false;
+  }
 
-  vkAcquireNextImageKHR(vk_device_, vk_swapchain_, UINT64_MAX, 
-                        vk_image_available_semaphores_[current_frame_], VK_NULL_HANDLE, 
-                        &current_image_index_);
+  auto acquire_duration = std::chrono::steady_clock::now() - acquire_start;
 
   if (vk_images_in_flight_[current_image_index_] != VK_NULL_HANDLE) {
+    fence_wait_start = std::chrono::steady_clock::now();
+
     vkWaitForFences(vk_device_, 1, &vk_images_in_flight_[current_image_index_], VK_TRUE, 
                     UINT64_MAX);
+
+    fence_wait_duration += std::chrono::steady_clock::now() - fence_wait_start;
   }
 
   vk_images_in_flight_[current_image_index_] = vk_in_flight_fences_[current_frame_];
+
+  if (profiler_) {
+    // The image's command buffer is about to be resubmitted, which resets its queries.
+    profiler_->OnQuerySetIdle(current_image_index_);
+
+    profiler_->AddCpuTime(GALProfiler::CpuTimer::FenceWait, fence_wait_duration);
+    profiler_->AddCpuTime(GALProfiler::CpuTimer::Acquire, acquire_duration);
+  }
+
+  return true;
+}
+
+bool GALPlatform::AcquireSwapchainImage() {
+  if (window_->ConsumeResize()) {
+    swapchain_out_of_date_ = true;
+  }
+
+  if (swapchain_out_of_date_ && !RecreateSwapchain()) {
+    return false;
+  }
+
+  VkResult result = vkAcquireNextImageKHR(vk_device_, vk_swapchain_, UINT64_MAX, 
+                                          vk_image_available_semaphores_[current_frame_], 
+                                          VK_NULL_HANDLE, &current_image_index_);
+
+  // The semaphore is left unsignaled when no image is acquired, so it can be reused with the new
+  // swapchain.
+  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    if (!RecreateSwapchain()) {
+      return false;
+    }
+
+    result = vkAcquireNextImageKHR(vk_device_, vk_swapchain_, UINT64_MAX, 
+                                   vk_image_available_semaphores_[current_frame_], 
+                                   VK_NULL_HANDLE, &current_image_index_);
+  }
+
+  // A suboptimal swapchain can still be rendered to and presented, so it is only replaced before
+  // the next frame.
+  if (result == VK_SUBOPTIMAL_KHR) {
+    swapchain_out_of_date_ = true;
+  } else if (result != VK_SUCCESS) {
+    std::cerr << "Could not acquire swapchain image." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool GALPlatform::RecreateSwapchain() {
+  // A minimized window has no area to present to. It is retried every frame until it has.
+  VkExtent2D extent = ChooseSwapExtent();
+  if (extent.width == 0 || extent.height == 0) {
+    return false;
+  }
+
+  // Frames in flight may still be rendering into the framebuffers, or presenting the images.
+  vkDeviceWaitIdle(vk_device_);
+
+  for (VkFramebuffer framebuffer : vk_framebuffers_) {
+    vkDestroyFramebuffer(vk_device_, framebuffer, nullptr);
+  }
+  for (VkImageView image_view : vk_swapchain_image_views_) {
+    vkDestroyImageView(vk_device_, image_view, nullptr);
+  }
+  DestroyDepthImages();
+
+  CreateSwapchain();
+  CreateDepthImages();
+  CreateFramebuffers();
+
+  vk_images_in_flight_.assign(vk_swapchain_images_.size(), VK_NULL_HANDLE);
+
+  if (profiler_) {
+    profiler_->OnSwapchainRecreated(static_cast<uint32_t>(vk_swapchain_images_.size()));
+  }
+
+  swapchain_out_of_date_ = false;
+  ++swapchain_generation_;
+
+  return true;
+}
+
+void GALPlatform::PaceFrame() {
+  uint32_t prev_frame = 
+      (current_frame_ + options_.frames_in_flight - 1) % options_.frames_in_flight;
+  auto sleep_start = std::chrono::steady_clock::now();
+  pacing_wake_time_ = sleep_start;
+
+  // The GPU is already idle, so recording should start right away.
+  if (!frame_submit_times_[prev_frame].has_value() || WaitForFrame(prev_frame, 0)) {
+    return;
+  }
+
+  // The previous frame started on the GPU once it was submitted and the frame before it was done.
+  // Recording starts early enough that the new frame is submitted about when it finishes.
+  auto gpu_start = std::max(frame_submit_times_[prev_frame].value(), last_gpu_done_time_);
+  auto wake_time = std::min(gpu_start + gpu_frame_time_ - cpu_frame_time_, 
+                            sleep_start + kMaxPacingDelay);
+
+  // Waiting on the fence rather than sleeping also wakes up if the GPU goes idle early, and times
+  // when it did.
+  if (wake_time > sleep_start) {
+    auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(wake_time - sleep_start);
+    WaitForFrame(prev_frame, static_cast<uint64_t>(timeout.count()));
+  }
+
+  pacing_wake_time_ = std::chrono::steady_clock::now();
+
+  if (profiler_) {
+    profiler_->AddCpuTime(GALProfiler::CpuTimer::FramePacing, pacing_wake_time_ - sleep_start);
+  }
+}
+
+void GALPlatform::UpdateFramePacing() {
+  uint32_t prev_frame = 
+      (current_frame_ + options_.frames_in_flight - 1) % options_.frames_in_flight;
+  if (prev_frame != current_frame_ && frame_submit_times_[prev_frame].has_value()) {
+    WaitForFrame(prev_frame, 0);
+  }
+
+  auto cpu_time = std::chrono::steady_clock::now() - pacing_wake_time_;
+  cpu_frame_time_ += (cpu_time - cpu_frame_time_) / kPacingSmoothing;
+}
+
+bool GALPlatform::WaitForFrame(uint32_t frame, uint64_t timeout_ns) {
+  if (vkWaitForFences(vk_device_, 1, &vk_in_flight_fences_[frame], VK_TRUE, timeout_ns) 
+          != VK_SUCCESS) {
+    return false;
+  }
+
+  if (frame_gpu_done_[frame] || !frame_submit_times_[frame].has_value()) {
+    return true;
+  }
+
+  // The fence is only seen some time after it signaled, so this overestimates the GPU's frame
+  // time by however late it was polled. Waits that block are timed exactly.
+  auto now = std::chrono::steady_clock::now();
+  auto gpu_start = std::max(frame_submit_times_[frame].value(), last_gpu_done_time_);
+  gpu_frame_time_ += (now - gpu_start - gpu_frame_time_) / kPacingSmoothing;
+  last_gpu_done_time_ = now;
+
+  // The queue executes frames in order, so every other submitted frame is done as well.
+  std::fill(frame_gpu_done_.begin(), frame_gpu_done_.end(), true);
+  return true;
+}
+
+void GALPlatform::WaitIdle() {
+  vkDeviceWaitIdle(vk_device_);
 }
 
 void GALPlatform::EndTick() {
-  current_frame_ = (current_frame_ + 1) % kMaxFramesInFlight;
+  current_frame_ = (current_frame_ + 1) % options_.frames_in_flight;
 }
 
 bool GALPlatform::ExecuteCommandBuffer(GALCommandBuffer* command_buffer) {
+  // The acquired image is still presented, so that its semaphore is waited on and the image is
+  // released back to the swapchain.
+  bool skipped = command_buffer == nullptr || command_buffer->IsOutOfDate();
+  if (command_buffer != nullptr && skipped) {
+    std::cerr << "Command buffer was recorded for a swapchain that has since been recreated."
+              << std::endl;
+  }
+
+  // Uploads are submitted ahead of the frame, so that buffers created since the last frame are
+  // ready by the time the frame uses them.
+  upload_manager_->Flush();
+
+  VkCommandBuffer vk_command_buffer = 
+      skipped ? RecordClearFrame() 
+              : command_buffer->GetVkCommandBuffer(current_frame_, current_image_index_);
+  if (vk_command_buffer == VK_NULL_HANDLE) {
+    AbandonFrame();
+    return false;
+  }
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &vk_command_buffer;
+
+  if (IsHeadless()) {
+    vkResetFences(vk_device_, 1, &vk_in_flight_fences_[current_frame_]);
+
+    if (!SubmitFrame(submit_info, !skipped)) {
+      AbandonFrame();
+      return false;
+    }
+    return !skipped;
+  }
+
   VkSemaphore wait_semaphores[] = { vk_image_available_semaphores_[current_frame_] };
   VkSemaphore signal_semaphores[] = { vk_render_finished_semaphores_[current_frame_] };
   VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
-  VkSubmitInfo submit_info{};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   submit_info.waitSemaphoreCount = 1;
   submit_info.pWaitSemaphores = wait_semaphores;
   submit_info.pWaitDstStageMask = wait_stages;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = 
-      &(command_buffer->GetVkCommandBuffers()[current_image_index_]);
   submit_info.signalSemaphoreCount = 1;
   submit_info.pSignalSemaphores = signal_semaphores;
 
   vkResetFences(vk_device_, 1, &vk_in_flight_fences_[current_frame_]);
 
-  if (vkQueueSubmit(vk_graphics_queue_, 1, &submit_info, vk_in_flight_fences_[current_frame_]) 
-          != VK_SUCCESS) {
+  if (!SubmitFrame(submit_info, !skipped)) {
+    AbandonFrame();
     return false;
   }
 
@@ -330,11 +1190,160 @@ bool GALPlatform::ExecuteCommandBuffer(GALCommandBuffer* command_buffer) {
   present_info.pSwapchains = swapchains;
   present_info.pImageIndices = &current_image_index_;
 
-  vkQueuePresentKHR(vk_present_queue_, &present_info);
+  auto present_start = std::chrono::steady_clock::now();
+
+  VkResult present_result = vkQueuePresentKHR(vk_present_queue_, &present_info);
+
+  if (profiler_) {
+    profiler_->AddCpuTime(GALProfiler::CpuTimer::Present, 
+                          std::chrono::steady_clock::now() - present_start);
+  }
+
+  // The frame was still submitted, so only the next one has to wait for a new swapchain.
+  if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR) {
+    swapchain_out_of_date_ = true;
+  } else if (present_result != VK_SUCCESS) {
+    std::cerr << "Could not present swapchain image." << std::endl;
+    return false;
+  }
+
+  return !skipped;
+}
+
+VkCommandBuffer GALPlatform::RecordClearFrame() {
+  VkCommandBuffer& command_buffer = vk_clear_command_buffers_[current_frame_];
+  if (command_buffer == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+    command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_alloc_info.commandPool = vk_frame_command_pools_[current_frame_];
+    command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_alloc_info.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(vk_device_, &command_buffer_alloc_info, 
+                                 &command_buffer) != VK_SUCCESS) {
+      std::cerr << "Could not allocate clear frame command buffer." << std::endl;
+      command_buffer = VK_NULL_HANDLE;
+      return VK_NULL_HANDLE;
+    }
+  }
+
+  // StartTick() reset the frame's pool, and the buffer with it.
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+    std::cerr << "Could not begin clear frame command buffer." << std::endl;
+    return VK_NULL_HANDLE;
+  }
+
+  // The render pass clears the image and leaves it in the final layout.
+  VkClearValue clear_values[2]{};
+  clear_values[0].color = {{0.f, 0.f, 0.f, 1.f}};
+  clear_values[1].depthStencil = {1.f, 0};
+
+  VkRenderPassBeginInfo render_pass_begin_info{};
+  render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  render_pass_begin_info.renderPass = vk_render_pass_;
+  render_pass_begin_info.framebuffer = vk_framebuffers_[current_image_index_];
+  render_pass_begin_info.renderArea.offset = {0, 0};
+  render_pass_begin_info.renderArea.extent = vk_swapchain_extent_;
+  render_pass_begin_info.clearValueCount = static_cast<uint32_t>(std::size(clear_values));
+  render_pass_begin_info.pClearValues = clear_values;
+
+  vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdEndRenderPass(command_buffer);
+
+  if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+    std::cerr << "Could not record clear frame command buffer." << std::endl;
+    return VK_NULL_HANDLE;
+  }
+  return command_buffer;
+}
+
+void GALPlatform::AbandonFrame() {
+  std::cerr << "Could not submit frame." << std::endl;
+
+  // A submit without command buffers still waits on the acquire semaphore, so that it is
+  // unsignaled again, and signals the fence that the next use of this frame waits on.
+  VkSemaphore wait_semaphores[] = { vk_image_available_semaphores_[current_frame_] };
+  VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  if (!IsHeadless()) {
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+  }
+
+  vkResetFences(vk_device_, 1, &vk_in_flight_fences_[current_frame_]);
+  if (vkQueueSubmit(vk_graphics_queue_, 1, &submit_info, vk_in_flight_fences_[current_frame_]) 
+          != VK_SUCCESS) {
+    // Nothing can be submitted, so the semaphore and fence are replaced instead.
+    vkDeviceWaitIdle(vk_device_);
+
+    VkFenceCreateInfo fence_create_info{};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    vkDestroyFence(vk_device_, vk_in_flight_fences_[current_frame_], nullptr);
+    if (vkCreateFence(vk_device_, &fence_create_info, nullptr, 
+                      &vk_in_flight_fences_[current_frame_]) != VK_SUCCESS) {
+      std::cerr << "Could not recreate fence." << std::endl;
+    }
+    // The image's entry still refers to the destroyed fence.
+    vk_images_in_flight_[current_image_index_] = VK_NULL_HANDLE;
+
+    if (!IsHeadless()) {
+      VkSemaphoreCreateInfo semaphore_create_info{};
+      semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+      vkDestroySemaphore(vk_device_, vk_image_available_semaphores_[current_frame_], nullptr);
+      if (vkCreateSemaphore(vk_device_, &semaphore_create_info, nullptr, 
+                            &vk_image_available_semaphores_[current_frame_]) != VK_SUCCESS) {
+        std::cerr << "Could not recreate semaphore." << std::endl;
+      }
+    }
+  }
+
+  // The acquired image cannot be presented, since nothing transitioned it to the present layout.
+  // Recreating the swapchain releases it.
+  if (!IsHeadless()) {
+    swapchain_out_of_date_ = true;
+  }
+}
+
+bool GALPlatform::SubmitFrame(const VkSubmitInfo& submit_info, bool profiled) {
+  if (options_.frame_pacing) {
+    UpdateFramePacing();
+  }
+
+  auto submit_start = std::chrono::steady_clock::now();
+
+  if (vkQueueSubmit(vk_graphics_queue_, 1, &submit_info, vk_in_flight_fences_[current_frame_]) 
+          != VK_SUCCESS) {
+    return false;
+  }
+
+  frame_submit_times_[current_frame_] = submit_start;
+  frame_gpu_done_[current_frame_] = false;
+
+  if (profiler_ && profiled) {
+    profiler_->AddCpuTime(GALProfiler::CpuTimer::Submit, 
+                          std::chrono::steady_clock::now() - submit_start);
+    profiler_->OnFrameSubmitted(current_frame_, current_image_index_);
+  }
 
   return true;
 }
 
+VkImageLayout GALPlatform::GetVkFinalImageLayout() const {
+  // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR is only valid with the swapchain extension. Offscreen images
+  // are left ready to be copied out instead.
+  return IsHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
 std::optional<GALPlatform::PhysicalDeviceInfo> GALPlatform::ChoosePhysicalDevice() {
   uint32_t physical_devices_count = 0;
   vkEnumeratePhysicalDevices(vk_instance_, &physical_devices_count, nullptr);
@@ -343,19 +1352,23 @@ std::optional<GALPlatform::PhysicalDeviceInfo> GALPlatform::ChoosePhysicalDevice
   vkEnumeratePhysicalDevices(vk_instance_, &physical_devices_count, physical_devices.data());
 
   bool found_physical_device = false;
+  int best_device_rank = 0;
   PhysicalDeviceInfo result;
 
   for (const VkPhysicalDevice& device : physical_devices) {
 
-    // Discrete GPU
+    // Device type - prefer discrete GPUs, but fall back to any other device
 
     VkPhysicalDeviceProperties device_props;
     vkGetPhysicalDeviceProperties(device, &device_props);
 
-    if (device_props.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+    int device_rank = GetDeviceTypeRank(device_props.deviceType);
+    if (found_physical_device && device_rank >= best_device_rank) {
       continue;
     }
 
+    PhysicalDeviceInfo device_info;
+
     uint32_t queue_families_count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_families_count, nullptr);
 
@@ -367,9 +1380,12 @@ std::optional<GALPlatform::PhysicalDeviceInfo> GALPlatform::ChoosePhysicalDevice
     bool found_graphics_queue = false;
 
     int index = 0;
+    // Compute commands are recorded into the same command buffers as draws. Every device with
+    // a graphics queue family has one that also supports compute.
     for (const VkQueueFamilyProperties& queue_family : queue_families) {
-      if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-        result.graphics_queue_family_index = index;
+      if ((queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+          (queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+        device_info.graphics_queue_family_index = index;
         found_graphics_queue = true;
         break;
       }
@@ -379,6 +1395,32 @@ std::optional<GALPlatform::PhysicalDeviceInfo> GALPlatform::ChoosePhysicalDevice
       continue;
     }
 
+    // Transfer queue - prefer a family that only does transfers, since it is usually backed by a
+    // DMA engine that runs alongside the graphics work.
+
+    device_info.transfer_queue_family_index = device_info.graphics_queue_family_index;
+
+    index = 0;
+    for (const VkQueueFamilyProperties& queue_family : queue_families) {
+      if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+          !(queue_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        device_info.transfer_queue_family_index = index;
+        break;
+      }
+      ++index;
+    }
+
+    if (IsHeadless()) {
+      // Nothing is presented, so the remaining surface checks do not apply.
+      device_info.present_queue_family_index = device_info.graphics_queue_family_index;
+
+      found_physical_device = true;
+      best_device_rank = device_rank;
+      vk_physical_device_ = device;
+      result = device_info;
+      continue;
+    }
+
     // Present queue
 
     bool found_present_queue = false;
@@ -389,7 +1431,7 @@ std::optional<GALPlatform::PhysicalDeviceInfo> GALPlatform::ChoosePhysicalDevice
       vkGetPhysicalDeviceSurfaceSupportKHR(device, index, vk_surface_, 
                                             &supports_present);
       if (supports_present) {
-        result.present_queue_family_index = index;
+        device_info.present_queue_family_index = index;
         found_present_queue = true;
         break;
       }
@@ -432,7 +1474,9 @@ std::optional<GALPlatform::PhysicalDeviceInfo> GALPlatform::ChoosePhysicalDevice
     }
 
     found_physical_device = true;
+    best_device_rank = device_rank;
     vk_physical_device_ = device;
+    result = device_info;
   }
   
   if (!found_physical_device) {
@@ -461,6 +1505,29 @@ VkSurfaceFormatKHR GALPlatform::ChooseSurfaceFormat() {
   return surface_formats[0];
 }
 
+VkFormat GALPlatform::ChooseDepthFormat() {
+  // In order of preference. At least one of VK_FORMAT_D32_SFLOAT and
+  // VK_FORMAT_D32_SFLOAT_S8_UINT, and VK_FORMAT_D16_UNORM, are guaranteed to be supported.
+  const VkFormat candidates[] = {
+    VK_FORMAT_D32_SFLOAT,
+    VK_FORMAT_D32_SFLOAT_S8_UINT,
+    VK_FORMAT_X8_D24_UNORM_PACK32,
+    VK_FORMAT_D24_UNORM_S8_UINT,
+    VK_FORMAT_D16_UNORM
+  };
+
+  for (VkFormat format : candidates) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(vk_physical_device_, format, &props);
+
+    if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return format;
+    }
+  }
+
+  throw Exception("No supported depth format.");
+}
+
 VkPresentModeKHR GALPlatform::ChoosePresentMode() {
   uint32_t present_modes_count = 0;
   vkGetPhysicalDeviceSurfacePresentModesKHR(vk_physical_device_, vk_surface_, &present_modes_count, 
@@ -470,9 +1537,16 @@ VkPresentModeKHR GALPlatform::ChoosePresentMode() {
   vkGetPhysicalDeviceSurfacePresentModesKHR(vk_physical_device_, vk_surface_, &present_modes_count,
                                             present_modes.data());
 
-  for (const VkPresentModeKHR& present_mode : present_modes) {
-    if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return present_mode;
+  // FIFO is the only mode that is guaranteed to be supported.
+  std::vector<VkPresentModeKHR> candidates = { GetVkPresentMode(options_.present_mode) };
+  if (options_.present_mode == PresentMode::Immediate) {
+    candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+  }
+
+  for (VkPresentModeKHR candidate : candidates) {
+    if (std::find(present_modes.begin(), present_modes.end(), candidate) 
+            != present_modes.end()) {
+      return candidate;
     }
   }
     
@@ -495,7 +1569,7 @@ VkExtent2D GALPlatform::ChooseSwapExtent() {
     uint32_t max_height = surface_capabilities.maxImageExtent.height;
     uint32_t window_height = window_->GetHeight();
 
-    extent.width = std::max(min_width, std::min(window_height, max_height));
+    extent.width = std::max(min_width, std::min(window_width, max_width));
     extent.height = std::max(min_height, std::min(window_height, max_height));
 
     return extent;
@@ -3,10 +3,22 @@
 
 #include <vulkan/vulkan.h>
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 #include <vector>
+#include "gal/gal_bindless_table.h"
+#include "gal/gal_descriptor_cache.h"
 #include "gal/gal_exception.h"
+#include "gal/gal_memory_allocator.h"
+#include "gal/gal_pipeline_cache.h"
+#include "gal/gal_pipeline_registry.h"
+#include "gal/gal_profiler.h"
+#include "gal/gal_uniform_ring.h"
+#include "gal/gal_upload_manager.h"
+#include "gal/gal_worker_pool.h"
 #include "window/window.h"
 
 namespace gal {
@@ -16,57 +28,316 @@ class GALCommandBuffer;
 
 class GALPlatform {
 public:
-  GALPlatform(window::Window* window);
+  enum class PresentMode {
+    // Presents as soon as possible, and may tear.
+    Immediate,
+
+    // Presents at the next vertical blank, replacing any image that is already queued.
+    Mailbox,
+
+    // Queues images for consecutive vertical blanks. Always supported.
+    Fifo,
+
+    // Like Fifo, but presents right away, and may tear, when a vertical blank was missed.
+    FifoRelaxed
+  };
+
+  // Trades latency for throughput. The defaults keep 2 frames in flight with mailbox present.
+  struct Options {
+    // Frames that the CPU may record ahead of the GPU. More frames keep the GPU busy through CPU
+    // hitches, but every queued frame adds a frame of latency. At least 1.
+    uint32_t frames_in_flight = 2;
+
+    // Immediate falls back to Mailbox, and every mode falls back to Fifo if it is not supported.
+    // Ignored in headless mode.
+    PresentMode present_mode = PresentMode::Mailbox;
+
+    // Swapchain images requested on top of the surface's minimum, clamped to its maximum.
+    // Ignored in headless mode.
+    uint32_t extra_swapchain_images = 1;
+
+    // Sleeps in StartTick() so that each frame is submitted about when the GPU finishes the
+    // previous one, instead of as early as frames_in_flight allows. Input is then sampled as late
+    // as possible, which bounds input-to-photon latency. Needs frames_in_flight of at least 2, or
+    // the constructor throws.
+    bool frame_pacing = false;
+
+    // Creates a GALBindlessTable for pipelines built with GALPipeline::Builder::SetBindless().
+    // Needs descriptor indexing, which is core in Vulkan 1.2 and VK_EXT_descriptor_indexing on
+    // Vulkan 1.1. Without it, GetBindlessTable() is null and descriptor sets are bound per draw.
+    bool bindless = false;
+
+    // Enables the validation layers, and a debug messenger that prints their warnings and errors,
+    // if they are installed. They slow down every Vulkan call, so they are off by default in
+    // release builds and in Throughput().
+#ifdef NDEBUG
+    bool validation = false;
+#else
+    bool validation = true;
+#endif
+
+    // For interactive use.
+    static Options LowLatency();
+
+    // For batch rendering, where only the frame rate matters.
+    static Options Throughput();
+  };
+
+  // Creates a platform that presents to the window's surface through a swapchain.
+  GALPlatform(window::Window* window, const Options& options);
+
+  // Creates a headless platform. Frames are rendered into device-owned offscreen images of the
+  // given size instead of swapchain images, and nothing is presented.
+  GALPlatform(uint32_t width, uint32_t height, const Options& options);
+
   ~GALPlatform();
 
-  void StartTick();
+  // Returns false if there is no image to render into, e.g. while the window is minimized. The
+  // frame must then be skipped, without calling ExecuteCommandBuffer() or EndTick().
+  //
+  // With Options::frame_pacing, this first sleeps until the GPU is predicted to finish the
+  // previous frame, less the time the CPU usually takes from here until the frame is submitted.
+  // The GPU's frame time is measured from each frame's submission, or from the previous frame
+  // finishing if it was queued behind it, until its fence is seen to signal. The sleep is cut
+  // short if the GPU goes idle early.
+  //
+  // The swapchain is recreated here once the window has been resized, or once acquiring or
+  // presenting reports it as out of date or suboptimal. Persistent command buffers whose
+  // IsOutOfDate() is then true must be recorded again before they are executed.
+  //
+  // Once this returns true, ExecuteCommandBuffer() must be called exactly once before EndTick(),
+  // since the acquired image can only be released by presenting it.
+  bool StartTick();
   void EndTick();
 
+  // Submits the command buffer and presents the image acquired by StartTick(). If command_buffer
+  // is null, e.g. because recording it failed, or was recorded for an older swapchain, a cleared
+  // image is presented in its place and false is returned. If the frame cannot be submitted at
+  // all, false is returned too, and the swapchain is recreated by the next StartTick() to release
+  // the acquired image.
   bool ExecuteCommandBuffer(GALCommandBuffer* command_buffer);
 
+  // Waits for every submitted frame to finish, e.g. before reading back results.
+  void WaitIdle();
+
+  bool IsHeadless() const { return window_ == nullptr; }
+
+  const Options& GetOptions() const { return options_; }
+
+  // Must be called before any GALCommandBuffer is recorded, since the profiler's queries are
+  // recorded into the command buffers.
+  void EnableProfiler(const GALProfiler::Options& options);
+
+  // Null unless EnableProfiler() has been called.
+  GALProfiler* GetProfiler() { return profiler_.get(); }
+
+  // Loads the pipeline cache from the file at path, and saves it back there when the platform
+  // is destroyed. Must be called before any GALPipeline is created to have an effect.
+  void EnablePipelineCache(const std::string& path);
+
+  // Null unless EnablePipelineCache() has been called.
+  GALPipelineCache* GetPipelineCache() { return pipeline_cache_.get(); }
+
+  GALPipelineRegistry* GetPipelineRegistry() { return pipeline_registry_.get(); }
+
+  // Starts worker threads that GALCommandBuffer::SubmitCommandsParallel() records on. A
+  // worker_count of 0 picks one worker per hardware thread, leaving one for the caller.
+  void EnableWorkerThreads(uint32_t worker_count);
+
+  // Null unless EnableWorkerThreads() has been called.
+  GALWorkerPool* GetWorkerPool() { return worker_pool_.get(); }
+
+  // Null unless Options::bindless is set and the device supports descriptor indexing.
+  GALBindlessTable* GetBindlessTable() { return bindless_table_.get(); }
+
+  // Whether secondary command buffers can be executed while the profiler's pipeline statistics
+  // query is active.
+  bool IsInheritedQueriesEnabled() const { return inherited_queries_enabled_; }
+
+  // Whether one indirect draw can draw more than one record. GALCommandBuffer draws the records
+  // one at a time otherwise.
+  bool IsMultiDrawIndirectEnabled() const { return multi_draw_indirect_enabled_; }
+
+  // Whether indirect draw records may have a non-zero firstInstance.
+  bool IsDrawIndirectFirstInstanceEnabled() const {
+    return draw_indirect_first_instance_enabled_;
+  }
+
+  // vkCmdDrawIndexedIndirectCountKHR, or null if VK_KHR_draw_indirect_count is not supported.
+  PFN_vkCmdDrawIndexedIndirectCountKHR GetDrawIndexedIndirectCountFunction() const {
+    return vk_cmd_draw_indexed_indirect_count_;
+  }
+
   VkPhysicalDevice GetVkPhysicalDevice() { return vk_physical_device_; }
   VkDevice GetVkDevice() { return vk_device_; }
   const VkExtent2D& GetVkSwapchainExtent() const { return vk_swapchain_extent_; }
   const VkFormat& GetVkSwapchainImageFormat() const { return vk_swapchain_image_format_; }
+
+  // In headless mode, these are the views of the offscreen images.
   const std::vector<VkImageView>& GetSwapchainImageViews() const {
     return vk_swapchain_image_views_;
   }
+
+  // The layout that render passes should leave the swapchain (or offscreen) images in.
+  VkImageLayout GetVkFinalImageLayout() const;
+
+  // The format of the depth buffers, which are cleared to 1 at the start of every frame.
+  VkFormat GetVkDepthFormat() const { return vk_depth_format_; }
+
+  // The render pass that every GALPipeline renders in, with a colour and a depth attachment, and
+  // its framebuffer for each swapchain image. The render pass stays the same when the swapchain
+  // is recreated, so pipelines do not need to be, but the framebuffers are replaced.
+  VkRenderPass GetVkRenderPass() const { return vk_render_pass_; }
+  VkFramebuffer GetVkFramebuffer(uint32_t image_idx) const { return vk_framebuffers_[image_idx]; }
+
+  // Incremented every time the swapchain is recreated. Command buffers that were recorded for an
+  // older generation refer to framebuffers that no longer exist.
+  uint32_t GetSwapchainGeneration() const { return swapchain_generation_; }
+
+  GALMemoryAllocator* GetMemoryAllocator() { return memory_allocator_.get(); }
+  GALUploadManager* GetUploadManager() { return upload_manager_.get(); }
+
+  // The current frame's partition is reset by StartTick().
+  GALUniformRing* GetUniformRing() { return uniform_ring_.get(); }
+
+  // The current frame's sets are reset by StartTick() when needed.
+  GALDescriptorCache* GetDescriptorCache() { return descriptor_cache_.get(); }
+
   VkCommandPool GetVkCommandPool() { return vk_command_pool_; }
+
+  // Transient pool for command buffers that are recorded every frame. It is reset in bulk by
+  // StartTick() once the frame's previous submission has finished.
+  VkCommandPool GetFrameCommandPool(uint32_t frame) { return vk_frame_command_pools_[frame]; }
+
+  uint32_t GetFramesInFlight() const {
+    return static_cast<uint32_t>(vk_in_flight_fences_.size());
+  }
+
+  // Only meaningful between StartTick() and EndTick().
+  uint32_t GetCurrentFrame() const { return current_frame_; }
+  uint32_t GetCurrentImageIndex() const { return current_image_index_; }
   VkQueue GetVkGraphicsQueue() { return vk_graphics_queue_; }
+  uint32_t GetGraphicsQueueFamilyIndex() const { return graphics_queue_family_index_; }
 
 private:
   struct PhysicalDeviceInfo {
     uint32_t graphics_queue_family_index;
     uint32_t present_queue_family_index;
+
+    // Equal to graphics_queue_family_index if there is no dedicated transfer queue family.
+    uint32_t transfer_queue_family_index;
   };
 
+  void CreateInstance();
+  void CreateDevice();
+  void CreateSwapchain();
+  void CreateOffscreenImages(uint32_t width, uint32_t height);
+  void CreateRenderPass();
+  void CreateDepthImages();
+  void DestroyDepthImages();
+  void CreateFramebuffers();
+  void CreateCommandPoolAndSyncObjects();
+
+  // Returns false if the swapchain cannot be recreated at the window's current size.
+  bool RecreateSwapchain();
+  bool AcquireSwapchainImage();
+
+  void PaceFrame();
+  void UpdateFramePacing();
+
+  // Waits up to timeout_ns for the frame's fence, and returns whether it signaled. The first time
+  // a submitted frame is seen done, its GPU time is added to the frame pacing estimate.
+  bool WaitForFrame(uint32_t frame, uint64_t timeout_ns);
+
+  // profiled is false for frames whose command buffer does not write the profiler's queries.
+  bool SubmitFrame(const VkSubmitInfo& submit_info, bool profiled);
+
+  // Called when the current frame could not be submitted. Leaves the frame's acquire semaphore
+  // unsignaled and its fence signaled, so that the frame can be started again.
+  void AbandonFrame();
+
+  // Records a command buffer that only clears the current image and leaves it in the final
+  // layout. VK_NULL_HANDLE if it cannot be recorded.
+  VkCommandBuffer RecordClearFrame();
+
   std::optional<PhysicalDeviceInfo> ChoosePhysicalDevice();
 
+  // Returns false, and enables nothing, unless the device supports every descriptor indexing
+  // feature that GALBindlessTable needs.
+  bool EnableDescriptorIndexing(const std::vector<VkExtensionProperties>& available_extensions,
+                                std::vector<const char*>* device_extensions,
+                                VkPhysicalDeviceFeatures* enabled_features,
+                                VkPhysicalDeviceDescriptorIndexingFeatures* indexing_features);
+
   VkSurfaceFormatKHR ChooseSurfaceFormat();
+  VkFormat ChooseDepthFormat();
   VkPresentModeKHR ChoosePresentMode();
   VkExtent2D ChooseSwapExtent();
 
 private:
-  window::Window* window_;
+  Options options_;
+
+  // Null in headless mode.
+  window::Window* window_ = nullptr;
 
   VkInstance vk_instance_;
-  VkDebugUtilsMessengerEXT vk_debug_messenger_;
-  VkSurfaceKHR vk_surface_;
+
+  // The apiVersion that the instance was created with.
+  uint32_t instance_api_version_ = VK_API_VERSION_1_0;
+  VkDebugUtilsMessengerEXT vk_debug_messenger_ = VK_NULL_HANDLE;
+  VkSurfaceKHR vk_surface_ = VK_NULL_HANDLE;
+
+  std::vector<const char*> validation_layers_;
 
   VkPhysicalDevice vk_physical_device_;
   VkDevice vk_device_;
   VkQueue vk_graphics_queue_;
   VkQueue vk_present_queue_;
+  VkQueue vk_transfer_queue_;
+
+  std::unique_ptr<GALMemoryAllocator> memory_allocator_;
+  std::unique_ptr<GALUploadManager> upload_manager_;
+  std::unique_ptr<GALUniformRing> uniform_ring_;
+  std::unique_ptr<GALDescriptorCache> descriptor_cache_;
+
+  uint32_t graphics_queue_family_index_ = 0;
+  uint32_t present_queue_family_index_ = 0;
+  uint32_t transfer_queue_family_index_ = 0;
 
-  VkSwapchainKHR vk_swapchain_;
+  VkSwapchainKHR vk_swapchain_ = VK_NULL_HANDLE;
   VkFormat vk_swapchain_image_format_;
   VkExtent2D vk_swapchain_extent_;
 
+  // Chosen once, so that the render pass stays compatible with recreated swapchains.
+  VkSurfaceFormatKHR vk_surface_format_{};
+
+  // Set once the swapchain has to be recreated before the next image is acquired.
+  bool swapchain_out_of_date_ = false;
+  uint32_t swapchain_generation_ = 0;
+
+  VkRenderPass vk_render_pass_ = VK_NULL_HANDLE;
+
+  // One per swapchain image.
+  std::vector<VkFramebuffer> vk_framebuffers_;
+
   VkCommandPool vk_command_pool_;
+  std::vector<VkCommandPool> vk_frame_command_pools_;
+
+  // One per frame in flight, allocated from its pool the first time RecordClearFrame() needs it.
+  std::vector<VkCommandBuffer> vk_clear_command_buffers_;
 
   std::vector<VkImage> vk_swapchain_images_;
   std::vector<VkImageView> vk_swapchain_image_views_;
 
+  // Backing memory for the offscreen images. Only used in headless mode.
+  std::vector<GALMemoryAllocator::Allocation> offscreen_image_allocations_;
+
+  // One per swapchain image. Recreated with the swapchain.
+  VkFormat vk_depth_format_ = VK_FORMAT_UNDEFINED;
+  std::vector<VkImage> vk_depth_images_;
+  std::vector<VkImageView> vk_depth_image_views_;
+  std::vector<GALMemoryAllocator::Allocation> depth_image_allocations_;
+
   std::vector<VkSemaphore> vk_image_available_semaphores_;
   std::vector<VkSemaphore> vk_render_finished_semaphores_;
   std::vector<VkFence> vk_in_flight_fences_;
@@ -74,6 +345,35 @@ private:
 
   uint32_t current_image_index_ = 0;
   uint32_t current_frame_ = 0;
+
+  // When each frame in flight was last submitted. Empty until the frame's first submission.
+  std::vector<std::optional<std::chrono::steady_clock::time_point>> frame_submit_times_;
+
+  // Whether each frame in flight has been seen done since it was last submitted.
+  std::vector<bool> frame_gpu_done_;
+
+  // When the GPU was last seen to finish a frame.
+  std::chrono::steady_clock::time_point last_gpu_done_time_{};
+
+  // Smoothed GPU time per frame, and CPU time from the end of frame pacing until submission.
+  std::chrono::steady_clock::duration gpu_frame_time_{};
+  std::chrono::steady_clock::duration cpu_frame_time_{};
+
+  // When StartTick() last finished frame pacing.
+  std::chrono::steady_clock::time_point pacing_wake_time_{};
+
+  std::unique_ptr<GALProfiler> profiler_;
+
+  bool pipeline_creation_feedback_supported_ = false;
+  std::unique_ptr<GALPipelineCache> pipeline_cache_;
+  std::unique_ptr<GALPipelineRegistry> pipeline_registry_;
+
+  bool inherited_queries_enabled_ = false;
+  bool multi_draw_indirect_enabled_ = false;
+  bool draw_indirect_first_instance_enabled_ = false;
+  PFN_vkCmdDrawIndexedIndirectCountKHR vk_cmd_draw_indexed_indirect_count_ = nullptr;
+  std::unique_ptr<GALWorkerPool> worker_pool_;
+  std::unique_ptr<GALBindlessTable> bindless_table_;
 };
 
 } // namespace gal
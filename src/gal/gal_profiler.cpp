@@ -0,0 +1,355 @@
+#include "gal/gal_profiler.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+namespace {
+
+// Timestamp queries 0 and 1 of each query set hold the frame begin and end. Scope i uses
+// queries 2 + 2i and 3 + 2i.
+const uint32_t kFrameBeginQuery = 0;
+const uint32_t kFrameEndQuery = 1;
+const uint32_t kNumTimestampQueries = 2 + 2 * GALProfiler::kMaxScopes;
+
+struct PipelineStatistic {
+  VkQueryPipelineStatisticFlags flag;
+  const char* name;
+};
+
+// Ordered by bit, which is the order that the results are written in.
+const PipelineStatistic kPipelineStatistics[] = {
+  { VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT, "pipeline/ia_vertices" },
+  { VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT, "pipeline/ia_primitives" },
+  { VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT, "pipeline/vs_invocations" },
+  { VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT, "pipeline/clip_invocations" },
+  { VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT, "pipeline/clip_primitives" },
+  { VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT, "pipeline/fs_invocations" }
+};
+
+const char* GetCpuTimerName(GALProfiler::CpuTimer timer) {
+  switch (timer) {
+  case GALProfiler::CpuTimer::FenceWait:
+    return "cpu/fence_wait";
+  case GALProfiler::CpuTimer::Acquire:
+    return "cpu/acquire";
+  case GALProfiler::CpuTimer::Submit:
+    return "cpu/submit";
+  case GALProfiler::CpuTimer::Present:
+    return "cpu/present";
+  case GALProfiler::CpuTimer::FramePacing:
+    return "cpu/frame_pacing";
+  }
+  return "cpu/unknown";
+}
+
+} // namespace
+
+GALProfiler::GALProfiler(VkPhysicalDevice vk_physical_device, VkDevice vk_device, 
+                         uint32_t queue_family_index, uint32_t num_query_sets, 
+                         uint32_t num_frames_in_flight, const Options& options) 
+    : vk_device_(vk_device), options_(options) {
+  if (options_.history_size == 0) {
+    throw Exception("Profiler history size cannot be zero.");
+  }
+
+  VkPhysicalDeviceProperties device_props;
+  vkGetPhysicalDeviceProperties(vk_physical_device, &device_props);
+
+  uint32_t queue_families_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_families_count, nullptr);
+
+  std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_families_count, 
+                                           queue_families.data());
+
+  uint32_t timestamp_valid_bits = queue_families[queue_family_index].timestampValidBits;
+  if (timestamp_valid_bits != 0) {
+    timestamp_period_ns_ = device_props.limits.timestampPeriod;
+    timestamp_mask_ = timestamp_valid_bits >= 64 ? 
+        UINT64_MAX : (uint64_t(1) << timestamp_valid_bits) - 1;
+  } else {
+    std::cerr << "Queue does not support timestamps. Only CPU timings will be profiled." 
+              << std::endl;
+  }
+
+  if (options_.pipeline_statistics) {
+    VkPhysicalDeviceFeatures device_features;
+    vkGetPhysicalDeviceFeatures(vk_physical_device, &device_features);
+
+    if (!device_features.pipelineStatisticsQuery) {
+      std::cerr << "Pipeline statistics queries are not supported." << std::endl;
+      options_.pipeline_statistics = false;
+    }
+  }
+
+  if (options_.pipeline_statistics) {
+    for (const PipelineStatistic& statistic : kPipelineStatistics) {
+      pipeline_statistics_flags_ |= statistic.flag;
+      pipeline_stat_names_.push_back(statistic.name);
+    }
+  }
+
+  CreateQueryPools(num_query_sets);
+
+  frame_query_sets_.resize(num_frames_in_flight);
+
+  // Each result is followed by its availability value.
+  query_results_.resize(2 * std::max<size_t>(kNumTimestampQueries, 
+                                             std::size(kPipelineStatistics) + 1));
+}
+
+void GALProfiler::CreateQueryPools(uint32_t num_query_sets) {
+  if (HasGpuTimestamps()) {
+    VkQueryPoolCreateInfo query_pool_create_info{};
+    query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_create_info.queryCount = kNumTimestampQueries;
+
+    while (vk_timestamp_query_pools_.size() < num_query_sets) {
+      VkQueryPool query_pool;
+      if (vkCreateQueryPool(vk_device_, &query_pool_create_info, nullptr, &query_pool) 
+              != VK_SUCCESS) {
+        throw Exception("Could not create timestamp query pool.");
+      }
+      vk_timestamp_query_pools_.push_back(query_pool);
+    }
+  }
+
+  if (options_.pipeline_statistics) {
+    VkQueryPoolCreateInfo query_pool_create_info{};
+    query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    query_pool_create_info.queryCount = 1;
+    query_pool_create_info.pipelineStatistics = pipeline_statistics_flags_;
+
+    while (vk_pipeline_stats_query_pools_.size() < num_query_sets) {
+      VkQueryPool query_pool;
+      if (vkCreateQueryPool(vk_device_, &query_pool_create_info, nullptr, &query_pool) 
+              != VK_SUCCESS) {
+        throw Exception("Could not create pipeline statistics query pool.");
+      }
+      vk_pipeline_stats_query_pools_.push_back(query_pool);
+    }
+  }
+
+  if (query_set_pending_.size() < num_query_sets) {
+    query_set_pending_.resize(num_query_sets, false);
+  }
+}
+
+GALProfiler::~GALProfiler() {
+  for (VkQueryPool query_pool : vk_timestamp_query_pools_) {
+    vkDestroyQueryPool(vk_device_, query_pool, nullptr);
+  }
+  for (VkQueryPool query_pool : vk_pipeline_stats_query_pools_) {
+    vkDestroyQueryPool(vk_device_, query_pool, nullptr);
+  }
+}
+
+std::optional<GALProfiler::Stats> GALProfiler::GetStats(const std::string& name) const {
+  auto it = stats_.find(name);
+  if (it == stats_.end()) {
+    return std::nullopt;
+  }
+  return it->second.Compute();
+}
+
+std::vector<std::string> GALProfiler::GetStatNames() const {
+  std::vector<std::string> names;
+  for (const auto& [name, stat] : stats_) {
+    names.push_back(name);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+void GALProfiler::RecordFrameBegin(VkCommandBuffer command_buffer, uint32_t query_set) {
+  if (HasGpuTimestamps()) {
+    vkCmdResetQueryPool(command_buffer, vk_timestamp_query_pools_[query_set], 0, 
+                        kNumTimestampQueries);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
+                        vk_timestamp_query_pools_[query_set], kFrameBeginQuery);
+  }
+
+  if (options_.pipeline_statistics) {
+    vkCmdResetQueryPool(command_buffer, vk_pipeline_stats_query_pools_[query_set], 0, 1);
+    vkCmdBeginQuery(command_buffer, vk_pipeline_stats_query_pools_[query_set], 0, 0);
+  }
+}
+
+void GALProfiler::RecordFrameEnd(VkCommandBuffer command_buffer, uint32_t query_set) {
+  if (options_.pipeline_statistics) {
+    vkCmdEndQuery(command_buffer, vk_pipeline_stats_query_pools_[query_set], 0);
+  }
+
+  if (HasGpuTimestamps()) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 
+                        vk_timestamp_query_pools_[query_set], kFrameEndQuery);
+  }
+}
+
+void GALProfiler::RecordScopeBegin(VkCommandBuffer command_buffer, uint32_t query_set, 
+                                   uint32_t scope_id) {
+  if (HasGpuTimestamps()) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
+                        vk_timestamp_query_pools_[query_set], 2 + 2 * scope_id);
+  }
+}
+
+void GALProfiler::RecordScopeEnd(VkCommandBuffer command_buffer, uint32_t query_set, 
+                                 uint32_t scope_id) {
+  if (HasGpuTimestamps()) {
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 
+                        vk_timestamp_query_pools_[query_set], 3 + 2 * scope_id);
+  }
+}
+
+std::optional<uint32_t> GALProfiler::GetScopeId(const std::string& name) {
+  std::string stat_name = "gpu/" + name;
+
+  auto it = std::find(scope_names_.begin(), scope_names_.end(), stat_name);
+  if (it != scope_names_.end()) {
+    return static_cast<uint32_t>(it - scope_names_.begin());
+  }
+
+  if (scope_names_.size() >= kMaxScopes) {
+    return std::nullopt;
+  }
+
+  scope_names_.push_back(std::move(stat_name));
+  return static_cast<uint32_t>(scope_names_.size() - 1);
+}
+
+void GALProfiler::OnFrameFenceSignaled(uint32_t frame) {
+  if (frame_query_sets_[frame].has_value()) {
+    CollectQuerySet(frame_query_sets_[frame].value());
+    frame_query_sets_[frame].reset();
+  }
+}
+
+void GALProfiler::OnQuerySetIdle(uint32_t query_set) {
+  CollectQuerySet(query_set);
+}
+
+void GALProfiler::OnFrameSubmitted(uint32_t frame, uint32_t query_set) {
+  frame_query_sets_[frame] = query_set;
+  query_set_pending_[query_set] = true;
+}
+
+void GALProfiler::OnSwapchainRecreated(uint32_t num_query_sets) {
+  CreateQueryPools(num_query_sets);
+}
+
+void GALProfiler::AddCpuTime(CpuTimer timer, std::chrono::steady_clock::duration duration) {
+  AddSample(GetCpuTimerName(timer), 
+            std::chrono::duration<double, std::milli>(duration).count());
+}
+
+void GALProfiler::CollectQuerySet(uint32_t query_set) {
+  if (!query_set_pending_[query_set]) {
+    return;
+  }
+  query_set_pending_[query_set] = false;
+
+  // The frame's fence has signaled, so every query that was written is available. Queries that
+  // were not written this frame (e.g. scopes that were not recorded) are skipped by checking
+  // availability, rather than waiting on them.
+  VkQueryResultFlags result_flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+  if (HasGpuTimestamps()) {
+    uint32_t query_count = 2 + 2 * static_cast<uint32_t>(scope_names_.size());
+
+    VkResult result = vkGetQueryPoolResults(
+        vk_device_, vk_timestamp_query_pools_[query_set], 0, query_count, 
+        query_count * 2 * sizeof(uint64_t), query_results_.data(), 2 * sizeof(uint64_t), 
+        result_flags);
+
+    if (result == VK_SUCCESS || result == VK_NOT_READY) {
+      auto get_duration_ms = [this](uint32_t begin_query, uint32_t end_query) 
+          -> std::optional<double> {
+        if (query_results_[2 * begin_query + 1] == 0 || query_results_[2 * end_query + 1] == 0) {
+          return std::nullopt;
+        }
+        uint64_t begin = query_results_[2 * begin_query] & timestamp_mask_;
+        uint64_t end = query_results_[2 * end_query] & timestamp_mask_;
+        return ((end - begin) & timestamp_mask_) * timestamp_period_ns_ / 1e6;
+      };
+
+      std::optional<double> frame_ms = get_duration_ms(kFrameBeginQuery, kFrameEndQuery);
+      if (frame_ms.has_value()) {
+        AddSample("gpu/frame", frame_ms.value());
+      }
+
+      for (uint32_t i = 0; i < scope_names_.size(); ++i) {
+        std::optional<double> scope_ms = get_duration_ms(2 + 2 * i, 3 + 2 * i);
+        if (scope_ms.has_value()) {
+          AddSample(scope_names_[i], scope_ms.value());
+        }
+      }
+    }
+  }
+
+  if (options_.pipeline_statistics) {
+    size_t stats_count = pipeline_stat_names_.size();
+
+    VkResult result = vkGetQueryPoolResults(
+        vk_device_, vk_pipeline_stats_query_pools_[query_set], 0, 1, 
+        (stats_count + 1) * sizeof(uint64_t), query_results_.data(), 
+        (stats_count + 1) * sizeof(uint64_t), result_flags);
+
+    if (result == VK_SUCCESS && query_results_[stats_count] != 0) {
+      for (size_t i = 0; i < stats_count; ++i) {
+        AddSample(pipeline_stat_names_[i], static_cast<double>(query_results_[i]));
+      }
+    }
+  }
+}
+
+void GALProfiler::AddSample(const std::string& name, double value) {
+  auto it = stats_.find(name);
+  if (it == stats_.end()) {
+    it = stats_.emplace(name, RollingStat(options_.history_size)).first;
+  }
+  it->second.Add(value);
+}
+
+void GALProfiler::RollingStat::Add(double value) {
+  samples_[next_] = value;
+  next_ = (next_ + 1) % samples_.size();
+  num_samples_ = std::min<uint32_t>(num_samples_ + 1, samples_.size());
+}
+
+GALProfiler::Stats GALProfiler::RollingStat::Compute() const {
+  Stats stats;
+  stats.num_samples = num_samples_;
+  if (num_samples_ == 0) {
+    return stats;
+  }
+
+  std::vector<double> sorted(samples_.begin(), samples_.begin() + num_samples_);
+
+  double sum = 0.0;
+  for (double sample : sorted) {
+    sum += sample;
+  }
+  stats.avg = sum / num_samples_;
+
+  size_t p99_index = static_cast<size_t>(std::ceil(0.99 * num_samples_)) - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + p99_index, sorted.end());
+  stats.p99 = sorted[p99_index];
+  stats.min = *std::min_element(sorted.begin(), sorted.begin() + p99_index + 1);
+
+  return stats;
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,139 @@
+#ifndef GAL_GAL_PROFILER_H_
+#define GAL_GAL_PROFILER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gal {
+
+// Collects GPU timestamps, optional pipeline statistics and CPU-side timings for each frame.
+//
+// GPU queries are recorded into one query set per recorded VkCommandBuffer (i.e. per swapchain
+// image). A ring with one entry per frame in flight remembers which query set each frame used,
+// and results are only read back once that frame's fence has signaled, so reading never stalls.
+//
+// Every value is kept in a rolling window per named stat:
+//   "gpu/frame", "gpu/<scope name>"      - GPU time in milliseconds.
+//   "cpu/fence_wait", "cpu/acquire",
+//   "cpu/submit", "cpu/present",
+//   "cpu/frame_pacing"                   - CPU time in milliseconds.
+//   "pipeline/<counter>"                 - Pipeline statistics counts per frame.
+class GALProfiler {
+public:
+  struct Options {
+    // Requires the pipelineStatisticsQuery device feature. Ignored if it is not supported.
+    bool pipeline_statistics = false;
+
+    // Number of samples each stat keeps.
+    uint32_t history_size = 256;
+  };
+
+  struct Stats {
+    double min = 0.0;
+    double avg = 0.0;
+    double p99 = 0.0;
+    uint32_t num_samples = 0;
+  };
+
+  enum class CpuTimer {
+    FenceWait,
+    Acquire,
+    Submit,
+    Present,
+    FramePacing
+  };
+
+  GALProfiler(VkPhysicalDevice vk_physical_device, VkDevice vk_device, 
+              uint32_t queue_family_index, uint32_t num_query_sets, 
+              uint32_t num_frames_in_flight, const Options& options);
+  ~GALProfiler();
+
+  std::optional<Stats> GetStats(const std::string& name) const;
+  std::vector<std::string> GetStatNames() const;
+
+  bool HasGpuTimestamps() const { return timestamp_period_ns_ > 0.0; }
+
+  // The statistics counted by the query that is active for the whole frame. 0 if pipeline
+  // statistics are disabled. Secondary command buffers must inherit these.
+  VkQueryPipelineStatisticFlags GetPipelineStatisticsFlags() const {
+    return pipeline_statistics_flags_;
+  }
+
+  // Recording - called by GALCommandBuffer for each of its VkCommandBuffers. query_set is the
+  // index of the VkCommandBuffer.
+  void RecordFrameBegin(VkCommandBuffer command_buffer, uint32_t query_set);
+  void RecordFrameEnd(VkCommandBuffer command_buffer, uint32_t query_set);
+  void RecordScopeBegin(VkCommandBuffer command_buffer, uint32_t query_set, uint32_t scope_id);
+  void RecordScopeEnd(VkCommandBuffer command_buffer, uint32_t query_set, uint32_t scope_id);
+
+  // Returns std::nullopt if there are already kMaxScopes scopes.
+  std::optional<uint32_t> GetScopeId(const std::string& name);
+
+  // Frame lifecycle - called by GALPlatform.
+  void OnFrameFenceSignaled(uint32_t frame);
+  void OnQuerySetIdle(uint32_t query_set);
+  void OnFrameSubmitted(uint32_t frame, uint32_t query_set);
+
+  // Adds query sets if the recreated swapchain has more images than before. Sets are never
+  // removed, so that ones still referenced by a frame stay valid.
+  void OnSwapchainRecreated(uint32_t num_query_sets);
+
+  void AddCpuTime(CpuTimer timer, std::chrono::steady_clock::duration duration);
+
+  static const uint32_t kMaxScopes = 64;
+
+private:
+  class RollingStat {
+  public:
+    RollingStat(uint32_t history_size) : samples_(history_size) {}
+
+    void Add(double value);
+    Stats Compute() const;
+
+  private:
+    std::vector<double> samples_;
+    uint32_t next_ = 0;
+    uint32_t num_samples_ = 0;
+  };
+
+  // Creates query pools until there are num_query_sets of each kind in use.
+  void CreateQueryPools(uint32_t num_query_sets);
+
+  void CollectQuerySet(uint32_t query_set);
+  void AddSample(const std::string& name, double value);
+
+private:
+  VkDevice vk_device_;
+
+  Options options_;
+
+  // Nanoseconds per timestamp tick. 0 if the queue does not support timestamps.
+  double timestamp_period_ns_ = 0.0;
+  uint64_t timestamp_mask_ = 0;
+
+  std::vector<VkQueryPool> vk_timestamp_query_pools_;
+  std::vector<VkQueryPool> vk_pipeline_stats_query_pools_;
+  VkQueryPipelineStatisticFlags pipeline_statistics_flags_ = 0;
+  std::vector<bool> query_set_pending_;
+
+  // Ring indexed by frame in flight. Holds the query set that the frame was submitted with.
+  std::vector<std::optional<uint32_t>> frame_query_sets_;
+
+  std::vector<std::string> scope_names_;
+  std::vector<std::string> pipeline_stat_names_;
+
+  std::unordered_map<std::string, RollingStat> stats_;
+
+  // Scratch space for query results, so that collection does not allocate.
+  std::vector<uint64_t> query_results_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_PROFILER_H_
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "gal/gal_render_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include "gal/gal_commands.h"
+
+namespace gal {
+
+namespace {
+
+// Bits of each field of the sort key. Ids past the largest that fits share it, which only costs
+// some grouping, since draws are only merged if their state really matches.
+const int kIdBits = 10;
+const int kDepthBits = 23;
+
+const uint32_t kMaxId = (1u << kIdBits) - 1;
+const uint32_t kMaxDepth = (1u << kDepthBits) - 1;
+
+// 8 passes of 8 bits.
+const int kRadixBits = 8;
+const size_t kRadixBuckets = size_t{1} << kRadixBits;
+
+template <typename Key, typename Hash>
+uint32_t GetOrAssignId(std::unordered_map<Key, uint32_t, Hash>* ids, const Key& key) {
+  auto it = ids->try_emplace(key, static_cast<uint32_t>(ids->size())).first;
+  return std::min(it->second, kMaxId);
+}
+
+} // namespace
+
+size_t GALRenderQueue::MeshKeyHash::operator()(const MeshKey& key) const {
+  size_t hash = std::hash<const void*>()(key.index_buffer);
+  for (uint32_t value : {key.index_count, key.first_index, 
+                         static_cast<uint32_t>(key.vertex_offset)}) {
+    hash ^= std::hash<uint32_t>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+GALRenderQueue::GALRenderQueue(uint32_t instance_stride, int instance_buffer_idx)
+    : instance_stride_(instance_stride), instance_buffer_idx_(instance_buffer_idx) {}
+
+void GALRenderQueue::SetDepthRange(float near_depth, float far_depth) {
+  near_depth_ = near_depth;
+  far_depth_ = far_depth;
+}
+
+void GALRenderQueue::AddUniformData(const command::SetUniformData& command) {
+  uniform_data_.push_back(command);
+}
+
+void GALRenderQueue::AddPushConstants(const command::PushConstants& command) {
+  size_t offset = push_constant_data_.size();
+  push_constant_data_.resize(offset + command.size);
+  memcpy(push_constant_data_.data() + offset, command.data, command.size);
+
+  push_constants_.push_back(command);
+  push_constant_offsets_.push_back(offset);
+}
+
+void GALRenderQueue::Add(const Draw& draw) {
+  if (draw.pipeline == nullptr || draw.vertex_buffer == nullptr || 
+      draw.index_buffer == nullptr) {
+    std::cerr << "Draw was added to the render queue without a pipeline and buffers." 
+              << std::endl;
+    return;
+  }
+
+  draws_.push_back(draw);
+  sort_keys_.push_back(MakeSortKey(draw));
+
+  if (instance_stride_ > 0) {
+    size_t offset = instance_data_.size();
+    instance_data_.resize(offset + instance_stride_);
+    memcpy(instance_data_.data() + offset, draw.instance_data, instance_stride_);
+  }
+}
+
+uint64_t GALRenderQueue::MakeSortKey(const Draw& draw) {
+  uint64_t pipeline_id = GetOrAssignId(&pipeline_ids_, static_cast<const void*>(draw.pipeline));
+  uint64_t texture_id = GetOrAssignId(&texture_ids_, static_cast<const void*>(draw.texture));
+  uint64_t vertex_buffer_id = 
+      GetOrAssignId(&vertex_buffer_ids_, static_cast<const void*>(draw.vertex_buffer));
+  uint64_t mesh_id = GetOrAssignId(&mesh_ids_, MeshKey{draw.index_buffer, draw.index_count, 
+                                                       draw.first_index, draw.vertex_offset});
+
+  float depth_range = far_depth_ - near_depth_;
+  float normalized_depth = 
+      depth_range > 0.f ? std::clamp((draw.depth - near_depth_) / depth_range, 0.f, 1.f) : 0.f;
+  uint64_t depth = static_cast<uint64_t>(normalized_depth * kMaxDepth);
+
+  uint64_t state = (pipeline_id << (3 * kIdBits)) | (texture_id << (2 * kIdBits)) |
+                   (vertex_buffer_id << kIdBits) | mesh_id;
+
+  if (draw.pass == Pass::Opaque) {
+    return (state << kDepthBits) | depth;
+  }
+  return (uint64_t{1} << 63) | ((kMaxDepth - depth) << (4 * kIdBits)) | state;
+}
+
+void GALRenderQueue::Flush(std::vector<CommandVariant>* commands) {
+  size_t draw_count = draws_.size();
+
+  stats_ = Stats{};
+  stats_.draws_added = static_cast<uint32_t>(draw_count);
+
+  draw_order_.clear();
+  for (const Draw& draw : draws_) {
+    draw_order_.push_back(&draw);
+  }
+  stats_.binds_added = CountBinds(draw_order_);
+
+  sorted_draws_.resize(draw_count);
+  for (size_t i = 0; i < draw_count; ++i) {
+    sorted_draws_[i] = static_cast<uint32_t>(i);
+  }
+  RadixSort();
+
+  // The instance data is laid out in the order the draws are submitted in, so that each merged
+  // draw's instances are contiguous.
+  sorted_instance_data_.resize(draw_count * instance_stride_);
+  for (size_t i = 0; i < draw_count; ++i) {
+    draw_order_[i] = &draws_[sorted_draws_[i]];
+
+    if (instance_stride_ > 0) {
+      memcpy(sorted_instance_data_.data() + i * instance_stride_, 
+             instance_data_.data() + static_cast<size_t>(sorted_draws_[i]) * instance_stride_,
+             instance_stride_);
+    }
+  }
+  stats_.binds_submitted = CountBinds(draw_order_);
+
+  // Swapping keeps both buffers' capacity, so that adding push constants stops allocating.
+  flushed_push_constant_data_.swap(push_constant_data_);
+  for (size_t i = 0; i < push_constants_.size(); ++i) {
+    push_constants_[i].data = flushed_push_constant_data_.data() + push_constant_offsets_[i];
+  }
+
+  const Draw* bound = nullptr;
+  for (size_t i = 0; i < draw_count;) {
+    const Draw& draw = *draw_order_[i];
+
+    size_t end = i + 1;
+    if (instance_stride_ > 0) {
+      while (end < draw_count && CanMerge(draw, *draw_order_[end])) {
+        ++end;
+      }
+    }
+
+    bool pipeline_changed = bound == nullptr || draw.pipeline != bound->pipeline;
+    if (pipeline_changed) {
+      command::SetPipeline set_pipeline;
+      set_pipeline.pipeline = draw.pipeline;
+      commands->push_back(set_pipeline);
+
+      for (const command::SetUniformData& set_uniform_data : uniform_data_) {
+        commands->push_back(set_uniform_data);
+      }
+      for (const command::PushConstants& push_constants : push_constants_) {
+        commands->push_back(push_constants);
+      }
+
+      // Vertex buffers stay bound across pipelines, so the stream is only bound once, after the
+      // first SetPipeline has begun the render pass.
+      if (bound == nullptr && instance_stride_ > 0) {
+        command::SetInstanceData set_instances;
+        set_instances.buffer_idx = instance_buffer_idx_;
+        set_instances.data = sorted_instance_data_.data();
+        set_instances.size = static_cast<uint32_t>(sorted_instance_data_.size());
+        commands->push_back(set_instances);
+      }
+    }
+
+    if (draw.texture != nullptr && (pipeline_changed || draw.texture != bound->texture)) {
+      command::BindTexture bind_texture;
+      bind_texture.texture = draw.texture;
+      bind_texture.shader_idx = draw.texture_shader_idx;
+      commands->push_back(bind_texture);
+    }
+
+    if (bound == nullptr || draw.vertex_buffer != bound->vertex_buffer) {
+      command::SetVertexBuffer set_vert_buf;
+      set_vert_buf.buffer = draw.vertex_buffer;
+      set_vert_buf.buffer_idx = 0;
+      commands->push_back(set_vert_buf);
+    }
+
+    if (bound == nullptr || draw.index_buffer != bound->index_buffer) {
+      command::SetIndexBuffer set_index_buf;
+      set_index_buf.buffer = draw.index_buffer;
+      commands->push_back(set_index_buf);
+    }
+
+    command::DrawIndexed draw_indexed;
+    draw_indexed.index_count = draw.index_count;
+    draw_indexed.first_index = draw.first_index;
+    draw_indexed.vertex_offset = draw.vertex_offset;
+    draw_indexed.instance_count = static_cast<uint32_t>(end - i);
+    draw_indexed.first_instance = instance_stride_ > 0 ? static_cast<uint32_t>(i) : 0;
+    commands->push_back(draw_indexed);
+
+    ++stats_.draws_submitted;
+
+    bound = &draw;
+    i = end;
+  }
+
+  // The commands point at sorted_instance_data_ and flushed_push_constant_data_, which are kept
+  // until the next Flush().
+  uniform_data_.clear();
+  push_constants_.clear();
+  push_constant_offsets_.clear();
+  push_constant_data_.clear();
+  draws_.clear();
+  instance_data_.clear();
+  sort_keys_.clear();
+  pipeline_ids_.clear();
+  texture_ids_.clear();
+  vertex_buffer_ids_.clear();
+  mesh_ids_.clear();
+}
+
+void GALRenderQueue::RadixSort() {
+  size_t count = sort_keys_.size();
+  scratch_keys_.resize(count);
+  scratch_draws_.resize(count);
+
+  size_t histogram[kRadixBuckets];
+
+  for (int shift = 0; shift < 64; shift += kRadixBits) {
+    std::fill(std::begin(histogram), std::end(histogram), 0);
+    for (uint64_t key : sort_keys_) {
+      ++histogram[(key >> shift) & (kRadixBuckets - 1)];
+    }
+
+    // Keys that all have the same digit are already in order for this pass. Common for the high
+    // bits of the ids, since few are in use.
+    if (std::find(std::begin(histogram), std::end(histogram), count) != std::end(histogram)) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (size_t& bucket : histogram) {
+      size_t bucket_count = bucket;
+      bucket = offset;
+      offset += bucket_count;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      size_t dst = histogram[(sort_keys_[i] >> shift) & (kRadixBuckets - 1)]++;
+      scratch_keys_[dst] = sort_keys_[i];
+      scratch_draws_[dst] = sorted_draws_[i];
+    }
+
+    sort_keys_.swap(scratch_keys_);
+    sorted_draws_.swap(scratch_draws_);
+  }
+}
+
+bool GALRenderQueue::CanMerge(const Draw& a, const Draw& b) {
+  return a.pipeline == b.pipeline && a.texture == b.texture && 
+         a.texture_shader_idx == b.texture_shader_idx && a.vertex_buffer == b.vertex_buffer &&
+         a.index_buffer == b.index_buffer && a.index_count == b.index_count && 
+         a.first_index == b.first_index && a.vertex_offset == b.vertex_offset;
+}
+
+uint32_t GALRenderQueue::CountBinds(const std::vector<const Draw*>& draws) {
+  uint32_t bind_count = 0;
+
+  const Draw* bound = nullptr;
+  for (const Draw* draw : draws) {
+    bool pipeline_changed = bound == nullptr || draw->pipeline != bound->pipeline;
+    if (pipeline_changed) {
+      ++bind_count;
+    }
+    if (draw->texture != nullptr && (pipeline_changed || draw->texture != bound->texture)) {
+      ++bind_count;
+    }
+    if (bound == nullptr || draw->vertex_buffer != bound->vertex_buffer) {
+      ++bind_count;
+    }
+    if (bound == nullptr || draw->index_buffer != bound->index_buffer) {
+      ++bind_count;
+    }
+    bound = draw;
+  }
+  return bind_count;
+}
+
+} // namespace gal
\ No newline at end of file
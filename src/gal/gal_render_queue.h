@@ -0,0 +1,161 @@
+#ifndef GAL_GAL_RENDER_QUEUE_H_
+#define GAL_GAL_RENDER_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "gal/gal_buffer.h"
+#include "gal/gal_commands.h"
+#include "gal/gal_pipeline.h"
+#include "gal/gal_texture.h"
+
+namespace gal {
+
+// Collects a frame's draws, sorts them by a 64-bit key so that draws sharing state are
+// submitted together, and merges consecutive draws of the same mesh with the same state into
+// instanced draws.
+//
+// From the most significant bit down, an opaque draw's key holds the pass, pipeline, texture,
+// vertex buffer, mesh and quantised depth, so that draws are grouped by state and drawn front
+// to back within a group. A transparent draw's key holds the pass, then the inverted depth, then
+// the rest, so that transparent draws come after every opaque one and are drawn back to front.
+// Pipelines, textures, vertex buffers and meshes are numbered in the order they were first
+// added in the frame, so that e.g. a depth prepass's pipeline that is added first is drawn
+// first.
+//
+// Each draw is one instance. Its instance data is copied into the queue, and the instance data
+// of the draws that are merged into one instanced draw is laid out contiguously in one stream,
+// which is bound with SetInstanceData. The commands must therefore be submitted in
+// RecordingMode::PerFrame, before the next Flush().
+//
+// Not thread-safe.
+class GALRenderQueue {
+public:
+  enum class Pass {
+    Opaque,
+    Transparent
+  };
+
+  struct Draw {
+    GALPipeline* pipeline = nullptr;
+
+    // Bound to the sampler at texture_shader_idx of the pipeline's resource set. May be null.
+    GALTexture* texture = nullptr;
+    int texture_shader_idx = 0;
+
+    // Bound at buffer index 0.
+    GALBuffer* vertex_buffer = nullptr;
+    GALBuffer* index_buffer = nullptr;
+
+    uint32_t index_count = 0;
+    uint32_t first_index = 0;
+    int32_t vertex_offset = 0;
+
+    Pass pass = Pass::Opaque;
+
+    // Distance from the camera along its view direction. Quantised between the queue's depth
+    // range, outside of which it is clamped.
+    float depth = 0.f;
+
+    // instance_stride bytes of per-instance data. Only needs to stay valid until Add() returns.
+    const void* instance_data = nullptr;
+  };
+
+  // Counted as if every draw only bound what differs from the draw before it, in the order the
+  // draws were added, and in the order they were submitted in.
+  struct Stats {
+    uint32_t draws_added = 0;
+    uint32_t draws_submitted = 0;
+    uint32_t binds_added = 0;
+    uint32_t binds_submitted = 0;
+  };
+
+  // Instance data is bound at instance_buffer_idx. instance_stride is 0 if draws have no
+  // instance data, in which case they are not merged.
+  GALRenderQueue(uint32_t instance_stride, int instance_buffer_idx);
+
+  void SetDepthRange(float near_depth, float far_depth);
+
+  // Submitted after every SetPipeline, since the uniforms and push constants are reset along
+  // with the pipeline. Every pipeline in the queue must have the uniform or push constant range.
+  // Push constant data is copied into the queue, like instance data, while uniform data must stay
+  // valid until the commands have been submitted.
+  void AddUniformData(const command::SetUniformData& command);
+  void AddPushConstants(const command::PushConstants& command);
+
+  void Add(const Draw& draw);
+
+  // Sorts and merges the draws added since the last Flush(), appends the commands that draw
+  // them to commands, and removes them, the uniform data and the push constants from the queue.
+  void Flush(std::vector<CommandVariant>* commands);
+
+  // For the last Flush().
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct MeshKey {
+    GALBuffer* index_buffer;
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+
+    bool operator==(const MeshKey& other) const {
+      return index_buffer == other.index_buffer && index_count == other.index_count &&
+             first_index == other.first_index && vertex_offset == other.vertex_offset;
+    }
+  };
+
+  struct MeshKeyHash {
+    size_t operator()(const MeshKey& key) const;
+  };
+
+  uint64_t MakeSortKey(const Draw& draw);
+
+  // Sorts sort_keys_ along with sorted_draws_, in place.
+  void RadixSort();
+
+  static bool CanMerge(const Draw& a, const Draw& b);
+
+  // Counts the state changes between consecutive draws, as Flush() submits them.
+  static uint32_t CountBinds(const std::vector<const Draw*>& draws);
+
+private:
+  uint32_t instance_stride_;
+  int instance_buffer_idx_;
+
+  float near_depth_ = 0.f;
+  float far_depth_ = 1.f;
+
+  std::vector<command::SetUniformData> uniform_data_;
+
+  // Each command's data is at the matching offset into push_constant_data_ until Flush(), which
+  // moves the data to flushed_push_constant_data_ and points the commands at it.
+  std::vector<command::PushConstants> push_constants_;
+  std::vector<size_t> push_constant_offsets_;
+  std::vector<uint8_t> push_constant_data_;
+  std::vector<uint8_t> flushed_push_constant_data_;
+
+  std::vector<Draw> draws_;
+  std::vector<uint8_t> instance_data_;
+
+  // Numbered in the order they were first added.
+  std::unordered_map<const void*, uint32_t> pipeline_ids_;
+  std::unordered_map<const void*, uint32_t> texture_ids_;
+  std::unordered_map<const void*, uint32_t> vertex_buffer_ids_;
+  std::unordered_map<MeshKey, uint32_t, MeshKeyHash> mesh_ids_;
+
+  Stats stats_;
+
+  // Scratch space, kept so that Flush() does not allocate every frame.
+  std::vector<uint64_t> sort_keys_;
+  std::vector<uint32_t> sorted_draws_;
+  std::vector<uint64_t> scratch_keys_;
+  std::vector<uint32_t> scratch_draws_;
+  std::vector<const Draw*> draw_order_;
+  std::vector<uint8_t> sorted_instance_data_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_RENDER_QUEUE_H_
\ No newline at end of file
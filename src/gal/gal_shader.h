@@ -12,7 +12,8 @@ namespace gal {
 enum class ShaderType {
   Invalid,
   Vertex,
-  Fragment
+  Fragment,
+  Compute
 };
 
 class GALShader {
@@ -23,7 +24,7 @@ public:
   VkShaderModule GetShaderModule() const { return vk_shader_; }
 
 private:
-  VkShaderModule vk_shader_;
+  VkShaderModule vk_shader_ = VK_NULL_HANDLE;
   VkDevice vk_device_;
 };
 
@@ -0,0 +1,120 @@
+#include "gal/gal_texture.h"
+
+#include <memory>
+#include <optional>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+namespace {
+
+const VkFormat kTextureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const uint32_t kTexelSize = 4;
+
+} // namespace
+
+GALTexture::GALTexture(GALTexture::Builder& builder) {
+  vk_device_ = builder.gal_platform_->GetVkDevice();
+  memory_allocator_ = builder.gal_platform_->GetMemoryAllocator();
+  upload_manager_ = builder.gal_platform_->GetUploadManager();
+  descriptor_cache_ = builder.gal_platform_->GetDescriptorCache();
+
+  if (builder.data_ == nullptr || builder.width_ == 0 || builder.height_ == 0) {
+    throw Exception("Texture data not set.");
+  }
+
+  VkImageCreateInfo image_create_info{};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = kTextureFormat;
+  image_create_info.extent = {builder.width_, builder.height_, 1};
+  image_create_info.mipLevels = 1;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (vkCreateImage(vk_device_, &image_create_info, nullptr, &vk_image_) != VK_SUCCESS) {
+    throw Exception("Could not create VkImage.");
+  }
+
+  std::optional<GALMemoryAllocator::Allocation> allocation = 
+      memory_allocator_->AllocateImageMemory(vk_image_, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+  if (!allocation.has_value()) {
+    vkDestroyImage(vk_device_, vk_image_, nullptr);
+    throw Exception("Could not allocate memory for VkImage.");
+  }
+  allocation_ = allocation.value();
+
+  VkImageViewCreateInfo image_view_create_info{};
+  image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  image_view_create_info.image = vk_image_;
+  image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  image_view_create_info.format = kTextureFormat;
+  image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  image_view_create_info.subresourceRange.baseMipLevel = 0;
+  image_view_create_info.subresourceRange.levelCount = 1;
+  image_view_create_info.subresourceRange.baseArrayLayer = 0;
+  image_view_create_info.subresourceRange.layerCount = 1;
+
+  VkSamplerCreateInfo sampler_create_info{};
+  sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_create_info.magFilter = VK_FILTER_LINEAR;
+  sampler_create_info.minFilter = VK_FILTER_LINEAR;
+  sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sampler_create_info.anisotropyEnable = VK_FALSE;
+  sampler_create_info.compareEnable = VK_FALSE;
+  sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
+  sampler_create_info.minLod = 0.f;
+  sampler_create_info.maxLod = 0.f;
+  sampler_create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  sampler_create_info.unnormalizedCoordinates = VK_FALSE;
+
+  if (vkCreateImageView(vk_device_, &image_view_create_info, nullptr, &vk_image_view_) 
+          != VK_SUCCESS ||
+      vkCreateSampler(vk_device_, &sampler_create_info, nullptr, &vk_sampler_) != VK_SUCCESS) {
+    if (vk_image_view_ != VK_NULL_HANDLE) {
+      vkDestroyImageView(vk_device_, vk_image_view_, nullptr);
+    }
+    vkDestroyImage(vk_device_, vk_image_, nullptr);
+    memory_allocator_->Free(allocation_);
+    throw Exception("Could not create texture view or sampler.");
+  }
+
+  upload_ticket_ = upload_manager_->EnqueueImageUpload(
+      vk_image_, image_create_info.extent, builder.data_, 
+      static_cast<VkDeviceSize>(builder.width_) * builder.height_ * kTexelSize, 
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, 
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+GALTexture::~GALTexture() {
+  // The upload may still be writing to the image.
+  upload_manager_->Wait(upload_ticket_);
+
+  descriptor_cache_->OnResourceDestroyed();
+
+  vkDestroySampler(vk_device_, vk_sampler_, nullptr);
+  vkDestroyImageView(vk_device_, vk_image_view_, nullptr);
+  vkDestroyImage(vk_device_, vk_image_, nullptr);
+  memory_allocator_->Free(allocation_);
+}
+
+GALTexture::Builder& GALTexture::Builder::SetImageData(uint8_t* data, uint32_t width, 
+                                                       uint32_t height) {
+  data_ = data;
+  width_ = width;
+  height_ = height;
+  return *this;
+}
+
+std::unique_ptr<GALTexture> GALTexture::Builder::Create() {
+  return std::make_unique<GALTexture>(*this);
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef GAL_GAL_TEXTURE_H_
+#define GAL_GAL_TEXTURE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include "gal/gal_descriptor_cache.h"
+#include "gal/gal_memory_allocator.h"
+#include "gal/gal_platform.h"
+#include "gal/gal_upload_manager.h"
+
+namespace gal {
+
+// A sampled 2D texture with a single mip level. Texel data is 8-bit RGBA.
+class GALTexture {
+// Forward declaration
+class Builder;
+
+public:
+  GALTexture(Builder& builder);
+  ~GALTexture();
+
+  static Builder BeginBuild(GALPlatform* gal_platform) {
+    return Builder(gal_platform);
+  }
+
+  VkImageView GetVkImageView() { return vk_image_view_; }
+  VkSampler GetVkSampler() { return vk_sampler_; }
+
+  // The texture's contents are ready once this ticket completes. Frames submitted through
+  // GALPlatform do not need to wait on it.
+  UploadTicket GetUploadTicket() const { return upload_ticket_; }
+
+private:
+  VkDevice vk_device_;
+  GALMemoryAllocator* memory_allocator_;
+  GALUploadManager* upload_manager_;
+  GALDescriptorCache* descriptor_cache_;
+
+  VkImage vk_image_;
+  GALMemoryAllocator::Allocation allocation_;
+  VkImageView vk_image_view_ = VK_NULL_HANDLE;
+  VkSampler vk_sampler_ = VK_NULL_HANDLE;
+
+  UploadTicket upload_ticket_;
+
+public:
+  class Builder {
+  friend class GALTexture;
+
+  public:
+    Builder(GALPlatform* gal_platform) : gal_platform_(gal_platform) {}
+
+    // data holds width * height tightly packed RGBA texels.
+    Builder& SetImageData(uint8_t* data, uint32_t width, uint32_t height);
+
+    std::unique_ptr<GALTexture> Create();
+
+  private:
+    GALPlatform* gal_platform_;
+
+    uint8_t* data_ = nullptr;
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+  };
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_TEXTURE_H_
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "gal/gal_uniform_ring.h"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <vector>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+namespace {
+
+// Leaves room for the instance data of tens of thousands of draws.
+const VkDeviceSize kFrameSize = 16 * 1024 * 1024;
+
+// Bounds the range of each descriptor, and so how far past the last allocation the GPU may read.
+const VkDeviceSize kMaxBindingRange = 64 * 1024;
+
+// Descriptor sets are only created per descriptor set layout, so this is not per draw.
+const uint32_t kMaxDescriptorSets = 256;
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+GALUniformRing::GALUniformRing(VkDevice vk_device, GALMemoryAllocator* memory_allocator,
+                               const VkPhysicalDeviceLimits& limits, 
+                               uint32_t num_frames_in_flight)
+    : vk_device_(vk_device), memory_allocator_(memory_allocator) {
+  offset_alignment_ = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+  binding_range_ = std::min<VkDeviceSize>(limits.maxUniformBufferRange, kMaxBindingRange);
+  frame_size_ = AlignUp(kFrameSize, offset_alignment_);
+
+  // Every descriptor covers binding_range_ bytes from its dynamic offset, so the buffer extends
+  // that far past the last partition.
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = frame_size_ * num_frames_in_flight + binding_range_;
+  buffer_create_info.usage =
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(vk_device_, &buffer_create_info, nullptr, &vk_buffer_) != VK_SUCCESS) {
+    throw Exception("Could not create uniform ring buffer.");
+  }
+
+  // Device-local host-visible memory is preferred where it exists, since the GPU reads the data
+  // directly.
+  std::optional<GALMemoryAllocator::Allocation> allocation = 
+      memory_allocator_->AllocateBufferMemory(
+          vk_buffer_, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (!allocation.has_value()) {
+    vkDestroyBuffer(vk_device_, vk_buffer_, nullptr);
+    throw Exception("Could not allocate memory for uniform ring buffer.");
+  }
+  allocation_ = allocation.value();
+
+  VkDescriptorPoolSize pool_size{};
+  pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  pool_size.descriptorCount = kMaxDescriptorSets * kMaxBindingsPerSet;
+
+  VkDescriptorPoolCreateInfo descriptor_pool_create_info{};
+  descriptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptor_pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  descriptor_pool_create_info.maxSets = kMaxDescriptorSets;
+  descriptor_pool_create_info.poolSizeCount = 1;
+  descriptor_pool_create_info.pPoolSizes = &pool_size;
+
+  if (vkCreateDescriptorPool(vk_device_, &descriptor_pool_create_info, nullptr, 
+                             &vk_descriptor_pool_) != VK_SUCCESS) {
+    vkDestroyBuffer(vk_device_, vk_buffer_, nullptr);
+    memory_allocator_->Free(allocation_);
+    throw Exception("Could not create uniform descriptor pool.");
+  }
+}
+
+GALUniformRing::~GALUniformRing() {
+  // Destroying the pool frees its descriptor sets.
+  vkDestroyDescriptorPool(vk_device_, vk_descriptor_pool_, nullptr);
+
+  vkDestroyBuffer(vk_device_, vk_buffer_, nullptr);
+  memory_allocator_->Free(allocation_);
+}
+
+void GALUniformRing::BeginFrame(uint32_t frame) {
+  current_frame_ = frame;
+  frame_head_ = 0;
+  stats_.frame_bytes = 0;
+}
+
+std::optional<GALUniformRing::Allocation> GALUniformRing::Allocate(VkDeviceSize size) {
+  if (size > binding_range_) {
+    ++stats_.failed_allocation_count;
+    return std::nullopt;
+  }
+
+  return AllocateFromFrame(size);
+}
+
+std::optional<GALUniformRing::Allocation> GALUniformRing::AllocateVertexData(VkDeviceSize size) {
+  return AllocateFromFrame(size);
+}
+
+std::optional<GALUniformRing::Allocation> GALUniformRing::AllocateFromFrame(VkDeviceSize size) {
+  VkDeviceSize aligned_size = AlignUp(size, offset_alignment_);
+
+  if (frame_head_ + aligned_size > frame_size_) {
+    ++stats_.failed_allocation_count;
+    return std::nullopt;
+  }
+
+  VkDeviceSize offset = current_frame_ * frame_size_ + frame_head_;
+  frame_head_ += aligned_size;
+
+  stats_.frame_bytes = frame_head_;
+  stats_.peak_frame_bytes = std::max(stats_.peak_frame_bytes, frame_head_);
+
+  Allocation allocation;
+  allocation.offset = static_cast<uint32_t>(offset);
+  allocation.mapped_data = static_cast<uint8_t*>(allocation_.mapped_data) + offset;
+  return allocation;
+}
+
+std::optional<VkDescriptorSet> GALUniformRing::AllocateDescriptorSet(
+    VkDescriptorSetLayout set_layout, const std::vector<uint32_t>& bindings) {
+  if (bindings.size() > kMaxBindingsPerSet) {
+    std::cerr << "Too many uniform bindings in descriptor set." << std::endl;
+    return std::nullopt;
+  }
+
+  VkDescriptorSetAllocateInfo descriptor_set_alloc_info{};
+  descriptor_set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  descriptor_set_alloc_info.descriptorPool = vk_descriptor_pool_;
+  descriptor_set_alloc_info.descriptorSetCount = 1;
+  descriptor_set_alloc_info.pSetLayouts = &set_layout;
+
+  VkDescriptorSet descriptor_set;
+  if (vkAllocateDescriptorSets(vk_device_, &descriptor_set_alloc_info, &descriptor_set) 
+          != VK_SUCCESS) {
+    std::cerr << "Could not allocate uniform descriptor set." << std::endl;
+    return std::nullopt;
+  }
+
+  VkDescriptorBufferInfo buffer_info{};
+  buffer_info.buffer = vk_buffer_;
+  buffer_info.offset = 0;
+  buffer_info.range = binding_range_;
+
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t binding : bindings) {
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptor_set;
+    write.dstBinding = binding;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &buffer_info;
+    writes.push_back(write);
+  }
+
+  vkUpdateDescriptorSets(vk_device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, 
+                         nullptr);
+
+  return descriptor_set;
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef GAL_GAL_UNIFORM_RING_H_
+#define GAL_GAL_UNIFORM_RING_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "gal/gal_memory_allocator.h"
+
+namespace gal {
+
+// Per-frame storage for uniform data that changes every draw.
+//
+// A single persistently mapped, host-coherent buffer is split into one partition per frame in
+// flight. Allocations are bumped out of the current frame's partition, which is reset by
+// BeginFrame() once the GPU has finished with the frame that last used it. Every uniform
+// binding is a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor that points at the start of
+// the buffer, so an allocation is bound by passing its offset to vkCmdBindDescriptorSets() and
+// the descriptor sets are never updated after they are created.
+//
+// The ring also streams per-frame vertex data, such as the instance data written with
+// command::SetInstanceData, which is bound directly as a vertex buffer.
+//
+// Not thread-safe.
+class GALUniformRing {
+public:
+  // Matches the minimum maxDescriptorSetUniformBuffersDynamic.
+  static constexpr uint32_t kMaxBindingsPerSet = 8;
+
+  struct Allocation {
+    // Dynamic offset to bind the data with.
+    uint32_t offset;
+    void* mapped_data;
+  };
+
+  struct Stats {
+    VkDeviceSize frame_bytes = 0;
+    VkDeviceSize peak_frame_bytes = 0;
+    uint64_t failed_allocation_count = 0;
+  };
+
+  GALUniformRing(VkDevice vk_device, GALMemoryAllocator* memory_allocator, 
+                 const VkPhysicalDeviceLimits& limits, uint32_t num_frames_in_flight);
+  ~GALUniformRing();
+
+  // Makes the frame's partition current and discards everything allocated from it.
+  void BeginFrame(uint32_t frame);
+
+  // std::nullopt if size exceeds GetBindingRange() or the frame's partition is full.
+  std::optional<Allocation> Allocate(VkDeviceSize size);
+
+  // Allocates data to bind with vkCmdBindVertexBuffers() at the allocation's offset into
+  // GetVkBuffer(). Not limited by GetBindingRange(). std::nullopt if the frame's partition is
+  // full.
+  std::optional<Allocation> AllocateVertexData(VkDeviceSize size);
+
+  // Allocates a descriptor set for set_layout, whose bindings must all be single dynamic uniform
+  // buffers. bindings lists their binding numbers.
+  std::optional<VkDescriptorSet> AllocateDescriptorSet(VkDescriptorSetLayout set_layout, 
+                                                       const std::vector<uint32_t>& bindings);
+
+  VkBuffer GetVkBuffer() { return vk_buffer_; }
+  VkDescriptorPool GetVkDescriptorPool() { return vk_descriptor_pool_; }
+
+  // The most uniform data that a single binding can read.
+  VkDeviceSize GetBindingRange() const { return binding_range_; }
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  std::optional<Allocation> AllocateFromFrame(VkDeviceSize size);
+
+private:
+  VkDevice vk_device_;
+  GALMemoryAllocator* memory_allocator_;
+
+  VkBuffer vk_buffer_;
+  GALMemoryAllocator::Allocation allocation_;
+
+  VkDescriptorPool vk_descriptor_pool_;
+
+  VkDeviceSize offset_alignment_;
+  VkDeviceSize binding_range_;
+  VkDeviceSize frame_size_;
+
+  uint32_t current_frame_ = 0;
+  VkDeviceSize frame_head_ = 0;
+
+  Stats stats_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_UNIFORM_RING_H_
\ No newline at end of file
@@ -0,0 +1,517 @@
+#include "gal/gal_upload_manager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <vector>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+GALUploadManager::GALUploadManager(VkDevice vk_device, GALMemoryAllocator* memory_allocator,
+                                   VkQueue vk_graphics_queue, 
+                                   uint32_t graphics_queue_family_index,
+                                   VkQueue vk_transfer_queue, 
+                                   uint32_t transfer_queue_family_index,
+                                   VkDeviceSize copy_offset_alignment)
+    : vk_device_(vk_device), memory_allocator_(memory_allocator), 
+      vk_graphics_queue_(vk_graphics_queue), 
+      graphics_queue_family_index_(graphics_queue_family_index),
+      vk_transfer_queue_(vk_transfer_queue), 
+      transfer_queue_family_index_(transfer_queue_family_index),
+      copy_offset_alignment_(std::max<VkDeviceSize>(copy_offset_alignment, 4)) {
+  VkCommandPoolCreateInfo command_pool_create_info{};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | 
+                                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  command_pool_create_info.queueFamilyIndex = transfer_queue_family_index_;
+
+  if (vkCreateCommandPool(vk_device_, &command_pool_create_info, nullptr,
+                          &vk_transfer_command_pool_) != VK_SUCCESS) {
+    throw Exception("Could not create upload command pool.");
+  }
+
+  if (UsesDedicatedTransferQueue()) {
+    command_pool_create_info.queueFamilyIndex = graphics_queue_family_index_;
+
+    if (vkCreateCommandPool(vk_device_, &command_pool_create_info, nullptr,
+                            &vk_acquire_command_pool_) != VK_SUCCESS) {
+      throw Exception("Could not create upload command pool.");
+    }
+  }
+
+  VkBufferCreateInfo buffer_create_info{};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = kStagingRingSize;
+  buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(vk_device_, &buffer_create_info, nullptr, &vk_staging_ring_) 
+          != VK_SUCCESS) {
+    throw Exception("Could not create staging ring buffer.");
+  }
+
+  std::optional<GALMemoryAllocator::Allocation> allocation = 
+      memory_allocator_->AllocateBufferMemory(
+          vk_staging_ring_, 
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0);
+  if (!allocation.has_value()) {
+    throw Exception("Could not allocate memory for staging ring buffer.");
+  }
+  staging_ring_allocation_ = allocation.value();
+}
+
+GALUploadManager::~GALUploadManager() {
+  // Uploads that were never flushed are dropped.
+  for (const auto& [buffer, allocation] : pending_dedicated_staging_) {
+    vkDestroyBuffer(vk_device_, buffer, nullptr);
+    memory_allocator_->Free(allocation);
+  }
+
+  while (!in_flight_batches_.empty()) {
+    RetireOldestBatch(/*wait=*/ true);
+  }
+
+  for (const BatchResources& resources : free_batch_resources_) {
+    vkDestroyFence(vk_device_, resources.vk_fence, nullptr);
+    if (resources.vk_semaphore != VK_NULL_HANDLE) {
+      vkDestroySemaphore(vk_device_, resources.vk_semaphore, nullptr);
+    }
+  }
+
+  vkDestroyBuffer(vk_device_, vk_staging_ring_, nullptr);
+  memory_allocator_->Free(staging_ring_allocation_);
+
+  // Destroying the pools frees their command buffers.
+  if (vk_acquire_command_pool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(vk_device_, vk_acquire_command_pool_, nullptr);
+  }
+  vkDestroyCommandPool(vk_device_, vk_transfer_command_pool_, nullptr);
+}
+
+UploadTicket GALUploadManager::EnqueueBufferUpload(VkBuffer dst_buffer, VkDeviceSize dst_offset,
+                                                   const void* data, VkDeviceSize size,
+                                                   VkAccessFlags dst_access, 
+                                                   VkPipelineStageFlags dst_stage) {
+  PendingCopy copy{};
+  copy.dst_buffer = dst_buffer;
+  copy.region.dstOffset = dst_offset;
+  copy.region.size = size;
+  copy.dst_access = dst_access;
+  copy.dst_stage = dst_stage;
+
+  StageData(data, size, &copy.src_buffer, &copy.region.srcOffset);
+
+  pending_copies_.push_back(copy);
+
+  stats_.bytes_uploaded += size;
+  ++stats_.copy_count;
+
+  return pending_ticket_;
+}
+
+UploadTicket GALUploadManager::EnqueueImageUpload(VkImage dst_image, const VkExtent3D& extent,
+                                                  const void* data, VkDeviceSize size,
+                                                  VkImageLayout final_layout,
+                                                  VkAccessFlags dst_access,
+                                                  VkPipelineStageFlags dst_stage) {
+  PendingImageCopy copy{};
+  copy.dst_image = dst_image;
+  copy.region.bufferRowLength = 0;
+  copy.region.bufferImageHeight = 0;
+  copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copy.region.imageSubresource.mipLevel = 0;
+  copy.region.imageSubresource.baseArrayLayer = 0;
+  copy.region.imageSubresource.layerCount = 1;
+  copy.region.imageOffset = {0, 0, 0};
+  copy.region.imageExtent = extent;
+  copy.final_layout = final_layout;
+  copy.dst_access = dst_access;
+  copy.dst_stage = dst_stage;
+
+  StageData(data, size, &copy.src_buffer, &copy.region.bufferOffset);
+
+  pending_image_copies_.push_back(copy);
+
+  stats_.bytes_uploaded += size;
+  ++stats_.copy_count;
+
+  return pending_ticket_;
+}
+
+void GALUploadManager::StageData(const void* data, VkDeviceSize size, VkBuffer* src_buffer, 
+                                 VkDeviceSize* src_offset) {
+  std::optional<VkDeviceSize> ring_offset = AllocateFromRing(size);
+
+  if (ring_offset.has_value()) {
+    *src_buffer = VK_NULL_HANDLE;
+    *src_offset = ring_offset.value();
+    memcpy(static_cast<uint8_t*>(staging_ring_allocation_.mapped_data) + ring_offset.value(), 
+           data, size);
+  } else {
+    // Too large for the ring, so the data gets a staging buffer of its own, which is destroyed
+    // once the batch completes.
+    VkBufferCreateInfo buffer_create_info{};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = size;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer staging_buffer;
+    if (vkCreateBuffer(vk_device_, &buffer_create_info, nullptr, &staging_buffer) 
+            != VK_SUCCESS) {
+      throw Exception("Could not create staging buffer.");
+    }
+
+    std::optional<GALMemoryAllocator::Allocation> allocation = 
+        memory_allocator_->AllocateBufferMemory(
+            staging_buffer, 
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0);
+    if (!allocation.has_value()) {
+      vkDestroyBuffer(vk_device_, staging_buffer, nullptr);
+      throw Exception("Could not allocate memory for staging buffer.");
+    }
+
+    memcpy(allocation.value().mapped_data, data, size);
+
+    *src_buffer = staging_buffer;
+    *src_offset = 0;
+    pending_dedicated_staging_.push_back({staging_buffer, allocation.value()});
+  }
+}
+
+std::optional<VkDeviceSize> GALUploadManager::AllocateFromRing(VkDeviceSize size) {
+  if (size > kStagingRingSize) {
+    return std::nullopt;
+  }
+
+  for (;;) {
+    uint64_t start = AlignUp(ring_head_, copy_offset_alignment_);
+
+    // Allocations do not wrap around the end of the ring.
+    if (start % kStagingRingSize + size > kStagingRingSize) {
+      start = AlignUp(start, kStagingRingSize);
+    }
+
+    if (start + size - ring_tail_ <= kStagingRingSize) {
+      ring_head_ = start + size;
+      return start % kStagingRingSize;
+    }
+
+    // The ring is full. Submit what is pending so that its space can be reclaimed, then wait for
+    // the oldest batch.
+    if (!pending_copies_.empty() || !pending_image_copies_.empty()) {
+      Flush();
+    }
+
+    if (in_flight_batches_.empty()) {
+      // Everything has been reclaimed, so the ring is empty.
+      ring_head_ = ring_tail_ = AlignUp(ring_head_, kStagingRingSize);
+      continue;
+    }
+
+    RetireOldestBatch(/*wait=*/ true);
+  }
+}
+
+void GALUploadManager::Flush() {
+  RetireCompletedBatches();
+
+  if (pending_copies_.empty() && pending_image_copies_.empty()) {
+    return;
+  }
+
+  BatchResources resources = AcquireBatchResources();
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(resources.vk_transfer_command_buffer, &begin_info);
+
+  VkPipelineStageFlags dst_stages = 0;
+  barriers_.clear();
+  image_barriers_.clear();
+
+  // Images need to be in a transfer layout before they can be copied into.
+  if (!pending_image_copies_.empty()) {
+    for (const PendingImageCopy& copy : pending_image_copies_) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = copy.dst_image;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.baseMipLevel = 0;
+      barrier.subresourceRange.levelCount = 1;
+      barrier.subresourceRange.baseArrayLayer = 0;
+      barrier.subresourceRange.layerCount = 1;
+      image_barriers_.push_back(barrier);
+    }
+
+    vkCmdPipelineBarrier(resources.vk_transfer_command_buffer, 
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 
+                         0, nullptr, 0, nullptr, static_cast<uint32_t>(image_barriers_.size()), 
+                         image_barriers_.data());
+  }
+
+  for (const PendingCopy& copy : pending_copies_) {
+    VkBuffer src_buffer = copy.src_buffer != VK_NULL_HANDLE ? copy.src_buffer 
+                                                            : vk_staging_ring_;
+    vkCmdCopyBuffer(resources.vk_transfer_command_buffer, src_buffer, copy.dst_buffer, 1, 
+                    &copy.region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = copy.dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = copy.dst_buffer;
+    barrier.offset = copy.region.dstOffset;
+    barrier.size = copy.region.size;
+
+    if (UsesDedicatedTransferQueue()) {
+      barrier.srcQueueFamilyIndex = transfer_queue_family_index_;
+      barrier.dstQueueFamilyIndex = graphics_queue_family_index_;
+    }
+
+    barriers_.push_back(barrier);
+    dst_stages |= copy.dst_stage;
+  }
+
+  // The transfer barriers are reused as the barriers that follow the copies.
+  for (size_t i = 0; i < pending_image_copies_.size(); ++i) {
+    const PendingImageCopy& copy = pending_image_copies_[i];
+
+    VkBuffer src_buffer = copy.src_buffer != VK_NULL_HANDLE ? copy.src_buffer 
+                                                            : vk_staging_ring_;
+    vkCmdCopyBufferToImage(resources.vk_transfer_command_buffer, src_buffer, copy.dst_image, 
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+
+    VkImageMemoryBarrier& barrier = image_barriers_[i];
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = copy.dst_access;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = copy.final_layout;
+
+    if (UsesDedicatedTransferQueue()) {
+      barrier.srcQueueFamilyIndex = transfer_queue_family_index_;
+      barrier.dstQueueFamilyIndex = graphics_queue_family_index_;
+    }
+
+    dst_stages |= copy.dst_stage;
+  }
+
+  if (!UsesDedicatedTransferQueue()) {
+    // Later submissions to the same queue are in the barrier's second synchronisation scope, so
+    // this is all that frames using the buffers need.
+    vkCmdPipelineBarrier(resources.vk_transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                         dst_stages, 0, 0, nullptr, static_cast<uint32_t>(barriers_.size()), 
+                         barriers_.data(), static_cast<uint32_t>(image_barriers_.size()), 
+                         image_barriers_.data());
+    vkEndCommandBuffer(resources.vk_transfer_command_buffer);
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &resources.vk_transfer_command_buffer;
+
+    if (vkQueueSubmit(vk_graphics_queue_, 1, &submit_info, resources.vk_fence) != VK_SUCCESS) {
+      throw Exception("Could not submit uploads.");
+    }
+  } else {
+    // Release the buffers from the transfer queue family. The destination access mask is
+    // ignored for a release.
+    for (VkBufferMemoryBarrier& barrier : barriers_) {
+      barrier.dstAccessMask = 0;
+    }
+    for (VkImageMemoryBarrier& barrier : image_barriers_) {
+      barrier.dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(resources.vk_transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 
+                         static_cast<uint32_t>(barriers_.size()), barriers_.data(), 
+                         static_cast<uint32_t>(image_barriers_.size()), image_barriers_.data());
+    vkEndCommandBuffer(resources.vk_transfer_command_buffer);
+
+    // Acquire them on the graphics queue family. The source access mask is ignored for an
+    // acquire.
+    for (size_t i = 0; i < barriers_.size(); ++i) {
+      barriers_[i].srcAccessMask = 0;
+      barriers_[i].dstAccessMask = pending_copies_[i].dst_access;
+    }
+    for (size_t i = 0; i < image_barriers_.size(); ++i) {
+      image_barriers_[i].srcAccessMask = 0;
+      image_barriers_[i].dstAccessMask = pending_image_copies_[i].dst_access;
+    }
+
+    vkBeginCommandBuffer(resources.vk_acquire_command_buffer, &begin_info);
+    vkCmdPipelineBarrier(resources.vk_acquire_command_buffer, 
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages, 0, 0, nullptr, 
+                         static_cast<uint32_t>(barriers_.size()), barriers_.data(), 
+                         static_cast<uint32_t>(image_barriers_.size()), image_barriers_.data());
+    vkEndCommandBuffer(resources.vk_acquire_command_buffer);
+
+    VkSubmitInfo transfer_submit_info{};
+    transfer_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transfer_submit_info.commandBufferCount = 1;
+    transfer_submit_info.pCommandBuffers = &resources.vk_transfer_command_buffer;
+    transfer_submit_info.signalSemaphoreCount = 1;
+    transfer_submit_info.pSignalSemaphores = &resources.vk_semaphore;
+
+    if (vkQueueSubmit(vk_transfer_queue_, 1, &transfer_submit_info, VK_NULL_HANDLE) 
+            != VK_SUCCESS) {
+      throw Exception("Could not submit uploads.");
+    }
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+    VkSubmitInfo acquire_submit_info{};
+    acquire_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquire_submit_info.waitSemaphoreCount = 1;
+    acquire_submit_info.pWaitSemaphores = &resources.vk_semaphore;
+    acquire_submit_info.pWaitDstStageMask = &wait_stage;
+    acquire_submit_info.commandBufferCount = 1;
+    acquire_submit_info.pCommandBuffers = &resources.vk_acquire_command_buffer;
+
+    if (vkQueueSubmit(vk_graphics_queue_, 1, &acquire_submit_info, resources.vk_fence) 
+            != VK_SUCCESS) {
+      throw Exception("Could not submit upload ownership transfer.");
+    }
+  }
+
+  InFlightBatch batch;
+  batch.ticket = pending_ticket_;
+  batch.resources = resources;
+  batch.ring_end = ring_head_;
+  batch.dedicated_staging = std::move(pending_dedicated_staging_);
+  in_flight_batches_.push_back(std::move(batch));
+
+  pending_copies_.clear();
+  pending_image_copies_.clear();
+  pending_dedicated_staging_.clear();
+
+  ++pending_ticket_;
+  ++stats_.batch_count;
+}
+
+bool GALUploadManager::IsComplete(UploadTicket ticket) {
+  if (ticket <= completed_ticket_) {
+    return true;
+  }
+
+  RetireCompletedBatches();
+
+  return ticket <= completed_ticket_;
+}
+
+void GALUploadManager::Wait(UploadTicket ticket) {
+  if (ticket >= pending_ticket_) {
+    Flush();
+  }
+
+  while (completed_ticket_ < ticket && !in_flight_batches_.empty()) {
+    RetireOldestBatch(/*wait=*/ true);
+  }
+}
+
+GALUploadManager::BatchResources GALUploadManager::AcquireBatchResources() {
+  if (!free_batch_resources_.empty()) {
+    BatchResources resources = free_batch_resources_.back();
+    free_batch_resources_.pop_back();
+
+    vkResetFences(vk_device_, 1, &resources.vk_fence);
+    vkResetCommandBuffer(resources.vk_transfer_command_buffer, 0);
+    if (resources.vk_acquire_command_buffer != VK_NULL_HANDLE) {
+      vkResetCommandBuffer(resources.vk_acquire_command_buffer, 0);
+    }
+
+    return resources;
+  }
+
+  BatchResources resources{};
+
+  VkFenceCreateInfo fence_create_info{};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  if (vkCreateFence(vk_device_, &fence_create_info, nullptr, &resources.vk_fence) 
+          != VK_SUCCESS) {
+    throw Exception("Could not create fence.");
+  }
+
+  VkCommandBufferAllocateInfo cmd_buf_alloc_info{};
+  cmd_buf_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmd_buf_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmd_buf_alloc_info.commandPool = vk_transfer_command_pool_;
+  cmd_buf_alloc_info.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers(vk_device_, &cmd_buf_alloc_info, 
+                               &resources.vk_transfer_command_buffer) != VK_SUCCESS) {
+    throw Exception("Could not allocate upload command buffer.");
+  }
+
+  if (!UsesDedicatedTransferQueue()) {
+    return resources;
+  }
+
+  cmd_buf_alloc_info.commandPool = vk_acquire_command_pool_;
+
+  if (vkAllocateCommandBuffers(vk_device_, &cmd_buf_alloc_info, 
+                               &resources.vk_acquire_command_buffer) != VK_SUCCESS) {
+    throw Exception("Could not allocate upload command buffer.");
+  }
+
+  VkSemaphoreCreateInfo semaphore_create_info{};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  if (vkCreateSemaphore(vk_device_, &semaphore_create_info, nullptr, &resources.vk_semaphore) 
+          != VK_SUCCESS) {
+    throw Exception("Could not create semaphore.");
+  }
+
+  return resources;
+}
+
+void GALUploadManager::RetireCompletedBatches() {
+  // Batches are retired in submission order, since the ring's space is reclaimed in order.
+  while (!in_flight_batches_.empty() && 
+         vkGetFenceStatus(vk_device_, in_flight_batches_.front().resources.vk_fence) 
+             == VK_SUCCESS) {
+    RetireOldestBatch(/*wait=*/ false);
+  }
+}
+
+void GALUploadManager::RetireOldestBatch(bool wait) {
+  InFlightBatch& batch = in_flight_batches_.front();
+
+  if (wait) {
+    vkWaitForFences(vk_device_, 1, &batch.resources.vk_fence, VK_TRUE, UINT64_MAX);
+  }
+
+  for (const auto& [buffer, allocation] : batch.dedicated_staging) {
+    vkDestroyBuffer(vk_device_, buffer, nullptr);
+    memory_allocator_->Free(allocation);
+  }
+
+  ring_tail_ = batch.ring_end;
+  completed_ticket_ = batch.ticket;
+  free_batch_resources_.push_back(batch.resources);
+
+  in_flight_batches_.pop_front();
+}
+
+} // namespace gal
\ No newline at end of file
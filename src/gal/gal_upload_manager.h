@@ -0,0 +1,169 @@
+#ifndef GAL_GAL_UPLOAD_MANAGER_H_
+#define GAL_GAL_UPLOAD_MANAGER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+#include "gal/gal_memory_allocator.h"
+
+namespace gal {
+
+// Identifies a batch of uploads. A ticket is complete once every upload enqueued with it (and
+// every earlier ticket) has finished on the GPU.
+using UploadTicket = uint64_t;
+
+// Batches uploads of host data into device-local buffers and images.
+//
+// Data is copied into a persistently mapped staging ring when enqueued, so callers can release
+// their copy immediately. Enqueued copies are recorded into a single command buffer and
+// submitted together by Flush(), which GALPlatform calls before submitting each frame. The
+// copies end with a barrier that makes the data visible to the requested pipeline stage, so
+// draws submitted afterwards need no further synchronisation.
+//
+// If the device has a dedicated transfer queue family, the copies run on it and ownership of
+// each buffer and image is released to the graphics queue family, which acquires it in a small
+// command buffer that waits on the transfer submission.
+class GALUploadManager {
+public:
+  // Uploads that do not fit get a staging buffer of their own.
+  static constexpr VkDeviceSize kStagingRingSize = 32 * 1024 * 1024;
+
+  struct Stats {
+    uint64_t bytes_uploaded = 0;
+    uint64_t copy_count = 0;
+    uint64_t batch_count = 0;
+  };
+
+  GALUploadManager(VkDevice vk_device, GALMemoryAllocator* memory_allocator,
+                   VkQueue vk_graphics_queue, uint32_t graphics_queue_family_index,
+                   VkQueue vk_transfer_queue, uint32_t transfer_queue_family_index,
+                   VkDeviceSize copy_offset_alignment);
+  ~GALUploadManager();
+
+  // Copies the data into staging memory and schedules a copy into dst_buffer at dst_offset.
+  // dst_access and dst_stage describe the first use of the buffer after the upload.
+  UploadTicket EnqueueBufferUpload(VkBuffer dst_buffer, VkDeviceSize dst_offset,
+                                   const void* data, VkDeviceSize size,
+                                   VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+  // Copies tightly packed texel data for the first mip level and array layer of dst_image into
+  // staging memory, and schedules a copy into the image. The image's previous contents are
+  // discarded, and it is left in final_layout. The texel size must divide the copy offset
+  // alignment, which holds for every format with power-of-two texels of up to 4 bytes.
+  UploadTicket EnqueueImageUpload(VkImage dst_image, const VkExtent3D& extent, const void* data,
+                                  VkDeviceSize size, VkImageLayout final_layout,
+                                  VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+  // Submits every enqueued upload. Does not wait.
+  void Flush();
+
+  bool IsComplete(UploadTicket ticket);
+
+  // Flushes the ticket's batch if it has not been submitted, and waits for it to finish.
+  void Wait(UploadTicket ticket);
+
+  bool UsesDedicatedTransferQueue() const {
+    return transfer_queue_family_index_ != graphics_queue_family_index_;
+  }
+
+  const Stats& GetStats() const { return stats_; }
+
+private:
+  struct PendingCopy {
+    VkBuffer dst_buffer;
+    VkBufferCopy region;
+    VkAccessFlags dst_access;
+    VkPipelineStageFlags dst_stage;
+
+    // Null if the data is in the staging ring.
+    VkBuffer src_buffer;
+  };
+
+  struct PendingImageCopy {
+    VkImage dst_image;
+    VkBufferImageCopy region;
+    VkImageLayout final_layout;
+    VkAccessFlags dst_access;
+    VkPipelineStageFlags dst_stage;
+
+    // Null if the data is in the staging ring.
+    VkBuffer src_buffer;
+  };
+
+  struct BatchResources {
+    VkFence vk_fence;
+    VkCommandBuffer vk_transfer_command_buffer;
+
+    // Only used with a dedicated transfer queue.
+    VkCommandBuffer vk_acquire_command_buffer = VK_NULL_HANDLE;
+    VkSemaphore vk_semaphore = VK_NULL_HANDLE;
+  };
+
+  struct InFlightBatch {
+    UploadTicket ticket;
+    BatchResources resources;
+
+    // Value of ring_head_ once the batch was recorded. The ring's tail moves here once the
+    // batch completes.
+    uint64_t ring_end;
+
+    // Staging buffers for uploads too large for the ring.
+    std::vector<std::pair<VkBuffer, GALMemoryAllocator::Allocation>> dedicated_staging;
+  };
+
+  // Copies the data into the staging ring, or into a staging buffer of its own if it does not
+  // fit. src_buffer is set to null in the first case.
+  void StageData(const void* data, VkDeviceSize size, VkBuffer* src_buffer, 
+                 VkDeviceSize* src_offset);
+
+  std::optional<VkDeviceSize> AllocateFromRing(VkDeviceSize size);
+  BatchResources AcquireBatchResources();
+  void RetireCompletedBatches();
+  void RetireOldestBatch(bool wait);
+
+private:
+  VkDevice vk_device_;
+  GALMemoryAllocator* memory_allocator_;
+
+  VkQueue vk_graphics_queue_;
+  uint32_t graphics_queue_family_index_;
+  VkQueue vk_transfer_queue_;
+  uint32_t transfer_queue_family_index_;
+
+  VkDeviceSize copy_offset_alignment_;
+
+  VkCommandPool vk_transfer_command_pool_;
+  VkCommandPool vk_acquire_command_pool_ = VK_NULL_HANDLE;
+
+  VkBuffer vk_staging_ring_;
+  GALMemoryAllocator::Allocation staging_ring_allocation_;
+
+  // Monotonic byte counters. The ring offset is the counter modulo the ring size.
+  uint64_t ring_head_ = 0;
+  uint64_t ring_tail_ = 0;
+
+  std::vector<PendingCopy> pending_copies_;
+  std::vector<PendingImageCopy> pending_image_copies_;
+  std::vector<std::pair<VkBuffer, GALMemoryAllocator::Allocation>> pending_dedicated_staging_;
+
+  // Ordered by ticket.
+  std::deque<InFlightBatch> in_flight_batches_;
+  std::vector<BatchResources> free_batch_resources_;
+
+  // The ticket that the next Flush() submits.
+  UploadTicket pending_ticket_ = 1;
+  UploadTicket completed_ticket_ = 0;
+
+  Stats stats_;
+
+  // Scratch space used while recording, so that Flush() does not allocate.
+  std::vector<VkBufferMemoryBarrier> barriers_;
+  std::vector<VkImageMemoryBarrier> image_barriers_;
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_UPLOAD_MANAGER_H_
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "gal/gal_worker_pool.h"
+
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "gal/gal_exception.h"
+
+namespace gal {
+
+GALWorkerPool::GALWorkerPool(VkDevice vk_device, uint32_t queue_family_index,
+                             uint32_t worker_count, uint32_t num_frames_in_flight)
+    : vk_device_(vk_device) {
+  if (worker_count == 0) {
+    throw Exception("Worker count cannot be zero.");
+  }
+
+  VkCommandPoolCreateInfo command_pool_create_info{};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.queueFamilyIndex = queue_family_index;
+
+  vk_persistent_command_pools_.resize(worker_count);
+  vk_frame_command_pools_.resize(worker_count);
+
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    command_pool_create_info.flags = 0;
+
+    if (vkCreateCommandPool(vk_device_, &command_pool_create_info, nullptr,
+                            &vk_persistent_command_pools_[i]) != VK_SUCCESS) {
+      throw Exception("Could not create worker command pool.");
+    }
+
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    vk_frame_command_pools_[i].resize(num_frames_in_flight);
+    for (VkCommandPool& command_pool : vk_frame_command_pools_[i]) {
+      if (vkCreateCommandPool(vk_device_, &command_pool_create_info, nullptr,
+                              &command_pool) != VK_SUCCESS) {
+        throw Exception("Could not create worker command pool.");
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&GALWorkerPool::WorkerMain, this, i);
+  }
+}
+
+GALWorkerPool::~GALWorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  work_available_.notify_all();
+
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+
+  for (const std::vector<VkCommandPool>& frame_command_pools : vk_frame_command_pools_) {
+    for (VkCommandPool command_pool : frame_command_pools) {
+      vkDestroyCommandPool(vk_device_, command_pool, nullptr);
+    }
+  }
+  for (VkCommandPool command_pool : vk_persistent_command_pools_) {
+    vkDestroyCommandPool(vk_device_, command_pool, nullptr);
+  }
+}
+
+void GALWorkerPool::ParallelFor(
+    uint32_t task_count, const std::function<void(uint32_t task_idx, uint32_t worker_idx)>& task) {
+  if (task_count == 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  task_ = &task;
+  task_count_ = task_count;
+  next_task_.store(0, std::memory_order_relaxed);
+  busy_workers_ = static_cast<uint32_t>(workers_.size());
+  first_exception_ = nullptr;
+  ++generation_;
+
+  work_available_.notify_all();
+  work_done_.wait(lock, [this]() { return busy_workers_ == 0; });
+
+  task_ = nullptr;
+
+  if (first_exception_) {
+    std::rethrow_exception(first_exception_);
+  }
+}
+
+void GALWorkerPool::ResetFrameCommandPools(uint32_t frame) {
+  for (const std::vector<VkCommandPool>& frame_command_pools : vk_frame_command_pools_) {
+    vkResetCommandPool(vk_device_, frame_command_pools[frame], 0);
+  }
+}
+
+void GALWorkerPool::WorkerMain(uint32_t worker_idx) {
+  uint64_t last_generation = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this, last_generation]() {
+        return shutting_down_ || generation_ != last_generation;
+      });
+      if (shutting_down_) {
+        return;
+      }
+      last_generation = generation_;
+    }
+
+    // Tasks are handed out one at a time, so that uneven slices balance across the workers.
+    std::exception_ptr exception;
+    for (uint32_t task_idx = next_task_.fetch_add(1); task_idx < task_count_;
+         task_idx = next_task_.fetch_add(1)) {
+      try {
+        (*task_)(task_idx, worker_idx);
+      } catch (...) {
+        if (!exception) {
+          exception = std::current_exception();
+        }
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (exception && !first_exception_) {
+        first_exception_ = exception;
+      }
+      --busy_workers_;
+      if (busy_workers_ == 0) {
+        work_done_.notify_one();
+      }
+    }
+  }
+}
+
+} // namespace gal
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef GAL_GAL_WORKER_POOL_H_
+#define GAL_GAL_WORKER_POOL_H_
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gal {
+
+// Worker threads for recording command buffers in parallel.
+//
+// VkCommandPools must not be used from two threads at once, so every worker owns its own pools:
+// one transient pool per frame in flight, which is reset in bulk once that frame's fence has
+// signaled, and one persistent pool for command buffers that are recorded once and replayed.
+class GALWorkerPool {
+public:
+  GALWorkerPool(VkDevice vk_device, uint32_t queue_family_index, uint32_t worker_count,
+                uint32_t num_frames_in_flight);
+  ~GALWorkerPool();
+
+  uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+  // Runs task(task_idx, worker_idx) for every task_idx in [0, task_count) on the workers, and
+  // returns once all of them have finished. worker_idx identifies the calling worker's pools.
+  // If a task throws, the first exception is rethrown here.
+  void ParallelFor(uint32_t task_count,
+                   const std::function<void(uint32_t task_idx, uint32_t worker_idx)>& task);
+
+  // Must only be used by the worker with the given index, or while no tasks are running.
+  VkCommandPool GetFrameCommandPool(uint32_t worker_idx, uint32_t frame) {
+    return vk_frame_command_pools_[worker_idx][frame];
+  }
+  VkCommandPool GetPersistentCommandPool(uint32_t worker_idx) {
+    return vk_persistent_command_pools_[worker_idx];
+  }
+
+  // Called by GALPlatform once the frame's fence has signaled.
+  void ResetFrameCommandPools(uint32_t frame);
+
+private:
+  void WorkerMain(uint32_t worker_idx);
+
+private:
+  VkDevice vk_device_;
+
+  // Indexed by worker, then by frame in flight.
+  std::vector<std::vector<VkCommandPool>> vk_frame_command_pools_;
+  std::vector<VkCommandPool> vk_persistent_command_pools_;
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable work_done_;
+
+  // Protected by mutex_.
+  bool shutting_down_ = false;
+  uint64_t generation_ = 0;
+  uint32_t busy_workers_ = 0;
+  std::exception_ptr first_exception_;
+
+  // Set before generation_ is incremented, and only read by workers of that generation.
+  const std::function<void(uint32_t, uint32_t)>* task_ = nullptr;
+  uint32_t task_count_ = 0;
+  std::atomic<uint32_t> next_task_{0};
+};
+
+} // namespace gal
+
+#endif // GAL_GAL_WORKER_POOL_H_
\ No newline at end of file
@@ -1,8 +1,94 @@
 #include "app.h"
 
-int main() {
-  App app;
-  app.MainLoop();
-  
-  return 0;
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "gal/gal_exception.h"
+
+int main(int argc, char* argv[]) {
+  AppOptions options;
+
+  // The presets are applied first, so that the flags below can adjust them.
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--latency=low") == 0) {
+      options.platform_options = gal::GALPlatform::Options::LowLatency();
+    } else if (strcmp(argv[i], "--latency=throughput") == 0) {
+      options.platform_options = gal::GALPlatform::Options::Throughput();
+    }
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      options.headless = true;
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      options.profile = true;
+    } else if (strcmp(argv[i], "--parallel") == 0) {
+      options.parallel_recording = true;
+    } else if (strcmp(argv[i], "--per-frame") == 0) {
+      options.per_frame_recording = true;
+    } else if (strncmp(argv[i], "--frames=", 9) == 0) {
+      options.headless_frame_count = static_cast<uint32_t>(strtoul(argv[i] + 9, nullptr, 10));
+    } else if (strncmp(argv[i], "--frames-in-flight=", 19) == 0) {
+      options.platform_options.frames_in_flight = 
+          static_cast<uint32_t>(strtoul(argv[i] + 19, nullptr, 10));
+    } else if (strcmp(argv[i], "--present-mode=immediate") == 0) {
+      options.platform_options.present_mode = gal::GALPlatform::PresentMode::Immediate;
+    } else if (strcmp(argv[i], "--present-mode=mailbox") == 0) {
+      options.platform_options.present_mode = gal::GALPlatform::PresentMode::Mailbox;
+    } else if (strcmp(argv[i], "--present-mode=fifo") == 0) {
+      options.platform_options.present_mode = gal::GALPlatform::PresentMode::Fifo;
+    } else if (strcmp(argv[i], "--present-mode=fifo-relaxed") == 0) {
+      options.platform_options.present_mode = gal::GALPlatform::PresentMode::FifoRelaxed;
+    } else if (strncmp(argv[i], "--extra-swapchain-images=", 25) == 0) {
+      options.platform_options.extra_swapchain_images = 
+          static_cast<uint32_t>(strtoul(argv[i] + 25, nullptr, 10));
+    } else if (strcmp(argv[i], "--frame-pacing") == 0) {
+      options.platform_options.frame_pacing = true;
+    } else if (strcmp(argv[i], "--validation") == 0) {
+      options.platform_options.validation = true;
+    } else if (strcmp(argv[i], "--no-validation") == 0) {
+      options.platform_options.validation = false;
+    } else if (strncmp(argv[i], "--pipeline-cache=", 17) == 0) {
+      options.pipeline_cache_path = argv[i] + 17;
+    } else if (strncmp(argv[i], "--model=", 8) == 0) {
+      options.model_path = argv[i] + 8;
+    } else if (strncmp(argv[i], "--synthetic-mesh=", 17) == 0) {
+      options.synthetic_mesh_segments = static_cast<uint32_t>(strtoul(argv[i] + 17, nullptr, 10));
+    } else if (strncmp(argv[i], "--instances=", 12) == 0) {
+      options.model_instance_count = static_cast<uint32_t>(strtoul(argv[i] + 12, nullptr, 10));
+    } else if (strcmp(argv[i], "--no-mesh-opt") == 0) {
+      options.optimize_meshes = false;
+    } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+      options.depth_prepass = true;
+    } else if (strcmp(argv[i], "--push-constants") == 0) {
+      options.push_constants = true;
+    } else if (strcmp(argv[i], "--bindless") == 0) {
+      options.bindless = true;
+      options.platform_options.bindless = true;
+    } else if (strcmp(argv[i], "--gpu-culling") == 0) {
+      options.gpu_culling = true;
+    } else if (strcmp(argv[i], "--cpu-culling") == 0) {
+      options.cpu_culling = true;
+    } else if (strcmp(argv[i], "--render-queue") == 0) {
+      options.render_queue = true;
+    } else if (strncmp(argv[i], "--cull-bench=", 13) == 0) {
+      options.cull_benchmark_size = static_cast<uint32_t>(strtoul(argv[i] + 13, nullptr, 10));
+    } else if (strncmp(argv[i], "--compute-bench=", 16) == 0) {
+      options.compute_benchmark_size = static_cast<uint32_t>(strtoul(argv[i] + 16, nullptr, 10));
+    } else if (strncmp(argv[i], "--encode-bench=", 15) == 0) {
+      options.encode_benchmark_size = static_cast<uint32_t>(strtoul(argv[i] + 15, nullptr, 10));
+    } else if (strcmp(argv[i], "--upload-check") == 0) {
+      options.upload_check = true;
+    }
+  }
+
+  // Invalid options, e.g. --frames-in-flight=0, are rejected by the constructors.
+  try {
+    App app(options);
+
+    return app.MainLoop() ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (gal::Exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "mesh/mesh.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "gal/gal_exception.h"
+
+namespace mesh {
+
+gal::GALPipeline::VertexInput GetVertexInput(int buffer_idx) {
+  gal::GALPipeline::VertexInput vert_input;
+  vert_input.buffer_idx = buffer_idx;
+  vert_input.stride = sizeof(Vertex);
+  return vert_input;
+}
+
+std::vector<gal::GALPipeline::VertexDesc> GetVertexDescs(int buffer_idx) {
+  gal::GALPipeline::VertexDesc position_desc;
+  position_desc.buffer_idx = buffer_idx;
+  position_desc.shader_idx = 0;
+  position_desc.num_components = 3;
+  position_desc.offset = offsetof(Vertex, position);
+
+  gal::GALPipeline::VertexDesc normal_desc;
+  normal_desc.buffer_idx = buffer_idx;
+  normal_desc.shader_idx = 1;
+  normal_desc.num_components = 3;
+  normal_desc.offset = offsetof(Vertex, normal);
+
+  gal::GALPipeline::VertexDesc texcoord_desc;
+  texcoord_desc.buffer_idx = buffer_idx;
+  texcoord_desc.shader_idx = 2;
+  texcoord_desc.num_components = 2;
+  texcoord_desc.offset = offsetof(Vertex, texcoord);
+
+  return {position_desc, normal_desc, texcoord_desc};
+}
+
+void ComputeBounds(MeshData* mesh_data) {
+  for (SubMesh& submesh : mesh_data->submeshes) {
+    std::fill_n(submesh.bounds_min, 3, std::numeric_limits<float>::max());
+    std::fill_n(submesh.bounds_max, 3, std::numeric_limits<float>::lowest());
+
+    for (uint32_t i = 0; i < submesh.index_count; ++i) {
+      uint32_t idx = mesh_data->indices[submesh.first_index + i];
+      const Vertex& vertex = mesh_data->vertices[submesh.vertex_offset + idx];
+
+      for (int axis = 0; axis < 3; ++axis) {
+        submesh.bounds_min[axis] = std::min(submesh.bounds_min[axis], vertex.position[axis]);
+        submesh.bounds_max[axis] = std::max(submesh.bounds_max[axis], vertex.position[axis]);
+      }
+    }
+
+    if (submesh.index_count == 0) {
+      std::fill_n(submesh.bounds_min, 3, 0.f);
+      std::fill_n(submesh.bounds_max, 3, 0.f);
+    }
+  }
+}
+
+bool FitsUint16Indices(const MeshData& mesh_data) {
+  return std::all_of(mesh_data.indices.begin(), mesh_data.indices.end(), [](uint32_t idx) {
+    return idx <= std::numeric_limits<uint16_t>::max();
+  });
+}
+
+Mesh::Mesh(gal::GALPlatform* gal_platform, const MeshData& mesh_data) {
+  submeshes_ = mesh_data.submeshes;
+
+  size_t vertex_data_size = sizeof(Vertex) * mesh_data.vertices.size();
+
+  if (FitsUint16Indices(mesh_data)) {
+    std::vector<uint16_t> indices(mesh_data.indices.begin(), mesh_data.indices.end());
+
+    CreateBuffers(gal_platform, mesh_data.vertices.data(), vertex_data_size, indices.data(),
+                  sizeof(uint16_t) * indices.size(), gal::IndexType::Uint16);
+  } else {
+    CreateBuffers(gal_platform, mesh_data.vertices.data(), vertex_data_size,
+                  mesh_data.indices.data(), sizeof(uint32_t) * mesh_data.indices.size(),
+                  gal::IndexType::Uint32);
+  }
+}
+
+Mesh::Mesh(gal::GALPlatform* gal_platform, const void* vertex_data, size_t vertex_data_size,
+           const void* index_data, size_t index_data_size, gal::IndexType index_type,
+           std::vector<SubMesh> submeshes) {
+  submeshes_ = std::move(submeshes);
+
+  CreateBuffers(gal_platform, vertex_data, vertex_data_size, index_data, index_data_size,
+                index_type);
+}
+
+void Mesh::CreateBuffers(gal::GALPlatform* gal_platform, const void* vertex_data,
+                         size_t vertex_data_size, const void* index_data,
+                         size_t index_data_size, gal::IndexType index_type) {
+  if (vertex_data_size == 0 || index_data_size == 0) {
+    throw gal::Exception("Mesh has no vertices or indices.");
+  }
+
+  // The builder only reads from the data, which is copied into staging memory by Create().
+  vertex_buffer_ = gal::GALBuffer::BeginBuild(gal_platform)
+      .SetType(gal::BufferType::Vertex)
+      .SetBufferData(static_cast<uint8_t*>(const_cast<void*>(vertex_data)), vertex_data_size)
+      .Create();
+
+  index_buffer_ = gal::GALBuffer::BeginBuild(gal_platform)
+      .SetType(gal::BufferType::Index)
+      .SetIndexType(index_type)
+      .SetBufferData(static_cast<uint8_t*>(const_cast<void*>(index_data)), index_data_size)
+      .Create();
+}
+
+} // namespace mesh
\ No newline at end of file
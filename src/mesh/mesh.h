@@ -0,0 +1,87 @@
+#ifndef MESH_MESH_H_
+#define MESH_MESH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gal/gal_buffer.h"
+#include "gal/gal_pipeline.h"
+#include "gal/gal_platform.h"
+
+namespace mesh {
+
+// Interleaved vertex format of imported meshes. Attributes missing from the source are zero.
+struct Vertex {
+  float position[3];
+  float normal[3];
+  float texcoord[2];
+};
+
+// Vertex layout of Vertex for GALPipeline::Builder, with the position, normal and texcoord at
+// shader indices 0, 1 and 2.
+gal::GALPipeline::VertexInput GetVertexInput(int buffer_idx);
+std::vector<gal::GALPipeline::VertexDesc> GetVertexDescs(int buffer_idx);
+
+// A range of the index buffer, drawn with a single command::DrawIndexed.
+struct SubMesh {
+  std::string name;
+  uint32_t first_index = 0;
+  uint32_t index_count = 0;
+
+  // Indices are relative to the submesh's first vertex.
+  int32_t vertex_offset = 0;
+
+  // Axis-aligned bounds of the submesh's vertices.
+  float bounds_min[3] = {};
+  float bounds_max[3] = {};
+};
+
+struct MeshData {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<SubMesh> submeshes;
+};
+
+// Updates the bounds of every submesh from the vertices that it references.
+void ComputeBounds(MeshData* mesh_data);
+
+// Whether every index of mesh_data fits into 16 bits.
+bool FitsUint16Indices(const MeshData& mesh_data);
+
+// Vertex and index buffers for a mesh, ready for indexed drawing.
+class Mesh {
+public:
+  // Stores the indices as 16-bit values if FitsUint16Indices() is true.
+  //
+  // Throws gal::Exception if the buffers cannot be created.
+  Mesh(gal::GALPlatform* gal_platform, const MeshData& mesh_data);
+
+  // Copies vertex_data (an array of Vertex) and index_data (an array of index_type values)
+  // straight into staging memory, e.g. from a memory-mapped file.
+  //
+  // Throws gal::Exception if the buffers cannot be created.
+  Mesh(gal::GALPlatform* gal_platform, const void* vertex_data, size_t vertex_data_size,
+       const void* index_data, size_t index_data_size, gal::IndexType index_type,
+       std::vector<SubMesh> submeshes);
+
+  gal::GALBuffer* GetVertexBuffer() { return vertex_buffer_.get(); }
+  gal::GALBuffer* GetIndexBuffer() { return index_buffer_.get(); }
+
+  const std::vector<SubMesh>& GetSubMeshes() const { return submeshes_; }
+
+private:
+  void CreateBuffers(gal::GALPlatform* gal_platform, const void* vertex_data,
+                     size_t vertex_data_size, const void* index_data, size_t index_data_size,
+                     gal::IndexType index_type);
+
+  std::unique_ptr<gal::GALBuffer> vertex_buffer_;
+  std::unique_ptr<gal::GALBuffer> index_buffer_;
+
+  std::vector<SubMesh> submeshes_;
+};
+
+} // namespace mesh
+
+#endif // MESH_MESH_H_
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include "mesh/mesh_cache.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "gal/gal_buffer.h"
+#include "gal/gal_pipeline.h"
+
+namespace mesh {
+
+namespace {
+
+const uint32_t kMagic = 0x48534D4F; // "OMSH"
+
+// Bump when the layout of the file changes.
+const uint32_t kVersion = 2;
+
+// Alignment of every blob in the file.
+const uint64_t kBlobAlignment = 64;
+
+// All values are stored in the native byte order.
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint64_t file_size;
+
+  uint32_t vertex_stride;
+  uint32_t vertex_desc_count;
+  uint32_t index_type;
+  uint32_t submesh_count;
+
+  uint64_t vertex_desc_offset;
+  uint64_t vertex_data_offset;
+  uint64_t vertex_data_size;
+  uint64_t index_data_offset;
+  uint64_t index_data_size;
+  uint64_t submesh_offset;
+  uint64_t name_data_offset;
+  uint64_t name_data_size;
+};
+
+// Matches GALPipeline::VertexDesc.
+struct FileVertexDesc {
+  int32_t buffer_idx;
+  int32_t shader_idx;
+  int32_t num_components;
+  int32_t offset;
+};
+
+struct FileSubMesh {
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+
+  // Range in the name blob.
+  uint32_t name_offset;
+  uint32_t name_size;
+  uint32_t padding;
+
+  float bounds_min[3];
+  float bounds_max[3];
+};
+
+const uint32_t kIndexTypeUint16 = 0;
+const uint32_t kIndexTypeUint32 = 1;
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + kBlobAlignment - 1) & ~(kBlobAlignment - 1);
+}
+
+// Read-only mapping of a whole file.
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+#else
+    if (data_ != nullptr) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+  }
+
+  // Returns false if the file cannot be opened or mapped. An empty file maps to no data.
+  bool Open(const std::string& path) {
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size)) {
+      return false;
+    }
+
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    if (size_ == 0) {
+      return true;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+      return false;
+    }
+
+    data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    return data_ != nullptr;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+      close(fd);
+      return false;
+    }
+
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ == 0) {
+      close(fd);
+      return true;
+    }
+
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+      return false;
+    }
+
+    // The file is read once, front to back.
+    madvise(data, size_, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const uint8_t*>(data);
+    return true;
+#endif
+  }
+
+  const uint8_t* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+
+private:
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#endif
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+uint64_t Mix(uint64_t hash, uint64_t value) {
+  hash ^= value;
+  hash *= 0x9E3779B97F4A7C15ull;
+  return hash ^ (hash >> 29);
+}
+
+// Non-cryptographic hash. Hashes four independent lanes so that it runs at close to memory
+// bandwidth.
+uint64_t HashData(const uint8_t* data, size_t size) {
+  uint64_t lanes[4] = {size, 0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull};
+
+  size_t offset = 0;
+  for (; offset + 32 <= size; offset += 32) {
+    uint64_t words[4];
+    memcpy(words, data + offset, sizeof(words));
+
+    for (int i = 0; i < 4; ++i) {
+      lanes[i] = Mix(lanes[i], words[i]);
+    }
+  }
+
+  uint8_t tail[32] = {};
+  memcpy(tail, data + offset, size - offset);
+
+  uint64_t words[4];
+  memcpy(words, tail, sizeof(words));
+
+  uint64_t hash = 0;
+  for (int i = 0; i < 4; ++i) {
+    hash = Mix(hash, Mix(lanes[i], words[i]));
+  }
+  return hash;
+}
+
+bool IsBlobInFile(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset % kBlobAlignment == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+} // namespace
+
+std::optional<uint64_t> HashSourceFile(const std::string& path) {
+  MappedFile file;
+  if (!file.Open(path)) {
+    std::cerr << "Could not map file: " << path << std::endl;
+    return std::nullopt;
+  }
+
+  return HashData(file.GetData(), file.GetSize());
+}
+
+bool WriteMeshCache(const std::string& path, const MeshData& mesh_data, uint64_t source_hash) {
+  std::vector<gal::GALPipeline::VertexDesc> vertex_descs = GetVertexDescs(0);
+
+  std::vector<FileVertexDesc> file_vertex_descs;
+  for (const gal::GALPipeline::VertexDesc& desc : vertex_descs) {
+    file_vertex_descs.push_back({desc.buffer_idx, desc.shader_idx, desc.num_components,
+                                 desc.offset});
+  }
+
+  std::vector<uint16_t> indices_16;
+  bool use_uint16 = FitsUint16Indices(mesh_data);
+  if (use_uint16) {
+    indices_16.assign(mesh_data.indices.begin(), mesh_data.indices.end());
+  }
+
+  std::vector<FileSubMesh> file_submeshes;
+  std::string name_data;
+  for (const SubMesh& submesh : mesh_data.submeshes) {
+    FileSubMesh file_submesh = {};
+    file_submesh.first_index = submesh.first_index;
+    file_submesh.index_count = submesh.index_count;
+    file_submesh.vertex_offset = submesh.vertex_offset;
+    file_submesh.name_offset = static_cast<uint32_t>(name_data.size());
+    file_submesh.name_size = static_cast<uint32_t>(submesh.name.size());
+    std::copy_n(submesh.bounds_min, 3, file_submesh.bounds_min);
+    std::copy_n(submesh.bounds_max, 3, file_submesh.bounds_max);
+    file_submeshes.push_back(file_submesh);
+
+    name_data += submesh.name;
+  }
+
+  FileHeader header = {};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.source_hash = source_hash;
+  header.vertex_stride = sizeof(Vertex);
+  header.vertex_desc_count = static_cast<uint32_t>(file_vertex_descs.size());
+  header.index_type = use_uint16 ? kIndexTypeUint16 : kIndexTypeUint32;
+  header.submesh_count = static_cast<uint32_t>(file_submeshes.size());
+
+  header.vertex_desc_offset = AlignUp(sizeof(FileHeader));
+  header.vertex_data_offset = AlignUp(header.vertex_desc_offset +
+                                      sizeof(FileVertexDesc) * file_vertex_descs.size());
+  header.vertex_data_size = sizeof(Vertex) * mesh_data.vertices.size();
+  header.index_data_offset = AlignUp(header.vertex_data_offset + header.vertex_data_size);
+  header.index_data_size = use_uint16 ? sizeof(uint16_t) * indices_16.size()
+                                      : sizeof(uint32_t) * mesh_data.indices.size();
+  header.submesh_offset = AlignUp(header.index_data_offset + header.index_data_size);
+  header.name_data_offset = AlignUp(header.submesh_offset +
+                                    sizeof(FileSubMesh) * file_submeshes.size());
+  header.name_data_size = name_data.size();
+  header.file_size = header.name_data_offset + header.name_data_size;
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    std::cerr << "Could not open mesh cache for writing: " << path << std::endl;
+    return false;
+  }
+
+  auto write_blob = [&file](uint64_t offset, const void* data, uint64_t size) {
+    static const char kPadding[kBlobAlignment] = {};
+    file.write(kPadding, offset - static_cast<uint64_t>(file.tellp()));
+    file.write(static_cast<const char*>(data), size);
+  };
+
+  write_blob(0, &header, sizeof(header));
+  write_blob(header.vertex_desc_offset, file_vertex_descs.data(),
+             sizeof(FileVertexDesc) * file_vertex_descs.size());
+  write_blob(header.vertex_data_offset, mesh_data.vertices.data(), header.vertex_data_size);
+  if (use_uint16) {
+    write_blob(header.index_data_offset, indices_16.data(), header.index_data_size);
+  } else {
+    write_blob(header.index_data_offset, mesh_data.indices.data(), header.index_data_size);
+  }
+  write_blob(header.submesh_offset, file_submeshes.data(),
+             sizeof(FileSubMesh) * file_submeshes.size());
+  write_blob(header.name_data_offset, name_data.data(), name_data.size());
+
+  if (!file) {
+    std::cerr << "Could not write mesh cache: " << path << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+std::unique_ptr<Mesh> LoadMeshCache(gal::GALPlatform* gal_platform, const std::string& path,
+                                    uint64_t source_hash) {
+  MappedFile file;
+  if (!file.Open(path) || file.GetSize() < sizeof(FileHeader)) {
+    return nullptr;
+  }
+
+  const uint8_t* data = file.GetData();
+  uint64_t file_size = file.GetSize();
+
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  if (header.magic != kMagic || header.version != kVersion || header.file_size != file_size) {
+    return nullptr;
+  }
+
+  // The source file changed since the cache was written.
+  if (header.source_hash != source_hash) {
+    return nullptr;
+  }
+
+  if (!IsBlobInFile(header.vertex_desc_offset,
+                    sizeof(FileVertexDesc) * uint64_t{header.vertex_desc_count}, file_size) ||
+      !IsBlobInFile(header.vertex_data_offset, header.vertex_data_size, file_size) ||
+      !IsBlobInFile(header.index_data_offset, header.index_data_size, file_size) ||
+      !IsBlobInFile(header.submesh_offset,
+                    sizeof(FileSubMesh) * uint64_t{header.submesh_count}, file_size) ||
+      !IsBlobInFile(header.name_data_offset, header.name_data_size, file_size)) {
+    std::cerr << "Mesh cache is malformed: " << path << std::endl;
+    return nullptr;
+  }
+
+  // Caches written for a different vertex layout are treated as stale.
+  std::vector<gal::GALPipeline::VertexDesc> vertex_descs = GetVertexDescs(0);
+  if (header.vertex_stride != sizeof(Vertex) || header.vertex_desc_count != vertex_descs.size()) {
+    return nullptr;
+  }
+
+  for (size_t i = 0; i < vertex_descs.size(); ++i) {
+    FileVertexDesc file_desc;
+    memcpy(&file_desc, data + header.vertex_desc_offset + sizeof(FileVertexDesc) * i,
+           sizeof(file_desc));
+
+    if (file_desc.buffer_idx != vertex_descs[i].buffer_idx ||
+        file_desc.shader_idx != vertex_descs[i].shader_idx ||
+        file_desc.num_components != vertex_descs[i].num_components ||
+        file_desc.offset != vertex_descs[i].offset) {
+      return nullptr;
+    }
+  }
+
+  gal::IndexType index_type;
+  uint64_t index_size;
+  if (header.index_type == kIndexTypeUint16) {
+    index_type = gal::IndexType::Uint16;
+    index_size = sizeof(uint16_t);
+  } else if (header.index_type == kIndexTypeUint32) {
+    index_type = gal::IndexType::Uint32;
+    index_size = sizeof(uint32_t);
+  } else {
+    std::cerr << "Mesh cache is malformed: " << path << std::endl;
+    return nullptr;
+  }
+
+  uint64_t index_count = header.index_data_size / index_size;
+
+  std::vector<SubMesh> submeshes;
+  submeshes.reserve(header.submesh_count);
+
+  for (uint32_t i = 0; i < header.submesh_count; ++i) {
+    FileSubMesh file_submesh;
+    memcpy(&file_submesh, data + header.submesh_offset + sizeof(FileSubMesh) * i,
+           sizeof(file_submesh));
+
+    if (uint64_t{file_submesh.first_index} + file_submesh.index_count > index_count ||
+        uint64_t{file_submesh.name_offset} + file_submesh.name_size > header.name_data_size) {
+      std::cerr << "Mesh cache is malformed: " << path << std::endl;
+      return nullptr;
+    }
+
+    SubMesh submesh;
+    submesh.name.assign(
+        reinterpret_cast<const char*>(data + header.name_data_offset + file_submesh.name_offset),
+        file_submesh.name_size);
+    submesh.first_index = file_submesh.first_index;
+    submesh.index_count = file_submesh.index_count;
+    submesh.vertex_offset = file_submesh.vertex_offset;
+    std::copy_n(file_submesh.bounds_min, 3, submesh.bounds_min);
+    std::copy_n(file_submesh.bounds_max, 3, submesh.bounds_max);
+    submeshes.push_back(std::move(submesh));
+  }
+
+  // The vertex and index data are copied from the mapping into staging memory by the mesh's
+  // buffers, before the mapping is closed.
+  return std::make_unique<Mesh>(gal_platform, data + header.vertex_data_offset,
+                                header.vertex_data_size, data + header.index_data_offset,
+                                header.index_data_size, index_type, std::move(submeshes));
+}
+
+} // namespace mesh
\ No newline at end of file
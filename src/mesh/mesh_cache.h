@@ -0,0 +1,35 @@
+#ifndef MESH_MESH_CACHE_H_
+#define MESH_MESH_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include "gal/gal_platform.h"
+#include "mesh/mesh.h"
+
+namespace mesh {
+
+// Binary container for imported meshes, so that source files only need to be parsed once. A cache
+// file holds a header, the vertex layout (as GALPipeline::VertexDesc values), the vertex and index
+// data in the layout of the GPU buffers, and the submesh ranges. The data blobs are aligned, so
+// that a memory-mapped cache file can be copied into staging memory as-is.
+//
+// Each cache file records a hash of its source file, and is ignored once the source changes.
+
+// Hashes the contents of a source file, for WriteMeshCache() and LoadMeshCache().
+std::optional<uint64_t> HashSourceFile(const std::string& path);
+
+// Returns false if the file cannot be written.
+bool WriteMeshCache(const std::string& path, const MeshData& mesh_data, uint64_t source_hash);
+
+// Maps the cache file and creates a mesh from it. Returns nullptr if the file is missing, was
+// written for a different source_hash or vertex layout, or is malformed.
+//
+// Throws gal::Exception if the mesh's buffers cannot be created.
+std::unique_ptr<Mesh> LoadMeshCache(gal::GALPlatform* gal_platform, const std::string& path,
+                                    uint64_t source_hash);
+
+} // namespace mesh
+
+#endif // MESH_MESH_CACHE_H_
\ No newline at end of file
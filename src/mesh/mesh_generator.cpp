@@ -0,0 +1,101 @@
+#include "mesh/mesh_generator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace mesh {
+
+namespace {
+
+const float kPi = 3.14159265358979f;
+
+} // namespace
+
+MeshData GenerateSphere(uint32_t segments, uint32_t rings, uint32_t shuffle_seed) {
+  segments = std::max(segments, 3u);
+  rings = std::max(rings, 2u);
+
+  MeshData mesh_data;
+
+  // The seam and poles have duplicate vertices, so that the texcoords do not wrap.
+  for (uint32_t ring = 0; ring <= rings; ++ring) {
+    float v = static_cast<float>(ring) / rings;
+    float theta = v * kPi;
+
+    for (uint32_t segment = 0; segment <= segments; ++segment) {
+      float u = static_cast<float>(segment) / segments;
+      float phi = u * 2.f * kPi;
+
+      Vertex vertex;
+      vertex.normal[0] = std::sin(theta) * std::cos(phi);
+      vertex.normal[1] = std::cos(theta);
+      vertex.normal[2] = std::sin(theta) * std::sin(phi);
+      std::copy_n(vertex.normal, 3, vertex.position);
+      vertex.texcoord[0] = u;
+      vertex.texcoord[1] = v;
+
+      mesh_data.vertices.push_back(vertex);
+    }
+  }
+
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (uint32_t ring = 0; ring < rings; ++ring) {
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+      uint32_t v0 = ring * (segments + 1) + segment;
+      uint32_t v1 = v0 + 1;
+      uint32_t v2 = v0 + segments + 1;
+      uint32_t v3 = v2 + 1;
+
+      // The triangles that touch the poles are degenerate.
+      if (ring != 0) {
+        triangles.push_back({v0, v1, v2});
+      }
+      if (ring != rings - 1) {
+        triangles.push_back({v1, v3, v2});
+      }
+    }
+  }
+
+  if (shuffle_seed != 0) {
+    std::mt19937 random(shuffle_seed);
+
+    std::shuffle(triangles.begin(), triangles.end(), random);
+
+    std::vector<uint32_t> remap(mesh_data.vertices.size());
+    std::iota(remap.begin(), remap.end(), 0);
+    std::shuffle(remap.begin(), remap.end(), random);
+
+    std::vector<Vertex> shuffled(mesh_data.vertices.size());
+    for (size_t i = 0; i < remap.size(); ++i) {
+      shuffled[remap[i]] = mesh_data.vertices[i];
+    }
+    mesh_data.vertices = std::move(shuffled);
+
+    for (std::array<uint32_t, 3>& triangle : triangles) {
+      for (uint32_t& idx : triangle) {
+        idx = remap[idx];
+      }
+    }
+  }
+
+  for (const std::array<uint32_t, 3>& triangle : triangles) {
+    mesh_data.indices.insert(mesh_data.indices.end(), triangle.begin(), triangle.end());
+  }
+
+  SubMesh submesh;
+  submesh.name = "sphere";
+  submesh.index_count = static_cast<uint32_t>(mesh_data.indices.size());
+  mesh_data.submeshes.push_back(submesh);
+
+  ComputeBounds(&mesh_data);
+
+  return mesh_data;
+}
+
+} // namespace mesh
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef MESH_MESH_GENERATOR_H_
+#define MESH_MESH_GENERATOR_H_
+
+#include <cstdint>
+#include "mesh/mesh.h"
+
+namespace mesh {
+
+// Generates a unit UV sphere as a single submesh. If shuffle_seed is non-zero, the triangles and
+// vertices are shuffled, which gives the worst case for the vertex cache, like a poorly exported
+// asset. Useful for benchmarking the mesh optimizer.
+MeshData GenerateSphere(uint32_t segments, uint32_t rings, uint32_t shuffle_seed = 0);
+
+} // namespace mesh
+
+#endif // MESH_MESH_GENERATOR_H_
\ No newline at end of file
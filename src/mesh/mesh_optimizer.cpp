@@ -0,0 +1,369 @@
+#include "mesh/mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mesh {
+
+namespace {
+
+const uint32_t kInvalidIndex = 0xFFFFFFFF;
+
+struct CacheCounts {
+  size_t misses = 0;
+  size_t triangles = 0;
+  size_t vertices = 0;
+};
+
+CacheCounts CountCacheMisses(const uint32_t* indices, size_t index_count, size_t vertex_count,
+                             uint32_t cache_size) {
+  CacheCounts counts;
+  counts.triangles = index_count / 3;
+
+  // A vertex is in the FIFO cache until cache_size misses have happened after its own.
+  std::vector<size_t> miss_stamps(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+
+  for (size_t i = 0; i < index_count; ++i) {
+    uint32_t idx = indices[i];
+
+    if (!referenced[idx]) {
+      referenced[idx] = true;
+      ++counts.vertices;
+    } else if (counts.misses - miss_stamps[idx] < cache_size) {
+      continue;
+    }
+
+    miss_stamps[idx] = counts.misses++;
+  }
+
+  return counts;
+}
+
+VertexCacheStats ToStats(const CacheCounts& counts) {
+  VertexCacheStats stats;
+  if (counts.triangles > 0) {
+    stats.acmr = static_cast<float>(counts.misses) / counts.triangles;
+  }
+  if (counts.vertices > 0) {
+    stats.atvr = static_cast<float>(counts.misses) / counts.vertices;
+  }
+  return stats;
+}
+
+// Vertex to triangle adjacency, in compressed row form.
+struct Adjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+};
+
+Adjacency BuildAdjacency(const uint32_t* indices, size_t index_count, size_t vertex_count) {
+  Adjacency adjacency;
+  adjacency.offsets.assign(vertex_count + 1, 0);
+  adjacency.triangles.resize(index_count);
+
+  for (size_t i = 0; i < index_count; ++i) {
+    ++adjacency.offsets[indices[i] + 1];
+  }
+  for (size_t v = 0; v < vertex_count; ++v) {
+    adjacency.offsets[v + 1] += adjacency.offsets[v];
+  }
+
+  std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+  for (size_t i = 0; i < index_count; ++i) {
+    adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  return adjacency;
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t index_count,
+                                    size_t vertex_count, uint32_t cache_size) {
+  return ToStats(CountCacheMisses(indices, index_count, vertex_count, cache_size));
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count,
+                         uint32_t cache_size, std::vector<uint32_t>* clusters) {
+  size_t triangle_count = index_count / 3;
+  if (triangle_count == 0) {
+    return;
+  }
+
+  Adjacency adjacency = BuildAdjacency(indices, index_count, vertex_count);
+
+  // Number of triangles that still have to be emitted per vertex.
+  std::vector<uint32_t> live_counts(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    live_counts[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  }
+
+  // Time at which each vertex last entered the cache.
+  std::vector<uint32_t> cache_stamps(vertex_count, 0);
+  uint32_t time_stamp = cache_size + 1;
+
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end_stack;
+  std::vector<uint32_t> candidates;
+
+  std::vector<uint32_t> output;
+  output.reserve(index_count);
+
+  if (clusters != nullptr) {
+    clusters->clear();
+    clusters->push_back(0);
+  }
+
+  uint32_t fanning_vertex = indices[0];
+  uint32_t scan_cursor = 0;
+
+  while (fanning_vertex != kInvalidIndex) {
+    candidates.clear();
+
+    // Emits every remaining triangle around the fanning vertex.
+    for (uint32_t i = adjacency.offsets[fanning_vertex];
+         i < adjacency.offsets[fanning_vertex + 1]; ++i) {
+      uint32_t triangle = adjacency.triangles[i];
+      if (emitted[triangle]) {
+        continue;
+      }
+
+      emitted[triangle] = true;
+
+      for (int corner = 0; corner < 3; ++corner) {
+        uint32_t v = indices[triangle * 3 + corner];
+        output.push_back(v);
+
+        dead_end_stack.push_back(v);
+        candidates.push_back(v);
+        --live_counts[v];
+
+        if (time_stamp - cache_stamps[v] > cache_size) {
+          cache_stamps[v] = time_stamp++;
+        }
+      }
+    }
+
+    // Picks the candidate that is oldest in the cache but will still be in it after its
+    // remaining triangles are emitted.
+    uint32_t next_vertex = kInvalidIndex;
+    uint32_t best_priority = 0;
+
+    for (uint32_t v : candidates) {
+      if (live_counts[v] == 0) {
+        continue;
+      }
+
+      uint32_t priority = 0;
+      if (time_stamp - cache_stamps[v] + 2 * live_counts[v] <= cache_size) {
+        priority = time_stamp - cache_stamps[v];
+      }
+
+      if (next_vertex == kInvalidIndex || priority > best_priority) {
+        best_priority = priority;
+        next_vertex = v;
+      }
+    }
+
+    if (next_vertex != kInvalidIndex) {
+      fanning_vertex = next_vertex;
+      continue;
+    }
+
+    // Dead end. Tries recently used vertices first, then scans for any vertex with triangles left.
+    while (!dead_end_stack.empty()) {
+      uint32_t v = dead_end_stack.back();
+      dead_end_stack.pop_back();
+
+      if (live_counts[v] > 0) {
+        next_vertex = v;
+        break;
+      }
+    }
+
+    while (next_vertex == kInvalidIndex && scan_cursor < vertex_count) {
+      if (live_counts[scan_cursor] > 0) {
+        next_vertex = scan_cursor;
+      }
+      ++scan_cursor;
+    }
+
+    if (clusters != nullptr && next_vertex != kInvalidIndex) {
+      clusters->push_back(static_cast<uint32_t>(output.size() / 3));
+    }
+
+    fanning_vertex = next_vertex;
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t index_count, const Vertex* vertices,
+                      const std::vector<uint32_t>& clusters) {
+  size_t triangle_count = index_count / 3;
+  if (clusters.size() <= 1) {
+    return;
+  }
+
+  struct Cluster {
+    uint32_t first_triangle;
+    uint32_t triangle_count;
+    float sort_key;
+  };
+
+  std::vector<Cluster> sorted_clusters(clusters.size());
+
+  float mesh_centroid[3] = {};
+  float mesh_area = 0.f;
+
+  std::vector<float> cluster_data(clusters.size() * 7, 0.f);
+
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    uint32_t end = c + 1 < clusters.size() ? clusters[c + 1]
+                                           : static_cast<uint32_t>(triangle_count);
+
+    sorted_clusters[c].first_triangle = clusters[c];
+    sorted_clusters[c].triangle_count = end - clusters[c];
+
+    // Area-weighted centroid (0-2), area-weighted normal (3-5) and area (6).
+    float* data = &cluster_data[c * 7];
+
+    for (uint32_t t = clusters[c]; t < end; ++t) {
+      const float* p0 = vertices[indices[t * 3]].position;
+      const float* p1 = vertices[indices[t * 3 + 1]].position;
+      const float* p2 = vertices[indices[t * 3 + 2]].position;
+
+      float e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      float e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      float normal[3] = {e0[1] * e1[2] - e0[2] * e1[1],
+                         e0[2] * e1[0] - e0[0] * e1[2],
+                         e0[0] * e1[1] - e0[1] * e1[0]};
+      float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                             normal[2] * normal[2]);
+
+      for (int i = 0; i < 3; ++i) {
+        data[i] += (p0[i] + p1[i] + p2[i]) / 3.f * area;
+        data[3 + i] += normal[i];
+      }
+      data[6] += area;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+      mesh_centroid[i] += data[i];
+    }
+    mesh_area += data[6];
+  }
+
+  if (mesh_area > 0.f) {
+    for (int i = 0; i < 3; ++i) {
+      mesh_centroid[i] /= mesh_area;
+    }
+  }
+
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const float* data = &cluster_data[c * 7];
+
+    float key = 0.f;
+    if (data[6] > 0.f) {
+      for (int i = 0; i < 3; ++i) {
+        key += (data[i] / data[6] - mesh_centroid[i]) * data[3 + i];
+      }
+      // The normal is weighted by area, so this normalizes it.
+      float normal_length = std::sqrt(data[3] * data[3] + data[4] * data[4] +
+                                      data[5] * data[5]);
+      if (normal_length > 0.f) {
+        key /= normal_length;
+      }
+    }
+    sorted_clusters[c].sort_key = key;
+  }
+
+  std::stable_sort(sorted_clusters.begin(), sorted_clusters.end(),
+                   [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+  std::vector<uint32_t> output;
+  output.reserve(index_count);
+
+  for (const Cluster& cluster : sorted_clusters) {
+    output.insert(output.end(), indices + cluster.first_triangle * 3,
+                  indices + (cluster.first_triangle + cluster.triangle_count) * 3);
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(Vertex* vertices, size_t vertex_count, uint32_t* indices,
+                         size_t index_count) {
+  std::vector<uint32_t> remap(vertex_count, kInvalidIndex);
+  uint32_t next_vertex = 0;
+
+  for (size_t i = 0; i < index_count; ++i) {
+    uint32_t& remapped = remap[indices[i]];
+    if (remapped == kInvalidIndex) {
+      remapped = next_vertex++;
+    }
+    indices[i] = remapped;
+  }
+
+  for (uint32_t& remapped : remap) {
+    if (remapped == kInvalidIndex) {
+      remapped = next_vertex++;
+    }
+  }
+
+  std::vector<Vertex> reordered(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    reordered[remap[v]] = vertices[v];
+  }
+
+  std::copy(reordered.begin(), reordered.end(), vertices);
+}
+
+MeshOptimizeStats OptimizeMesh(MeshData* mesh_data, const MeshOptimizeOptions& options) {
+  CacheCounts before;
+  CacheCounts after;
+
+  std::vector<uint32_t> clusters;
+
+  for (const SubMesh& submesh : mesh_data->submeshes) {
+    if (submesh.index_count == 0) {
+      continue;
+    }
+
+    uint32_t* indices = mesh_data->indices.data() + submesh.first_index;
+    Vertex* vertices = mesh_data->vertices.data() + submesh.vertex_offset;
+
+    size_t vertex_count = *std::max_element(indices, indices + submesh.index_count) + 1;
+
+    CacheCounts counts = CountCacheMisses(indices, submesh.index_count, vertex_count,
+                                          options.cache_size);
+    before.misses += counts.misses;
+    before.triangles += counts.triangles;
+    before.vertices += counts.vertices;
+
+    OptimizeVertexCache(indices, submesh.index_count, vertex_count, options.cache_size,
+                        options.optimize_overdraw ? &clusters : nullptr);
+
+    if (options.optimize_overdraw) {
+      OptimizeOverdraw(indices, submesh.index_count, vertices, clusters);
+    }
+
+    OptimizeVertexFetch(vertices, vertex_count, indices, submesh.index_count);
+
+    counts = CountCacheMisses(indices, submesh.index_count, vertex_count, options.cache_size);
+    after.misses += counts.misses;
+    after.triangles += counts.triangles;
+    after.vertices += counts.vertices;
+  }
+
+  MeshOptimizeStats stats;
+  stats.before = ToStats(before);
+  stats.after = ToStats(after);
+  return stats;
+}
+
+} // namespace mesh
\ No newline at end of file
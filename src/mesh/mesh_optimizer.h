@@ -0,0 +1,67 @@
+#ifndef MESH_MESH_OPTIMIZER_H_
+#define MESH_MESH_OPTIMIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh/mesh.h"
+
+namespace mesh {
+
+// Post-transform vertex cache size that the passes optimize for and that AnalyzeVertexCache()
+// simulates. Meant to be a conservative estimate for current GPUs.
+constexpr uint32_t kDefaultVertexCacheSize = 16;
+
+struct VertexCacheStats {
+  // Average cache misses per triangle. Between 0.5 (ideal for a regular grid) and 3.
+  float acmr = 0.f;
+
+  // Average cache misses per referenced vertex. 1 is ideal.
+  float atvr = 0.f;
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries over the triangle list.
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t index_count,
+                                    size_t vertex_count,
+                                    uint32_t cache_size = kDefaultVertexCacheSize);
+
+// Reorders triangles for post-transform cache locality, with the Tipsify algorithm (Sander et
+// al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007). Runs in linear
+// time.
+//
+// If clusters is non-null, the first triangle of every cluster is written to it. Clusters start
+// where Tipsify had to jump to a vertex outside the cache, so they can be reordered by
+// OptimizeOverdraw() without hurting cache locality much.
+void OptimizeVertexCache(uint32_t* indices, size_t index_count, size_t vertex_count,
+                         uint32_t cache_size = kDefaultVertexCacheSize,
+                         std::vector<uint32_t>* clusters = nullptr);
+
+// Sorts the clusters from OptimizeVertexCache() so that clusters facing away from the mesh's
+// centre are drawn first, since they tend to occlude the others. Triangles keep their order
+// within a cluster.
+void OptimizeOverdraw(uint32_t* indices, size_t index_count, const Vertex* vertices,
+                      const std::vector<uint32_t>& clusters);
+
+// Reorders vertices into the order in which the indices first reference them, and rewrites the
+// indices to match, so that vertex fetches walk the vertex buffer mostly linearly. Unreferenced
+// vertices are moved to the end.
+void OptimizeVertexFetch(Vertex* vertices, size_t vertex_count, uint32_t* indices,
+                         size_t index_count);
+
+struct MeshOptimizeOptions {
+  uint32_t cache_size = kDefaultVertexCacheSize;
+  bool optimize_overdraw = true;
+};
+
+struct MeshOptimizeStats {
+  // Over all submeshes.
+  VertexCacheStats before;
+  VertexCacheStats after;
+};
+
+// Runs the passes above on every submesh. Submeshes must not share vertices.
+MeshOptimizeStats OptimizeMesh(MeshData* mesh_data, const MeshOptimizeOptions& options = {});
+
+} // namespace mesh
+
+#endif // MESH_MESH_OPTIMIZER_H_
\ No newline at end of file
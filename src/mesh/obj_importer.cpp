@@ -0,0 +1,422 @@
+#include "mesh/obj_importer.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tinyobjloader/tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "gal/gal_worker_pool.h"
+
+namespace mesh {
+
+namespace {
+
+// Chunks are cut at line boundaries, so that each one can be parsed on its own.
+const size_t kMinChunkSize = 1 << 20;
+const size_t kChunksPerThread = 4;
+
+const uint32_t kNoIndex = 0xFFFFFFFF;
+
+// Relative (negative) OBJ indices are resolved against the attributes seen so far, which a chunk
+// only knows about locally. They are stored as signed 30-bit offsets from the chunk's first
+// attribute, with this bit set, until the chunk's base is known.
+const uint32_t kChunkLocalBit = 0x80000000;
+const uint32_t kChunkLocalMask = 0x3FFFFFFF;
+
+struct FaceVertex {
+  uint32_t position = kNoIndex;
+  uint32_t normal = kNoIndex;
+  uint32_t texcoord = kNoIndex;
+
+  bool operator==(const FaceVertex& other) const {
+    return position == other.position && normal == other.normal && texcoord == other.texcoord;
+  }
+};
+
+struct ObjectStart {
+  std::string name;
+
+  // Index of the object's first face vertex.
+  size_t first_face_vertex;
+};
+
+struct ChunkResult {
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> texcoords;
+
+  // 3 per triangle.
+  std::vector<FaceVertex> face_vertices;
+
+  std::vector<ObjectStart> objects;
+
+  bool success = true;
+};
+
+struct SubMeshResult {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// Exposes a range of memory as a std::istream without copying it.
+class MemoryStreamBuf : public std::streambuf {
+public:
+  MemoryStreamBuf(const char* begin, const char* end) {
+    char* data = const_cast<char*>(begin);
+    setg(data, data, const_cast<char*>(end));
+  }
+};
+
+// Runs task(i) for every i in [0, count), on the worker pool's threads if it is non-null.
+void RunTasks(size_t count, gal::GALWorkerPool* worker_pool,
+              const std::function<void(size_t)>& task) {
+  if (worker_pool == nullptr || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  worker_pool->ParallelFor(static_cast<uint32_t>(count), [&task](uint32_t task_idx, uint32_t) {
+    task(task_idx);
+  });
+}
+
+std::vector<std::pair<size_t, size_t>> SplitIntoChunks(const std::vector<char>& file_data,
+                                                       size_t thread_count) {
+  size_t chunk_size = std::max(kMinChunkSize,
+                               file_data.size() / (thread_count * kChunksPerThread));
+
+  std::vector<std::pair<size_t, size_t>> chunks;
+
+  size_t begin = 0;
+  while (begin < file_data.size()) {
+    size_t end = std::min(begin + chunk_size, file_data.size());
+
+    while (end < file_data.size() && file_data[end - 1] != '\n') {
+      ++end;
+    }
+
+    chunks.push_back({begin, end});
+    begin = end;
+  }
+
+  return chunks;
+}
+
+// Converts a raw OBJ index to a global 0-based index or a chunk-local one (see kChunkLocalBit).
+uint32_t ConvertIndex(int raw_idx, size_t local_count) {
+  if (raw_idx > 0) {
+    return static_cast<uint32_t>(raw_idx - 1);
+  }
+
+  if (raw_idx < 0) {
+    // May be negative if the index refers to an attribute in a previous chunk.
+    int64_t local_idx = static_cast<int64_t>(local_count) + raw_idx;
+    return (static_cast<uint32_t>(local_idx) & kChunkLocalMask) | kChunkLocalBit;
+  }
+
+  return kNoIndex;
+}
+
+void ParseChunk(const char* begin, const char* end, ChunkResult* result) {
+  tinyobj::callback_t callback;
+
+  callback.vertex_cb = [](void* user_data, tinyobj::real_t x, tinyobj::real_t y,
+                          tinyobj::real_t z, tinyobj::real_t) {
+    auto chunk = static_cast<ChunkResult*>(user_data);
+    chunk->positions.insert(chunk->positions.end(), {x, y, z});
+  };
+
+  callback.normal_cb = [](void* user_data, tinyobj::real_t x, tinyobj::real_t y,
+                          tinyobj::real_t z) {
+    auto chunk = static_cast<ChunkResult*>(user_data);
+    chunk->normals.insert(chunk->normals.end(), {x, y, z});
+  };
+
+  callback.texcoord_cb = [](void* user_data, tinyobj::real_t x, tinyobj::real_t y,
+                            tinyobj::real_t) {
+    auto chunk = static_cast<ChunkResult*>(user_data);
+    chunk->texcoords.insert(chunk->texcoords.end(), {x, y});
+  };
+
+  callback.index_cb = [](void* user_data, tinyobj::index_t* indices, int num_indices) {
+    auto chunk = static_cast<ChunkResult*>(user_data);
+
+    auto convert = [chunk](const tinyobj::index_t& idx) {
+      FaceVertex face_vertex;
+      face_vertex.position = ConvertIndex(idx.vertex_index, chunk->positions.size() / 3);
+      face_vertex.normal = ConvertIndex(idx.normal_index, chunk->normals.size() / 3);
+      face_vertex.texcoord = ConvertIndex(idx.texcoord_index, chunk->texcoords.size() / 2);
+      return face_vertex;
+    };
+
+    // Triangulates the polygon as a fan around its first vertex.
+    for (int i = 2; i < num_indices; ++i) {
+      chunk->face_vertices.push_back(convert(indices[0]));
+      chunk->face_vertices.push_back(convert(indices[i - 1]));
+      chunk->face_vertices.push_back(convert(indices[i]));
+    }
+  };
+
+  callback.object_cb = [](void* user_data, const char* name) {
+    auto chunk = static_cast<ChunkResult*>(user_data);
+
+    std::string object_name = name;
+    object_name.erase(object_name.find_last_not_of(" \t\r\n") + 1);
+
+    chunk->objects.push_back({object_name, chunk->face_vertices.size()});
+  };
+
+  // Groups start a submesh just like objects. A group with several names is named after all of
+  // them.
+  callback.group_cb = [](void* user_data, const char** names, int num_names) {
+    auto chunk = static_cast<ChunkResult*>(user_data);
+
+    std::string group_name;
+    for (int i = 0; i < num_names; ++i) {
+      if (i > 0) {
+        group_name += ' ';
+      }
+      group_name += names[i];
+    }
+
+    chunk->objects.push_back({group_name, chunk->face_vertices.size()});
+  };
+
+  MemoryStreamBuf stream_buf(begin, end);
+  std::istream stream(&stream_buf);
+
+  std::string warn;
+  std::string err;
+  if (!tinyobj::LoadObjWithCallback(stream, callback, result, nullptr, &warn, &err)) {
+    std::cerr << "Could not parse OBJ chunk: " << err << std::endl;
+    result->success = false;
+  }
+}
+
+// Resolves chunk-local indices against the chunk's attribute base and checks the range.
+bool ResolveIndex(uint32_t* idx, uint32_t base, uint32_t count) {
+  if (*idx == kNoIndex) {
+    return true;
+  }
+
+  if (*idx & kChunkLocalBit) {
+    // Sign-extends the 30-bit offset.
+    int64_t local_idx = static_cast<int32_t>(*idx << 2) >> 2;
+    int64_t global_idx = base + local_idx;
+    if (global_idx < 0) {
+      return false;
+    }
+
+    *idx = static_cast<uint32_t>(global_idx);
+  }
+
+  return *idx < count;
+}
+
+// Open-addressing hash map from face vertices to deduplicated vertex indices.
+class FaceVertexMap {
+public:
+  FaceVertexMap(size_t max_size) {
+    size_t capacity = 16;
+    while (capacity < max_size * 2) {
+      capacity *= 2;
+    }
+
+    keys_.resize(capacity);
+    values_.resize(capacity, kNoIndex);
+    mask_ = capacity - 1;
+  }
+
+  // Returns the value mapped to key, inserting value first if there is none.
+  uint32_t FindOrInsert(const FaceVertex& key, uint32_t value) {
+    for (size_t slot = Hash(key) & mask_;; slot = (slot + 1) & mask_) {
+      if (values_[slot] == kNoIndex) {
+        keys_[slot] = key;
+        values_[slot] = value;
+        return value;
+      }
+
+      if (keys_[slot] == key) {
+        return values_[slot];
+      }
+    }
+  }
+
+private:
+  static size_t Hash(const FaceVertex& key) {
+    uint64_t hash = key.position;
+    hash = hash * 0x9E3779B97F4A7C15ull ^ key.normal;
+    hash = hash * 0x9E3779B97F4A7C15ull ^ key.texcoord;
+    hash ^= hash >> 32;
+    return static_cast<size_t>(hash * 0x9E3779B97F4A7C15ull >> 16);
+  }
+
+  std::vector<FaceVertex> keys_;
+  std::vector<uint32_t> values_;
+  size_t mask_;
+};
+
+void BuildSubMesh(const std::vector<FaceVertex>& face_vertices, size_t begin, size_t end,
+                  const std::vector<float>& positions, const std::vector<float>& normals,
+                  const std::vector<float>& texcoords, SubMeshResult* result) {
+  FaceVertexMap vertex_map(end - begin);
+
+  result->indices.reserve(end - begin);
+
+  for (size_t i = begin; i < end; ++i) {
+    const FaceVertex& face_vertex = face_vertices[i];
+
+    uint32_t next_idx = static_cast<uint32_t>(result->vertices.size());
+    uint32_t idx = vertex_map.FindOrInsert(face_vertex, next_idx);
+
+    if (idx == next_idx) {
+      Vertex vertex = {};
+
+      std::copy_n(&positions[size_t{face_vertex.position} * 3], 3, vertex.position);
+
+      if (face_vertex.normal != kNoIndex) {
+        std::copy_n(&normals[size_t{face_vertex.normal} * 3], 3, vertex.normal);
+      }
+      if (face_vertex.texcoord != kNoIndex) {
+        std::copy_n(&texcoords[size_t{face_vertex.texcoord} * 2], 2, vertex.texcoord);
+      }
+
+      result->vertices.push_back(vertex);
+    }
+
+    result->indices.push_back(idx);
+  }
+}
+
+} // namespace
+
+std::optional<MeshData> ImportObj(const std::string& path, gal::GALWorkerPool* worker_pool) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Could not open OBJ file: " << path << std::endl;
+    return std::nullopt;
+  }
+
+  std::vector<char> file_data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(file_data.data(), file_data.size())) {
+    std::cerr << "Could not read OBJ file: " << path << std::endl;
+    return std::nullopt;
+  }
+
+  size_t thread_count = worker_pool != nullptr ? worker_pool->GetWorkerCount() : 1;
+  std::vector<std::pair<size_t, size_t>> chunk_ranges = SplitIntoChunks(file_data, thread_count);
+  std::vector<ChunkResult> chunks(chunk_ranges.size());
+
+  RunTasks(chunks.size(), worker_pool, [&](size_t i) {
+    ParseChunk(file_data.data() + chunk_ranges[i].first,
+               file_data.data() + chunk_ranges[i].second, &chunks[i]);
+  });
+
+  // Merges the chunks' attributes and face vertices.
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> texcoords;
+  std::vector<FaceVertex> face_vertices;
+  std::vector<ObjectStart> objects;
+
+  for (ChunkResult& chunk : chunks) {
+    if (!chunk.success) {
+      return std::nullopt;
+    }
+
+    for (ObjectStart& object : chunk.objects) {
+      objects.push_back({std::move(object.name),
+                         object.first_face_vertex + face_vertices.size()});
+    }
+
+    uint32_t position_base = static_cast<uint32_t>(positions.size() / 3);
+    uint32_t normal_base = static_cast<uint32_t>(normals.size() / 3);
+    uint32_t texcoord_base = static_cast<uint32_t>(texcoords.size() / 2);
+
+    positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+    normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+
+    for (FaceVertex& face_vertex : chunk.face_vertices) {
+      if (face_vertex.position == kNoIndex ||
+          !ResolveIndex(&face_vertex.position, position_base,
+                        static_cast<uint32_t>(positions.size() / 3)) ||
+          !ResolveIndex(&face_vertex.normal, normal_base,
+                        static_cast<uint32_t>(normals.size() / 3)) ||
+          !ResolveIndex(&face_vertex.texcoord, texcoord_base,
+                        static_cast<uint32_t>(texcoords.size() / 2))) {
+        std::cerr << "OBJ file has out-of-range face indices: " << path << std::endl;
+        return std::nullopt;
+      }
+    }
+
+    face_vertices.insert(face_vertices.end(), chunk.face_vertices.begin(),
+                         chunk.face_vertices.end());
+
+    chunk = ChunkResult();
+  }
+
+  // Faces before the first object, or all of them if there are no objects, get an unnamed submesh.
+  if (objects.empty() || objects.front().first_face_vertex != 0) {
+    objects.insert(objects.begin(), {"", 0});
+  }
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  std::vector<std::string> names;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    size_t end = i + 1 < objects.size() ? objects[i + 1].first_face_vertex :
+                                          face_vertices.size();
+    if (end > objects[i].first_face_vertex) {
+      ranges.push_back({objects[i].first_face_vertex, end});
+      names.push_back(std::move(objects[i].name));
+    }
+  }
+
+  std::vector<SubMeshResult> submesh_results(ranges.size());
+
+  RunTasks(ranges.size(), worker_pool, [&](size_t i) {
+    BuildSubMesh(face_vertices, ranges[i].first, ranges[i].second, positions, normals,
+                 texcoords, &submesh_results[i]);
+  });
+
+  MeshData mesh_data;
+
+  size_t vertex_count = 0;
+  size_t index_count = 0;
+  for (const SubMeshResult& result : submesh_results) {
+    vertex_count += result.vertices.size();
+    index_count += result.indices.size();
+  }
+  mesh_data.vertices.reserve(vertex_count);
+  mesh_data.indices.reserve(index_count);
+
+  for (size_t i = 0; i < submesh_results.size(); ++i) {
+    SubMesh submesh;
+    submesh.name = std::move(names[i]);
+    submesh.first_index = static_cast<uint32_t>(mesh_data.indices.size());
+    submesh.index_count = static_cast<uint32_t>(submesh_results[i].indices.size());
+    submesh.vertex_offset = static_cast<int32_t>(mesh_data.vertices.size());
+    mesh_data.submeshes.push_back(std::move(submesh));
+
+    mesh_data.vertices.insert(mesh_data.vertices.end(), submesh_results[i].vertices.begin(),
+                              submesh_results[i].vertices.end());
+    mesh_data.indices.insert(mesh_data.indices.end(), submesh_results[i].indices.begin(),
+                             submesh_results[i].indices.end());
+  }
+
+  ComputeBounds(&mesh_data);
+
+  return mesh_data;
+}
+
+} // namespace mesh
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef MESH_OBJ_IMPORTER_H_
+#define MESH_OBJ_IMPORTER_H_
+
+#include <optional>
+#include <string>
+#include "gal/gal_worker_pool.h"
+#include "mesh/mesh.h"
+
+namespace mesh {
+
+// Imports a Wavefront OBJ file as an indexed triangle mesh. Polygons are triangulated and
+// position/normal/texcoord tuples are deduplicated into shared vertices. Each object ('o') and
+// group ('g') in the file starts a new SubMesh. The file is split into chunks, which are parsed,
+// and submeshes, which are built, on the worker pool's threads if it is non-null.
+//
+// Returns std::nullopt if the file cannot be read or has out-of-range face indices.
+std::optional<MeshData> ImportObj(const std::string& path, gal::GALWorkerPool* worker_pool);
+
+} // namespace mesh
+
+#endif // MESH_OBJ_IMPORTER_H_
\ No newline at end of file
@@ -0,0 +1,515 @@
+#include "scene/bvh.h"
+
+#if defined(__AVX__)
+#define SCENE_BVH_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_BVH_SSE
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include "gal/gal_worker_pool.h"
+#include "scene/frustum.h"
+
+namespace scene {
+
+namespace {
+
+// SAH split candidates per axis.
+const uint32_t kBinCount = 16;
+
+// More tasks than workers, so that a worker that finishes early can take another subtree.
+const uint32_t kTasksPerWorker = 4;
+
+const Aabb kEmptyAabb = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+void Grow(Aabb* box, const Aabb& other) {
+  for (int axis = 0; axis < 3; ++axis) {
+    box->min[axis] = std::min(box->min[axis], other.min[axis]);
+    box->max[axis] = std::max(box->max[axis], other.max[axis]);
+  }
+}
+
+float SurfaceArea(const Aabb& box) {
+  float dx = box.max[0] - box.min[0];
+  float dy = box.max[1] - box.min[1];
+  float dz = box.max[2] - box.min[2];
+  if (dx < 0.f || dy < 0.f || dz < 0.f) {
+    return 0.f;
+  }
+  return 2.f * (dx * dy + dy * dz + dz * dx);
+}
+
+} // namespace
+
+void Bvh::Build(const std::vector<Aabb>& object_bounds) {
+  object_bounds_ = object_bounds;
+  nodes_.clear();
+  object_nodes_.assign(object_bounds.size(), kEmptySlot);
+  dirty_nodes_.clear();
+  any_dirty_ = false;
+
+  if (object_bounds.empty()) {
+    return;
+  }
+
+  uint32_t object_count = static_cast<uint32_t>(object_bounds.size());
+
+  std::vector<float> centroids(3 * object_count);
+  for (uint32_t i = 0; i < object_count; ++i) {
+    for (int axis = 0; axis < 3; ++axis) {
+      centroids[3 * i + axis] = (object_bounds[i].min[axis] + object_bounds[i].max[axis]) * 0.5f;
+    }
+  }
+
+  std::vector<uint32_t> objects(object_count);
+  std::iota(objects.begin(), objects.end(), 0);
+
+  // A binary tree with one object per leaf has 2n - 1 nodes, and collapsing it leaves fewer
+  // than n.
+  build_nodes_.reserve(2 * object_count);
+  nodes_.reserve(object_count);
+
+  uint32_t root = BuildBinary(objects.data(), object_count, centroids);
+  Collapse(root, kEmptySlot);
+
+  dirty_nodes_.assign(nodes_.size(), 0);
+
+  build_nodes_.clear();
+  build_nodes_.shrink_to_fit();
+}
+
+void Bvh::UpdateObject(uint32_t object_idx, const Aabb& bounds) {
+  object_bounds_[object_idx] = bounds;
+
+  // Nodes above a dirty node are already dirty.
+  for (uint32_t node_idx = object_nodes_[object_idx];
+       node_idx != kEmptySlot && !dirty_nodes_[node_idx]; node_idx = nodes_[node_idx].parent) {
+    dirty_nodes_[node_idx] = 1;
+  }
+  any_dirty_ = true;
+}
+
+void Bvh::Refit() {
+  if (!any_dirty_) {
+    return;
+  }
+
+  // Children come after their parents, so walking backwards refits them first.
+  for (size_t i = nodes_.size(); i-- > 0;) {
+    if (!dirty_nodes_[i]) {
+      continue;
+    }
+
+    Node& node = nodes_[i];
+    for (uint32_t slot = 0; slot < kNodeWidth; ++slot) {
+      uint32_t child = node.child[slot];
+      if (child == kEmptySlot) {
+        continue;
+      }
+
+      SetSlot(&node, slot, child, (child & kObjectBit) ? object_bounds_[child & ~kObjectBit]
+                                                      : GetNodeBounds(nodes_[child]));
+    }
+    dirty_nodes_[i] = 0;
+  }
+  any_dirty_ = false;
+}
+
+void Bvh::Cull(const Frustum& frustum, gal::GALWorkerPool* worker_pool,
+               std::vector<uint32_t>* visible) {
+  visible->clear();
+  if (nodes_.empty()) {
+    return;
+  }
+
+  tasks_.clear();
+  tasks_.push_back({0, false});
+
+  // The top of the tree is culled here until there are enough subtrees to spread over the
+  // workers.
+  uint32_t target_task_count = worker_pool != nullptr
+                                   ? worker_pool->GetWorkerCount() * kTasksPerWorker
+                                   : 1;
+
+  while (!tasks_.empty() && tasks_.size() < target_task_count) {
+    next_tasks_.clear();
+    bool expanded = false;
+
+    for (const CullTask& task : tasks_) {
+      if (task.inside) {
+        next_tasks_.push_back(task);
+        continue;
+      }
+      expanded = true;
+
+      const Node& node = nodes_[task.node];
+
+      uint32_t outside;
+      uint32_t inside;
+      TestNode(node, frustum, &outside, &inside);
+
+      for (uint32_t slot = 0; slot < kNodeWidth; ++slot) {
+        uint32_t child = node.child[slot];
+        if (child == kEmptySlot || (outside >> slot) & 1) {
+          continue;
+        }
+
+        if (child & kObjectBit) {
+          visible->push_back(child & ~kObjectBit);
+        } else {
+          next_tasks_.push_back({child, ((inside >> slot) & 1) != 0});
+        }
+      }
+    }
+
+    std::swap(tasks_, next_tasks_);
+    if (!expanded) {
+      break;
+    }
+  }
+
+  uint32_t task_count = static_cast<uint32_t>(tasks_.size());
+  if (task_visible_.size() < task_count) {
+    task_visible_.resize(task_count);
+    task_stacks_.resize(task_count);
+  }
+
+  if (worker_pool != nullptr && task_count > 1) {
+    worker_pool->ParallelFor(task_count, [this, &frustum](uint32_t task_idx, uint32_t) {
+      task_visible_[task_idx].clear();
+      CullSubtree(tasks_[task_idx], frustum, &task_stacks_[task_idx], &task_visible_[task_idx]);
+    });
+  } else {
+    for (uint32_t i = 0; i < task_count; ++i) {
+      task_visible_[i].clear();
+      CullSubtree(tasks_[i], frustum, &task_stacks_[i], &task_visible_[i]);
+    }
+  }
+
+  for (uint32_t i = 0; i < task_count; ++i) {
+    visible->insert(visible->end(), task_visible_[i].begin(), task_visible_[i].end());
+  }
+}
+
+Bvh::Stats Bvh::GetStats() const {
+  Stats stats;
+  stats.node_count = static_cast<uint32_t>(nodes_.size());
+
+  // Parents come before their children, so one pass finds every node's depth.
+  std::vector<uint32_t> depths(nodes_.size(), 1);
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].parent != kEmptySlot) {
+      depths[i] = depths[nodes_[i].parent] + 1;
+    }
+    stats.depth = std::max(stats.depth, depths[i]);
+  }
+  return stats;
+}
+
+uint32_t Bvh::BuildBinary(uint32_t* objects, uint32_t count,
+                          const std::vector<float>& centroids) {
+  uint32_t node_idx = static_cast<uint32_t>(build_nodes_.size());
+  build_nodes_.push_back({});
+
+  Aabb bounds = kEmptyAabb;
+  Aabb centroid_bounds = kEmptyAabb;
+  for (uint32_t i = 0; i < count; ++i) {
+    Grow(&bounds, object_bounds_[objects[i]]);
+
+    const float* centroid = &centroids[3 * objects[i]];
+    Grow(&centroid_bounds, {{centroid[0], centroid[1], centroid[2]},
+                            {centroid[0], centroid[1], centroid[2]}});
+  }
+
+  if (count == 1) {
+    build_nodes_[node_idx] = {bounds, kEmptySlot, kEmptySlot, objects[0]};
+    return node_idx;
+  }
+
+  // Finds the bin boundary with the lowest surface area heuristic cost, over all three axes.
+  float best_cost = FLT_MAX;
+  int best_axis = -1;
+  uint32_t best_split = 0;
+
+  struct Bin {
+    Aabb bounds;
+    uint32_t count;
+  };
+
+  for (int axis = 0; axis < 3; ++axis) {
+    float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+    if (extent <= 0.f) {
+      continue;
+    }
+
+    Bin bins[kBinCount];
+    for (Bin& bin : bins) {
+      bin = {kEmptyAabb, 0};
+    }
+
+    float scale = kBinCount / extent;
+    for (uint32_t i = 0; i < count; ++i) {
+      float offset = centroids[3 * objects[i] + axis] - centroid_bounds.min[axis];
+      uint32_t bin_idx = std::min(kBinCount - 1, static_cast<uint32_t>(offset * scale));
+      Grow(&bins[bin_idx].bounds, object_bounds_[objects[i]]);
+      ++bins[bin_idx].count;
+    }
+
+    // right_costs[i] is the cost of the bins from i onwards.
+    float right_costs[kBinCount];
+    Aabb right_bounds = kEmptyAabb;
+    uint32_t right_count = 0;
+    for (uint32_t i = kBinCount; i-- > 1;) {
+      Grow(&right_bounds, bins[i].bounds);
+      right_count += bins[i].count;
+      right_costs[i] = SurfaceArea(right_bounds) * right_count;
+    }
+
+    Aabb left_bounds = kEmptyAabb;
+    uint32_t left_count = 0;
+    for (uint32_t split = 1; split < kBinCount; ++split) {
+      Grow(&left_bounds, bins[split - 1].bounds);
+      left_count += bins[split - 1].count;
+
+      float cost = SurfaceArea(left_bounds) * left_count + right_costs[split];
+      if (left_count > 0 && left_count < count && cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split;
+      }
+    }
+  }
+
+  uint32_t mid = count / 2;
+  if (best_axis >= 0) {
+    float extent = centroid_bounds.max[best_axis] - centroid_bounds.min[best_axis];
+    float scale = kBinCount / extent;
+
+    uint32_t* mid_ptr = std::partition(objects, objects + count, [&](uint32_t object) {
+      float offset = centroids[3 * object + best_axis] - centroid_bounds.min[best_axis];
+      return std::min(kBinCount - 1, static_cast<uint32_t>(offset * scale)) < best_split;
+    });
+    mid = static_cast<uint32_t>(mid_ptr - objects);
+  }
+
+  // Centroids that all coincide cannot be split by position, so the objects are split in half.
+  if (mid == 0 || mid == count) {
+    mid = count / 2;
+  }
+
+  uint32_t left = BuildBinary(objects, mid, centroids);
+  uint32_t right = BuildBinary(objects + mid, count - mid, centroids);
+
+  build_nodes_[node_idx] = {bounds, left, right, kEmptySlot};
+  return node_idx;
+}
+
+uint32_t Bvh::Collapse(uint32_t build_node_idx, uint32_t parent) {
+  uint32_t node_idx = static_cast<uint32_t>(nodes_.size());
+  nodes_.emplace_back();
+
+  for (uint32_t slot = 0; slot < kNodeWidth; ++slot) {
+    SetSlot(&nodes_[node_idx], slot, kEmptySlot, kEmptyAabb);
+  }
+  nodes_[node_idx].parent = parent;
+
+  // Opens up the binary tree below this node, largest child first, until it fills the node.
+  uint32_t children[kNodeWidth];
+  uint32_t child_count = 0;
+
+  const BuildNode& build_node = build_nodes_[build_node_idx];
+  if (build_node.left == kEmptySlot) {
+    children[child_count++] = build_node_idx;
+  } else {
+    children[child_count++] = build_node.left;
+    children[child_count++] = build_node.right;
+  }
+
+  while (child_count < kNodeWidth) {
+    int largest = -1;
+    float largest_area = -1.f;
+    for (uint32_t i = 0; i < child_count; ++i) {
+      const BuildNode& child = build_nodes_[children[i]];
+      float area = SurfaceArea(child.bounds);
+      if (child.left != kEmptySlot && area > largest_area) {
+        largest = static_cast<int>(i);
+        largest_area = area;
+      }
+    }
+
+    if (largest < 0) {
+      break;
+    }
+
+    const BuildNode& opened = build_nodes_[children[largest]];
+    children[largest] = opened.left;
+    children[child_count++] = opened.right;
+  }
+
+  for (uint32_t slot = 0; slot < child_count; ++slot) {
+    const BuildNode& child = build_nodes_[children[slot]];
+
+    if (child.left == kEmptySlot) {
+      SetSlot(&nodes_[node_idx], slot, child.object | kObjectBit, child.bounds);
+      object_nodes_[child.object] = node_idx;
+    } else {
+      uint32_t child_node_idx = Collapse(children[slot], node_idx);
+      SetSlot(&nodes_[node_idx], slot, child_node_idx, child.bounds);
+    }
+  }
+
+  return node_idx;
+}
+
+void Bvh::SetSlot(Node* node, uint32_t slot, uint32_t child, const Aabb& bounds) {
+  node->min_x[slot] = bounds.min[0];
+  node->min_y[slot] = bounds.min[1];
+  node->min_z[slot] = bounds.min[2];
+  node->max_x[slot] = bounds.max[0];
+  node->max_y[slot] = bounds.max[1];
+  node->max_z[slot] = bounds.max[2];
+  node->child[slot] = child;
+}
+
+Aabb Bvh::GetNodeBounds(const Node& node) const {
+  // Unused slots have inverted bounds, so they do not contribute.
+  Aabb bounds = kEmptyAabb;
+  for (uint32_t slot = 0; slot < kNodeWidth; ++slot) {
+    Grow(&bounds, {{node.min_x[slot], node.min_y[slot], node.min_z[slot]},
+                   {node.max_x[slot], node.max_y[slot], node.max_z[slot]}});
+  }
+  return bounds;
+}
+
+void Bvh::TestNode(const Node& node, const Frustum& frustum, uint32_t* outside,
+                   uint32_t* inside) {
+  // For each plane, a box is outside if its corner furthest along the plane's normal is
+  // outside, and inside if its nearest corner is inside. The corners are picked per plane
+  // rather than per box, since every box in the node shares the plane. The sums are in the
+  // same order as IsOutside(), so the results match it exactly.
+#if defined(SCENE_BVH_AVX)
+  __m256 zero = _mm256_setzero_ps();
+  __m256 outside_mask = zero;
+  __m256 inside_mask = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+  for (const float* plane : frustum.planes) {
+    __m256 normal_x = _mm256_set1_ps(plane[0]);
+    __m256 normal_y = _mm256_set1_ps(plane[1]);
+    __m256 normal_z = _mm256_set1_ps(plane[2]);
+    __m256 distance = _mm256_set1_ps(plane[3]);
+
+    __m256 far = _mm256_add_ps(distance, _mm256_mul_ps(normal_x, _mm256_loadu_ps(
+        plane[0] > 0.f ? node.max_x : node.min_x)));
+    far = _mm256_add_ps(far, _mm256_mul_ps(normal_y, _mm256_loadu_ps(
+        plane[1] > 0.f ? node.max_y : node.min_y)));
+    far = _mm256_add_ps(far, _mm256_mul_ps(normal_z, _mm256_loadu_ps(
+        plane[2] > 0.f ? node.max_z : node.min_z)));
+
+    __m256 near = _mm256_add_ps(distance, _mm256_mul_ps(normal_x, _mm256_loadu_ps(
+        plane[0] > 0.f ? node.min_x : node.max_x)));
+    near = _mm256_add_ps(near, _mm256_mul_ps(normal_y, _mm256_loadu_ps(
+        plane[1] > 0.f ? node.min_y : node.max_y)));
+    near = _mm256_add_ps(near, _mm256_mul_ps(normal_z, _mm256_loadu_ps(
+        plane[2] > 0.f ? node.min_z : node.max_z)));
+
+    outside_mask = _mm256_or_ps(outside_mask, _mm256_cmp_ps(far, zero, _CMP_LT_OQ));
+    inside_mask = _mm256_and_ps(inside_mask, _mm256_cmp_ps(near, zero, _CMP_GE_OQ));
+  }
+
+  *outside = static_cast<uint32_t>(_mm256_movemask_ps(outside_mask));
+  *inside = static_cast<uint32_t>(_mm256_movemask_ps(inside_mask));
+#elif defined(SCENE_BVH_SSE)
+  __m128 zero = _mm_setzero_ps();
+  __m128 outside_mask = zero;
+  __m128 inside_mask = _mm_cmpeq_ps(zero, zero);
+
+  for (const float* plane : frustum.planes) {
+    __m128 normal_x = _mm_set1_ps(plane[0]);
+    __m128 normal_y = _mm_set1_ps(plane[1]);
+    __m128 normal_z = _mm_set1_ps(plane[2]);
+    __m128 distance = _mm_set1_ps(plane[3]);
+
+    __m128 far = _mm_add_ps(distance, _mm_mul_ps(normal_x, _mm_loadu_ps(
+        plane[0] > 0.f ? node.max_x : node.min_x)));
+    far = _mm_add_ps(far, _mm_mul_ps(normal_y, _mm_loadu_ps(
+        plane[1] > 0.f ? node.max_y : node.min_y)));
+    far = _mm_add_ps(far, _mm_mul_ps(normal_z, _mm_loadu_ps(
+        plane[2] > 0.f ? node.max_z : node.min_z)));
+
+    __m128 near = _mm_add_ps(distance, _mm_mul_ps(normal_x, _mm_loadu_ps(
+        plane[0] > 0.f ? node.min_x : node.max_x)));
+    near = _mm_add_ps(near, _mm_mul_ps(normal_y, _mm_loadu_ps(
+        plane[1] > 0.f ? node.min_y : node.max_y)));
+    near = _mm_add_ps(near, _mm_mul_ps(normal_z, _mm_loadu_ps(
+        plane[2] > 0.f ? node.min_z : node.max_z)));
+
+    outside_mask = _mm_or_ps(outside_mask, _mm_cmplt_ps(far, zero));
+    inside_mask = _mm_and_ps(inside_mask, _mm_cmpge_ps(near, zero));
+  }
+
+  *outside = static_cast<uint32_t>(_mm_movemask_ps(outside_mask));
+  *inside = static_cast<uint32_t>(_mm_movemask_ps(inside_mask));
+#else
+  *outside = 0;
+  *inside = 0;
+
+  for (uint32_t slot = 0; slot < kNodeWidth; ++slot) {
+    Aabb box = {{node.min_x[slot], node.min_y[slot], node.min_z[slot]},
+                {node.max_x[slot], node.max_y[slot], node.max_z[slot]}};
+
+    bool is_inside = true;
+    for (const float* plane : frustum.planes) {
+      float near = plane[3];
+      for (int axis = 0; axis < 3; ++axis) {
+        near += plane[axis] * (plane[axis] > 0.f ? box.min[axis] : box.max[axis]);
+      }
+      is_inside = is_inside && near >= 0.f;
+    }
+
+    *outside |= static_cast<uint32_t>(IsOutside(frustum, box)) << slot;
+    *inside |= static_cast<uint32_t>(is_inside) << slot;
+  }
+#endif
+}
+
+void Bvh::CullSubtree(const CullTask& task, const Frustum& frustum,
+                      std::vector<uint32_t>* stack, std::vector<uint32_t>* visible) const {
+  stack->clear();
+  stack->push_back(task.node | (task.inside ? kInsideBit : 0));
+
+  while (!stack->empty()) {
+    uint32_t entry = stack->back();
+    stack->pop_back();
+
+    const Node& node = nodes_[entry & ~kInsideBit];
+
+    // Nothing below a node that is inside the frustum needs to be tested.
+    uint32_t outside = 0;
+    uint32_t inside = ~0u;
+    if (!(entry & kInsideBit)) {
+      TestNode(node, frustum, &outside, &inside);
+    }
+
+    for (uint32_t slot = 0; slot < kNodeWidth; ++slot) {
+      uint32_t child = node.child[slot];
+      if (child == kEmptySlot || (outside >> slot) & 1) {
+        continue;
+      }
+
+      if (child & kObjectBit) {
+        visible->push_back(child & ~kObjectBit);
+      } else {
+        stack->push_back(child | (((inside >> slot) & 1) ? kInsideBit : 0));
+      }
+    }
+  }
+}
+
+} // namespace scene
\ No newline at end of file
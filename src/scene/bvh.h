@@ -0,0 +1,131 @@
+#ifndef SCENE_BVH_H_
+#define SCENE_BVH_H_
+
+#include <cstdint>
+#include <vector>
+#include "gal/gal_worker_pool.h"
+#include "scene/frustum.h"
+
+namespace scene {
+
+// A bounding volume hierarchy over object AABBs, for frustum culling on the CPU.
+//
+// The tree is built as a binary tree with binned SAH, and collapsed into nodes of kNodeWidth
+// children, whose bounds are stored as SoA so that a node's children are tested against a plane
+// with a few SIMD instructions: 8 at a time with AVX, 4 with SSE, and one at a time otherwise.
+// Every child is either another node or a single object, so objects are tested the same way.
+//
+// Objects that move are refit rather than rebuilt: UpdateObject() only marks the nodes above
+// the object, and Refit() recomputes the marked nodes. The tree's quality degrades as objects
+// move far from where it was built, after which it should be rebuilt.
+class Bvh {
+public:
+#if defined(__AVX__)
+  static constexpr uint32_t kNodeWidth = 8;
+#else
+  static constexpr uint32_t kNodeWidth = 4;
+#endif
+
+  struct Stats {
+    uint32_t node_count = 0;
+    uint32_t depth = 0;
+  };
+
+  // Replaces the tree with one over these objects. Object i keeps index i.
+  void Build(const std::vector<Aabb>& object_bounds);
+
+  void UpdateObject(uint32_t object_idx, const Aabb& bounds);
+
+  // Recomputes the bounds of every node above an object that has been updated since the last
+  // refit.
+  void Refit();
+
+  // Writes the indices of the objects that are not outside the frustum to visible, in no
+  // particular order. Subtrees are culled on the worker pool's threads if it is non-null. The
+  // scratch buffers are kept between calls, so culling every frame does not allocate once they
+  // have grown to fit.
+  void Cull(const Frustum& frustum, gal::GALWorkerPool* worker_pool,
+            std::vector<uint32_t>* visible);
+
+  uint32_t GetObjectCount() const { return static_cast<uint32_t>(object_bounds_.size()); }
+  Stats GetStats() const;
+
+private:
+  // Set in a child slot for objects, and all bits for unused slots.
+  static constexpr uint32_t kObjectBit = 0x80000000;
+  static constexpr uint32_t kEmptySlot = 0xFFFFFFFF;
+
+  struct alignas(32) Node {
+    // Unused slots have inverted bounds at the edge of the float range, which are outside of
+    // every plane.
+    float min_x[kNodeWidth];
+    float min_y[kNodeWidth];
+    float min_z[kNodeWidth];
+    float max_x[kNodeWidth];
+    float max_y[kNodeWidth];
+    float max_z[kNodeWidth];
+
+    // The child node's index, or the object's index with kObjectBit set. Child nodes always
+    // come after their parents.
+    uint32_t child[kNodeWidth];
+
+    uint32_t parent;
+  };
+
+  struct BuildNode {
+    Aabb bounds;
+
+    // Both set for internal nodes. object is set for leaves.
+    uint32_t left;
+    uint32_t right;
+    uint32_t object;
+  };
+
+  // A subtree whose root is known not to be outside the frustum. Its objects are all visible if
+  // it is known to be inside.
+  struct CullTask {
+    uint32_t node;
+    bool inside;
+  };
+
+  // Set on the entries of a cull stack whose node is inside the frustum.
+  static constexpr uint32_t kInsideBit = 0x80000000;
+
+  uint32_t BuildBinary(uint32_t* objects, uint32_t count,
+                       const std::vector<float>& centroids);
+  uint32_t Collapse(uint32_t build_node_idx, uint32_t parent);
+
+  void SetSlot(Node* node, uint32_t slot, uint32_t child, const Aabb& bounds);
+  Aabb GetNodeBounds(const Node& node) const;
+
+  // Sets bit i of *outside for each child slot that is outside of a plane, and bit i of
+  // *inside for each slot that is inside of all of them.
+  static void TestNode(const Node& node, const Frustum& frustum, uint32_t* outside,
+                       uint32_t* inside);
+
+  void CullSubtree(const CullTask& task, const Frustum& frustum, std::vector<uint32_t>* stack,
+                   std::vector<uint32_t>* visible) const;
+
+private:
+  std::vector<Aabb> object_bounds_;
+  std::vector<Node> nodes_;
+
+  // The node whose slot holds each object.
+  std::vector<uint32_t> object_nodes_;
+
+  std::vector<uint8_t> dirty_nodes_;
+  bool any_dirty_ = false;
+
+  // Only used while building.
+  std::vector<BuildNode> build_nodes_;
+
+  // Scratch space for Cull(). The task buffers have one entry per task.
+  std::vector<CullTask> tasks_;
+  std::vector<CullTask> next_tasks_;
+  std::vector<std::vector<uint32_t>> task_visible_;
+  std::vector<std::vector<uint32_t>> task_stacks_;
+};
+
+} // namespace scene
+
+#endif // SCENE_BVH_H_
\ No newline at end of file
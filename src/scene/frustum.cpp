@@ -0,0 +1,49 @@
+#include "scene/frustum.h"
+
+#include <glm/glm.hpp>
+
+namespace scene {
+
+Frustum MakeFrustum(const glm::mat4& view_proj) {
+  glm::vec4 row[4];
+  for (int i = 0; i < 4; ++i) {
+    row[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+  }
+
+  // Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection
+  // Matrix", 2001. Vulkan clips depth to 0 <= z <= w rather than OpenGL's -w <= z <= w, so the
+  // near plane is z >= 0.
+  glm::vec4 planes[6] = {
+    row[3] + row[0],
+    row[3] - row[0],
+    row[3] + row[1],
+    row[3] - row[1],
+    row[2],
+    row[3] - row[2]
+  };
+
+  Frustum frustum;
+  for (int i = 0; i < 6; ++i) {
+    glm::vec4 plane = planes[i] / glm::length(glm::vec3(planes[i]));
+    for (int j = 0; j < 4; ++j) {
+      frustum.planes[i][j] = plane[j];
+    }
+  }
+  return frustum;
+}
+
+bool IsOutside(const Frustum& frustum, const Aabb& box) {
+  for (const float* plane : frustum.planes) {
+    // The corner furthest along the plane's normal.
+    float distance = plane[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      distance += plane[axis] * (plane[axis] > 0.f ? box.max[axis] : box.min[axis]);
+    }
+    if (distance < 0.f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace scene
\ No newline at end of file
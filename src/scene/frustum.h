@@ -0,0 +1,32 @@
+#ifndef SCENE_FRUSTUM_H_
+#define SCENE_FRUSTUM_H_
+
+#include <glm/glm.hpp>
+
+namespace scene {
+
+struct Aabb {
+  float min[3];
+  float max[3];
+};
+
+// Planes in the layout of a vec4 array, so that they can be uploaded as is. Each plane holds a
+// unit normal in xyz, pointing into the frustum, and a distance in w, so that points p with
+// dot(normal, p) + w >= 0 are on the inner side.
+struct Frustum {
+  float planes[6][4];
+};
+
+// The frustum that view_proj projects into Vulkan's clip volume, where 0 <= z <= w. Planes are in
+// the space that view_proj transforms from. With an OpenGL-style projection, such as
+// glm::perspective() without GLM_FORCE_DEPTH_ZERO_TO_ONE, the near plane is where the rasterizer
+// clips, which is further out than the projection's near distance.
+Frustum MakeFrustum(const glm::mat4& view_proj);
+
+// True if the box is entirely outside one of the planes. Conservative: boxes near the frustum's
+// edges can pass without touching it.
+bool IsOutside(const Frustum& frustum, const Aabb& box);
+
+} // namespace scene
+
+#endif // SCENE_FRUSTUM_H_
\ No newline at end of file
@@ -17,6 +17,11 @@ Window::Window(int width, int height, const std::string& title)
   if (glfw_window_ == nullptr) {
     throw Exception("Could not create GLFW window.");
   }
+
+  glfwGetFramebufferSize(glfw_window_, &width_, &height_);
+
+  glfwSetWindowUserPointer(glfw_window_, this);
+  glfwSetFramebufferSizeCallback(glfw_window_, OnFramebufferResized);
 }
 
 Window::~Window() {
@@ -39,6 +44,19 @@ bool Window::ShouldClose() {
   return glfwWindowShouldClose(glfw_window_);
 }
 
+bool Window::ConsumeResize() {
+  bool resized = resized_;
+  resized_ = false;
+  return resized;
+}
+
+void Window::OnFramebufferResized(GLFWwindow* glfw_window, int width, int height) {
+  Window* window = static_cast<Window*>(glfwGetWindowUserPointer(glfw_window));
+  window->width_ = width;
+  window->height_ = height;
+  window->resized_ = true;
+}
+
 VkSurfaceKHR Window::CreateVkSurface(VkInstance vk_instance) {
   VkSurfaceKHR surface;
   if (glfwCreateWindowSurface(vk_instance, glfw_window_, nullptr, &surface) != VK_SUCCESS) {
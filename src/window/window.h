@@ -35,16 +35,26 @@ public:
 
   VkSurfaceKHR CreateVkSurface(VkInstance vk_instance);
 
+  // The size of the framebuffer in pixels, which can differ from the size the window was created
+  // with, e.g. on high-DPI displays. 0 while the window is minimized.
   int GetWidth() const { return width_; }
   int GetHeight() const { return height_; }
   const std::string& GetTitle() const { return title_; }
 
+  // True if the framebuffer has been resized since the last call.
+  bool ConsumeResize();
+
+private:
+  static void OnFramebufferResized(GLFWwindow* glfw_window, int width, int height);
+
 private:
   GLFWwindow* glfw_window_;
 
   int width_;
   int height_;
   std::string title_;
+
+  bool resized_ = false;
 };
 
 } // namespace window